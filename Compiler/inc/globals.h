@@ -99,6 +99,29 @@ typedef enum {INTEGER_VAR = 0, CHARACTER_VAR, STRING_VAR, ATOM_VAR, LIST_VAR} GP
 
 typedef enum {NONE = 0, RED, GREEN, BLUE, GREY, DASHED, ANY} MarkType; 
 
+/* Host nodes are indexed by their signature, a number computed from the node's
+ * mark, outdegree, indegree, number of loops and root status. Degrees greater
+ * than SIG_DEGREE_CAP and loop counts greater than SIG_LOOP_CAP share the 
+ * signature of the cap. The compiler uses the same definitions to work out
+ * which signatures can match a rule node, so they are shared here. Setting
+ * both caps to 0 reduces the signature to the node's mark and root status.
+ * The marks that occur in host graphs are the MarkType values below ANY. */
+#define SIG_DEGREE_CAP 3
+#define SIG_LOOP_CAP 1
+#define SIG_CAPPED(value, cap) ((value) < (cap) ? (value) : (cap))
+#define SIGNATURE(mark, outdegree, indegree, loops, root)                   \
+   (((((mark) * (SIG_DEGREE_CAP + 1) + SIG_CAPPED(outdegree, SIG_DEGREE_CAP)) \
+      * (SIG_DEGREE_CAP + 1) + SIG_CAPPED(indegree, SIG_DEGREE_CAP))          \
+      * (SIG_LOOP_CAP + 1) + SIG_CAPPED(loops, SIG_LOOP_CAP)) * 2 + ((root) ? 1 : 0))
+#define NUMBER_OF_SIGNATURES SIGNATURE(ANY, 0, 0, 0, false)
+#define SIGNATURE_MARK(signature) ((signature) / SIGNATURE(1, 0, 0, 0, false))
+
+/* Host lists and strings are hashed with FNV-1a (see label.c). The compiler 
+ * computes the hashes of constant rule lists in the same way, so that the 
+ * matching code can reject most host lists by comparing hashes. */
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_STEP(hash, byte) (((hash) ^ (unsigned char)(byte)) * 16777619u)
+
 typedef enum {INT_CHECK = 0, CHAR_CHECK, STRING_CHECK, ATOM_CHECK, EDGE_PRED,
               EQUAL, NOT_EQUAL, GREATER, GREATER_EQUAL, LESS, LESS_EQUAL, 
 	      BOOL_NOT, BOOL_OR, BOOL_AND } ConditionType;
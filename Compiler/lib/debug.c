@@ -62,6 +62,19 @@ void closeTraceFile(void)
  *     graph->number_of_edges.
  * (7) Source and target consistency: For all edges E, if S is E's source and
  *     T is E's target, then E is in S's outedge list and E is in T's inedge list. 
+ * (8) Every node in the signature bucket for signature S has signature S, and
+ *     the number of nodes in all signature buckets is equal to 
+ *     graph->number_of_nodes.
+ * (9) The dense arrays of the node array hold the mark, root status and degrees
+ *     of every node, and those of the edge array hold the mark of every edge.
+ * (10) The root node set holds exactly the root nodes, each at its recorded
+ *      position.
+ * (11) If the label index is built, every node is indexed under its own list,
+ *      and the nodes in the bucket of a list have that list.
+ * (12) If the edge index is built, the edges in the bucket of a pair of nodes
+ *      go from the first to the second, and the buckets hold every edge.
+ * (13) graph->high_degree_arrays is the number of outdegrees and indegrees of
+ *      the nodes greater than EDGE_INDEX_MIN_DEGREE.
  */
 
 bool validGraph(Graph *graph)
@@ -104,12 +117,12 @@ bool validGraph(Graph *graph)
       {
          /* Keep a count of the number of nodes in the array. */
          node_count++;
-         int n;
-         for(n = 0; n < node->out_edges.size + 2; n++)
+         int n, *edges;
+         forEachOutEdge(node, edges, n)
          {
-            Edge *node_edge = getNthOutEdge(graph, node, n);
-            /* Keep a count of the number of outedges in the array. */
-            if(node_edge != NULL) edge_count++;           
+            Edge *node_edge = getEdge(graph, edges[n]);
+            /* Keep a count of the live outedges in the array. */
+            if(node_edge->index >= 0 && node_edge->source == node->index) edge_count++;
          }
          /* Invariant (3) */
          if(node->outdegree != edge_count)
@@ -121,11 +134,11 @@ bool validGraph(Graph *graph)
          }
          edge_count = 0;
 
-         for(n = 0; n < node->in_edges.size + 2; n++)
+         forEachInEdge(node, edges, n)
          {
-            Edge *node_edge = getNthInEdge(graph, node, n);
-            /* Keep a count of the number of inedges in the array. */
-            if(node_edge != NULL) edge_count++;
+            Edge *node_edge = getEdge(graph, edges[n]);
+            /* Keep a count of the live inedges in the array. */
+            if(node_edge->index >= 0 && node_edge->target == node->index) edge_count++;
          }
          /* Invariant (4) */
          if(node->indegree != edge_count)
@@ -178,18 +191,13 @@ bool validGraph(Graph *graph)
          Node *target = getNode(graph, edge->target);
 
          bool source_found = false;
-         if(source->first_out_edge == edge->index || source->second_out_edge == edge->index)
-            source_found = true;
-         if(!source_found)
+         int counter, *edges;
+         forEachOutEdge(source, edges, counter)
          {
-            int counter;
-            for(counter = 0; counter < source->out_edges.size; counter++)
+            if(edges[counter] == edge->index)
             {
-               if(source->out_edges.items[counter] == edge->index)
-               {
-                  source_found = true;
-                  break;
-               }
+               source_found = true;
+               break;
             }
          }
          /* Invariant (7) */
@@ -201,18 +209,12 @@ bool validGraph(Graph *graph)
          }   
 
          bool target_found = false;
-         if(target->first_in_edge == edge->index || target->second_in_edge == edge->index)
-            target_found = true;
-         if(!target_found)
+         forEachInEdge(target, edges, counter)
          {
-            int counter;
-            for(counter = 0; counter < target->in_edges.size; counter++)
+            if(edges[counter] == edge->index)
             {
-               if(target->in_edges.items[counter] == edge->index)
-               {
-                  target_found = true;
-                  break;
-               }
+               target_found = true;
+               break;
             }
          }
          if(!target_found)
@@ -232,6 +234,173 @@ bool validGraph(Graph *graph)
               "edges in the edge array (%d).\n", graph->number_of_edges, edge_count);
       valid_graph = false;
    }     
+
+   int signature, bucket_count = 0;
+   for(signature = 0; signature < NUMBER_OF_SIGNATURES; signature++)
+   {
+      for(node_index = getFirstNodeBySignature(graph, signature); node_index != -1; 
+          node_index = getNextNodeBySignature(graph, node_index))
+      {
+         bucket_count++;
+         Node *node = getNode(graph, node_index);
+         int node_signature = SIGNATURE(node->label.mark, node->outdegree,
+                                        node->indegree, node->loopdegree, node->root);
+         /* Invariant (8) */
+         if(node->index == -1 || node_signature != signature)
+         {
+            fprintf(stderr, "(8) Node %d is in the bucket for signature %d but its "
+                    "signature is %d.\n", node_index, signature, node_signature);
+            valid_graph = false;
+         }
+      }
+   }
+   /* Invariant (8) */
+   if(bucket_count != graph->number_of_nodes)
+   {
+      fprintf(stderr, "(8) graph->number_of_nodes (%d) is not equal to the number of "
+              "nodes in the signature buckets (%d).\n", graph->number_of_nodes, 
+              bucket_count);
+      valid_graph = false;
+   }
+
+   for(node_index = 0; node_index < graph->nodes.size; node_index++)
+   {
+      Node *node = getNode(graph, node_index);
+      if(node->index == -1) continue;
+      /* Invariant (9) */
+      if(graph->nodes.marks[node_index] != node->label.mark ||
+         graph->nodes.roots[node_index] != node->root ||
+         graph->nodes.outdegrees[node_index] != node->outdegree ||
+         graph->nodes.indegrees[node_index] != node->indegree)
+      {
+         fprintf(stderr, "(9) The dense arrays do not match node %d.\n", node_index);
+         valid_graph = false;
+      }
+   }
+   /* Invariant (10) */
+   RootNodes *roots = &(graph->root_nodes);
+   int root_count = 0, position;
+   for(node_index = 0; node_index < graph->nodes.size; node_index++)
+   {
+      Node *node = getNode(graph, node_index);
+      if(node->index != -1 && node->root) root_count++;
+   }
+   for(position = 0; position < roots->size; position++)
+   {
+      node_index = roots->items[position];
+      if(node_index < 0 || node_index >= graph->nodes.size || 
+         getNode(graph, node_index)->index == -1 || !getNode(graph, node_index)->root ||
+         roots->position[node_index] != position)
+      {
+         fprintf(stderr, "(10) Entry %d of the root node set (%d) is not a root node "
+                 "at its recorded position.\n", position, node_index);
+         valid_graph = false;
+      }
+   }
+   if(root_count != roots->size)
+   {
+      fprintf(stderr, "(10) The graph has %d root nodes but the root node set "
+              "has %d entries.\n", root_count, roots->size);
+      valid_graph = false;
+   }
+   /* Invariant (11) */
+   if(graph->label_index.built)
+   {
+      for(node_index = 0; node_index < graph->nodes.size; node_index++)
+      {
+         Node *node = getNode(graph, node_index);
+         if(node->index != -1 && node->indexed_list != node->label.list)
+         {
+            fprintf(stderr, "(11) Node %d is not indexed under its list.\n", node_index);
+            valid_graph = false;
+         }
+      }
+      for(position = 0; position < graph->label_index.size; position++)
+      {
+         LabelBucket *bucket = &(graph->label_index.buckets[position]);
+         if(bucket->list == NULL || bucket->count == 0) continue;
+         int count = 0;
+         for(node_index = bucket->head; node_index != -1; 
+             node_index = getNode(graph, node_index)->next_by_label)
+         {
+            if(getNode(graph, node_index)->label.list != bucket->list)
+            {
+               fprintf(stderr, "(11) Node %d is in the label index bucket of "
+                       "another list.\n", node_index);
+               valid_graph = false;
+            }
+            count++;
+         }
+         if(count != bucket->count)
+         {
+            fprintf(stderr, "(11) A label index bucket holds %d nodes, not %d.\n",
+                    count, bucket->count);
+            valid_graph = false;
+         }
+      }
+   }
+   for(edge_index = 0; edge_index < graph->edges.size; edge_index++)
+   {
+      Edge *edge = getEdge(graph, edge_index);
+      if(edge->index == -1) continue;
+      /* Invariant (9) */
+      if(graph->edges.marks[edge_index] != edge->label.mark)
+      {
+         fprintf(stderr, "(9) The dense arrays do not match edge %d.\n", edge_index);
+         valid_graph = false;
+      }
+   }
+   /* Invariant (13) */
+   int high_degree_arrays = 0;
+   for(node_index = 0; node_index < graph->nodes.size; node_index++)
+   {
+      Node *node = getNode(graph, node_index);
+      if(node->index == -1) continue;
+      if(node->outdegree > EDGE_INDEX_MIN_DEGREE) high_degree_arrays++;
+      if(node->indegree > EDGE_INDEX_MIN_DEGREE) high_degree_arrays++;
+   }
+   if(high_degree_arrays != graph->high_degree_arrays)
+   {
+      fprintf(stderr, "(13) The graph has %d high degree arrays, not %d.\n",
+              high_degree_arrays, graph->high_degree_arrays);
+      valid_graph = false;
+   }
+   /* Invariant (12) */
+   if(graph->edge_index.built)
+   {
+      int indexed_edges = 0;
+      for(position = 0; position < graph->edge_index.size; position++)
+      {
+         EdgeBucket *bucket = &(graph->edge_index.buckets[position]);
+         if(bucket->source < 0) continue;
+         int count = 0;
+         for(edge_index = bucket->head; edge_index != -1; 
+             edge_index = getEdge(graph, edge_index)->next_by_ends)
+         {
+            Edge *edge = getEdge(graph, edge_index);
+            if(edge->source != bucket->source || edge->target != bucket->target)
+            {
+               fprintf(stderr, "(12) Edge %d is in the edge index bucket of "
+                       "another pair of nodes.\n", edge_index);
+               valid_graph = false;
+            }
+            count++;
+         }
+         if(count != bucket->count)
+         {
+            fprintf(stderr, "(12) An edge index bucket holds %d edges, not %d.\n",
+                    count, bucket->count);
+            valid_graph = false;
+         }
+         indexed_edges += count;
+      }
+      if(indexed_edges != graph->number_of_edges)
+      {
+         fprintf(stderr, "(12) The edge index holds %d edges, not %d.\n",
+                 indexed_edges, graph->number_of_edges);
+         valid_graph = false;
+      }
+   }
     
    if(valid_graph) fprintf(stderr, "Graph satisfies all the data invariants!\n");
    printf("\n");
@@ -248,12 +417,12 @@ void printVerboseGraph(Graph *graph, FILE *file)
        if(node->index >= 0) printVerboseNode(node, file);
     }   
     PTF("Root Node List: ");
-    RootNodes *iterator = graph->root_nodes;
-    while(iterator != NULL)
+    RootNodes *roots = &(graph->root_nodes);
+    int position;
+    for(position = roots->size - 1; position >= 0; position--)
     {
-       if(iterator->next == NULL) PTF("%d\n", iterator->index);
-       else PTF("%d, ", iterator->index);
-       iterator = iterator->next;
+       if(position == 0) PTF("%d\n", roots->items[position]);
+       else PTF("%d, ", roots->items[position]);
     }
     PTF("\n");
     PTF("Edges\n=====\n");
@@ -273,26 +442,15 @@ void printVerboseNode(Node *node, FILE *file)
     PTF("Label: ");
     printHostLabel(node->label, file);
     PTF("\n");
-    PTF("Outdegree: %d. Indegree: %d\n", node->outdegree, node->indegree);
+    PTF("Outdegree: %d. Indegree: %d. Loops: %d\n", node->outdegree, node->indegree,
+        node->loopdegree);
 
     PTF("Outedges: ");
-    if(node->first_out_edge >= 0) PTF("%d ", node->first_out_edge);
-    if(node->second_out_edge >= 0) PTF("%d ", node->second_out_edge);
-    int index;
-    for(index = 0; index < node->out_edges.size; index++)
-    {
-       int out_edge = node->out_edges.items[index];
-       if(out_edge >= 0) PTF("%d ", out_edge);
-    }
+    int index, *edges;
+    forEachOutEdge(node, edges, index) PTF("%d ", edges[index]);
 
     PTF("\nInedges: ");
-    if(node->first_in_edge >= 0) PTF("%d ", node->first_in_edge);
-    if(node->second_in_edge >= 0) PTF("%d ", node->second_in_edge);
-    for(index = 0; index < node->in_edges.size; index++)
-    {
-       int in_edge = node->in_edges.items[index];
-       if(in_edge >= 0) PTF("%d ", in_edge);
-    }
+    forEachInEdge(node, edges, index) PTF("%d ", edges[index]);
     PTF("\n\n");
 }
 
@@ -15,9 +15,12 @@
 
 #include "graph.h"
 
-Node dummy_node = {-1, false, {NONE, 0, NULL}, 0, 0, -1, -1, -1, -1, 
-                   {0, 0, NULL}, {0, 0, NULL}, false};
-Edge dummy_edge = {-1, {NONE, 0, NULL}, -1, -1, false};
+#include <limits.h>
+
+Node dummy_node = {-1, false, {NONE, 0, NULL}, 0, 0, 0, 
+                   {{0}, NULL, INLINE_EDGES}, {{0}, NULL, INLINE_EDGES}, 
+                   -1, -1, -1, NULL, -1, -1};
+Edge dummy_edge = {-1, {NONE, 0, NULL}, -1, -1, -1, -1};
 
 IntArray makeIntArray(int initial_capacity)
 {
@@ -87,6 +90,657 @@ void removeFromIntArray(IntArray *array, int index)
    }
 }
    
+/* Overflow blocks for incident edges have capacity 2*INLINE_EDGES times a
+ * power of two. Freed blocks are kept in one free list per capacity and reused
+ * by later spills instead of being returned to malloc. The link to the next
+ * free block is stored in the first bytes of the block itself. */
+#define EDGE_BLOCK_CLASSES 32
+static int *free_edge_blocks[EDGE_BLOCK_CLASSES] = {NULL};
+
+static int edgeBlockClass(int capacity)
+{
+   int block_class = 0, size = 2 * INLINE_EDGES;
+   while(size < capacity) 
+   {
+      size *= 2;
+      block_class++;
+   }
+   assert(size == capacity && block_class < EDGE_BLOCK_CLASSES);
+   return block_class;
+}
+
+static int *allocateEdgeBlock(int capacity)
+{
+   int block_class = edgeBlockClass(capacity);
+   int *block = free_edge_blocks[block_class];
+   if(block != NULL)
+   {
+      free_edge_blocks[block_class] = *(int **)block;
+      return block;
+   }
+   block = malloc(capacity * sizeof(int));
+   if(block == NULL)
+   {
+      print_to_log("Error (allocateEdgeBlock): malloc failure.\n");
+      exit(1);
+   }
+   return block;
+}
+
+static void freeEdgeBlock(int *block, int capacity)
+{
+   int block_class = edgeBlockClass(capacity);
+   *(int **)block = free_edge_blocks[block_class];
+   free_edge_blocks[block_class] = block;
+}
+
+void freeEdgeBlockPool(void)
+{
+   int block_class;
+   for(block_class = 0; block_class < EDGE_BLOCK_CLASSES; block_class++)
+   {
+      int *block = free_edge_blocks[block_class];
+      while(block != NULL)
+      {
+         int *next = *(int **)block;
+         free(block);
+         block = next;
+      }
+      free_edge_blocks[block_class] = NULL;
+   }
+}
+
+/* Appends an edge index to an incident edge array currently holding count
+ * indices. On the first overflow the inline indices are moved to a block of
+ * capacity 2*INLINE_EDGES. Afterwards the block is doubled when full. */
+static void addIncidentEdge(IncidentEdges *edges, int count, int index)
+{
+   if(count < edges->capacity)
+   {
+      if(edges->overflow == NULL) edges->items[count] = index;
+      else edges->overflow[count] = index;
+      return;
+   }
+   int *block = allocateEdgeBlock(2 * edges->capacity);
+   if(edges->overflow == NULL) memcpy(block, edges->items, count * sizeof(int));
+   else 
+   {
+      memcpy(block, edges->overflow, count * sizeof(int));
+      freeEdgeBlock(edges->overflow, edges->capacity);
+   }
+   edges->overflow = block;
+   edges->capacity *= 2;
+   edges->overflow[count] = index;
+}
+
+/* Removes an edge index from an incident edge array currently holding count
+ * indices. The last index is moved into the vacated slot to keep the array
+ * contiguous. */
+static void removeIncidentEdge(IncidentEdges *edges, int count, int index)
+{
+   int *items = edges->overflow == NULL ? edges->items : edges->overflow;
+   int i;
+   for(i = 0; i < count; i++)
+   {
+      if(items[i] == index)
+      {
+         items[i] = items[count - 1];
+         return;
+      }
+   }
+   assert(false);
+}
+
+static void freeIncidentEdges(IncidentEdges *edges)
+{
+   if(edges->overflow != NULL) freeEdgeBlock(edges->overflow, edges->capacity);
+   edges->overflow = NULL;
+   edges->capacity = INLINE_EDGES;
+}
+
+static void copyIncidentEdges(IncidentEdges *edges, int count)
+{
+   if(edges->overflow == NULL) return;
+   int *block = allocateEdgeBlock(edges->capacity);
+   memcpy(block, edges->overflow, count * sizeof(int));
+   edges->overflow = block;
+}
+
+void freeNodeEdges(Node *node)
+{
+   freeIncidentEdges(&(node->out_edges));
+   freeIncidentEdges(&(node->in_edges));
+}
+
+void copyNodeEdges(Node *node)
+{
+   copyIncidentEdges(&(node->out_edges), node->outdegree);
+   copyIncidentEdges(&(node->in_edges), node->indegree);
+}
+
+/* ==============
+ * Change Journal
+ * ============== */
+static void journalNode(Graph *graph, int index)
+{
+   ChangeJournal *journal = &(graph->journal);
+   journal->nodes[journal->count % CHANGE_JOURNAL_SIZE] = index;
+   journal->count++;
+}
+
+/* Skips the count past the current position of every reader, which then sees
+ * the reset and restarts its search. */
+static void resetChangeJournal(Graph *graph)
+{
+   graph->journal.count++;
+   graph->journal.reset = graph->journal.count;
+}
+
+/* Each call uses two stamps: the first marks the nodes already pending and
+ * the second the nodes reached by the current breadth-first search. */
+static void prepareStamps(Graph *graph)
+{
+   ChangeJournal *journal = &(graph->journal);
+   if(journal->capacity < graph->nodes.capacity)
+   {
+      int capacity = graph->nodes.capacity;
+      int *stamps = realloc(journal->stamps, capacity * sizeof(int));
+      int *queue = realloc(journal->queue, capacity * sizeof(int));
+      if(stamps == NULL || queue == NULL)
+      {
+         print_to_log("Error (updateSearchResume): malloc failure.\n");
+         exit(1);
+      }
+      memset(stamps + journal->capacity, 0, 
+             (capacity - journal->capacity) * sizeof(int));
+      journal->stamps = stamps;
+      journal->queue = queue;
+      journal->capacity = capacity;
+   }
+   if(journal->stamp > INT_MAX - 2)
+   {
+      memset(journal->stamps, 0, journal->capacity * sizeof(int));
+      journal->stamp = 0;
+   }
+   journal->stamp += 2;
+}
+
+static void addPendingNode(SearchResume *resume, int index)
+{
+   if(resume->pending_size == resume->pending_capacity)
+   {
+      int capacity = resume->pending_capacity == 0 ? 16 : 2 * resume->pending_capacity;
+      int *pending = realloc(resume->pending, capacity * sizeof(int));
+      if(pending == NULL)
+      {
+         print_to_log("Error (updateSearchResume): malloc failure.\n");
+         exit(1);
+      }
+      resume->pending = pending;
+      resume->pending_capacity = capacity;
+   }
+   resume->pending[resume->pending_size++] = index;
+}
+
+/* Stamps a node reached by the search and queues it, making it pending if it
+ * is not already. Returns the new end of the queue. */
+static int reachNode(Graph *graph, SearchResume *resume, int index, int end)
+{
+   ChangeJournal *journal = &(graph->journal);
+   if(journal->stamps[index] == journal->stamp) return end;
+   if(journal->stamps[index] != journal->stamp - 1) addPendingNode(resume, index);
+   journal->stamps[index] = journal->stamp;
+   journal->queue[end] = index;
+   return end + 1;
+}
+
+void updateSearchResume(Graph *graph, SearchResume *resume, int radius)
+{
+   ChangeJournal *journal = &(graph->journal);
+   long position = resume->journal_position;
+   resume->journal_position = journal->count;
+   if(position < journal->reset || journal->count - position > CHANGE_JOURNAL_SIZE)
+   {
+      resume->bucket = 0;
+      resume->index = -1;
+      resume->pending_size = 0;
+      return;
+   }
+   if(position == journal->count) return;
+
+   prepareStamps(graph);
+   int counter;
+   for(counter = 0; counter < resume->pending_size; counter++)
+      journal->stamps[resume->pending[counter]] = journal->stamp - 1;
+   int start = 0, end = 0;
+   for(; position < journal->count; position++)
+   {
+      int index = journal->nodes[position % CHANGE_JOURNAL_SIZE];
+      if(index >= graph->nodes.size || graph->nodes.items[index].index == -1) continue;
+      end = reachNode(graph, resume, index, end);
+   }
+   /* Queue positions [start, end) hold the nodes at the current distance. */
+   int distance;
+   for(distance = 0; distance < radius && start < end; distance++)
+   {
+      int layer_end = end;
+      for(; start < layer_end; start++)
+      {
+         Node *node = getNode(graph, journal->queue[start]);
+         int *node_edges;
+         forEachOutEdge(node, node_edges, counter)
+            end = reachNode(graph, resume, getEdge(graph, node_edges[counter])->target, end);
+         forEachInEdge(node, node_edges, counter)
+            end = reachNode(graph, resume, getEdge(graph, node_edges[counter])->source, end);
+      }
+   }
+}
+
+bool relevantChangeSince(Graph *graph, long *failed_at, const bool *relevant)
+{
+   ChangeJournal *journal = &(graph->journal);
+   long position = *failed_at;
+   if(position >= journal->reset && journal->count - position <= CHANGE_JOURNAL_SIZE)
+   {
+      for(; position < journal->count; position++)
+      {
+         int index = journal->nodes[position % CHANGE_JOURNAL_SIZE];
+         if(index >= graph->nodes.size) continue;
+         /* Removed nodes have signature -1. */
+         int signature = graph->nodes.items[index].signature;
+         if(signature != -1 && relevant[signature]) break;
+      }
+      if(position == journal->count)
+      {
+         *failed_at = position;
+         return false;
+      }
+   }
+   *failed_at = 0;
+   return true;
+}
+
+/* ===============
+ * Graph Snapshots
+ * =============== */
+/* The node array, the edge array and the two holes arrays are divided into
+ * pages of SNAPSHOT_PAGE_SIZE consecutive slots. A snapshot keeps, for each
+ * of these four arrays, the pages saved since the snapshot was taken and a
+ * flag per page recording whether it has been saved. */
+#define SNAPSHOT_PAGE_BITS 6
+#define SNAPSHOT_PAGE_SIZE (1 << SNAPSHOT_PAGE_BITS)
+
+typedef enum { NODE_PAGES = 0, EDGE_PAGES, NODE_HOLE_PAGES, EDGE_HOLE_PAGES,
+               PAGE_ARRAYS } PageArray;
+
+/* A saved page is followed in memory by a copy of its SNAPSHOT_PAGE_SIZE slots. 
+ * The nodes and edges in the copy hold their own references to their labels, 
+ * and the nodes own copies of their overflow edge blocks. */
+typedef struct SavedPage {
+   int page;
+   struct SavedPage *next;
+} SavedPage;
+
+typedef struct SavedPages {
+   int capacity;
+   bool *saved;
+   SavedPage *first;
+} SavedPages;
+
+typedef struct GraphSnapshot {
+   /* The number of snapshots below this one. */
+   int depth;
+   int node_size, edge_size, node_holes, edge_holes;
+   int number_of_nodes, number_of_edges, high_degree_arrays;
+   int nodes_by_signature[NUMBER_OF_SIGNATURES];
+   int node_mark_counts[NUMBER_OF_MARKS];
+   /* The items of the graph's root node set. The positions are recomputed 
+    * from them when the snapshot is restored. */
+   int *root_nodes, root_count;
+   SavedPages pages[PAGE_ARRAYS];
+   struct GraphSnapshot *previous;
+} GraphSnapshot;
+
+static size_t pageItemSize(PageArray array)
+{
+   if(array == NODE_PAGES) return sizeof(Node);
+   if(array == EDGE_PAGES) return sizeof(Edge);
+   return sizeof(int);
+}
+
+static void *pageItems(SavedPage *saved_page)
+{
+   return saved_page + 1;
+}
+
+static HostList *retainHostList(HostList *list)
+{
+   #ifdef LIST_HASHING
+      addHostList(list);
+      return list;
+   #else
+      return copyHostList(list);
+   #endif
+}
+
+static bool pageSaved(SavedPages *pages, int page)
+{
+   return page < pages->capacity && pages->saved[page];
+}
+
+static void markPageSaved(SavedPages *pages, int page)
+{
+   if(page >= pages->capacity)
+   {
+      int old_capacity = pages->capacity;
+      int capacity = old_capacity == 0 ? 16 : old_capacity;
+      while(capacity <= page) capacity *= 2;
+      pages->saved = realloc(pages->saved, capacity * sizeof(bool));
+      if(pages->saved == NULL)
+      {
+         print_to_log("Error (markPageSaved): malloc failure.\n");
+         exit(1);
+      }
+      memset(pages->saved + old_capacity, 0, (capacity - old_capacity) * sizeof(bool));
+      pages->capacity = capacity;
+   }
+   pages->saved[page] = true;
+}
+
+/* Copies the page containing the slot at index to the top snapshot, unless
+ * the page has already been saved there. Called before the slot is modified. */
+static void savePage(Graph *graph, PageArray array, int index)
+{
+   SavedPages *pages = &(graph->snapshot->pages[array]);
+   int page = index >> SNAPSHOT_PAGE_BITS;
+   if(pageSaved(pages, page)) return;
+   markPageSaved(pages, page);
+
+   SavedPage *saved_page = malloc(sizeof(SavedPage) + SNAPSHOT_PAGE_SIZE * pageItemSize(array));
+   if(saved_page == NULL)
+   {
+      print_to_log("Error (savePage): malloc failure.\n");
+      exit(1);
+   }
+   saved_page->page = page;
+   saved_page->next = pages->first;
+   pages->first = saved_page;
+
+   int first = page << SNAPSHOT_PAGE_BITS, slot;
+   for(slot = 0; slot < SNAPSHOT_PAGE_SIZE; slot++)
+   {
+      int index = first + slot;
+      if(array == NODE_PAGES)
+      {
+         Node *copy = (Node *)pageItems(saved_page) + slot;
+         /* Slots past the end of the array are saved as dummy nodes. */
+         if(index >= graph->nodes.size || graph->nodes.items[index].index < 0)
+         {
+            *copy = dummy_node;
+            continue;
+         }
+         *copy = graph->nodes.items[index];
+         copyNodeEdges(copy);
+         copy->label.list = retainHostList(copy->label.list);
+      }
+      else if(array == EDGE_PAGES)
+      {
+         Edge *copy = (Edge *)pageItems(saved_page) + slot;
+         if(index >= graph->edges.size || graph->edges.items[index].index < 0)
+         {
+            *copy = dummy_edge;
+            continue;
+         }
+         *copy = graph->edges.items[index];
+         copy->label.list = retainHostList(copy->label.list);
+      }
+      else
+      {
+         IntArray *holes = array == NODE_HOLE_PAGES ? &(graph->nodes.holes) : 
+                                                      &(graph->edges.holes);
+         int *copy = (int *)pageItems(saved_page) + slot;
+         *copy = index < holes->capacity ? holes->items[index] : -1;
+      }
+   }
+}
+
+/* The write barrier. Each function that modifies a slot of one of the paged
+ * arrays calls the matching function below first. */
+static void touchNode(Graph *graph, int index)
+{
+   if(graph->snapshot != NULL) savePage(graph, NODE_PAGES, index);
+}
+
+static void touchEdge(Graph *graph, int index)
+{
+   if(graph->snapshot != NULL) savePage(graph, EDGE_PAGES, index);
+}
+
+static void touchHole(Graph *graph, PageArray array, int index)
+{
+   if(graph->snapshot != NULL) savePage(graph, array, index);
+}
+
+/* Drops the references held by the items of a saved page and frees it. */
+static void releasePage(PageArray array, SavedPage *saved_page)
+{
+   int slot;
+   for(slot = 0; slot < SNAPSHOT_PAGE_SIZE; slot++)
+   {
+      if(array == NODE_PAGES)
+      {
+         Node *node = (Node *)pageItems(saved_page) + slot;
+         if(node->index < 0) continue;
+         freeNodeEdges(node);
+         removeHostList(node->label.list);
+      }
+      else if(array == EDGE_PAGES)
+      {
+         Edge *edge = (Edge *)pageItems(saved_page) + slot;
+         if(edge->index >= 0) removeHostList(edge->label.list);
+      }
+   }
+   free(saved_page);
+}
+
+/* Replaces the slots of a page with the saved copy. The references held by
+ * the replaced items are dropped and those of the saved items are taken over.
+ * The dense array entries of restored nodes and edges are recomputed. */
+static void restorePage(Graph *graph, PageArray array, SavedPage *saved_page)
+{
+   int first = saved_page->page << SNAPSHOT_PAGE_BITS, slot;
+   for(slot = 0; slot < SNAPSHOT_PAGE_SIZE; slot++)
+   {
+      int index = first + slot;
+      if(array == NODE_PAGES)
+      {
+         if(index >= graph->nodes.capacity) break;
+         Node *node = &(graph->nodes.items[index]);
+         if(index < graph->nodes.size && node->index >= 0)
+         {
+            freeNodeEdges(node);
+            removeHostList(node->label.list);
+         }
+         *node = ((Node *)pageItems(saved_page))[slot];
+         if(node->index < 0) continue;
+         graph->nodes.matched[index] = 0;
+         graph->nodes.marks[index] = node->label.mark;
+         graph->nodes.roots[index] = node->root;
+         graph->nodes.outdegrees[index] = node->outdegree;
+         graph->nodes.indegrees[index] = node->indegree;
+      }
+      else if(array == EDGE_PAGES)
+      {
+         if(index >= graph->edges.capacity) break;
+         Edge *edge = &(graph->edges.items[index]);
+         if(index < graph->edges.size && edge->index >= 0) 
+            removeHostList(edge->label.list);
+         *edge = ((Edge *)pageItems(saved_page))[slot];
+         if(edge->index < 0) continue;
+         graph->edges.matched[index] = 0;
+         graph->edges.marks[index] = edge->label.mark;
+      }
+      else
+      {
+         IntArray *holes = array == NODE_HOLE_PAGES ? &(graph->nodes.holes) : 
+                                                      &(graph->edges.holes);
+         if(index >= holes->capacity) break;
+         holes->items[index] = ((int *)pageItems(saved_page))[slot];
+      }
+   }
+   free(saved_page);
+}
+
+static int *copyRootNodes(RootNodes *root_nodes)
+{
+   if(root_nodes->size == 0) return NULL;
+   int *copy = malloc(root_nodes->size * sizeof(int));
+   if(copy == NULL)
+   {
+      print_to_log("Error (copyRootNodes): malloc failure.\n");
+      exit(1);
+   }
+   memcpy(copy, root_nodes->items, root_nodes->size * sizeof(int));
+   return copy;
+}
+
+/* Replaces the root node set by the count root nodes in items. */
+static void restoreRootNodes(Graph *graph, int *items, int count)
+{
+   graph->root_nodes.size = 0;
+   int index;
+   for(index = 0; index < count; index++) addRootNode(graph, items[index]);
+}
+
+int pushGraphSnapshot(Graph *graph)
+{
+   GraphSnapshot *snapshot = malloc(sizeof(GraphSnapshot));
+   if(snapshot == NULL)
+   {
+      print_to_log("Error (pushGraphSnapshot): malloc failure.\n");
+      exit(1);
+   }
+   snapshot->depth = graph->snapshot == NULL ? 0 : graph->snapshot->depth + 1;
+   snapshot->node_size = graph->nodes.size;
+   snapshot->edge_size = graph->edges.size;
+   snapshot->node_holes = graph->nodes.holes.size;
+   snapshot->edge_holes = graph->edges.holes.size;
+   snapshot->number_of_nodes = graph->number_of_nodes;
+   snapshot->number_of_edges = graph->number_of_edges;
+   snapshot->high_degree_arrays = graph->high_degree_arrays;
+   memcpy(snapshot->nodes_by_signature, graph->nodes_by_signature, 
+          sizeof(graph->nodes_by_signature));
+   memcpy(snapshot->node_mark_counts, graph->node_mark_counts, 
+          sizeof(graph->node_mark_counts));
+   snapshot->root_nodes = copyRootNodes(&(graph->root_nodes));
+   snapshot->root_count = graph->root_nodes.size;
+   int array;
+   for(array = 0; array < PAGE_ARRAYS; array++)
+   {
+      snapshot->pages[array].capacity = 0;
+      snapshot->pages[array].saved = NULL;
+      snapshot->pages[array].first = NULL;
+   }
+   snapshot->previous = graph->snapshot;
+   graph->snapshot = snapshot;
+   return snapshot->depth;
+}
+
+int countGraphSnapshots(Graph *graph)
+{
+   return graph->snapshot == NULL ? 0 : graph->snapshot->depth + 1;
+}
+
+void restoreGraphSnapshot(Graph *graph)
+{
+   GraphSnapshot *snapshot = graph->snapshot;
+   assert(snapshot != NULL);
+   /* Pages are restored while the array sizes are those of the current graph,
+    * which tell restorePage which of the replaced slots hold live items. */
+   int array;
+   for(array = 0; array < PAGE_ARRAYS; array++)
+   {
+      SavedPage *saved_page = snapshot->pages[array].first;
+      while(saved_page != NULL)
+      {
+         SavedPage *next = saved_page->next;
+         restorePage(graph, array, saved_page);
+         saved_page = next;
+      }
+      free(snapshot->pages[array].saved);
+   }
+   graph->nodes.size = snapshot->node_size;
+   graph->edges.size = snapshot->edge_size;
+   graph->nodes.holes.size = snapshot->node_holes;
+   graph->edges.holes.size = snapshot->edge_holes;
+   graph->number_of_nodes = snapshot->number_of_nodes;
+   graph->number_of_edges = snapshot->number_of_edges;
+   graph->high_degree_arrays = snapshot->high_degree_arrays;
+   memcpy(graph->nodes_by_signature, snapshot->nodes_by_signature, 
+          sizeof(graph->nodes_by_signature));
+   memcpy(graph->node_mark_counts, snapshot->node_mark_counts, 
+          sizeof(graph->node_mark_counts));
+   restoreRootNodes(graph, snapshot->root_nodes, snapshot->root_count);
+   free(snapshot->root_nodes);
+   graph->snapshot = snapshot->previous;
+   free(snapshot);
+   resetChangeJournal(graph);
+   graph->label_index.built = false;
+   graph->edge_index.built = false;
+}
+
+void dropGraphSnapshot(Graph *graph)
+{
+   GraphSnapshot *snapshot = graph->snapshot;
+   assert(snapshot != NULL);
+   GraphSnapshot *previous = snapshot->previous;
+   int array;
+   for(array = 0; array < PAGE_ARRAYS; array++)
+   {
+      SavedPage *saved_page = snapshot->pages[array].first;
+      while(saved_page != NULL)
+      {
+         SavedPage *next = saved_page->next;
+         /* A page not saved in the previous snapshot was not modified between 
+          * the two snapshots, so this copy also records its state at the time
+          * of the previous snapshot. */
+         if(previous != NULL && !pageSaved(&(previous->pages[array]), saved_page->page))
+         {
+            markPageSaved(&(previous->pages[array]), saved_page->page);
+            saved_page->next = previous->pages[array].first;
+            previous->pages[array].first = saved_page;
+         }
+         else releasePage(array, saved_page);
+         saved_page = next;
+      }
+      free(snapshot->pages[array].saved);
+   }
+   free(snapshot->root_nodes);
+   graph->snapshot = previous;
+   free(snapshot);
+}
+
+/* Allocates or resizes one of the dense arrays of a node or edge array. */
+static void *resizeDenseArray(void *array, int capacity, size_t item_size)
+{
+   array = realloc(array, capacity * item_size);
+   if(array == NULL && capacity > 0)
+   {
+      print_to_log("Error (resizeDenseArray): malloc failure.\n");
+      exit(1);
+   }
+   return array;
+}
+
+static void resizeNodeDenseArrays(NodeArray *array)
+{
+   array->matched = resizeDenseArray(array->matched, array->capacity, sizeof(unsigned));
+   array->marks = resizeDenseArray(array->marks, array->capacity, sizeof(unsigned char));
+   array->roots = resizeDenseArray(array->roots, array->capacity, sizeof(bool));
+   array->outdegrees = resizeDenseArray(array->outdegrees, array->capacity, sizeof(int));
+   array->indegrees = resizeDenseArray(array->indegrees, array->capacity, sizeof(int));
+}
+
 static NodeArray makeNodeArray(int initial_capacity)
 {
    NodeArray array;
@@ -98,6 +752,12 @@ static NodeArray makeNodeArray(int initial_capacity)
       print_to_log("Error (makeNodeArray): malloc failure.\n");
       exit(1);
    }
+   array.matched = NULL;
+   array.marks = NULL;
+   array.roots = NULL;
+   array.outdegrees = NULL;
+   array.indegrees = NULL;
+   resizeNodeDenseArrays(&array);
    array.holes = makeIntArray(16);
    return array;
 }
@@ -111,16 +771,19 @@ static void doubleNodeArray(NodeArray *array)
       print_to_log("Error (doubleCapacity): malloc failure.\n");
       exit(1);
    }
+   resizeNodeDenseArrays(array);
 }
 
-static int addToNodeArray(NodeArray *array, Node node)
+static int addToNodeArray(Graph *graph, Node node)
 {
+   NodeArray *array = &(graph->nodes);
    /* If the holes array is empty, the node's index is the current size
     * of the node array. */
    if(array->holes.size == 0)
    {
       node.index = array->size;
       if(array->size >= array->capacity) doubleNodeArray(array);
+      touchNode(graph, node.index);
       array->items[array->size++] = node;
    }
    /* If the holes array is non-empty, the node is placed in the hole marked by 
@@ -130,20 +793,34 @@ static int addToNodeArray(NodeArray *array, Node node)
       array->holes.size--;
       assert(array->holes.items[array->holes.size] >= 0);
       node.index = array->holes.items[array->holes.size];
+      touchNode(graph, node.index);
       array->items[node.index] = node;
+      touchHole(graph, NODE_HOLE_PAGES, array->holes.size);
       array->holes.items[array->holes.size] = -1;
    }
    return node.index;
 }
 
-static void removeFromNodeArray(NodeArray *array, int index)
+static void removeFromNodeArray(Graph *graph, int index)
 {
+   NodeArray *array = &(graph->nodes);
+   touchNode(graph, index);
    array->items[index] = dummy_node;
    /* If the index is the last index in the array, no hole is created. */
    if(index == array->size - 1) array->size--;
-   else addToIntArray(&(array->holes), index);
+   else 
+   {
+      touchHole(graph, NODE_HOLE_PAGES, array->holes.size);
+      addToIntArray(&(array->holes), index);
+   }
 }
    
+static void resizeEdgeDenseArrays(EdgeArray *array)
+{
+   array->matched = resizeDenseArray(array->matched, array->capacity, sizeof(unsigned));
+   array->marks = resizeDenseArray(array->marks, array->capacity, sizeof(unsigned char));
+}
+
 static EdgeArray makeEdgeArray(int initial_capacity)
 {
    EdgeArray array;
@@ -155,6 +832,9 @@ static EdgeArray makeEdgeArray(int initial_capacity)
       print_to_log("Error (makeEdgeArray): malloc failure.\n");
       exit(1);
    }
+   array.matched = NULL;
+   array.marks = NULL;
+   resizeEdgeDenseArrays(&array);
    array.holes = makeIntArray(16);
    return array;
 }
@@ -169,10 +849,12 @@ static void doubleEdgeArray(EdgeArray *array)
       print_to_log("Error (doubleCapacity): malloc failure.\n");
       exit(1);
    }
+   resizeEdgeDenseArrays(array);
 }
 
-static int addToEdgeArray(EdgeArray *array, Edge edge)
+static int addToEdgeArray(Graph *graph, Edge edge)
 {
+   EdgeArray *array = &(graph->edges);
    /* If the holes array is empty, the edge's index is the current size
     * of the edge array. */
    if(array->holes.size == 0)
@@ -181,6 +863,7 @@ static int addToEdgeArray(EdgeArray *array, Edge edge)
        * size of the node array. */
       edge.index  = array->size;
       if(array->size >= array->capacity) doubleEdgeArray(array);
+      touchEdge(graph, edge.index);
       array->items[array->size++] = edge;
    }
    /* If the holes array is non-empty, the edge is placed in the hole marked by 
@@ -190,18 +873,26 @@ static int addToEdgeArray(EdgeArray *array, Edge edge)
       array->holes.size--;
       assert(array->holes.items[array->holes.size] >= 0);
       edge.index = array->holes.items[array->holes.size];
+      touchEdge(graph, edge.index);
       array->items[edge.index] = edge;
+      touchHole(graph, EDGE_HOLE_PAGES, array->holes.size);
       array->holes.items[array->holes.size] = -1;
    }
    return edge.index;
 }
 
-static void removeFromEdgeArray(EdgeArray *array, int index)
+static void removeFromEdgeArray(Graph *graph, int index)
 {
+   EdgeArray *array = &(graph->edges);
+   touchEdge(graph, index);
    array->items[index] = dummy_edge;
    /* If the index is the last index in the array, no hole is created. */
    if(index == array->size - 1) array->size--;
-   else addToIntArray(&(array->holes), index);
+   else 
+   {
+      touchHole(graph, EDGE_HOLE_PAGES, array->holes.size);
+      addToIntArray(&(array->holes), index);
+   }
 }
 
 
@@ -221,7 +912,35 @@ Graph *newGraph(int nodes, int edges)
 
    graph->number_of_nodes = 0;
    graph->number_of_edges = 0;
-   graph->root_nodes = NULL;
+   graph->root_nodes.items = NULL;
+   graph->root_nodes.size = 0;
+   graph->root_nodes.capacity = 0;
+   graph->root_nodes.position = NULL;
+   graph->root_nodes.position_capacity = 0;
+   graph->snapshot = NULL;
+   graph->label_index.built = false;
+   graph->label_index.buckets = NULL;
+   graph->label_index.size = 0;
+   graph->label_index.count = 0;
+   graph->label_index.used = 0;
+   graph->edge_index.built = false;
+   graph->edge_index.buckets = NULL;
+   graph->edge_index.size = 0;
+   graph->edge_index.count = 0;
+   graph->edge_index.used = 0;
+   graph->high_degree_arrays = 0;
+   graph->match_epoch = 1;
+   graph->journal.count = 0;
+   graph->journal.stamps = NULL;
+   graph->journal.queue = NULL;
+   graph->journal.capacity = 0;
+   graph->journal.stamp = 0;
+   resetChangeJournal(graph);
+   int signature;
+   for(signature = 0; signature < NUMBER_OF_SIGNATURES; signature++) 
+      graph->nodes_by_signature[signature] = -1;
+   int mark;
+   for(mark = 0; mark < NUMBER_OF_MARKS; mark++) graph->node_mark_counts[mark] = 0;
    return graph;
 }
 
@@ -230,17 +949,21 @@ int addNode(Graph *graph, bool root, HostLabel label)
    Node node;
    node.root = root;
    node.label = label;
-   node.first_out_edge = -1;
-   node.second_out_edge = -1;
-   node.first_in_edge = -1;
-   node.second_in_edge = -1;
-   node.out_edges = makeIntArray(0);
-   node.in_edges = makeIntArray(0);
+   node.out_edges = dummy_node.out_edges;
+   node.in_edges = dummy_node.in_edges;
    node.outdegree = 0;
    node.indegree = 0;
-   node.matched = false;
+   node.loopdegree = 0;
+   node.signature = -1;
+   node.next_by_signature = -1;
+   node.prev_by_signature = -1;
+   node.indexed_list = NULL;
+   node.next_by_label = -1;
+   node.prev_by_label = -1;
 
-   int index = addToNodeArray(&(graph->nodes), node);
+   int index = addToNodeArray(graph, node);
+   graph->nodes.matched[index] = 0;
+   indexNode(graph, index);
    if(root) addRootNode(graph, index);
    graph->number_of_nodes++;
    return index; 
@@ -248,15 +971,31 @@ int addNode(Graph *graph, bool root, HostLabel label)
 
 void addRootNode(Graph *graph, int index)
 {
-   RootNodes *root_node = malloc(sizeof(RootNodes));
-   if(root_node == NULL)
+   RootNodes *roots = &(graph->root_nodes);
+   if(roots->size >= roots->capacity)
    {
-      print_to_log("Error (addRootNode): malloc failure.\n");
-      exit(1);
+      roots->capacity = roots->capacity == 0 ? 4 : 2 * roots->capacity;
+      roots->items = realloc(roots->items, roots->capacity * sizeof(int));
+      if(roots->items == NULL)
+      {
+         print_to_log("Error (addRootNode): malloc failure.\n");
+         exit(1);
+      }
    }
-   root_node->index = index;
-   root_node->next = graph->root_nodes;
-   graph->root_nodes = root_node;
+   if(index >= roots->position_capacity)
+   {
+      int capacity = roots->position_capacity == 0 ? 4 : roots->position_capacity;
+      while(capacity <= index) capacity *= 2;
+      roots->position = realloc(roots->position, capacity * sizeof(int));
+      if(roots->position == NULL)
+      {
+         print_to_log("Error (addRootNode): malloc failure.\n");
+         exit(1);
+      }
+      roots->position_capacity = capacity;
+   }
+   roots->position[index] = roots->size;
+   roots->items[roots->size++] = index;
 }
 
 int addEdge(Graph *graph, HostLabel label, int source_index, int target_index) 
@@ -265,24 +1004,11 @@ int addEdge(Graph *graph, HostLabel label, int source_index, int target_index)
    edge.label = label;
    edge.source = source_index;
    edge.target = target_index;
-   edge.matched = false;
-
-   int index = addToEdgeArray(&(graph->edges), edge);
-
-   Node *source = getNode(graph, source_index);
-   assert(source != NULL);
-   if(source->first_out_edge == -1) source->first_out_edge = index;
-   else if(source->second_out_edge == -1) source->second_out_edge = index;
-   else addToIntArray(&(source->out_edges), index);
-   source->outdegree++;
-
-   Node *target = getNode(graph, target_index);
-   assert(target != NULL);
-   if(target->first_in_edge == -1) target->first_in_edge = index;
-   else if(target->second_in_edge == -1) target->second_in_edge = index;
-   else addToIntArray(&(target->in_edges), index);
-   target->indegree++;
+   edge.next_by_ends = -1;
+   edge.prev_by_ends = -1;
 
+   int index = addToEdgeArray(graph, edge);
+   linkEdge(graph, index);
    graph->number_of_edges++;
    return index; 
 }
@@ -291,91 +1017,572 @@ void removeNode(Graph *graph, int index)
 {   
    Node *node = getNode(graph, index);  
    assert(node->indegree == 0 && node->outdegree == 0);
-   if(node->out_edges.items != NULL) free(node->out_edges.items);
-   if(node->in_edges.items != NULL) free(node->in_edges.items); 
+   touchNode(graph, index);
+   freeNodeEdges(node);
    if(node->root) removeRootNode(graph, index);
+   unindexNode(graph, index);
 
    removeHostList(node->label.list);
    
-   removeFromNodeArray(&(graph->nodes), index);
+   removeFromNodeArray(graph, index);
    graph->number_of_nodes--;
 }
 
 void removeRootNode(Graph *graph, int index)
 {
-   RootNodes *current = graph->root_nodes, *previous = NULL;
-   while(current != NULL)
-   {
-      if(current->index == index) 
-      {
-         if(previous == NULL) graph->root_nodes = current->next;
-         else previous->next = current->next;
-         free(current);
-         break;
-      }
-      previous = current;
-      current = current->next;
-   }
+   RootNodes *roots = &(graph->root_nodes);
+   if(index >= roots->position_capacity) return;
+   int position = roots->position[index];
+   if(position < 0 || position >= roots->size || roots->items[position] != index)
+      return;
+   int last = roots->items[--roots->size];
+   roots->items[position] = last;
+   roots->position[last] = position;
 }
 
 void removeEdge(Graph *graph, int index) 
 {
-   Node *source = getNode(graph, graph->edges.items[index].source);
-   if(source->first_out_edge == index) source->first_out_edge = -1;
-   else if(source->second_out_edge == index) source->second_out_edge = -1;
-   else removeFromIntArray(&(source->out_edges), index);
-   source->outdegree--;
-
-   Node *target = getNode(graph, graph->edges.items[index].target);
-   if(target->first_in_edge == index) target->first_in_edge = -1;
-   else if(target->second_in_edge == index) target->second_in_edge = -1;
-   else removeFromIntArray(&(target->in_edges), index);
-   target->indegree--;
-
+   unlinkEdge(graph, index);
+   /* The page is saved before the label's reference is dropped. */
+   touchEdge(graph, index);
    removeHostList(graph->edges.items[index].label.list);
 
-   removeFromEdgeArray(&(graph->edges), index);
+   removeFromEdgeArray(graph, index);
    graph->number_of_edges--;
 }
 
 void relabelNode(Graph *graph, int index, HostLabel new_label) 
 {
-   removeHostList(graph->nodes.items[index].label.list);
+   touchNode(graph, index);
+   /* The old list is released after the node has left its label index bucket,
+    * which is found from the hash stored in the list. */
+   HostList *old_list = graph->nodes.items[index].label.list;
    graph->nodes.items[index].label = new_label;
+   indexNode(graph, index);
+   removeHostList(old_list);
 }
 
 void changeNodeMark(Graph *graph, int index, MarkType new_mark)
 {
+   touchNode(graph, index);
    graph->nodes.items[index].label.mark = new_mark;
+   indexNode(graph, index);
 }
 
 void changeRoot(Graph *graph, int index)
 {
+   touchNode(graph, index);
    bool is_root = graph->nodes.items[index].root;
    if(is_root) removeRootNode(graph, index);
    else addRootNode(graph, index);
    graph->nodes.items[index].root = !is_root;
+   indexNode(graph, index);
 }
 
 void resetMatchedNodeFlag(Graph *graph, int index)
 {
-   graph->nodes.items[index].matched = false;
+   graph->nodes.matched[index] = 0;
+}
+
+void resetMatchedFlags(Graph *graph)
+{
+   graph->match_epoch++;
+   if(graph->match_epoch != 0) return;
+   memset(graph->nodes.matched, 0, graph->nodes.capacity * sizeof(unsigned));
+   memset(graph->edges.matched, 0, graph->edges.capacity * sizeof(unsigned));
+   graph->match_epoch = 1;
+}
+
+/* Compaction moves each live item to the slot given by the number of live
+ * items before it, recording the moves in new_index, and then rewrites the
+ * indices stored in the graph. The cost is linear in the size of the node and
+ * edge arrays. Waiting until half of the slots are holes makes the cost 
+ * amortised constant per removal. */
+static int *makeIndexMap(int size)
+{
+   int *new_index = malloc(size * sizeof(int));
+   if(new_index == NULL)
+   {
+      print_to_log("Error (compactGraph): malloc failure.\n");
+      exit(1);
+   }
+   return new_index;
+}
+
+static void compactNodeArray(Graph *graph)
+{
+   NodeArray *nodes = &(graph->nodes);
+   int *new_index = makeIndexMap(nodes->size);
+   int index, count = 0;
+   for(index = 0; index < nodes->size; index++)
+   {
+      if(nodes->items[index].index == -1)
+      {
+         new_index[index] = -1;
+         continue;
+      }
+      new_index[index] = count;
+      if(count != index)
+      {
+         nodes->items[count] = nodes->items[index];
+         nodes->items[count].index = count;
+         nodes->matched[count] = nodes->matched[index];
+         nodes->marks[count] = nodes->marks[index];
+         nodes->roots[count] = nodes->roots[index];
+         nodes->outdegrees[count] = nodes->outdegrees[index];
+         nodes->indegrees[count] = nodes->indegrees[index];
+      }
+      count++;
+   }
+   for(index = count; index < nodes->size; index++) nodes->items[index] = dummy_node;
+   for(index = 0; index < nodes->holes.size; index++) nodes->holes.items[index] = -1;
+   nodes->holes.size = 0;
+   nodes->size = count;
+
+   for(index = 0; index < nodes->size; index++)
+   {
+      Node *node = &(nodes->items[index]);
+      if(node->next_by_signature != -1) 
+         node->next_by_signature = new_index[node->next_by_signature];
+      if(node->prev_by_signature != -1) 
+         node->prev_by_signature = new_index[node->prev_by_signature];
+   }
+   int signature;
+   for(signature = 0; signature < NUMBER_OF_SIGNATURES; signature++)
+      if(graph->nodes_by_signature[signature] != -1)
+         graph->nodes_by_signature[signature] = 
+            new_index[graph->nodes_by_signature[signature]];
+   /* New indices are not larger than old ones, so they fit in the position
+    * map without resizing it. */
+   RootNodes *roots = &(graph->root_nodes);
+   for(index = 0; index < roots->size; index++)
+   {
+      roots->items[index] = new_index[roots->items[index]];
+      roots->position[roots->items[index]] = index;
+   }
+   for(index = 0; index < graph->edges.size; index++)
+   {
+      Edge *edge = &(graph->edges.items[index]);
+      if(edge->index == -1) continue;
+      edge->source = new_index[edge->source];
+      edge->target = new_index[edge->target];
+   }
+   free(new_index);
+   resetChangeJournal(graph);
+   graph->label_index.built = false;
+   graph->edge_index.built = false;
+}
+
+static void compactEdgeArray(Graph *graph)
+{
+   EdgeArray *edges = &(graph->edges);
+   int *new_index = makeIndexMap(edges->size);
+   int index, count = 0;
+   for(index = 0; index < edges->size; index++)
+   {
+      if(edges->items[index].index == -1)
+      {
+         new_index[index] = -1;
+         continue;
+      }
+      new_index[index] = count;
+      if(count != index)
+      {
+         edges->items[count] = edges->items[index];
+         edges->items[count].index = count;
+         edges->matched[count] = edges->matched[index];
+         edges->marks[count] = edges->marks[index];
+      }
+      count++;
+   }
+   for(index = count; index < edges->size; index++) edges->items[index] = dummy_edge;
+   for(index = 0; index < edges->holes.size; index++) edges->holes.items[index] = -1;
+   edges->holes.size = 0;
+   edges->size = count;
+
+   for(index = 0; index < graph->nodes.size; index++)
+   {
+      Node *node = &(graph->nodes.items[index]);
+      if(node->index == -1) continue;
+      int counter, *node_edges;
+      forEachOutEdge(node, node_edges, counter) 
+         node_edges[counter] = new_index[node_edges[counter]];
+      forEachInEdge(node, node_edges, counter) 
+         node_edges[counter] = new_index[node_edges[counter]];
+   }
+   free(new_index);
+   graph->edge_index.built = false;
+}
+
+void compactGraph(Graph *graph)
+{
+   assert(graph->snapshot == NULL);
+   if(graph->nodes.holes.size > 0 && 2 * graph->nodes.holes.size >= graph->nodes.size)
+      compactNodeArray(graph);
+   if(graph->edges.holes.size > 0 && 2 * graph->edges.holes.size >= graph->edges.size)
+      compactEdgeArray(graph);
+}
+
+static void addToEdgeIndex(Graph *graph, int index);
+static void removeFromEdgeIndex(Graph *graph, int index);
+
+void linkEdge(Graph *graph, int index)
+{
+   Edge *edge = &(graph->edges.items[index]);
+   if(graph->edge_index.built) addToEdgeIndex(graph, index);
+   graph->edges.matched[index] = 0;
+   graph->edges.marks[index] = edge->label.mark;
+   touchNode(graph, edge->source);
+   Node *source = getNode(graph, edge->source);
+   assert(source != NULL);
+   addIncidentEdge(&(source->out_edges), source->outdegree, index);
+   source->outdegree++;
+   if(source->outdegree == EDGE_INDEX_MIN_DEGREE + 1) graph->high_degree_arrays++;
+
+   touchNode(graph, edge->target);
+   Node *target = getNode(graph, edge->target);
+   assert(target != NULL);
+   addIncidentEdge(&(target->in_edges), target->indegree, index);
+   target->indegree++;
+   if(target->indegree == EDGE_INDEX_MIN_DEGREE + 1) graph->high_degree_arrays++;
+
+   if(edge->source == edge->target) source->loopdegree++;
+   indexNode(graph, edge->source);
+   if(edge->source != edge->target) indexNode(graph, edge->target);
+}
+
+void unlinkEdge(Graph *graph, int index)
+{
+   Edge *edge = &(graph->edges.items[index]);
+   if(graph->edge_index.built) removeFromEdgeIndex(graph, index);
+   touchNode(graph, edge->source);
+   touchNode(graph, edge->target);
+   Node *source = getNode(graph, edge->source);
+   removeIncidentEdge(&(source->out_edges), source->outdegree, index);
+   if(source->outdegree == EDGE_INDEX_MIN_DEGREE + 1) graph->high_degree_arrays--;
+   source->outdegree--;
+
+   Node *target = getNode(graph, edge->target);
+   removeIncidentEdge(&(target->in_edges), target->indegree, index);
+   if(target->indegree == EDGE_INDEX_MIN_DEGREE + 1) graph->high_degree_arrays--;
+   target->indegree--;
+
+   if(edge->source == edge->target) source->loopdegree--;
+   indexNode(graph, edge->source);
+   if(edge->source != edge->target) indexNode(graph, edge->target);
+}
+
+/* Marks a label index bucket whose list was removed, so that probing continues
+ * past it. */
+static HostList deleted_label_list;
+#define DELETED_LABEL (&deleted_label_list)
+
+/* Returns the bucket of the list, or NULL if the list is not in the index and
+ * insert is false. If insert is true, a bucket for the list is made if there
+ * is none. */
+static LabelBucket *findLabelBucket(LabelIndex *label_index, HostList *list, bool insert)
+{
+   if(insert && (label_index->used + 1) * 4 > label_index->size * 3)
+   {
+      /* Rebuild the table without its deleted buckets, doubling it if the lists
+       * alone fill at least half of it. */
+      LabelBucket *old_buckets = label_index->buckets;
+      int old_size = label_index->size, index;
+      if(label_index->size == 0) label_index->size = 16;
+      else if((label_index->count + 1) * 2 >= label_index->size) label_index->size *= 2;
+      label_index->buckets = calloc(label_index->size, sizeof(LabelBucket));
+      if(label_index->buckets == NULL)
+      {
+         print_to_log("Error (findLabelBucket): malloc failure.\n");
+         exit(1);
+      }
+      label_index->used = label_index->count;
+      unsigned mask = label_index->size - 1;
+      for(index = 0; index < old_size; index++)
+      {
+         LabelBucket bucket = old_buckets[index];
+         if(bucket.list == NULL || bucket.list == DELETED_LABEL) continue;
+         unsigned slot = bucket.list->hash & mask;
+         while(label_index->buckets[slot].list != NULL) slot = (slot + 1) & mask;
+         label_index->buckets[slot] = bucket;
+      }
+      free(old_buckets);
+   }
+   if(label_index->size == 0) return NULL;
+   unsigned mask = label_index->size - 1;
+   unsigned slot = list->hash & mask;
+   int free_slot = -1;
+   while(label_index->buckets[slot].list != NULL)
+   {
+      if(label_index->buckets[slot].list == list) return &(label_index->buckets[slot]);
+      if(label_index->buckets[slot].list == DELETED_LABEL && free_slot < 0) 
+         free_slot = slot;
+      slot = (slot + 1) & mask;
+   }
+   if(!insert) return NULL;
+   if(free_slot >= 0) slot = free_slot;
+   else label_index->used++;
+   label_index->count++;
+   LabelBucket *bucket = &(label_index->buckets[slot]);
+   bucket->list = list;
+   bucket->head = -1;
+   bucket->count = 0;
+   return bucket;
+}
+
+/* The label index links are not saved in snapshots, because restoring a
+ * snapshot discards the label index. The nodes are not touched here. */
+static void addToLabelIndex(Graph *graph, int index)
+{
+   Node *node = &(graph->nodes.items[index]);
+   node->indexed_list = node->label.list;
+   node->prev_by_label = -1;
+   node->next_by_label = -1;
+   if(node->indexed_list == NULL) return;
+   LabelBucket *bucket = findLabelBucket(&(graph->label_index), node->indexed_list, true);
+   node->next_by_label = bucket->head;
+   if(bucket->head != -1) graph->nodes.items[bucket->head].prev_by_label = index;
+   bucket->head = index;
+   bucket->count++;
+}
+
+static void removeFromLabelIndex(Graph *graph, int index)
+{
+   Node *node = &(graph->nodes.items[index]);
+   if(node->indexed_list == NULL) return;
+   LabelBucket *bucket = findLabelBucket(&(graph->label_index), node->indexed_list, false);
+   assert(bucket != NULL);
+   if(node->prev_by_label == -1) bucket->head = node->next_by_label;
+   else graph->nodes.items[node->prev_by_label].next_by_label = node->next_by_label;
+   if(node->next_by_label != -1) 
+      graph->nodes.items[node->next_by_label].prev_by_label = node->prev_by_label;
+   bucket->count--;
+   if(bucket->count == 0) 
+   {
+      bucket->list = DELETED_LABEL;
+      graph->label_index.count--;
+   }
+   node->indexed_list = NULL;
+   node->next_by_label = -1;
+   node->prev_by_label = -1;
+}
+
+static void buildLabelIndex(Graph *graph)
+{
+   LabelIndex *label_index = &(graph->label_index);
+   int index;
+   for(index = 0; index < label_index->size; index++) 
+      label_index->buckets[index].list = NULL;
+   label_index->count = 0;
+   label_index->used = 0;
+   label_index->built = true;
+   for(index = 0; index < graph->nodes.size; index++)
+      if(graph->nodes.items[index].index != -1) addToLabelIndex(graph, index);
+}
+
+/* Marks an edge index bucket whose edges were all removed, so that probing
+ * continues past it. */
+#define DELETED_ENDS -2
+
+static unsigned hashEnds(int source, int target)
+{
+   unsigned hash = (unsigned)source * 2654435761u ^ (unsigned)target;
+   return hash ^ (hash >> 16);
+}
+
+/* Returns the bucket of the pair of nodes, or NULL if the pair is not in the
+ * index and insert is false. If insert is true, a bucket for the pair is made
+ * if there is none. */
+static EdgeBucket *findEdgeBucket(EdgeIndex *edge_index, int source, int target, 
+                                  bool insert)
+{
+   if(insert && (edge_index->used + 1) * 4 > edge_index->size * 3)
+   {
+      /* Rebuild the table without its deleted buckets, doubling it if the pairs
+       * alone fill at least half of it. */
+      EdgeBucket *old_buckets = edge_index->buckets;
+      int old_size = edge_index->size, index;
+      if(edge_index->size == 0) edge_index->size = 16;
+      else if((edge_index->count + 1) * 2 >= edge_index->size) edge_index->size *= 2;
+      edge_index->buckets = malloc(edge_index->size * sizeof(EdgeBucket));
+      if(edge_index->buckets == NULL)
+      {
+         print_to_log("Error (findEdgeBucket): malloc failure.\n");
+         exit(1);
+      }
+      for(index = 0; index < edge_index->size; index++) 
+         edge_index->buckets[index].source = -1;
+      edge_index->used = edge_index->count;
+      unsigned mask = edge_index->size - 1;
+      for(index = 0; index < old_size; index++)
+      {
+         EdgeBucket bucket = old_buckets[index];
+         if(bucket.source < 0) continue;
+         unsigned slot = hashEnds(bucket.source, bucket.target) & mask;
+         while(edge_index->buckets[slot].source != -1) slot = (slot + 1) & mask;
+         edge_index->buckets[slot] = bucket;
+      }
+      free(old_buckets);
+   }
+   if(edge_index->size == 0) return NULL;
+   unsigned mask = edge_index->size - 1;
+   unsigned slot = hashEnds(source, target) & mask;
+   int free_slot = -1;
+   while(edge_index->buckets[slot].source != -1)
+   {
+      EdgeBucket *bucket = &(edge_index->buckets[slot]);
+      if(bucket->source == source && bucket->target == target) return bucket;
+      if(bucket->source == DELETED_ENDS && free_slot < 0) free_slot = slot;
+      slot = (slot + 1) & mask;
+   }
+   if(!insert) return NULL;
+   if(free_slot >= 0) slot = free_slot;
+   else edge_index->used++;
+   edge_index->count++;
+   EdgeBucket *bucket = &(edge_index->buckets[slot]);
+   bucket->source = source;
+   bucket->target = target;
+   bucket->head = -1;
+   bucket->count = 0;
+   return bucket;
+}
+
+/* The edge index links are not saved in snapshots, because restoring a 
+ * snapshot discards the edge index. The edges are not touched here. */
+static void addToEdgeIndex(Graph *graph, int index)
+{
+   Edge *edge = &(graph->edges.items[index]);
+   EdgeBucket *bucket = findEdgeBucket(&(graph->edge_index), edge->source, 
+                                       edge->target, true);
+   edge->prev_by_ends = -1;
+   edge->next_by_ends = bucket->head;
+   if(bucket->head != -1) graph->edges.items[bucket->head].prev_by_ends = index;
+   bucket->head = index;
+   bucket->count++;
+}
+
+static void removeFromEdgeIndex(Graph *graph, int index)
+{
+   Edge *edge = &(graph->edges.items[index]);
+   EdgeBucket *bucket = findEdgeBucket(&(graph->edge_index), edge->source, 
+                                       edge->target, false);
+   assert(bucket != NULL);
+   if(edge->prev_by_ends == -1) bucket->head = edge->next_by_ends;
+   else graph->edges.items[edge->prev_by_ends].next_by_ends = edge->next_by_ends;
+   if(edge->next_by_ends != -1) 
+      graph->edges.items[edge->next_by_ends].prev_by_ends = edge->prev_by_ends;
+   bucket->count--;
+   if(bucket->count == 0) 
+   {
+      bucket->source = DELETED_ENDS;
+      graph->edge_index.count--;
+   }
+   edge->next_by_ends = -1;
+   edge->prev_by_ends = -1;
+}
+
+void buildEdgeIndex(Graph *graph)
+{
+   EdgeIndex *edge_index = &(graph->edge_index);
+   if(edge_index->built) return;
+   int index;
+   for(index = 0; index < edge_index->size; index++) 
+      edge_index->buckets[index].source = -1;
+   edge_index->count = 0;
+   edge_index->used = 0;
+   edge_index->built = true;
+   for(index = 0; index < graph->edges.size; index++)
+      if(graph->edges.items[index].index != -1) addToEdgeIndex(graph, index);
+}
+
+static void leaveSignatureBucket(Graph *graph, int index)
+{
+   Node *node = &(graph->nodes.items[index]);
+   if(node->signature == -1) return;
+   touchNode(graph, index);
+   if(node->prev_by_signature == -1) 
+      graph->nodes_by_signature[node->signature] = node->next_by_signature;
+   else 
+   {
+      touchNode(graph, node->prev_by_signature);
+      graph->nodes.items[node->prev_by_signature].next_by_signature = 
+         node->next_by_signature;
+   }
+   if(node->next_by_signature != -1) 
+   {
+      touchNode(graph, node->next_by_signature);
+      graph->nodes.items[node->next_by_signature].prev_by_signature = 
+         node->prev_by_signature;
+   }
+   graph->node_mark_counts[SIGNATURE_MARK(node->signature)]--;
+   node->signature = -1;
+   node->next_by_signature = -1;
+   node->prev_by_signature = -1;
+}
+
+/* Nodes are pushed to the front of their bucket. Insertion and removal are
+ * constant time because the bucket links are stored in the nodes themselves. */
+void indexNode(Graph *graph, int index)
+{
+   touchNode(graph, index);
+   journalNode(graph, index);
+   Node *node = &(graph->nodes.items[index]);
+   assert(node->label.mark >= 0 && node->label.mark < NUMBER_OF_MARKS);
+   graph->nodes.marks[index] = node->label.mark;
+   graph->nodes.roots[index] = node->root;
+   graph->nodes.outdegrees[index] = node->outdegree;
+   graph->nodes.indegrees[index] = node->indegree;
+   int signature = SIGNATURE(node->label.mark, node->outdegree, node->indegree,
+                             node->loopdegree, node->root);
+   if(graph->label_index.built && node->indexed_list != node->label.list)
+   {
+      removeFromLabelIndex(graph, index);
+      addToLabelIndex(graph, index);
+   }
+   if(signature == node->signature) return;
+   leaveSignatureBucket(graph, index);
+
+   int head = graph->nodes_by_signature[signature];
+   node->signature = signature;
+   node->prev_by_signature = -1;
+   node->next_by_signature = head;
+   if(head != -1) 
+   {
+      touchNode(graph, head);
+      graph->nodes.items[head].prev_by_signature = index;
+   }
+   graph->nodes_by_signature[signature] = index;
+   graph->node_mark_counts[SIGNATURE_MARK(signature)]++;
+}
+
+void unindexNode(Graph *graph, int index)
+{
+   if(graph->label_index.built) removeFromLabelIndex(graph, index);
+   leaveSignatureBucket(graph, index);
 }
 
 void relabelEdge(Graph *graph, int index, HostLabel new_label)
 {	
+   touchEdge(graph, index);
    removeHostList(graph->edges.items[index].label.list);
    graph->edges.items[index].label = new_label;
+   graph->edges.marks[index] = new_label.mark;
+   journalNode(graph, graph->edges.items[index].source);
+   journalNode(graph, graph->edges.items[index].target);
 }
 
 void changeEdgeMark(Graph *graph, int index, MarkType new_mark)
 {
+   touchEdge(graph, index);
    graph->edges.items[index].label.mark = new_mark;
+   graph->edges.marks[index] = new_mark;
+   journalNode(graph, graph->edges.items[index].source);
+   journalNode(graph, graph->edges.items[index].target);
 }
 
 void resetMatchedEdgeFlag(Graph *graph, int index)
 {
-   graph->edges.items[index].matched = false; 
+   graph->edges.matched[index] = 0;
 }
 
 /* ========================
@@ -397,31 +1604,61 @@ Edge *getEdge(Graph *graph, int index)
 
 RootNodes *getRootNodeList(Graph *graph)
 {
-   return graph->root_nodes;
+   return &(graph->root_nodes);
+}
+
+int getFirstNodeBySignature(Graph *graph, int signature)
+{
+   assert(signature >= 0 && signature < NUMBER_OF_SIGNATURES);
+   return graph->nodes_by_signature[signature];
+}
+
+int getNextNodeBySignature(Graph *graph, int index)
+{
+   return graph->nodes.items[index].next_by_signature;
+}
+
+int countNodesByList(Graph *graph, HostList *list)
+{
+   if(!graph->label_index.built) buildLabelIndex(graph);
+   LabelBucket *bucket = findLabelBucket(&(graph->label_index), list, false);
+   return bucket == NULL ? 0 : bucket->count;
+}
+
+int getFirstNodeByList(Graph *graph, HostList *list)
+{
+   if(!graph->label_index.built) buildLabelIndex(graph);
+   LabelBucket *bucket = findLabelBucket(&(graph->label_index), list, false);
+   return bucket == NULL ? -1 : bucket->head;
+}
+
+int getNextNodeByList(Graph *graph, int index)
+{
+   return graph->nodes.items[index].next_by_label;
+}
+
+int getFirstEdgeBetween(Graph *graph, int source, int target)
+{
+   buildEdgeIndex(graph);
+   EdgeBucket *bucket = findEdgeBucket(&(graph->edge_index), source, target, false);
+   return bucket == NULL ? -1 : bucket->head;
+}
+
+int getNextEdgeBetween(Graph *graph, int index)
+{
+   return graph->edges.items[index].next_by_ends;
 }
 
 Edge *getNthOutEdge(Graph *graph, Node *node, int n)
 {
-   assert(n >= 0);
-   if(n == 0) return getEdge(graph, node->first_out_edge);
-   else if(n == 1) return getEdge(graph, node->second_out_edge);
-   else
-   {
-      assert(n - 2 < node->out_edges.size);
-      return getEdge(graph, node->out_edges.items[n - 2]);
-   }
+   assert(n >= 0 && n < node->outdegree);
+   return getEdge(graph, outEdgeIndices(node)[n]);
 }
 
 Edge *getNthInEdge(Graph *graph, Node *node, int n)
 {
-   assert(n >= 0);
-   if(n == 0) return getEdge(graph, node->first_in_edge);
-   else if(n == 1) return getEdge(graph, node->second_in_edge);
-   else
-   {
-      assert(n - 2 < node->in_edges.size);
-      return getEdge(graph, node->in_edges.items[n - 2]);
-   }
+   assert(n >= 0 && n < node->indegree);
+   return getEdge(graph, inEdgeIndices(node)[n]);
 }
 
 Node *getSource(Graph *graph, Edge *edge) 
@@ -513,17 +1750,24 @@ void printGraph(Graph *graph, FILE *file)
 void freeGraph(Graph *graph) 
 {
    if(graph == NULL) return;
+   while(graph->snapshot != NULL) dropGraphSnapshot(graph);
    int index;
    for(index = 0; index < graph->nodes.size; index++)
    {
       Node *node = getNode(graph, index);
       if(node == NULL) continue;
-      if(node->out_edges.items != NULL) free(node->out_edges.items);
-      if(node->in_edges.items != NULL) free(node->in_edges.items);
+      freeNodeEdges(node);
       removeHostList(node->label.list);
    }
    if(graph->nodes.holes.items) free(graph->nodes.holes.items);
    if(graph->nodes.items) free(graph->nodes.items);
+   free(graph->nodes.matched);
+   free(graph->nodes.marks);
+   free(graph->nodes.roots);
+   free(graph->nodes.outdegrees);
+   free(graph->nodes.indegrees);
+   free(graph->journal.stamps);
+   free(graph->journal.queue);
 
    for(index = 0; index < graph->edges.size; index++)
    {
@@ -533,16 +1777,12 @@ void freeGraph(Graph *graph)
    }
    if(graph->edges.holes.items) free(graph->edges.holes.items);
    if(graph->edges.items) free(graph->edges.items);
-   if(graph->root_nodes != NULL) 
-   {
-      RootNodes *iterator = graph->root_nodes;
-      while(iterator != NULL)
-      {
-         RootNodes *temp = iterator;
-         iterator = iterator->next;
-         free(temp);
-      }
-   }
+   free(graph->edges.matched);
+   free(graph->edges.marks);
+   free(graph->root_nodes.items);
+   free(graph->root_nodes.position);
+   free(graph->label_index.buckets);
+   free(graph->edge_index.buckets);
    free(graph);
 }
 
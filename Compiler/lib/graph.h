@@ -44,10 +44,92 @@ IntArray makeIntArray(int initial_capacity);
 void addToIntArray(IntArray *array, int item);
 void removeFromIntArray(IntArray *array, int index);
 
+/* The number of incident edges of each direction stored inside a node. */
+#define INLINE_EDGES 4
+
+/* The indices of a node's outgoing or incoming edges. The number of indices is
+ * the node's outdegree or indegree. The indices are stored contiguously in 
+ * items while they fit. When the degree grows past INLINE_EDGES, all the
+ * indices are moved to an overflow block taken from a pool of edge blocks.
+ * The overflow block is kept until the node is removed. */
+typedef struct IncidentEdges {
+   int items[INLINE_EDGES];
+   int *overflow;
+   int capacity;
+} IncidentEdges;
+
+/* Returns a pointer to the contiguous array of indices of a node's outgoing
+ * or incoming edges. */
+#define outEdgeIndices(node) \
+   ((node)->out_edges.overflow == NULL ? (node)->out_edges.items : (node)->out_edges.overflow)
+#define inEdgeIndices(node) \
+   ((node)->in_edges.overflow == NULL ? (node)->in_edges.items : (node)->in_edges.overflow)
+
+/* Loops over the indices of the outgoing or incoming edges of a node. The
+ * location of the index array is looked up once, before the loop, so that the
+ * loop body is a plain array read. The node's edges must not be added or
+ * removed inside the loop. Usage:
+ * int counter, *edges;
+ * forEachOutEdge(node, edges, counter) { Edge *edge = getEdge(g, edges[counter]); } */
+#define forEachOutEdge(node, edges, counter) \
+   for((edges) = outEdgeIndices(node), (counter) = 0; (counter) < (node)->outdegree; (counter)++)
+#define forEachInEdge(node, edges, counter) \
+   for((edges) = inEdgeIndices(node), (counter) = 0; (counter) < (node)->indegree; (counter)++)
+
+/* The edges between two nodes are looked up in the edge index only if the node
+ * whose incident edges would otherwise be walked has more than this number of
+ * them. The index is not built for graphs without such nodes. */
+#define EDGE_INDEX_MIN_DEGREE 8
+
+/* Loops over the indices of the outgoing edges of a node that go to the node 
+ * with index target, or of all its outgoing edges if target is -1. The loop
+ * body must check the target of each edge: the indices are taken from the 
+ * edge index only if the node has more than EDGE_INDEX_MIN_DEGREE outgoing
+ * edges, and otherwise all the outgoing edges are walked. forEachInEdgeFrom
+ * does the same for the incoming edges from the node with index source. The
+ * graph must not be modified inside the loop. Usage:
+ * int counter, *edges, item;
+ * forEachOutEdgeTo(g, node, t, edges, counter, item) { Edge *e = getEdge(g, item); } */
+#define forEachOutEdgeTo(graph, node, target, edges, counter, item)              \
+   for((edges) = outEdgeIndices(node), (counter) = 0,                              \
+       (item) = (target) >= 0 && (node)->outdegree > EDGE_INDEX_MIN_DEGREE ?      \
+                 getFirstEdgeBetween(graph, (node)->index, target) :               \
+                 ((node)->outdegree > 0 ? (edges)[0] : -1);                        \
+       (item) != -1;                                                              \
+       (item) = (target) >= 0 && (node)->outdegree > EDGE_INDEX_MIN_DEGREE ?      \
+                 getNextEdgeBetween(graph, item) :                                \
+                 (++(counter) < (node)->outdegree ? (edges)[counter] : -1))
+#define forEachInEdgeFrom(graph, node, source, edges, counter, item)             \
+   for((edges) = inEdgeIndices(node), (counter) = 0,                               \
+       (item) = (source) >= 0 && (node)->indegree > EDGE_INDEX_MIN_DEGREE ?       \
+                 getFirstEdgeBetween(graph, source, (node)->index) :               \
+                 ((node)->indegree > 0 ? (edges)[0] : -1);                         \
+       (item) != -1;                                                              \
+       (item) = (source) >= 0 && (node)->indegree > EDGE_INDEX_MIN_DEGREE ?       \
+                 getNextEdgeBetween(graph, item) :                                \
+                 (++(counter) < (node)->indegree ? (edges)[counter] : -1))
+
+/* Frees the blocks cached by the edge block pool. Call after freeing all graphs. */
+void freeEdgeBlockPool(void);
+
+/* The node and edge arrays keep the fields read by the generated matching code
+ * in dense arrays indexed in parallel with items, so that a scan over candidate
+ * items touches a few bytes per item instead of the whole structure. Marks are
+ * stored in one byte.
+ * The matched entries are stored only in the dense arrays: an item is matched
+ * by the current search if its entry is equal to the match epoch of the graph
+ * (see resetMatchedFlags), and an entry of 0 is never matched. The other dense arrays
+ * are copies of fields of the node and edge structures. Node copies are
+ * refreshed by indexNode and edge copies are set by linkEdge and the edge
+ * modification functions. The entries of dummy items are not meaningful. */
 typedef struct NodeArray {
    int capacity;
    int size;
    struct Node *items;
+   unsigned *matched;
+   unsigned char *marks;
+   bool *roots;
+   int *outdegrees, *indegrees;
    struct IntArray holes;
 } NodeArray;
 
@@ -55,9 +137,88 @@ typedef struct EdgeArray {
    int capacity;
    int size;
    struct Edge *items;
+   unsigned *matched;
+   unsigned char *marks;
    struct IntArray holes;
 } EdgeArray;
 
+/* The change journal of a graph records the index of each node affected by a
+ * modification: added, relabelled, remarked and rerooted nodes, the end points
+ * of added, removed, relabelled and remarked edges, and the nodes restored by 
+ * the graph backtracking code. The last CHANGE_JOURNAL_SIZE entries are kept in
+ * a ring and numbered by a running count. Changes that are not recorded entry
+ * by entry (restoring a snapshot, compacting the node array, creating the 
+ * graph) reset the journal: readers that last read it before a reset must
+ * assume that every node has changed. */
+#define CHANGE_JOURNAL_SIZE 1024
+
+typedef struct ChangeJournal {
+   long count;
+   long reset;
+   int nodes[CHANGE_JOURNAL_SIZE];
+   /* Scratch space for updateSearchResume. */
+   int *stamps, *queue;
+   int capacity, stamp;
+} ChangeJournal;
+
+/* The root nodes of a graph are stored as a dense set: items[0..size-1] are the
+ * indices of the root nodes in no particular order, and position[i] is the
+ * place of root node i in items. position is indexed by node index and its
+ * entries for non-root nodes are not meaningful. A root node is removed by 
+ * moving the last item into its place, so that insertion and removal take
+ * constant time and the root nodes can be iterated over contiguously, e.g.
+ * for(i = 0; i < roots->size; i++) use(roots->items[i]); */
+typedef struct RootNodes {
+   int *items;
+   int size, capacity;
+   int *position;
+   int position_capacity;
+} RootNodes;
+
+/* The label index of a graph maps each host list to the nodes labelled with
+ * it. Host lists are canonical when LIST_HASHING is defined, so the list 
+ * pointer stands for the contents of the list. The index is a hash table with
+ * linear probing on the hash of the list. The bucket of a list holds the head
+ * of a doubly-linked list of its nodes, threaded through the next_by_label and
+ * prev_by_label fields of the nodes, and their number. Nodes with the empty
+ * list are not indexed.
+ * The index is built by the first lookup (see getFirstNodeByList) and kept up
+ * to date by indexNode and unindexNode from then on. Restoring a snapshot or
+ * compacting the node array discards it, and the next lookup builds it again. */
+typedef struct LabelBucket {
+   struct HostList *list;
+   int head, count;
+} LabelBucket;
+
+typedef struct LabelIndex {
+   bool built;
+   LabelBucket *buckets;
+   /* The number of buckets (a power of two), the number of lists in the index,
+    * and the number of buckets that are not empty (lists and deleted buckets). */
+   int size, count, used;
+} LabelIndex;
+
+/* The edge index of a graph maps each pair of a source and a target node to 
+ * the edges from the source to the target. It is organised as the label 
+ * index: a hash table with linear probing on the hash of the pair, whose 
+ * bucket for a pair holds the head of a doubly-linked list of its edges,
+ * threaded through the next_by_ends and prev_by_ends fields of the edges, and
+ * their number. An empty bucket has source -1. 
+ * The index is built by the first lookup (see getFirstEdgeBetween) and kept up
+ * to date by linkEdge and unlinkEdge from then on. Restoring a snapshot or
+ * compacting the graph discards it, and the next lookup builds it again. */
+typedef struct EdgeBucket {
+   int source, target;
+   int head, count;
+} EdgeBucket;
+
+typedef struct EdgeIndex {
+   bool built;
+   EdgeBucket *buckets;
+   /* As in LabelIndex, with pairs in place of lists. */
+   int size, count, used;
+} EdgeIndex;
+
 /* ================================
  * Graph Data Structure + Functions
  * ================================ */
@@ -76,8 +237,36 @@ typedef struct Graph
     * a dummy node (a hole created by the removal of a node), or a valid node. */
    int number_of_nodes, number_of_edges;
    
-   /* Root nodes referenced in a linked list for fast access. */
-   struct RootNodes *root_nodes;
+   /* Root nodes referenced in a dense set for fast access. */
+   RootNodes root_nodes;
+
+   /* Heads of the node signature buckets, indexed by signature (see SIGNATURE
+    * in globals.h). Each bucket is a doubly-linked list of the indices of the
+    * nodes with that signature, threaded through the next_by_signature and
+    * prev_by_signature fields of the nodes. An empty bucket has head -1. 
+    * Used by the generated matching code so that only the nodes whose mark
+    * and degrees are compatible with the rule node are considered. */
+   int nodes_by_signature[NUMBER_OF_SIGNATURES];
+
+   /* The number of nodes with each mark, kept with the signature buckets. Read
+    * by generated matchers that choose between searchplans at runtime. */
+   int node_mark_counts[NUMBER_OF_MARKS];
+
+   /* The most recent snapshot of the graph, or NULL. See pushGraphSnapshot. */
+   struct GraphSnapshot *snapshot;
+
+   LabelIndex label_index;
+   EdgeIndex edge_index;
+   /* The number of incident edge arrays (outgoing and incoming) of the nodes
+    * that hold more than EDGE_INDEX_MIN_DEGREE edges. If it is zero, no lookup
+    * uses the edge index. */
+   int high_degree_arrays;
+
+   /* The value of the matched entries of the items matched by the current
+    * search. Never 0. */
+   unsigned match_epoch;
+
+   ChangeJournal journal;
 } Graph;
 
 /* The arguments nodes and edges are the initial sizes of the node array and the
@@ -97,10 +286,88 @@ void relabelNode(Graph *graph, int index, HostLabel new_label);
 void changeNodeMark(Graph *graph, int index, MarkType new_mark);
 void changeRoot(Graph *graph, int index);
 void resetMatchedNodeFlag(Graph *graph, int index);
+/* Unmatches all nodes and edges by advancing the match epoch, so that the 
+ * matched entries of the items do not have to be written back. The entries 
+ * are cleared only when the epoch wraps around. */
+void resetMatchedFlags(Graph *graph);
+/* Removes the holes from the node array and from the edge array if at least
+ * half of the array's slots are holes. The live items keep their relative
+ * order and all node and edge indices stored in the graph are remapped.
+ * Indices held outside the graph, such as those in morphisms and in graph
+ * change records, are invalidated. See compactGraphAtSafePoint in 
+ * graphStacks.h. */
+void compactGraph(Graph *graph);
+/* linkEdge adds an edge to the incident edges of its source and target,
+ * updates their degrees and sets the edge's dense array entries. unlinkEdge
+ * reverses linkEdge. */
+void linkEdge(Graph *graph, int index);
+void unlinkEdge(Graph *graph, int index);
+/* indexNode copies a node's mark, degrees and root status to the dense arrays
+ * and moves the node to the signature bucket of those values, if it is not
+ * already there, and to the label index bucket of its list. unindexNode 
+ * removes the node from both indices. Called by the graph modification functions above. They are
+ * exposed for the graph backtracking code, which restores nodes and edges
+ * without calling the functions above. */
+void indexNode(Graph *graph, int index);
+void unindexNode(Graph *graph, int index);
 void relabelEdge(Graph *graph, int index, HostLabel new_label);
 void changeEdgeMark(Graph *graph, int index, MarkType new_mark);
 void resetMatchedEdgeFlag(Graph *graph, int index);
 
+/* Copy-on-write snapshots of a graph. pushGraphSnapshot records the sizes of
+ * the graph's arrays and the other graph-level fields, and returns the number
+ * of snapshots below the new one. The contents of the arrays are not copied.
+ * Instead, the node array, the edge array and the holes arrays are divided
+ * into pages of consecutive slots, and the graph modification functions save
+ * a page to the top snapshot before they first modify it. Only the pages 
+ * modified after a snapshot is taken are ever copied.
+ *
+ * restoreGraphSnapshot copies the saved pages back, returning the graph to its
+ * state at the time of the top snapshot, and removes the snapshot. 
+ * dropGraphSnapshot removes the top snapshot and keeps the current state. Its
+ * saved pages are passed to the snapshot below it if that snapshot has not 
+ * saved them itself. The matched flags are not part of a snapshot: restored
+ * items are unmatched. compactGraph must not be called on a graph with a 
+ * snapshot. */
+int pushGraphSnapshot(Graph *graph);
+int countGraphSnapshots(Graph *graph);
+void restoreGraphSnapshot(Graph *graph);
+void dropGraphSnapshot(Graph *graph);
+
+/* The state of a generated matcher that resumes its search for the first rule
+ * node where its previous search stopped, instead of rescanning the signature
+ * buckets from the start. A host node passed over by an earlier search did not
+ * match then, and can match now only if a node within the rule's radius of it
+ * has changed since: the radius is the largest distance in the LHS from the 
+ * first rule node to any other rule node, which must all be connected to it.
+ *
+ * updateSearchResume reads the journal entries written since the previous
+ * call and adds the live nodes within the radius of the changed nodes to the
+ * pending nodes, which the matcher tries before continuing the scan from 
+ * bucket and index (-1 for the start of the bucket). If the journal has been
+ * reset or has overflowed since the previous call, the pending nodes are 
+ * dropped and the scan restarts. A zero-initialised SearchResume restarts the
+ * scan. A matcher keeps the node it returns pending, or at the scan position,
+ * because the match might not be applied. */
+typedef struct SearchResume {
+   long journal_position;
+   int bucket, index;
+   int *pending;
+   int pending_size, pending_capacity;
+} SearchResume;
+
+void updateSearchResume(Graph *graph, SearchResume *resume, int radius);
+
+/* A rule that failed to match cannot match until a node is changed that 
+ * afterwards has the signature of a possible match for one of its LHS nodes.
+ * relevant is indexed by signature. The generated matcher stores the journal
+ * count in failed_at when the rule fails, and calls relevantChangeSince before
+ * searching again. If no relevant change has been journaled since, it returns
+ * false and moves failed_at to the current count, so that each entry is read
+ * once. Otherwise, or if the journal has been reset or has overflowed, it 
+ * returns true and sets failed_at to 0. */
+bool relevantChangeSince(Graph *graph, long *failed_at, const bool *relevant);
+
 /* =========================
  * Node and Edge Definitions
  * ========================= */
@@ -109,25 +376,33 @@ typedef struct Node {
    bool root;
    HostLabel label;
    int outdegree, indegree;
-   int first_out_edge, second_out_edge;
-   int first_in_edge, second_in_edge;
-   /* Dynamic integer arrays for the node's outgoing and incoming edges. */
-   IntArray out_edges, in_edges;
-   bool matched;
+   /* The number of loops incident to the node. Loops are also counted in the
+    * outdegree and the indegree. */
+   int loopdegree;
+   IncidentEdges out_edges, in_edges;
+   /* The signature bucket containing the node (-1 if the node is not in the
+    * index) and links to the neighbouring nodes in that bucket. */
+   int signature;
+   int next_by_signature, prev_by_signature;
+   /* The list under which the node is in the label index (NULL if it is not 
+    * in the index) and links to the neighbouring nodes with that list. */
+   struct HostList *indexed_list;
+   int next_by_label, prev_by_label;
 } Node;
 
 extern struct Node dummy_node;
 
-typedef struct RootNodes {
-   int index;
-   struct RootNodes *next;
-} RootNodes;
+/* freeNodeEdges returns the node's overflow blocks to the edge block pool.
+ * copyNodeEdges gives a bitwise copy of a node its own overflow blocks. */
+void freeNodeEdges(Node *node);
+void copyNodeEdges(Node *node);
 
 typedef struct Edge {
    int index;
    HostLabel label;
    int source, target;
-   bool matched;
+   /* Links of the edge index bucket of the edge's source and target. */
+   int next_by_ends, prev_by_ends;
 } Edge;
 
 extern struct Edge dummy_edge;
@@ -139,14 +414,33 @@ Node *getNode(Graph *graph, int index);
 Edge *getEdge(Graph *graph, int index);
 RootNodes *getRootNodeList(Graph *graph);
 
-/* Called with a positive integer n. The node structures store two outedge indices
- * and two inedge indices. More incident edges are placed in a dynamic array.
- * Pass n = 0 to get the node's first incident edge.
- * Pass n = 1 to get the node's second incident edge.
- * Pass n >= 2 to get the (n-2)th incident edge in the appropriate array. 
- * Designed for iteration e.g. 
- * for(i = 0; i < n->out_edges.size + 2; i++) getNthOutEdge(g, n, i); 
- * I'm sure there's a nicer way to do this... */
+/* Iteration over the nodes with a particular signature. Both functions return
+ * -1 when there are no more nodes. Designed for iteration e.g.
+ * for(i = getFirstNodeBySignature(g, s); i != -1; i = getNextNodeBySignature(g, i)) */
+int getFirstNodeBySignature(Graph *graph, int signature);
+int getNextNodeBySignature(Graph *graph, int index);
+
+/* Lookup in the label index. countNodesByList returns the number of nodes
+ * whose label has the passed non-empty list. Iteration is as above, e.g.
+ * for(i = getFirstNodeByList(g, l); i != -1; i = getNextNodeByList(g, i)) */
+int countNodesByList(Graph *graph, struct HostList *list);
+int getFirstNodeByList(Graph *graph, struct HostList *list);
+int getNextNodeByList(Graph *graph, int index);
+
+/* Lookup in the edge index. Iteration over the edges from source to target,
+ * designed for iteration e.g.
+ * for(i = getFirstEdgeBetween(g, s, t); i != -1; i = getNextEdgeBetween(g, i)) */
+int getFirstEdgeBetween(Graph *graph, int source, int target);
+int getNextEdgeBetween(Graph *graph, int index);
+
+/* Builds the edge index if it is not built. Lookups build it themselves, but
+ * they must not do so while several threads are matching, so a parallel
+ * search calls this first if the graph has a node of high degree. */
+void buildEdgeIndex(Graph *graph);
+
+/* Called with an integer 0 <= n < outdegree (resp. indegree). Returns the nth
+ * incident edge of the node. Generated code should prefer the forEachOutEdge
+ * and forEachInEdge macros, which avoid the repeated inline/overflow check. */
 Edge *getNthOutEdge(Graph *graph, Node *node, int n);
 Edge *getNthInEdge(Graph *graph, Node *node, int n);
 Node *getSource(Graph *graph, Edge *edge); 
@@ -15,16 +15,41 @@
 
 #include "graphStacks.h"
 
+#define CHANGE_CHUNK_SIZE 65536
+
+/* The last byte of each record: the change type in the low bits and flags. */
+#define CHANGE_TYPE_MASK 0x0F
+#define CHANGE_HOLE 0x10
+#define CHANGE_ROOT 0x20
+#define CHANGE_LABEL 0x40
+
+/* A reference to the host list of a recorded label, tagged with the position
+ * of its record in the log. */
+typedef struct LabelReference {
+   int position;
+   HostList *list;
+} LabelReference;
+
 typedef struct GraphChangeStack {
-   int size;
-   int capacity;
-   GraphChange *stack;
+   /* The position of the end of the log. Positions in chunk n start at
+    * n * CHANGE_CHUNK_SIZE. A record never spans two chunks: if it does not
+    * fit in the rest of the current chunk, it starts the next one. used
+    * records where the data in each chunk ends. */
+   int top;
+   int chunks, chunk_capacity;
+   unsigned char **chunk;
+   int *used;
+   int labels, label_capacity;
+   LabelReference *label;
+   /* The log positions of the open savepoints, innermost last. */
+   int savepoints, savepoint_capacity;
+   int *savepoint;
 } GraphChangeStack;
 
 GraphChangeStack *graph_change_stack = NULL;
 int graph_change_count = 0;
 
-static void makeGraphChangeStack(int initial_capacity)
+static void makeGraphChangeStack(void)
 {
    GraphChangeStack *stack = malloc(sizeof(GraphChangeStack));
    if(stack == NULL)
@@ -32,160 +57,266 @@ static void makeGraphChangeStack(int initial_capacity)
       print_to_log("Error (makeGraphChangeStack): malloc failure.\n");
       exit(1);
    }
-   stack->size = 0;
-   stack->capacity = initial_capacity;
-   stack->stack = calloc(initial_capacity, sizeof(GraphChange)); 
-   if(stack->stack == NULL)
-   {
-      print_to_log("Error (makeGraphChangeStack): malloc failure.\n");
-      exit(1);
-   }
+   stack->top = 0;
+   stack->chunks = 0;
+   stack->chunk_capacity = 0;
+   stack->chunk = NULL;
+   stack->used = NULL;
+   stack->labels = 0;
+   stack->label_capacity = 0;
+   stack->label = NULL;
+   stack->savepoints = 0;
+   stack->savepoint_capacity = 0;
+   stack->savepoint = NULL;
    graph_change_stack = stack;
 }
 
-static void growGraphChangeStack(void)
+static void addChangeChunk(void)
 {
-   graph_change_stack->capacity *= 2;
-   graph_change_stack->stack = realloc(graph_change_stack->stack,
-                                       graph_change_stack->capacity * sizeof(GraphChange)); 
-   if(graph_change_stack->stack == NULL)
+   GraphChangeStack *stack = graph_change_stack;
+   if(stack->chunks == stack->chunk_capacity)
+   {
+      stack->chunk_capacity = stack->chunk_capacity == 0 ? 4 : 2 * stack->chunk_capacity;
+      stack->chunk = realloc(stack->chunk, stack->chunk_capacity * sizeof(unsigned char *));
+      stack->used = realloc(stack->used, stack->chunk_capacity * sizeof(int));
+      if(stack->chunk == NULL || stack->used == NULL)
+      {
+         print_to_log("Error (addChangeChunk): malloc failure.\n");
+         exit(1);
+      }
+   }
+   stack->chunk[stack->chunks] = malloc(CHANGE_CHUNK_SIZE);
+   if(stack->chunk[stack->chunks] == NULL)
    {
-      print_to_log("Error (growGraphChangeStack): malloc failure.\n");
+      print_to_log("Error (addChangeChunk): malloc failure.\n");
       exit(1);
    }
+   stack->used[stack->chunks] = 0;
+   stack->chunks++;
 }
 
-static void pushGraphChange(GraphChange change)
+/* Returns the address at which a record of the passed size is written and
+ * moves the top of the log past it. */
+static unsigned char *reserveRecord(int size)
 {
-   if(graph_change_stack == NULL) makeGraphChangeStack(128);
-   else if(graph_change_stack->size >= graph_change_stack->capacity) growGraphChangeStack();
-   graph_change_stack->stack[graph_change_stack->size++] = change;
+   if(graph_change_stack == NULL) makeGraphChangeStack();
+   GraphChangeStack *stack = graph_change_stack;
+   int chunk = stack->top / CHANGE_CHUNK_SIZE, offset = stack->top % CHANGE_CHUNK_SIZE;
+   if(offset + size > CHANGE_CHUNK_SIZE)
+   {
+      stack->used[chunk] = offset;
+      chunk++;
+      offset = 0;
+      stack->top = chunk * CHANGE_CHUNK_SIZE;
+   }
+   if(chunk == stack->chunks) addChangeChunk();
+   stack->used[chunk] = offset + size;
+   stack->top += size;
    graph_change_count++;
+   return stack->chunk[chunk] + offset;
 }
 
-static GraphChange pullGraphChange(void)
+/* Returns the address of the end of the last record, first moving the top of
+ * the log to the end of the previous chunk if it is at the start of a chunk. */
+static unsigned char *endOfLog(void)
 {
-   assert(graph_change_stack != NULL);
-   assert(graph_change_stack->size > 0);
-   return graph_change_stack->stack[--graph_change_stack->size];
+   GraphChangeStack *stack = graph_change_stack;
+   int chunk = stack->top / CHANGE_CHUNK_SIZE, offset = stack->top % CHANGE_CHUNK_SIZE;
+   if(offset == 0 && chunk > 0)
+   {
+      chunk--;
+      offset = stack->used[chunk];
+      stack->top = chunk * CHANGE_CHUNK_SIZE + offset;
+   }
+   return stack->chunk[chunk] + offset;
+}
+
+static unsigned char *putInt(unsigned char *record, int value)
+{
+   memcpy(record, &value, sizeof(int));
+   return record + sizeof(int);
+}
+
+static int getInt(unsigned char **record)
+{
+   int value;
+   memcpy(&value, *record, sizeof(int));
+   *record += sizeof(int);
+   return value;
+}
+
+/* The number of bytes of a record of each type, including the final byte. */
+static int recordSize(GraphChangeType type)
+{
+   switch(type)
+   {
+      case ADDED_NODE:
+      case ADDED_EDGE:
+      case CHANGED_ROOT_NODE:
+           return sizeof(int) + 1;
+
+      case REMOVED_EDGE:
+           return 3 * sizeof(int) + 2;
+
+      default:
+           return sizeof(int) + 2;
+   }
+}
+
+/* Keeps a reference to the list of a recorded label, as the modification being
+ * recorded could free the list or remove it from the list store. Returns the
+ * CHANGE_LABEL flag if a reference was taken. */
+static int recordLabel(HostLabel label, int position)
+{
+   if(label.list == NULL) return 0;
+   GraphChangeStack *stack = graph_change_stack;
+   if(stack->labels == stack->label_capacity)
+   {
+      stack->label_capacity = stack->label_capacity == 0 ? 128 : 2 * stack->label_capacity;
+      stack->label = realloc(stack->label, stack->label_capacity * sizeof(LabelReference));
+      if(stack->label == NULL)
+      {
+         print_to_log("Error (recordLabel): malloc failure.\n");
+         exit(1);
+      }
+   }
+   stack->label[stack->labels].position = position;
+   #ifdef LIST_HASHING
+      addHostList(label.list);
+      stack->label[stack->labels].list = label.list;
+   #else
+      stack->label[stack->labels].list = copyHostList(label.list);
+   #endif
+   stack->labels++;
+   return CHANGE_LABEL;
+}
+
+static void pushIndexChange(GraphChangeType type, int flags, int index)
+{
+   unsigned char *record = reserveRecord(recordSize(type));
+   record = putInt(record, index);
+   *record = type | flags;
+}
+
+/* Pushes a record of a removed or relabelled item. Source and target are 
+ * written only for removed edges. */
+static void pushLabelChange(GraphChangeType type, int flags, int index, HostLabel label,
+                            int source, int target)
+{
+   int size = recordSize(type);
+   unsigned char *record = reserveRecord(size);
+   flags |= recordLabel(label, graph_change_stack->top - size);
+   record = putInt(record, index);
+   if(type == REMOVED_EDGE)
+   {
+      record = putInt(record, source);
+      record = putInt(record, target);
+   }
+   *record++ = (unsigned char)label.mark;
+   *record = type | flags;
 }
 
 int topOfGraphChangeStack(void)
 {
-   return graph_change_stack->size;
+   return graph_change_stack->top;
 }
 
 void pushAddedNode(int index, bool hole_filled)
 {
-   GraphChange change;
-   change.type = ADDED_NODE;
-   change.added_node.index = index;
-   change.added_node.hole_filled = hole_filled;
-   pushGraphChange(change);
+   pushIndexChange(ADDED_NODE, hole_filled ? CHANGE_HOLE : 0, index);
 }
    
 void pushAddedEdge(int index, bool hole_filled)
 {
-   GraphChange change;
-   change.type = ADDED_EDGE;
-   change.added_edge.index = index;
-   change.added_edge.hole_filled = hole_filled;
-   pushGraphChange(change);
+   pushIndexChange(ADDED_EDGE, hole_filled ? CHANGE_HOLE : 0, index);
 }
 
 void pushRemovedNode(bool root, HostLabel label, int index, bool hole_created)
 {
-   GraphChange change;
-   change.type = REMOVED_NODE;
-   change.removed_node.root = root;
-   change.removed_node.label = label;
-   /* Keep a record of the list as the removal of the node could free this list
-    * or remove its bucket from the hash table. */
-   #ifdef LIST_HASHING
-      addHostList(label.list);
-   #else
-      change.removed_node.label.list = copyHostList(label.list);
-   #endif
-   change.removed_node.index = index;
-   change.removed_node.hole_created = hole_created;
-   pushGraphChange(change);
+   int flags = (root ? CHANGE_ROOT : 0) | (hole_created ? CHANGE_HOLE : 0);
+   pushLabelChange(REMOVED_NODE, flags, index, label, -1, -1);
 }
 
 void pushRemovedEdge(HostLabel label, int source, int target, int index, bool hole_created)
 {
-   GraphChange change;
-   change.type = REMOVED_EDGE;
-   change.removed_edge.label = label;
-   /* Keep a record of the list as the removal of the node could free this list
-    * or remove its bucket from the hash table. */
-   #ifdef LIST_HASHING
-      addHostList(label.list);
-   #else
-      change.removed_edge.label.list = copyHostList(label.list);
-   #endif
-   change.removed_edge.source = source;
-   change.removed_edge.target = target;
-   change.removed_edge.index = index;
-   change.removed_edge.hole_created = hole_created;
-   pushGraphChange(change);
+   pushLabelChange(REMOVED_EDGE, hole_created ? CHANGE_HOLE : 0, index, label, 
+                   source, target);
 }
 
 void pushRelabelledNode(int index, HostLabel old_label)
 {
-   GraphChange change;
-   change.type = RELABELLED_NODE;
-   change.relabelled_node.index = index;
-   change.relabelled_node.old_label = old_label;
-   /* Keep a record of the list as the relabelling of the node could free this
-    * list or remove its bucket from the hash table. */
-   #ifdef LIST_HASHING
-      addHostList(old_label.list);
-   #else
-      change.relabelled_node.old_label.list = copyHostList(old_label.list);
-   #endif
-   pushGraphChange(change);
+   pushLabelChange(RELABELLED_NODE, 0, index, old_label, -1, -1);
 }
 
 void pushRelabelledEdge(int index, HostLabel old_label)
 {
-   GraphChange change;
-   change.type = RELABELLED_EDGE;
-   change.relabelled_edge.index = index;
-   change.relabelled_edge.old_label = old_label;
-   /* Keep a record of the list as the relabelling of the edge could free this
-    * list or remove its bucket from the hash table. */
-   #ifdef LIST_HASHING
-      addHostList(old_label.list);
-   #else
-      change.relabelled_edge.old_label.list = copyHostList(old_label.list);
-   #endif
-   pushGraphChange(change);
+   pushLabelChange(RELABELLED_EDGE, 0, index, old_label, -1, -1);
 }
 
 void pushRemarkedNode(int index, MarkType old_mark)
 {
-   GraphChange change;
-   change.type = REMARKED_NODE;
-   change.remarked_node.index = index;
-   change.remarked_node.old_mark = old_mark;
-   pushGraphChange(change);
+   unsigned char *record = reserveRecord(recordSize(REMARKED_NODE));
+   record = putInt(record, index);
+   *record++ = (unsigned char)old_mark;
+   *record = REMARKED_NODE;
 }
 
 void pushRemarkedEdge(int index, MarkType old_mark)
 {
-   GraphChange change;
-   change.type = REMARKED_EDGE;
-   change.remarked_edge.index = index;
-   change.remarked_edge.old_mark = old_mark;
-   pushGraphChange(change);
+   unsigned char *record = reserveRecord(recordSize(REMARKED_EDGE));
+   record = putInt(record, index);
+   *record++ = (unsigned char)old_mark;
+   *record = REMARKED_EDGE;
 }
 
 void pushChangedRootNode(int index)
 {
+   pushIndexChange(CHANGED_ROOT_NODE, 0, index);
+}
+
+/* The fields of a record read back from the log. */
+typedef struct GraphChange {
+   GraphChangeType type;
+   int flags;
+   int index, source, target;
+   MarkType mark;
+   HostList *list;
+} GraphChange;
+
+/* Removes the last record from the log. The record takes over the reference to
+ * its label's list, if it has one. */
+static GraphChange pullGraphChange(void)
+{
+   assert(graph_change_stack != NULL);
+   assert(graph_change_stack->top > 0);
+   GraphChangeStack *stack = graph_change_stack;
+   unsigned char *end = endOfLog();
    GraphChange change;
-   change.type = CHANGED_ROOT_NODE; 
-   change.changed_root_index = index;
-   pushGraphChange(change);
+   change.type = end[-1] & CHANGE_TYPE_MASK;
+   change.flags = end[-1] & ~CHANGE_TYPE_MASK;
+   int size = recordSize(change.type);
+   unsigned char *record = end - size;
+   stack->top -= size;
+   change.index = getInt(&record);
+   if(change.type == REMOVED_EDGE)
+   {
+      change.source = getInt(&record);
+      change.target = getInt(&record);
+   }
+   if(size > (int)sizeof(int) + 1) change.mark = *record;
+   change.list = NULL;
+   if(change.flags & CHANGE_LABEL)
+   {
+      assert(stack->labels > 0 && stack->label[stack->labels - 1].position == stack->top);
+      change.list = stack->label[--stack->labels].list;
+   }
+   return change;
+}
+
+static HostLabel changeLabel(GraphChange change)
+{
+   int length = change.list == NULL ? 0 : change.list->length;
+   return makeHostLabel(change.mark, length, change.list);
 }
   
 /* The reversal of addition and removal of graph items is done manually as opposed
@@ -197,22 +328,22 @@ void undoChanges(Graph *graph, int restore_point)
 {
    if(graph_change_stack == NULL) return;
    assert(restore_point >= 0);
-   while(graph_change_stack->size > restore_point)
+   while(graph_change_stack->top > restore_point)
    { 
       GraphChange change = pullGraphChange();
       switch(change.type)
       {
          case ADDED_NODE:
          {
-              int index = change.added_node.index;
+              int index = change.index;
               Node *node = getNode(graph, index);  
 
-              if(node->out_edges.items != NULL) free(node->out_edges.items);
-              if(node->in_edges.items != NULL) free(node->in_edges.items); 
+              freeNodeEdges(node);
               if(node->root) removeRootNode(graph, index);
+              unindexNode(graph, index);
               removeHostList(node->label.list);
 
-              if(change.added_node.hole_filled) 
+              if(change.flags & CHANGE_HOLE) 
                  graph->nodes.holes.items[graph->nodes.holes.size++] = index;
               else graph->nodes.size--;
 
@@ -223,23 +354,12 @@ void undoChanges(Graph *graph, int restore_point)
 
          case ADDED_EDGE:
          {
-              int index = change.added_edge.index;
+              int index = change.index;
               Edge *edge = getEdge(graph, index);
-
-              Node *source = getNode(graph, edge->source);
-              if(source->first_out_edge == index) source->first_out_edge = -1;
-              else if(source->second_out_edge == index) source->second_out_edge = -1;
-              else removeFromIntArray(&(source->out_edges), index);
-              source->outdegree--;
-
-              Node *target = getNode(graph, edge->target);
-              if(target->first_in_edge == index) target->first_in_edge = -1;
-              else if(target->second_in_edge == index) target->second_in_edge = -1;
-              else removeFromIntArray(&(target->in_edges), index);
-              target->indegree--;
+              unlinkEdge(graph, index);
               removeHostList(edge->label.list);
 
-              if(change.added_edge.hole_filled)
+              if(change.flags & CHANGE_HOLE)
                  graph->edges.holes.items[graph->edges.holes.size++] = index;
               else graph->edges.size--;
 
@@ -250,58 +370,54 @@ void undoChanges(Graph *graph, int restore_point)
          case REMOVED_NODE:
          {
               Node node;
-              node.index = change.removed_node.index;
-              node.root = change.removed_node.root;
-              node.label = change.removed_node.label;
-              node.first_out_edge = -1;
-              node.second_out_edge = -1;
-              node.first_in_edge = -1;
-              node.second_in_edge = -1;
-              node.out_edges = makeIntArray(0);
-              node.in_edges = makeIntArray(0);
+              node.index = change.index;
+              node.root = (change.flags & CHANGE_ROOT) != 0;
+              node.label = changeLabel(change);
+              node.out_edges = dummy_node.out_edges;
+              node.in_edges = dummy_node.in_edges;
               node.outdegree = 0;
               node.indegree = 0;
-
-              graph->nodes.items[change.removed_node.index] = node;
+              node.loopdegree = 0;
+              node.signature = -1;
+              node.next_by_signature = -1;
+              node.prev_by_signature = -1;
+              node.indexed_list = NULL;
+              node.next_by_label = -1;
+              node.prev_by_label = -1;
+
+              graph->nodes.items[change.index] = node;
+              graph->nodes.matched[change.index] = 0;
+              /* The node is not necessarily restored to its previous position in
+               * its signature bucket. Only the membership of the buckets matters. */
+              indexNode(graph, change.index);
               /* If the removal of the node created a hole, manually remove it from
                * the holes array. */
-              if(change.removed_node.hole_created)
+              if(change.flags & CHANGE_HOLE)
               {
                  graph->nodes.holes.size--;
                  graph->nodes.holes.items[graph->nodes.holes.size] = -1;
               }
               else graph->nodes.size++;
-              if(node.root) addRootNode(graph, change.removed_node.index);
+              if(node.root) addRootNode(graph, change.index);
               graph->number_of_nodes++;
               break;
          }
          case REMOVED_EDGE:
          {
               Edge edge;
-              edge.index = change.removed_edge.index;
-              edge.label = change.removed_edge.label;
-              edge.source = change.removed_edge.source;
-              edge.target = change.removed_edge.target;
+              edge.index = change.index;
+              edge.label = changeLabel(change);
+              edge.source = change.source;
+              edge.target = change.target;
+              edge.next_by_ends = -1;
+              edge.prev_by_ends = -1;
  
-              int index = change.removed_edge.index;
+              int index = change.index;
               graph->edges.items[index] = edge;
-
-              Node *source = getNode(graph, change.removed_edge.source);
-              assert(source != NULL);
-              if(source->first_out_edge == -1) source->first_out_edge = index;
-              else if(source->second_out_edge == -1) source->second_out_edge = index;
-              else addToIntArray(&(source->out_edges), index);
-              source->outdegree++;
-
-              Node *target = getNode(graph, change.removed_edge.target);
-              assert(target != NULL);
-              if(target->first_in_edge == -1) target->first_in_edge = index;
-              else if(target->second_in_edge == -1) target->second_in_edge = index;
-              else addToIntArray(&(target->in_edges), index);
-              target->indegree++;
+              linkEdge(graph, index);
               /* If the removal of the edge created a hole, manually remove it from
                * the holes array. */
-              if(change.removed_edge.hole_created)
+              if(change.flags & CHANGE_HOLE)
               {
                  graph->edges.holes.size--;
                  graph->edges.holes.items[graph->edges.holes.size] = -1;
@@ -311,23 +427,23 @@ void undoChanges(Graph *graph, int restore_point)
               break;
          }
          case RELABELLED_NODE:
-              relabelNode(graph, change.relabelled_node.index, change.relabelled_node.old_label);
+              relabelNode(graph, change.index, changeLabel(change));
               break;
 
          case RELABELLED_EDGE:
-              relabelEdge(graph, change.relabelled_edge.index, change.relabelled_edge.old_label);
+              relabelEdge(graph, change.index, changeLabel(change));
               break;
 
          case REMARKED_NODE:
-              changeNodeMark(graph, change.remarked_node.index, change.remarked_node.old_mark);
+              changeNodeMark(graph, change.index, change.mark);
               break;
 
          case REMARKED_EDGE:
-              changeEdgeMark(graph, change.remarked_edge.index, change.remarked_edge.old_mark);
+              changeEdgeMark(graph, change.index, change.mark);
               break;
 
          case CHANGED_ROOT_NODE:
-              changeRoot(graph, change.changed_root_index);
+              changeRoot(graph, change.index);
               break;
               
          default: 
@@ -338,209 +454,94 @@ void undoChanges(Graph *graph, int restore_point)
    } 
 } 
 
-static void freeGraphChange(GraphChange change)
+/* Only the records holding a label reference need any work, so the log is cut
+ * back to the restore point after releasing those references. */
+void discardChanges(int restore_point)
 {
-   switch(change.type)
-   {
-      case ADDED_NODE:
-      case ADDED_EDGE:
-      case CHANGED_ROOT_NODE:
-           break;
-
-      case REMOVED_NODE:
-           removeHostList(change.removed_node.label.list);
-           break;
-
-      case REMOVED_EDGE:
-           removeHostList(change.removed_edge.label.list);
-           break;
-
-      case RELABELLED_NODE: 
-           removeHostList(change.relabelled_node.old_label.list);
-           break;
-
-      case RELABELLED_EDGE: 
-           removeHostList(change.relabelled_edge.old_label.list);
-           break;
-
-      default: 
-           print_to_log("Error (freeGraphChange): Unexepected graph change "
-                        "type %d.\n",change.type); 
-           break;      
-   }  
+   if(graph_change_stack == NULL) return;
+   GraphChangeStack *stack = graph_change_stack;
+   if(stack->top <= restore_point) return;
+   while(stack->labels > 0 && stack->label[stack->labels - 1].position >= restore_point)
+      removeHostList(stack->label[--stack->labels].list);
+   stack->top = restore_point;
 } 
 
-void discardChanges(int restore_point)
+int beginSavepoint(void)
 {
-   if(graph_change_stack == NULL) return;
-   while(graph_change_stack->size > restore_point) 
+   if(graph_change_stack == NULL) makeGraphChangeStack();
+   GraphChangeStack *stack = graph_change_stack;
+   if(stack->savepoints == stack->savepoint_capacity)
    {
-      GraphChange change = pullGraphChange();
-      freeGraphChange(change);
+      stack->savepoint_capacity = stack->savepoint_capacity == 0 ? 16 : 2 * stack->savepoint_capacity;
+      stack->savepoint = realloc(stack->savepoint, stack->savepoint_capacity * sizeof(int));
+      if(stack->savepoint == NULL)
+      {
+         print_to_log("Error (beginSavepoint): malloc failure.\n");
+         exit(1);
+      }
    }
-} 
+   stack->savepoint[stack->savepoints] = stack->top;
+   return stack->savepoints++;
+}
+
+void rollbackSavepoint(Graph *graph, int savepoint)
+{
+   assert(savepoint >= 0);
+   if(graph_change_stack == NULL || savepoint >= graph_change_stack->savepoints) return;
+   undoChanges(graph, graph_change_stack->savepoint[savepoint]);
+   graph_change_stack->savepoints = savepoint;
+}
+
+/* Releasing a nested savepoint only closes it: the records stay in the log, where
+ * the enclosing savepoint can still roll them back. */
+void releaseSavepoint(int savepoint)
+{
+   assert(savepoint >= 0);
+   if(graph_change_stack == NULL || savepoint >= graph_change_stack->savepoints) return;
+   graph_change_stack->savepoints = savepoint;
+   if(savepoint == 0) discardChanges(graph_change_stack->savepoint[0]);
+}
 
 void freeGraphChangeStack(void)
 {
    if(graph_change_stack == NULL) return;
-   #ifndef LIST_HASHING
-      discardChanges(0);
-   #endif
-   free(graph_change_stack->stack);
+   discardChanges(0);
+   int chunk;
+   for(chunk = 0; chunk < graph_change_stack->chunks; chunk++) 
+      free(graph_change_stack->chunk[chunk]);
+   free(graph_change_stack->chunk);
+   free(graph_change_stack->used);
+   free(graph_change_stack->label);
+   free(graph_change_stack->savepoint);
    free(graph_change_stack);
+   graph_change_stack = NULL;
+}
+
+void compactGraphAtSafePoint(Graph *graph)
+{
+   if(graph_change_stack != NULL && 
+      (graph_change_stack->top > 0 || graph_change_stack->savepoints > 0)) return;
+   if(graph->snapshot != NULL) return;
+   compactGraph(graph);
 }
 
 
-Graph **graph_stack = NULL;
-int graph_stack_index = 0;
 int graph_copy_count = 0;
 
-void copyGraph(Graph *graph)
+int copyGraph(Graph *graph)
 { 
-   printf("Copying host graph.\n");
-   if(graph_stack_index == GRAPH_STACK_SIZE)
-   {
-      print_to_log("Error: copyGraph called with a full graph stack.\n");
-      return;
-   }
-   if(graph_stack == NULL) graph_stack = calloc(GRAPH_STACK_SIZE, sizeof(Graph*));
-   if(graph_stack == NULL)
-   {
-      print_to_log("Error (copyGraph): malloc failure.\n");
-      exit(1);
-   }
-   Graph *graph_copy = newGraph(graph->nodes.capacity, graph->edges.capacity); 
-
-   graph_copy->nodes.size = graph->nodes.size;
-   graph_copy->nodes.capacity = graph->nodes.capacity;
-   memcpy(graph_copy->nodes.items, graph->nodes.items, graph->nodes.capacity * sizeof(Node));
-
-   graph_copy->edges.size = graph->edges.size;
-   graph_copy->edges.capacity = graph->edges.capacity;
-   memcpy(graph_copy->edges.items, graph->edges.items, graph->edges.capacity * sizeof(Edge));
-
-   /* newGraph allocates an initial holes array of size 16. This may be smaller
-    * then the holes array in the original graph. */
-   if(graph_copy->nodes.holes.capacity < graph->nodes.holes.capacity)
-   {
-      free(graph_copy->nodes.holes.items);
-      graph_copy->nodes.holes.items = calloc(graph->nodes.holes.capacity, sizeof(int));
-      if(graph_copy->nodes.holes.items == NULL)
-      {
-         print_to_log("Error (copyGraph): malloc failure.\n");
-         exit(1);
-      }
-   }
-   graph_copy->nodes.holes.size = graph->nodes.holes.size;
-   graph_copy->nodes.holes.capacity = graph->nodes.holes.capacity;
-   memcpy(graph_copy->nodes.holes.items, graph->nodes.holes.items,
-          graph->nodes.holes.capacity * sizeof(int));
-
-   if(graph_copy->edges.holes.capacity < graph->edges.holes.capacity)
-   {
-      free(graph_copy->edges.holes.items);
-      graph_copy->edges.holes.items = calloc(graph->edges.holes.capacity, sizeof(int));
-      if(graph_copy->edges.holes.items == NULL)
-      {
-         print_to_log("Error (copyGraph): malloc failure.\n");
-         exit(1);
-      }
-   }
-   graph_copy->edges.holes.size = graph->edges.holes.size;
-   graph_copy->edges.holes.capacity = graph->edges.holes.capacity;
-   memcpy(graph_copy->edges.holes.items, graph->edges.holes.items,
-          graph->edges.holes.capacity * sizeof(int));
-   
-   graph_copy->number_of_nodes = graph->number_of_nodes;
-   graph_copy->number_of_edges = graph->number_of_edges;
-   graph_copy->root_nodes = NULL;
- 
-   int index;
-   for(index = 0; index < graph_copy->nodes.size; index++)
-   {
-      Node *node_copy = getNode(graph_copy, index);
-      /* The entry in the node array may be a dummy node, in which case nothing
-       * needs to be done. This is tested by checking the node's index. */
-      if(node_copy->index >= 0)
-      {
-         Node *node = getNode(graph, index);
-         /* If necessary, copy the edges arrays of the original node. */
-         if(node->out_edges.items != NULL)
-         {
-            node_copy->out_edges.items = calloc(node_copy->out_edges.size, sizeof(int));
-            if(node_copy->out_edges.items == NULL)
-            {
-               print_to_log("Error: (copyGraph): malloc failure.\n");
-               exit(1);
-            }
-            memcpy(node_copy->out_edges.items, node->out_edges.items,
-                   node_copy->out_edges.size * sizeof(int));
-         }
-         if(node->in_edges.items != NULL)
-         {
-            node_copy->in_edges.items = calloc(node_copy->in_edges.size, sizeof(int));
-            if(node_copy->in_edges.items == NULL)
-            {
-               print_to_log("Error: (copyGraph): malloc failure.\n");
-               exit(1);
-            }
-            memcpy(node_copy->in_edges.items, node->in_edges.items,
-                   node_copy->in_edges.size * sizeof(int));
-         }
-         /* Populate the root nodes list. */
-         if(node_copy->root) addRootNode(graph_copy, node_copy->index);
-         #ifdef LIST_HASHING
-            addHostList(node->label.list);
-         #else
-            node_copy->label.list = copyHostList(node->label.list);
-         #endif
-      }
-   }
-   for(index = 0; index < graph_copy->edges.size; index++)
-   {
-      Edge *edge_copy = getEdge(graph_copy, index);
-      if(edge_copy->index >= 0)
-      {
-         HostLabel label = getEdgeLabel(graph, index);
-         #ifdef LIST_HASHING
-            addHostList(label.list);
-         #else
-            edge_copy->label.list = copyHostList(label.list);
-         #endif
-      }
-   }
-   graph_stack[graph_stack_index++] = graph_copy;
    graph_copy_count++;
+   return pushGraphSnapshot(graph);
 }
 
-Graph *revertGraph(Graph *current_graph, int restore_point)
-{
-   printf("Popping copy of host graph.\n");
-   if(graph_stack == NULL) return NULL;
-   assert(graph_stack_index >= restore_point);
-   if(graph_stack_index == restore_point) return current_graph;
-   else freeGraph(current_graph);
-
-   Graph *graph = NULL;
-   while(graph_stack_index > restore_point)
-   { 
-      graph = graph_stack[--graph_stack_index];
-      /* Free graphs between the passed restore point and the top stack entry. */
-      if(graph_stack_index > restore_point) freeGraph(graph);
-   }
-   return graph;
-}
-
-void discardGraphs(int depth)
+void revertGraph(Graph *graph, int restore_point)
 {
-   if(graph_stack == NULL) return;
-   while(graph_stack_index > depth) freeGraph(graph_stack[--graph_stack_index]);
+   assert(restore_point >= 0);
+   while(countGraphSnapshots(graph) > restore_point) restoreGraphSnapshot(graph);
 }
 
-void freeGraphStack(void)
+void discardGraphs(Graph *graph, int restore_point)
 {
-   if(graph_stack == NULL) return;
-   discardGraphs(0);
-   free(graph_stack);
+   assert(restore_point >= 0);
+   while(countGraphSnapshots(graph) > restore_point) dropGraphSnapshot(graph);
 }
-
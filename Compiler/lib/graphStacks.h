@@ -21,7 +21,8 @@
 
   Data structures and functions for graph backtracking. There are two types
   of graph backtracking: 
-  (1) A complete memory copy of the working graph.
+  (1) A copy-on-write snapshot of the working graph (see pushGraphSnapshot
+      in graph.h).
   (2) A stack of graph changes maintained so that the graph can be rolled back
       if necessary.
 
@@ -30,65 +31,27 @@
 #ifndef INC_GRAPH_STACKS_H
 #define INC_GRAPH_STACKS_H
 
-#define GRAPH_STACK_SIZE 4
-
 #include "globals.h"
 #include "graph.h"
 #include "label.h"
 
-/* A GraphChange stores the data sufficient to undo a particular graph modification.
- * Specifically, an undo operation must restore the graph to its exact state,
- * which includes the indices of nodes and edges in their arrays and the graph's
- * holes arrays. */
+/* A graph change record stores the data sufficient to undo a particular graph
+ * modification. Specifically, an undo operation must restore the graph to its 
+ * exact state, which includes the indices of nodes and edges in their arrays and
+ * the graph's holes arrays. 
+ *
+ * The records are packed into a byte log: each record holds only the fields its
+ * type needs (indices, a mark, the source and target of a removed edge) and ends
+ * with a byte giving its type and its flags (hole filled or created, root), so
+ * that the log can be read backwards. The log is stored in fixed-size chunks
+ * that are kept for reuse when the log shrinks. The label of a removed or 
+ * relabelled item is kept as a reference to its host list in a separate stack,
+ * so that discarding records needs to visit only those holding a reference. 
+ * A restore point is a position in the log. */
 typedef enum { ADDED_NODE = 0, ADDED_EDGE, REMOVED_NODE, REMOVED_EDGE, 
 	       RELABELLED_NODE, RELABELLED_EDGE, REMARKED_NODE, REMARKED_EDGE,
                CHANGED_ROOT_NODE} GraphChangeType; 
 
-typedef struct GraphChange 
-{
-   GraphChangeType type;
-   union
-   {
-      /* Records the array index to which this item was added and a flag to signal
-       * whether the item was added using an index from the holes array or not. */
-      struct {
-         int index; 
-         bool hole_filled;  
-      } added_node, added_edge;
-      /* Records the root status and label of the removed node, along with its 
-       * index in the node array and a flag set to true if the removal of this
-       * node created a hole in the node array. */
-      struct {
-         bool root;
-         HostLabel label;
-         int index;
-         bool hole_created;
-      } removed_node;
-      /* Records the label, source and target of the removed edge, along with its 
-       * index in the edge array and a flag set to true if the removal of this
-       * edge created a hole in the edge array. */
-      struct {
-         HostLabel label;
-         int source;
-         int target;
-         int index;
-         bool hole_created;
-      } removed_edge;
-      /* Records the index of the relabelled item and the item's previous label. */
-      struct {
-         int index;
-         HostLabel old_label;
-      } relabelled_node, relabelled_edge;   
-      /* Records the index of the remarked item and the item's previous mark. */
-      struct {
-         int index;
-         MarkType old_mark;
-      } remarked_node, remarked_edge;   
-      /* Records the index of the node whose root status was changed. */
-      int changed_root_index;
-   };
-} GraphChange; 
-
 struct GraphChangeStack;
 extern struct GraphChangeStack *graph_change_stack;
 extern int graph_change_count;
@@ -107,19 +70,38 @@ void undoChanges(Graph *graph, int restore_point);
 void discardChanges(int restore_point);
 void freeGraphChangeStack(void);
 
+/* Savepoints are the interface used by the generated code to record changes.
+ * beginSavepoint opens a savepoint at the top of the graph change stack and 
+ * returns its handle: the number of savepoints open below it. rollbackSavepoint
+ * undoes the changes made since the savepoint with the passed handle and closes
+ * it and every savepoint opened after it. releaseSavepoint closes the same 
+ * savepoints but keeps the changes. If an enclosing savepoint is still open,
+ * the released changes become part of it without touching the records; 
+ * otherwise nothing can roll them back and they are discarded. Both do nothing
+ * if the savepoint is already closed. */
+int beginSavepoint(void);
+void rollbackSavepoint(Graph *graph, int savepoint);
+void releaseSavepoint(int savepoint);
+
+/* Calls compactGraph if the graph change stack is empty, no savepoint is open
+ * and the graph has no snapshot. The change records and snapshots refer to items by their array
+ * index and rely on the holes that the recorded changes created, so the arrays
+ * are not compacted while any change is recorded. Called by the generated code
+ * after rule applications. */
+void compactGraphAtSafePoint(Graph *graph);
 
-extern Graph **graph_stack;
-extern int graph_stack_index;
-extern int graph_copy_count;
 
-/* Creates a memory copy of the passed graph and pushes it to the graph stack. */
-void copyGraph(Graph *graph);
+extern int graph_copy_count;
 
-/* Returns the graph at the stack entry <restore_point> entries from the
- * bottom of the stack. Frees the passed graph unless the restore point
- * refers to the stack's index. */
-Graph *revertGraph(Graph *current_graph, int restore_point);
-void discardGraphs(int depth);
-void freeGraphStack(void);
+/* Used by the generated code when graph copying is enabled. The snapshots of
+ * the passed graph form the stack. copyGraph pushes a snapshot and returns its
+ * restore point: the number of snapshots below it. revertGraph returns the
+ * graph to its state at the snapshot with the passed restore point and removes
+ * that snapshot and those above it. discardGraphs removes the same snapshots 
+ * but keeps the current state of the graph. The snapshots are freed by 
+ * freeGraph. */
+int copyGraph(Graph *graph);
+void revertGraph(Graph *graph, int restore_point);
+void discardGraphs(Graph *graph, int restore_point);
 
 #endif /* INC_GRAPH_STACKS_H */
@@ -14,96 +14,367 @@
   along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>. */
 
 #include "label.h"
+#include <stddef.h>
 
 HostLabel blank_label = {NONE, 0, NULL};
 
-#ifdef LIST_HASHING
-Bucket **list_store = NULL;
-
-/* The list hash table has 400 buckets. It is structured as follows:
- * Lists of length 1 occupy buckets 0 - 99.
- * Lists of length 2 occupy buckets 100 - 199.
- * Lists of length 3 occupy buckets 200 - 299.
- * Lists of length > 3 occupy buckets 300 - 399.
- * The first unit in the first atom (an integer or the first character of a string)
- * gives the index to add to the 'base' (the appropriate multiple of 100) as defined
- * in the function. */
-static unsigned hashHostList(HostAtom *list, int length)
+/* Lists and the strings in string atoms are allocated from an arena
+ * of large blocks instead of by individual mallocs. Allocation sizes up to 
+ * ARENA_SMALL_SIZE are rounded up to a multiple of ARENA_MIN_SIZE, larger ones
+ * to a power of two. Freed memory is kept in one free list per size for reuse. The link to
+ * the next free chunk is stored in the chunk itself. New chunks are cut from
+ * the current block by bumping a pointer. Requests larger than a quarter of a
+ * block get a block of their own. All blocks are released together by 
+ * freeHostListStore. */
+#define ARENA_BLOCK_SIZE 65536
+#define ARENA_MIN_SIZE 16
+#define ARENA_SMALL_SIZE 256
+#define ARENA_CLASSES 48
+/* Space reserved at the start of each block for the link to the next block. 
+ * Kept at ARENA_MIN_SIZE so that chunks stay aligned. */
+#define ARENA_HEADER ARENA_MIN_SIZE
+
+static char *arena_blocks = NULL;
+static char *arena_next = NULL, *arena_end = NULL;
+static void *arena_free_chunks[ARENA_CLASSES] = {NULL};
+
+static int arenaClass(size_t size, size_t *chunk_size)
 {
-   unsigned hash = 0;
-   int index;
-   for(index = 0; index < length; index++)
+   if(size <= ARENA_SMALL_SIZE)
    {
-      HostAtom atom = list[index];
-      int value = atom.type == 'i' ? atom.num : atom.str[0];
-      hash = ((hash << 5) + hash) + value; /* hash = hash * 33 + value */
+      int size_class = size == 0 ? 0 : (size - 1) / ARENA_MIN_SIZE;
+      *chunk_size = (size_class + 1) * ARENA_MIN_SIZE;
+      return size_class;
+   }
+   int size_class = ARENA_SMALL_SIZE / ARENA_MIN_SIZE;
+   *chunk_size = 2 * ARENA_SMALL_SIZE;
+   while(*chunk_size < size)
+   {
+      *chunk_size *= 2;
+      size_class++;
    }
-   return hash % LIST_TABLE_SIZE ;
+   assert(size_class < ARENA_CLASSES);
+   return size_class;
 }
-#endif
 
-static HostList *appendHostAtom(HostList *list, HostAtom atom, bool free_strings)
+static char *makeArenaBlock(size_t size)
 {
-   HostListItem *new_item = malloc(sizeof(HostListItem));
-   if(new_item == NULL)
+   char *block = malloc(size + ARENA_HEADER);
+   if(block == NULL)
    {
-      print_to_log("Error (appendAtom): malloc failure.\n");
+      print_to_log("Error (makeArenaBlock): malloc failure.\n");
       exit(1);
    }
-   new_item->atom = atom;
-   if(atom.type == 's') 
+   *(char **)block = arena_blocks;
+   arena_blocks = block;
+   return block + ARENA_HEADER;
+}
+
+static void *arenaAllocate(size_t size)
+{
+   size_t chunk_size;
+   int size_class = arenaClass(size, &chunk_size);
+   void *chunk = arena_free_chunks[size_class];
+   if(chunk != NULL)
    {
-      if(free_strings) new_item->atom.str = atom.str;
-      else new_item->atom.str = strdup(atom.str);
+      arena_free_chunks[size_class] = *(void **)chunk;
+      return chunk;
    }
-   new_item->next = NULL;
+   if(chunk_size > ARENA_BLOCK_SIZE / 4) return makeArenaBlock(chunk_size);
+   if(arena_next == NULL || (size_t)(arena_end - arena_next) < chunk_size)
+   {
+      /* The rest of the current block is abandoned until the arena is freed. */
+      arena_next = makeArenaBlock(ARENA_BLOCK_SIZE);
+      arena_end = arena_next + ARENA_BLOCK_SIZE;
+   }
+   chunk = arena_next;
+   arena_next += chunk_size;
+   return chunk;
+}
 
-   if(list == NULL)
+static void arenaFree(void *chunk, size_t size)
+{
+   size_t chunk_size;
+   int size_class = arenaClass(size, &chunk_size);
+   *(void **)chunk = arena_free_chunks[size_class];
+   arena_free_chunks[size_class] = chunk;
+}
+
+/* String interning. Each distinct string in a host list or a string assignment
+ * is stored once, in the arena, preceded by an InternedString header. Two 
+ * interned strings are equal if and only if they are the same pointer. The 
+ * interned strings are kept in an open-addressing table like the list store and
+ * are reference counted: a string is removed when its last user releases it. */
+typedef struct InternedString {
+   unsigned hash;
+   int reference_count;
+   int length;
+   char chars[];
+} InternedString;
+
+#define STRING_TABLE_INITIAL_SIZE 1024
+/* Marks a slot whose string was removed, so that probing continues past it. */
+static InternedString deleted_string;
+#define DELETED_STRING (&deleted_string)
+
+static InternedString **string_table = NULL;
+static unsigned string_table_size = 0;
+static unsigned string_table_count = 0;
+static unsigned string_table_used = 0;
+
+static InternedString *internedHeader(string str)
+{
+   return (InternedString *)(str - offsetof(InternedString, chars));
+}
+
+/* FNV-1a over the characters of the string. */
+static unsigned hashString(string str, int *length)
+{
+   unsigned hash = FNV_OFFSET_BASIS;
+   const unsigned char *c;
+   for(c = (const unsigned char *)str; *c != '\0'; c++) hash = FNV_STEP(hash, *c);
+   *length = (int)((const char *)c - str);
+   return hash;
+}
+
+static InternedString **makeStringTable(unsigned size)
+{
+   InternedString **table = calloc(size, sizeof(InternedString *));
+   if(table == NULL)
+   {
+      print_to_log("Error (makeStringTable): malloc failure.\n");
+      exit(1);
+   }
+   return table;
+}
+
+/* Rebuilds the table without its deleted slots, doubling it if the strings
+ * alone fill at least half of it. */
+static void resizeStringTable(void)
+{
+   unsigned old_size = string_table_size;
+   InternedString **old_table = string_table;
+   if(string_table_count * 2 >= string_table_size) string_table_size *= 2;
+   string_table = makeStringTable(string_table_size);
+   string_table_used = string_table_count;
+   unsigned mask = string_table_size - 1, index;
+   for(index = 0; index < old_size; index++)
    {
-      new_item->prev = NULL;
-      HostList *new_list = malloc(sizeof(HostList));
-      if(new_list == NULL)
+      InternedString *interned = old_table[index];
+      if(interned == NULL || interned == DELETED_STRING) continue;
+      unsigned slot = interned->hash & mask;
+      while(string_table[slot] != NULL) slot = (slot + 1) & mask;
+      string_table[slot] = interned;
+   }
+   free(old_table);
+}
+
+string internString(string str)
+{
+   if(string_table == NULL)
+   {
+      string_table_size = STRING_TABLE_INITIAL_SIZE;
+      string_table = makeStringTable(string_table_size);
+   }
+   int length;
+   unsigned hash = hashString(str, &length);
+   unsigned mask = string_table_size - 1;
+   unsigned slot = hash & mask;
+   int free_slot = -1;
+   while(string_table[slot] != NULL)
+   {
+      InternedString *interned = string_table[slot];
+      if(interned == DELETED_STRING)
+      {
+         if(free_slot < 0) free_slot = slot;
+      }
+      else if(interned->hash == hash && interned->length == length &&
+              memcmp(interned->chars, str, length) == 0)
       {
-         print_to_log("Error (appendAtom): malloc failure.\n");
-         exit(1);
+         interned->reference_count++;
+         return interned->chars;
       }
-      new_list->hash = -1;
-      new_list->first = new_item;
-      new_list->last = new_item;
-      return new_list;
+      slot = (slot + 1) & mask;
    }
+   InternedString *interned = arenaAllocate(sizeof(InternedString) + length + 1);
+   interned->hash = hash;
+   interned->reference_count = 1;
+   interned->length = length;
+   memcpy(interned->chars, str, length + 1);
+   string_table_count++;
+   if(free_slot >= 0) string_table[free_slot] = interned;
    else
    {
-      list->last->next = new_item;
-      new_item->prev = list->last;
-      list->last = new_item;
-      return list;
+      string_table[slot] = interned;
+      string_table_used++;
+      if(string_table_used * 4 >= string_table_size * 3) resizeStringTable();
+   }
+   return interned->chars;
+}
+
+void retainString(string str)
+{
+   InternedString *interned = internedHeader(str);
+   assert(interned->reference_count > 0);
+   interned->reference_count++;
+}
+
+void releaseString(string str)
+{
+   InternedString *interned = internedHeader(str);
+   assert(interned->reference_count > 0);
+   interned->reference_count--;
+   if(interned->reference_count > 0) return;
+   unsigned mask = string_table_size - 1;
+   unsigned slot = interned->hash & mask;
+   while(string_table[slot] != interned)
+   {
+      assert(string_table[slot] != NULL);
+      slot = (slot + 1) & mask;
    }
+   string_table[slot] = DELETED_STRING;
+   string_table_count--;
+   arenaFree(interned, sizeof(InternedString) + interned->length + 1);
 }
 
 #ifdef LIST_HASHING
-/* Create a new bucket, allocate a list defined by the function arguments, and
- * point the bucket to that list. */
-static Bucket *makeBucket(HostAtom *array, int length, bool free_strings)
+static void freeArena(void)
 {
-   Bucket *bucket = malloc(sizeof(Bucket));
-   if(bucket == NULL)
+   while(arena_blocks != NULL)
    {
-      print_to_log("Error (makeBucket): malloc failure.\n");
-      exit(1);
+      char *next = *(char **)arena_blocks;
+      free(arena_blocks);
+      arena_blocks = next;
    }
-   HostList *list = NULL;
+   arena_next = NULL;
+   arena_end = NULL;
+   int size_class;
+   for(size_class = 0; size_class < ARENA_CLASSES; size_class++) 
+      arena_free_chunks[size_class] = NULL;
+}
+#endif
+
+/* FNV-1a over the type and value of each atom. The strings are interned, so
+ * a string atom contributes the hash of its full contents, which is cached in
+ * its interned header. The compiler repeats this computation for constant
+ * rule lists (see generateFixedListMatchingCode in genLabel.c). */
+static unsigned hashHostList(HostAtom *list, int length)
+{
+   unsigned hash = FNV_OFFSET_BASIS;
+   int index;
+   for(index = 0; index < length; index++)
+   {
+      HostAtom atom = list[index];
+      hash = FNV_STEP(hash, atom.type);
+      unsigned value = atom.type == 'i' ? (unsigned)atom.num : internedHeader(atom.str)->hash;
+      int byte;
+      for(byte = 0; byte < 4; byte++)
+      {
+         hash = FNV_STEP(hash, value & 0xFF);
+         value >>= 8;
+      }
+   }
+   return hash;
+}
+
+#ifdef LIST_HASHING
+HostList **list_store = NULL;
+
+#define LIST_STORE_INITIAL_SIZE 1024
+/* Marks a slot whose list was removed, so that probing continues past it. */
+static HostList deleted_list;
+#define DELETED_LIST (&deleted_list)
+
+/* The number of slots in the table, the number of lists in it, and the number
+ * of slots that are not empty (lists and deleted slots). */
+static unsigned list_store_size = 0;
+static unsigned list_store_count = 0;
+static unsigned list_store_used = 0;
+
+/* Compares two lists whose strings are interned. */
+static bool sameHostAtoms(HostAtom *left_list, HostAtom *right_list, int length)
+{
    int index;
-   for(index = 0; index < length; index++) 
-      list = appendHostAtom(list, array[index], free_strings);
-   bucket->list = list;
-   bucket->reference_count = 1;
-   bucket->next = NULL;
-   bucket->prev = NULL;
-   return bucket;
+   for(index = 0; index < length; index++)
+   {
+      if(left_list[index].type != right_list[index].type) return false;
+      if(left_list[index].type == 'i')
+      {
+         if(left_list[index].num != right_list[index].num) return false;
+      }
+      else if(left_list[index].str != right_list[index].str) return false;
+   }
+   return true;
+}
+
+static HostList **makeListStore(unsigned size)
+{
+   HostList **store = calloc(size, sizeof(HostList *));
+   if(store == NULL)
+   {
+      print_to_log("Error (makeListStore): malloc failure.\n");
+      exit(1);
+   }
+   return store;
+}
+
+/* Rebuilds the table, dropping the deleted slots. The table is doubled if the
+ * lists alone fill at least half of it. */
+static void resizeListStore(void)
+{
+   unsigned old_size = list_store_size;
+   HostList **old_store = list_store;
+   if(list_store_count * 2 >= list_store_size) list_store_size *= 2;
+   list_store = makeListStore(list_store_size);
+   list_store_used = list_store_count;
+   unsigned mask = list_store_size - 1, index;
+   for(index = 0; index < old_size; index++)
+   {
+      HostList *list = old_store[index];
+      if(list == NULL || list == DELETED_LIST) continue;
+      unsigned slot = list->hash & mask;
+      while(list_store[slot] != NULL) slot = (slot + 1) & mask;
+      list_store[slot] = list;
+   }
+   free(old_store);
 }
 #endif
 
+static size_t hostListSize(int length)
+{
+   return sizeof(HostList) + length * sizeof(HostAtom);
+}
+
+/* Returns a new list with a copy of the atoms in the array, or NULL if the
+ * length is 0. The strings in the array must be interned: the new list takes
+ * over the references to them. */
+static HostList *makeList(HostAtom *array, int length, unsigned hash)
+{
+   if(length == 0) return NULL;
+   HostList *list = arenaAllocate(hostListSize(length));
+   list->hash = hash;
+   list->reference_count = 1;
+   list->length = length;
+   memcpy(list->atoms, array, length * sizeof(HostAtom));
+   return list;
+}
+
+/* Copies the array into interned, replacing each string by its interned copy.
+ * The strings of the array are freed if free_strings is true. */
+static void internAtoms(HostAtom *array, HostAtom *interned, int length, bool free_strings)
+{
+   int index;
+   for(index = 0; index < length; index++)
+   {
+      interned[index] = array[index];
+      if(array[index].type == 's') 
+      {
+         interned[index].str = internString(array[index].str);
+         if(free_strings) free(array[index].str);
+      }
+   }
+}
+
 /* Adds a host list, represented by the passed array and its length, to the hash
  * table. The array and the length is passed to the hashing function. 
  *
@@ -116,116 +387,62 @@ static Bucket *makeBucket(HostAtom *array, int length, bool free_strings)
  * automatic strings which should not be freed. */
 HostList *makeHostList(HostAtom *array, int length, bool free_strings)
 {
+   if(length == 0) return NULL;
+   HostAtom atoms[length];
+   internAtoms(array, atoms, length, free_strings);
    #ifdef LIST_HASHING
       if(list_store == NULL)
       {
-         list_store = calloc(LIST_TABLE_SIZE, sizeof(Bucket*));
-         if(list_store == NULL)
-         {
-            print_to_log("Error(addListToStore): malloc failure.\n");
-            exit(1);
-         }
+         list_store_size = LIST_STORE_INITIAL_SIZE;
+         list_store = makeListStore(list_store_size);
       }
-      int hash = hashHostList(array, length);
-      if(list_store[hash] == NULL)
+      unsigned hash = hashHostList(atoms, length);
+      unsigned mask = list_store_size - 1;
+      unsigned slot = hash & mask;
+      /* The first deleted slot on the probe sequence is reused if the list is
+       * not in the table. */
+      int free_slot = -1;
+      while(list_store[slot] != NULL)
       {
-         Bucket *bucket = makeBucket(array, length, free_strings);
-         list_store[hash] = bucket;
-         bucket->list->hash = hash;
-         return bucket->list;
-      }
-      /* Check each list in the bucket for equality with the list represented
-       * by the passed array. */
-      else
-      {
-         Bucket *bucket = list_store[hash];
-         int index;
-         bool make_bucket = true;
-         while(bucket != NULL)
-         {
-            HostListItem *item = bucket->list->first;
-            for(index = 0; index < length; index++) 
-            {
-               if(item == NULL) break;
-               HostAtom atom = array[index];
-               if(item->atom.type != atom.type) break;
-               if(item->atom.type == 'i') 
-               {
-                  if(item->atom.num != atom.num) break;
-               }
-               else
-               {
-                  if(strcmp(item->atom.str, atom.str) != 0) break;
-               }
-               item = item->next;
-            }
-            /* The lists are equal if and only if the ends of both lists are reached.
-             * If an atom comparison failed, the for loop breaks before the end of
-             * either list is reached. If the array is shorter, then the for loop
-             * exits before item reaches its terminating NULL pointer. If the list
-             * is shorter, the first line in the for loop body will cause the loop
-             * to break before index == length. */
-            if(index == length && item == NULL)
-            {
-               make_bucket = false; 
-               break;
-            }
-            /* Exit the loop while maintaining the pointer to the last item in the
-             * bucket list, because a list is going to be appended! */
-            if(bucket->next == NULL) break;
-            bucket = bucket->next;
-         }
-         /* If control reaches this point, then no list in the bucket is equal to
-          * the passed list. Make a new list! */
-         if(make_bucket)
+         HostList *list = list_store[slot];
+         if(list == DELETED_LIST)
          {
-            Bucket *new_bucket = makeBucket(array, length, free_strings);
-            bucket->next = new_bucket;
-            new_bucket->prev = bucket;
-            new_bucket->list->hash = hash;
-            return new_bucket->list;
+            if(free_slot < 0) free_slot = slot;
          }
-         else 
+         else if(list->hash == hash && list->length == length &&
+                 sameHostAtoms(list->atoms, atoms, length))
          {
-            bucket->reference_count++;
-            if(free_strings)
-            {
-               for(index = 0; index < length; index++) 
-                  if(array[index].type == 's') free(array[index].str);
-            }
-            return bucket->list;
+            list->reference_count++;
+            /* Drop the string references taken for the array. */
+            int index;
+            for(index = 0; index < length; index++) 
+               if(atoms[index].type == 's') releaseString(atoms[index].str);
+            return list;
          }
+         slot = (slot + 1) & mask;
+      }
+      HostList *list = makeList(atoms, length, hash);
+      list_store_count++;
+      if(free_slot >= 0) list_store[free_slot] = list;
+      else
+      {
+         list_store[slot] = list;
+         list_store_used++;
+         if(list_store_used * 4 >= list_store_size * 3) resizeListStore();
       }
-   #else
-      HostList *list = NULL;
-      int index;
-      for(index = 0; index < length; index++) 
-         list = appendHostAtom(list, array[index], free_strings);
       return list;
+   #else
+      return makeList(atoms, length, hashHostList(atoms, length));
    #endif
 }
 
 #ifdef LIST_HASHING
-/* Returns the bucket containing the passed list. */
-static Bucket *getBucket(HostList *list)
-{
-   Bucket *bucket = list_store[list->hash];
-   assert(bucket != NULL);
-   while(bucket != NULL)
-   {
-      if(bucket->list == list) return bucket;
-      bucket = bucket->next;
-   } 
-   return NULL;
-}
-
 void addHostList(HostList *list)
 {
    if(list == NULL) return;
-   Bucket *bucket = getBucket(list); 
    /* The passed list is expected to exist in the host table. */
-   assert(bucket != NULL);
-   bucket->reference_count++;
+   assert(list->reference_count > 0);
+   list->reference_count++;
 }
 #endif
 
@@ -233,18 +450,21 @@ void removeHostList(HostList *list)
 {
    if(list == NULL) return;
    #ifdef LIST_HASHING
-      Bucket *bucket = getBucket(list); 
       /* The passed list is expected to exist in the host table. */
-      assert(bucket != NULL);
-      bucket->reference_count--;
-      if(bucket->reference_count == 0)
+      assert(list->reference_count > 0);
+      list->reference_count--;
+      if(list->reference_count == 0)
       {
-         /* Delete the bucket. */
-         if(bucket->prev == NULL) list_store[list->hash] = bucket->next;
-         else bucket->prev->next = bucket->next;
-         if(bucket->next != NULL) bucket->next->prev = bucket->prev;
+         unsigned mask = list_store_size - 1;
+         unsigned slot = list->hash & mask;
+         while(list_store[slot] != list) 
+         {
+            assert(list_store[slot] != NULL);
+            slot = (slot + 1) & mask;
+         }
+         list_store[slot] = DELETED_LIST;
+         list_store_count--;
          freeHostList(list);
-         free(bucket);
       }
    #else
       freeHostList(list);
@@ -286,7 +506,10 @@ bool equalHostLists(HostAtom *left_list, HostAtom *right_list,
       {
          if(left_atom.num != right_atom.num) return false;
       }
-      else if(strcmp(left_atom.str, right_atom.str) != 0) return false;
+      /* Interned strings are equal only if they are the same pointer, but the
+       * arrays passed here may also hold strings built at runtime. */
+      else if(left_atom.str != right_atom.str && 
+              strcmp(left_atom.str, right_atom.str) != 0) return false;
    }
    return true;
 }
@@ -294,20 +517,16 @@ bool equalHostLists(HostAtom *left_list, HostAtom *right_list,
 HostList *copyHostList(HostList *list)
 {
    if(list == NULL) return NULL;
-   HostList *list_copy = NULL;
-   HostListItem *item = list->first;
-   while(item != NULL)
-   {
-      list_copy = appendHostAtom(list_copy, item->atom, false);
-      item = item->next;
-   }
-   return list_copy;
+   int index;
+   for(index = 0; index < list->length; index++)
+      if(list->atoms[index].type == 's') retainString(list->atoms[index].str);
+   return makeList(list->atoms, list->length, list->hash);
 }
    
 void printHostLabel(HostLabel label, FILE *file) 
 {
    if(label.length == 0) fprintf(file, "empty");
-   else printHostList(label.list->first, file);
+   else printHostList(label.list->atoms, label.list->length, file);
    if(label.mark == RED) fprintf(file, " # red"); 
    if(label.mark == GREEN) fprintf(file, " # green");
    if(label.mark == BLUE) fprintf(file, " # blue");
@@ -315,47 +534,43 @@ void printHostLabel(HostLabel label, FILE *file)
    if(label.mark == DASHED) fprintf(file, " # dashed");
 }
 
-void printHostList(HostListItem *item, FILE *file)
+void printHostList(HostAtom *atoms, int length, FILE *file)
 {
-   while(item != NULL)
+   int index;
+   for(index = 0; index < length; index++)
    {
-      if(item->atom.type == 'i') fprintf(file, "%d", item->atom.num);
-      else fprintf(file, "\"%s\"", item->atom.str);
-      if(item->next != NULL) fprintf(file, " : ");
-      item = item->next;
+      if(atoms[index].type == 'i') fprintf(file, "%d", atoms[index].num);
+      else fprintf(file, "\"%s\"", atoms[index].str);
+      if(index < length - 1) fprintf(file, " : ");
    }
 }
 
-static void freeHostListItems(HostListItem *item)
-{
-   if(item == NULL) return;
-   if(item->atom.type == 's') free(item->atom.str);
-   freeHostListItems(item->next);
-   free(item);
-}
-
 void freeHostList(HostList *list)
 {
    if(list == NULL) return;
-   freeHostListItems(list->first);
-   free(list);
+   int index;
+   for(index = 0; index < list->length; index++)
+      if(list->atoms[index].type == 's') releaseString(list->atoms[index].str);
+   arenaFree(list, hostListSize(list->length));
 }
 
 
 #ifdef LIST_HASHING
-static void freeBuckets(Bucket *bucket)
-{
-   if(bucket == NULL) return; 
-   freeHostList(bucket->list);
-   freeBuckets(bucket->next);
-   free(bucket);
-}
-
+/* The lists in the store live in the arena, so they are released with the arena
+ * instead of one by one. */
 void freeHostListStore(void)
 {
    if(list_store == NULL) return;
-   int index;
-   for(index = 0; index < LIST_TABLE_SIZE; index++) freeBuckets(list_store[index]);
    free(list_store);
+   list_store = NULL;
+   list_store_size = 0;
+   list_store_count = 0;
+   list_store_used = 0;
+   free(string_table);
+   string_table = NULL;
+   string_table_size = 0;
+   string_table_count = 0;
+   string_table_used = 0;
+   freeArena();
 }
 #endif
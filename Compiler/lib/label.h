@@ -20,17 +20,17 @@
   ============
 
   Defines data types and operations host labels. Host lists are implemented 
-  as doubly-linked lists, and are stored in a hash table to avoid duplication
+  as arrays of atoms stored with their header, and are stored in a hash table to avoid duplication
   of lists that occur multiple times in a graph over the course of a program
-  execution.
+  execution. The strings in string atoms are interned, so equal strings are
+  the same pointer. The lists and their strings are allocated from an arena that
+  is released in bulk when the list store is freed.
 
 /////////////////////////////////////////////////////////////////////////// */
 
 #ifndef INC_LABEL_H
 #define INC_LABEL_H
 
-#define LIST_TABLE_SIZE 100003
-
 #include "globals.h"
 
 typedef struct HostLabel {
@@ -41,12 +41,6 @@ typedef struct HostLabel {
 
 extern struct HostLabel blank_label;
 
-typedef struct HostList {
-   int hash;
-   struct HostListItem *first;
-   struct HostListItem *last;
-} HostList;
-
 typedef struct HostAtom {
    char type; /* (i)nteger or (s)tring */
    union {
@@ -55,36 +49,46 @@ typedef struct HostAtom {
    };
 } HostAtom;
 
-typedef struct HostListItem {
-   struct HostAtom atom;
-   struct HostListItem *next;
-   struct HostListItem *prev;
-} HostListItem;
-
-typedef struct Bucket {
-   HostList *list;
+/* The atoms of a list are stored contiguously in a single allocation with the 
+ * list header. The first atom is atoms[0] and the last is atoms[length - 1]. */
+typedef struct HostList {
+   /* Hash of the full contents of the list, computed once when the list is made.
+    * It does not depend on where the strings are stored, so the generated
+    * matching code compares it with the precomputed hashes of constant rule
+    * lists. */
+   unsigned hash;
    int reference_count;
-   struct Bucket *next;
-   struct Bucket *prev;
-} Bucket;
+   int length;
+   HostAtom atoms[];
+} HostList;
 
-/* Hash table to store lists at runtime. Collisions are handled by separate chaining
- * implemented by singly-linked lists ("buckets" as defined above). Lists are added
- * to the host table by making an array of HostAtoms representing the list and 
- * passing it to makeHostList. In this way, each specific list is allocated to heap
- * exactly once and has a single point of reference. */
-extern Bucket **list_store;
+/* Hash table to store lists at runtime. Collisions are handled by open addressing
+ * with linear probing. The table size is a power of two. When three quarters of
+ * its slots are in use, by lists or by deleted slots, the table is rebuilt without
+ * the deleted slots, and doubled if the lists alone fill at least half of it.
+ * Lists are added to the table by making an array of HostAtoms representing the
+ * list and passing it to makeHostList. In this way, each specific list is 
+ * allocated to heap exactly once and has a single point of reference. */
+extern HostList **list_store;
+
+/* Returns the interned copy of the passed string, adding it to the string table
+ * if necessary. The caller owns one reference to the returned string. */
+string internString(string str);
+/* Add and drop a reference to an interned string. The string is freed when its
+ * last reference is dropped. */
+void retainString(string str);
+void releaseString(string str);
 
 /* If list hashing is enabled, makeHostList returns a pointer to the HostList represented 
  * by the passed array from the hash table (list_store). If not, the function returns a
  * pointer to a newly-allocated HostList. */
 HostList *makeHostList(HostAtom *array, int length, bool free_strings);
 /* Expects the passed pointer to exist in the list hash table. Increments the reference
- * count of the list's bucket. */
+ * count of the list. */
 void addHostList(HostList *list);
 /* Expects the passed pointer to exist in the list hash table. Decrements the reference
- * count of the list's bucket. Deletes/frees the list and its containing bucket if
- * the new reference count is 0. */
+ * count of the list. Removes the list from the table and frees it if the new 
+ * reference count is 0. */
 void removeHostList(HostList *list);
 
 /* Called at runtime to build labels. */
@@ -101,9 +105,12 @@ bool equalHostLists(HostAtom *left_list, HostAtom *right_list,
 HostList *copyHostList(HostList *list);
 
 void printHostLabel(HostLabel label, FILE *file);
-void printHostList(HostListItem *item, FILE *file);
+void printHostList(HostAtom *atoms, int length, FILE *file);
 
+/* Returns the items, strings and header of the list to the label arena. */
 void freeHostList(HostList *list);
+/* Frees the list store and releases the whole label arena, including any lists
+ * still referenced. Called once at the end of a program. */
 void freeHostListStore(void);
 
 #endif /* INC_LABEL_H */
@@ -76,17 +76,14 @@ Morphism *makeMorphism(int nodes, int edges, int variables)
 void initialiseMorphism(Morphism *morphism, Graph *graph)
 { 
    int index;
+   if(graph != NULL) resetMatchedFlags(graph);
    for(index = 0; index < morphism->nodes; index++)
    {
-      if(graph != NULL && morphism->node_map[index].host_index >= 0)
-         resetMatchedNodeFlag(graph, morphism->node_map[index].host_index);
       morphism->node_map[index].host_index = -1;
       morphism->node_map[index].assignments = 0;
    }
    for(index = 0; index < morphism->edges; index++)
    {
-      if(graph != NULL && morphism->edge_map[index].host_index >= 0)
-         resetMatchedEdgeFlag(graph, morphism->edge_map[index].host_index);
       morphism->edge_map[index].host_index = -1;
       morphism->edge_map[index].assignments = 0;
    }
@@ -95,7 +92,7 @@ void initialiseMorphism(Morphism *morphism, Graph *graph)
    {
       if(morphism->assignment[index].type == 's')
       {
-         free(morphism->assignment[index].str);
+         releaseString(morphism->assignment[index].str);
          morphism->assignment[index].str = NULL;
       }
       if(morphism->assignment[index].type == 'l')
@@ -170,7 +167,7 @@ int addStringAssignment(Morphism *morphism, int id, string str)
    if(morphism->assignment[id].type == 'n') 
    {
       morphism->assignment[id].type = 's';
-      morphism->assignment[id].str = strdup(str);
+      morphism->assignment[id].str = internString(str);
       pushVariableId(morphism, id);
       return 1;
    }
@@ -181,6 +178,24 @@ int addStringAssignment(Morphism *morphism, int id, string str)
    }
 }
 
+int addInternedStringAssignment(Morphism *morphism, int id, string str)
+{
+   assert(id < morphism->variables);
+   if(morphism->assignment[id].type == 'n') 
+   {
+      morphism->assignment[id].type = 's';
+      retainString(str);
+      morphism->assignment[id].str = str;
+      pushVariableId(morphism, id);
+      return 1;
+   }
+   else
+   {
+      if(morphism->assignment[id].str == str) return 0;
+      else return -1;
+   }
+}
+
 void removeNodeMap(Morphism *morphism, int left_index)
 {
    morphism->node_map[left_index].host_index = -1;
@@ -203,7 +218,7 @@ void removeAssignments(Morphism *morphism, int number)
       int id = popVariableId(morphism);
       if(morphism->assignment[id].type == 's')
       {
-         free(morphism->assignment[id].str);
+         releaseString(morphism->assignment[id].str);
          morphism->assignment[id].str = NULL;
       }
       if(morphism->assignment[id].type == 'l')
@@ -238,6 +253,42 @@ int lookupEdge(Morphism *morphism, int left_index)
    return morphism->edge_map[left_index].host_index;
 }
 
+bool nodeInMorphism(Morphism *morphism, int host_index)
+{
+   int index;
+   for(index = 0; index < morphism->nodes; index++)
+      if(morphism->node_map[index].host_index == host_index) return true;
+   return false;
+}
+
+bool edgeInMorphism(Morphism *morphism, int host_index)
+{
+   int index;
+   for(index = 0; index < morphism->edges; index++)
+      if(morphism->edge_map[index].host_index == host_index) return true;
+   return false;
+}
+
+void moveMorphism(Morphism *source, Morphism *target)
+{
+   assert(source->nodes == target->nodes && source->edges == target->edges &&
+          source->variables == target->variables);
+   int index;
+   for(index = 0; index < source->nodes; index++)
+      target->node_map[index] = source->node_map[index];
+   for(index = 0; index < source->edges; index++)
+      target->edge_map[index] = source->edge_map[index];
+   for(index = 0; index < source->variables; index++)
+   {
+      target->assignment[index] = source->assignment[index];
+      target->assigned_variables[index] = source->assigned_variables[index];
+      /* The values now belong to target. */
+      source->assignment[index].type = 'n';
+   }
+   target->variable_index = source->variable_index;
+   initialiseMorphism(source, NULL);
+}
+
 int getIntegerValue(Morphism *morphism, int id)
 {
    assert(id < morphism->variables);
@@ -260,14 +311,7 @@ int getAssignmentLength(Assignment assignment)
 {
    if(assignment.type != 'l') return 1;
    if(assignment.list == NULL) return 0;
-   HostListItem *item = assignment.list->first;
-   int length = 0;
-   while(item != NULL) 
-   {
-      length++;
-      item = item->next;
-   }
-   return length;
+   return assignment.list->length;
 }
 
 /* If rule_string is a prefix of host_string, return the position in host_string
@@ -331,7 +375,8 @@ void printMorphism(Morphism *morphism)
          if(morphism->assignment[index].type == 'l')
          {
             if(morphism->assignment[index].list == NULL) printf("empty");
-            else printHostList(morphism->assignment[index].list->first, stdout);
+            else printHostList(morphism->assignment[index].list->atoms, 
+                               morphism->assignment[index].list->length, stdout);
          }
          printf("\n\n");
       }
@@ -349,7 +394,7 @@ void freeMorphism(Morphism *morphism)
       for(index = 0; index < morphism->variables; index++)
       {
          if(morphism->assignment[index].type == 's') 
-            free(morphism->assignment[index].str);
+            releaseString(morphism->assignment[index].str);
          #ifdef LIST_HASHING
             if(morphism->assignment[index].type == 'l')
                removeHostList(morphism->assignment[index].list);
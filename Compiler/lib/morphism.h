@@ -69,6 +69,14 @@ typedef struct Morphism {
    int variable_index;
 } Morphism;
 
+/* Called with each match found by the generated function enumerate<rule_name>.
+ * The morphism holds the match and must not be changed. Returning true stops
+ * the enumeration. The enumeration does not use the matched flags of the host
+ * graph, so the callback may match, count or enumerate other rules, but it must
+ * not change the host graph or match the rule being enumerated, which is 
+ * asserted. */
+typedef bool (*MatchCallback)(Morphism *morphism);
+
 /* Allocates memory for the morphism, and calls initialiseMorphism. */
 Morphism *makeMorphism(int nodes, int edges, int variables);
 
@@ -76,7 +84,8 @@ Morphism *makeMorphism(int nodes, int edges, int variables);
  * reset the morphism after each rule application. The data in the morphism
  * are reset to their default values. 
  * The host graph is passed as an optional second argument to reset the matched flags
- * of all host graph items matched by the morphism. */
+ * of all host graph items matched by the morphism, which is done by advancing
+ * the match epoch of the graph (see resetMatchedFlags). */
 void initialiseMorphism(Morphism *morphism, Graph *graph);
 void addNodeMap(Morphism *morphism, int left_index, int host_index, int assignments);
 void removeNodeMap(Morphism *morphism, int left_index);
@@ -95,6 +104,10 @@ void removeEdgeMap(Morphism *morphism, int left_index);
 int addListAssignment(Morphism *morphism, int id, HostList *list);
 int addIntegerAssignment(Morphism *morphism, int id, int num);
 int addStringAssignment(Morphism *morphism, int id, string value);
+/* As addStringAssignment, for strings taken from host list atoms. These are
+ * interned, so the assignment shares the string and the comparison with an 
+ * existing value is a pointer comparison. */
+int addInternedStringAssignment(Morphism *morphism, int id, string value);
 
 void removeAssignments(Morphism *morphism, int number);
 void pushVariableId(Morphism *morphism, int id);
@@ -103,6 +116,16 @@ int popVariableId(Morphism *morphism);
 int lookupNode(Morphism *morphism, int left_index);
 int lookupEdge(Morphism *morphism, int left_index);
 
+/* Return true if some item of the morphism is mapped to the host item. Used in
+ * place of the matched flags of the host graph by matching code that runs in
+ * parallel (see parallel.h). */
+bool nodeInMorphism(Morphism *morphism, int host_index);
+bool edgeInMorphism(Morphism *morphism, int host_index);
+
+/* Moves the maps and assignments of source into target, which must have the
+ * same dimensions and be empty. source is left empty. */
+void moveMorphism(Morphism *source, Morphism *target);
+
 /* These functions expect to be passed the id of a variable of the appropriate type. */
 int getIntegerValue(Morphism *morphism, int id);
 string getStringValue(Morphism *morphism, int id);
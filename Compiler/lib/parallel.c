@@ -0,0 +1,323 @@
+/* Copyright 2015-2016 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "parallel.h"
+#include <pthread.h>
+
+/* The candidates are handed out to the threads in blocks of this size, in
+ * increasing order of position. */
+#define CANDIDATE_BLOCK_SIZE 16
+
+/* The matches found by a thread in a search for all matches. Each match is
+ * a record of record_size integers: the position of its candidate, the host
+ * indices of the node maps and the edge maps, and the type and the value of
+ * each variable assignment. */
+typedef struct MatchRecords {
+   int *records;
+   int size, capacity;
+} MatchRecords;
+
+/* The state of the current search, shared by the threads. The positions of
+ * the candidates below next have been handed out. The thread with index i
+ * matches with morphisms[i]. The calling thread has index 0.
+ * If all is false, the search stops at the first match: best is the lowest
+ * position from which a match has been found, or count if there is none,
+ * and found[i] is the position of the match of thread i. Otherwise, every
+ * candidate is tried, and thread i stores the first match from each of its
+ * candidates in matches[i]. */
+typedef struct Search {
+   int *candidates;
+   int count, capacity;
+   CandidateMatcher matcher;
+   bool all;
+   int next, best;
+   Morphism **morphisms;
+   int *found;
+   MatchRecords *matches;
+   int record_size;
+} Search;
+
+static Search search = {NULL, 0, 0, NULL, false, 0, 0, NULL, NULL, NULL, 0};
+
+/* The records of the disjoint matches selected by findDisjointMatches. */
+static int **selected = NULL;
+static int selected_capacity = 0;
+
+/* The thread pool. A search is started by incrementing generation. running is
+ * the number of pool threads that have not yet finished the current search. */
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t search_started = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t search_finished = PTHREAD_COND_INITIALIZER;
+static int pool_size = 0;
+static unsigned long generation = 0;
+static int running = 0;
+
+/* Lowers search.best to position unless a match from a lower position has
+ * already been found. */
+static void lowerBest(int position)
+{
+   int best = __atomic_load_n(&search.best, __ATOMIC_RELAXED);
+   while(position < best &&
+         !__atomic_compare_exchange_n(&search.best, &best, position, false,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static void recordMatch(MatchRecords *matches, int position, Morphism *morphism)
+{
+   if(matches->size + search.record_size > matches->capacity)
+   {
+      matches->capacity = 2 * matches->capacity + search.record_size;
+      matches->records = realloc(matches->records, matches->capacity * sizeof(int));
+      if(matches->records == NULL)
+      {
+         print_to_log("Error (recordMatch): malloc failure.\n");
+         exit(1);
+      }
+   }
+   int *record = matches->records + matches->size, index;
+   *record++ = position;
+   for(index = 0; index < morphism->nodes; index++)
+      *record++ = morphism->node_map[index].host_index;
+   for(index = 0; index < morphism->edges; index++)
+      *record++ = morphism->edge_map[index].host_index;
+   for(index = 0; index < morphism->variables; index++)
+   {
+      /* Matching in parallel is restricted to integer variables. */
+      assert(morphism->assignment[index].type != 's' && morphism->assignment[index].type != 'l');
+      *record++ = morphism->assignment[index].type;
+      *record++ = morphism->assignment[index].num;
+   }
+   matches->size += search.record_size;
+}
+
+/* In a search for the first match, a thread stops when it finds a match, 
+ * since any block it would take next comes after the match, or when the next
+ * candidate comes after a match found by another thread. */
+static void searchCandidates(int thread)
+{
+   Morphism *morphism = search.morphisms[thread];
+   search.found[thread] = search.count;
+   while(true)
+   {
+      int start = __atomic_fetch_add(&search.next, CANDIDATE_BLOCK_SIZE, __ATOMIC_RELAXED);
+      int end = start + CANDIDATE_BLOCK_SIZE;
+      if(end > search.count) end = search.count;
+      int position;
+      for(position = start; position < end; position++)
+      {
+         if(search.all)
+         {
+            if(!search.matcher(morphism, search.candidates[position])) continue;
+            recordMatch(&search.matches[thread], position, morphism);
+            initialiseMorphism(morphism, NULL);
+            continue;
+         }
+         if(position >= __atomic_load_n(&search.best, __ATOMIC_RELAXED)) return;
+         if(search.matcher(morphism, search.candidates[position]))
+         {
+            search.found[thread] = position;
+            lowerBest(position);
+            return;
+         }
+      }
+      if(end >= search.count) return;
+   }
+}
+
+static void *runPoolThread(void *argument)
+{
+   int thread = *(int *)argument;
+   free(argument);
+   unsigned long seen = 0;
+   pthread_mutex_lock(&pool_lock);
+   while(true)
+   {
+      while(generation == seen) pthread_cond_wait(&search_started, &pool_lock);
+      seen = generation;
+      pthread_mutex_unlock(&pool_lock);
+      searchCandidates(thread);
+      pthread_mutex_lock(&pool_lock);
+      running--;
+      if(running == 0) pthread_cond_signal(&search_finished);
+   }
+   return NULL;
+}
+
+/* The pool threads are never joined. They wait for the next search until the
+ * program exits. */
+static void startThreadPool(int threads)
+{
+   if(threads < 1) threads = 1;
+   search.morphisms = calloc(threads, sizeof(Morphism *));
+   search.found = calloc(threads, sizeof(int));
+   search.matches = calloc(threads, sizeof(MatchRecords));
+   if(search.morphisms == NULL || search.found == NULL || search.matches == NULL)
+   {
+      print_to_log("Error (startThreadPool): malloc failure.\n");
+      exit(1);
+   }
+   int index;
+   for(index = 1; index < threads; index++)
+   {
+      int *argument = malloc(sizeof(int));
+      if(argument == NULL)
+      {
+         print_to_log("Error (startThreadPool): malloc failure.\n");
+         exit(1);
+      }
+      *argument = index;
+      pthread_t thread;
+      if(pthread_create(&thread, NULL, runPoolThread, argument) != 0)
+      {
+         print_to_log("Error (startThreadPool): thread creation failure.\n");
+         exit(1);
+      }
+      pthread_detach(thread);
+   }
+   pool_size = threads;
+}
+
+/* Takes the candidates from the signature buckets and searches them with the
+ * thread pool. Returns false if there are no candidates. */
+static bool runSearch(Graph *graph, Morphism *morphism, const int *signatures,
+                      int signature_count, CandidateMatcher matcher, int threads,
+                      bool all)
+{
+   if(pool_size == 0) startThreadPool(threads);
+   if(search.capacity < graph->nodes.size)
+   {
+      search.capacity = graph->nodes.size;
+      search.candidates = realloc(search.candidates, search.capacity * sizeof(int));
+      if(search.candidates == NULL)
+      {
+         print_to_log("Error (matchInParallel): malloc failure.\n");
+         exit(1);
+      }
+   }
+   search.count = 0;
+   int index, host_index;
+   for(index = 0; index < signature_count; index++)
+      for(host_index = getFirstNodeBySignature(graph, signatures[index]); host_index != -1;
+          host_index = getNextNodeBySignature(graph, host_index))
+         search.candidates[search.count++] = host_index;
+   if(search.count == 0) return false;
+   if(graph->high_degree_arrays > 0) buildEdgeIndex(graph);
+
+   for(index = 0; index < pool_size; index++)
+   {
+      search.morphisms[index] = makeMorphism(morphism->nodes, morphism->edges,
+                                             morphism->variables);
+      search.matches[index].size = 0;
+   }
+   search.matcher = matcher;
+   search.all = all;
+   search.next = 0;
+   search.best = search.count;
+   search.record_size = 1 + morphism->nodes + morphism->edges + 2 * morphism->variables;
+
+   pthread_mutex_lock(&pool_lock);
+   running = pool_size - 1;
+   generation++;
+   pthread_cond_broadcast(&search_started);
+   pthread_mutex_unlock(&pool_lock);
+   searchCandidates(0);
+   pthread_mutex_lock(&pool_lock);
+   while(running > 0) pthread_cond_wait(&search_finished, &pool_lock);
+   pthread_mutex_unlock(&pool_lock);
+   return true;
+}
+
+bool matchInParallel(Graph *graph, Morphism *morphism, const int *signatures,
+                     int signature_count, CandidateMatcher matcher, int threads)
+{
+   if(!runSearch(graph, morphism, signatures, signature_count, matcher, threads, false))
+      return false;
+   int index;
+   bool found = search.best < search.count;
+   for(index = 0; index < pool_size; index++)
+   {
+      if(found && search.found[index] == search.best)
+         moveMorphism(search.morphisms[index], morphism);
+      freeMorphism(search.morphisms[index]);
+   }
+   if(!found) return false;
+   for(index = 0; index < morphism->nodes; index++)
+      graph->nodes.matched[morphism->node_map[index].host_index] = graph->match_epoch;
+   for(index = 0; index < morphism->edges; index++)
+      graph->edges.matched[morphism->edge_map[index].host_index] = graph->match_epoch;
+   return true;
+}
+
+static int compareRecords(const void *first, const void *second)
+{
+   return **(int * const *)first - **(int * const *)second;
+}
+
+int findDisjointMatches(Graph *graph, Morphism *morphism, const int *signatures,
+                        int signature_count, CandidateMatcher matcher, int threads)
+{
+   if(!runSearch(graph, morphism, signatures, signature_count, matcher, threads, true))
+      return 0;
+   int index, total = 0;
+   for(index = 0; index < pool_size; index++)
+   {
+      freeMorphism(search.morphisms[index]);
+      total += search.matches[index].size / search.record_size;
+   }
+   if(selected_capacity < total)
+   {
+      selected_capacity = total;
+      selected = realloc(selected, selected_capacity * sizeof(int *));
+      if(selected == NULL)
+      {
+         print_to_log("Error (findDisjointMatches): malloc failure.\n");
+         exit(1);
+      }
+   }
+   int count = 0, offset;
+   for(index = 0; index < pool_size; index++)
+      for(offset = 0; offset < search.matches[index].size; offset += search.record_size)
+         selected[count++] = search.matches[index].records + offset;
+   qsort(selected, count, sizeof(int *), compareRecords);
+
+   /* Keep the matches in the order of their candidates, dropping each match
+    * that shares a node with a match already kept. The matched flags of the
+    * graph mark the nodes of the kept matches. */
+   resetMatchedFlags(graph);
+   int kept = 0;
+   for(index = 0; index < count; index++)
+   {
+      int *nodes = selected[index] + 1, node;
+      for(node = 0; node < morphism->nodes; node++)
+         if(graph->nodes.matched[nodes[node]] == graph->match_epoch) break;
+      if(node < morphism->nodes) continue;
+      for(node = 0; node < morphism->nodes; node++)
+         graph->nodes.matched[nodes[node]] = graph->match_epoch;
+      selected[kept++] = selected[index];
+   }
+   resetMatchedFlags(graph);
+   return kept;
+}
+
+void getDisjointMatch(int index, Morphism *morphism)
+{
+   int *record = selected[index] + 1, item;
+   for(item = 0; item < morphism->nodes; item++)
+      addNodeMap(morphism, item, *record++, 0);
+   for(item = 0; item < morphism->edges; item++)
+      addEdgeMap(morphism, item, *record++, 0);
+   for(item = 0; item < morphism->variables; item++, record += 2)
+      if(record[0] == 'i') addIntegerAssignment(morphism, item, record[1]);
+}
@@ -0,0 +1,81 @@
+/* ///////////////////////////////////////////////////////////////////////////
+
+  Copyright 2015-2016 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>.
+
+  ======================
+  Parallel Search Module
+  ======================
+
+  Searches for a rule match with a pool of threads. Used by the matching code
+  of rules compiled with the -t option. The candidate host nodes for the first
+  node of the searchplan are split among the threads, each of which completes
+  the match from its candidates with its own morphism.
+
+  The generated matching code run by the threads does not write to the host
+  graph or to any other shared data. In particular, it tests injectivity with
+  nodeInMorphism and edgeInMorphism instead of the matched flags of the host
+  graph. The program must be linked with -pthread.
+
+/////////////////////////////////////////////////////////////////////////// */
+
+#ifndef INC_PARALLEL_H
+#define INC_PARALLEL_H
+
+#include "globals.h"
+#include "graph.h"
+#include "morphism.h"
+
+/* Below this number of candidate host nodes, the generated code searches
+ * serially, as the threads cost more to wake than the search itself. */
+#define PARALLEL_MIN_CANDIDATES 256
+
+/* A generated function that tries to complete a match of the rule with the
+ * first node of the searchplan mapped to the given host node. It leaves the
+ * morphism empty if it fails. */
+typedef bool (*CandidateMatcher)(Morphism *morphism, int host_index);
+
+/* Matches with the host nodes in the signature buckets of the graph given by
+ * the signatures array as the candidates. The threads take the candidates in
+ * the order of a serial scan of the buckets, and the match from the earliest
+ * candidate is the one returned, so that the result does not depend on the
+ * scheduling of the threads.
+ *
+ * If a match is found, it is moved into morphism, which must be empty, and
+ * the matched flags of its host items are set as in serial matching. The
+ * thread pool is started with threads - 1 threads on the first call; the
+ * calling thread takes part in the search. */
+bool matchInParallel(Graph *graph, Morphism *morphism, const int *signatures,
+                     int signature_count, CandidateMatcher matcher, int threads);
+
+/* Used to apply a rule as long as possible in batches. Searches every
+ * candidate, as in matchInParallel, for its first match, and selects from
+ * these, in the order of their candidates, a set of matches that pairwise
+ * share no host node. Returns the number of matches selected. The morphism is
+ * used only for its dimensions; the host graph is not changed.
+ *
+ * Matches with disjoint node sets are parallel independent: the application
+ * of one only changes edges incident to its own nodes, so it neither removes
+ * nor invalidates the others. Applying them in turn therefore gives the same
+ * result as a serial loop that happens to choose them in that order. */
+int findDisjointMatches(Graph *graph, Morphism *morphism, const int *signatures,
+                        int signature_count, CandidateMatcher matcher, int threads);
+
+/* Fills the empty morphism with the match at the given index, which must be
+ * less than the value returned by the last call to findDisjointMatches. The
+ * matched flags of the host graph are not set. */
+void getDisjointMatch(int index, Morphism *morphism);
+
+#endif /* INC_PARALLEL_H */
@@ -19,9 +19,7 @@ typedef enum {NO_BACKTRACK = 0, RECORD_CHANGES, COPY} copyType;
 
 static void annotate(GPCommand *command);
 static bool getIfCommandType(GPCommand *command);
-static bool getTryLoopCommandType(GPCommand *command, bool first_sequence,
-                                  bool first_command);
-static bool neverFails(GPCommand *command);
+static bool failsAfterChange(GPCommand *command);
 static bool nullCommand(GPCommand *command);
 
 void staticAnalysis(List *declarations)
@@ -88,9 +86,11 @@ static void annotate(GPCommand *command)
            GPCommand *then_command = command->cond_branch.then_command;
            GPCommand *else_command = command->cond_branch.else_command;
 
-           bool graph_recording;
-           if(command->type == IF_STATEMENT) graph_recording = getIfCommandType(condition); 
-           else graph_recording = getTryLoopCommandType(condition, true, true); 
+           /* A condition that never modifies the host graph has nothing to undo. */
+           bool graph_recording = false;
+           if(command->type == IF_STATEMENT) 
+              graph_recording = !nullCommand(condition) && getIfCommandType(condition); 
+           else graph_recording = failsAfterChange(condition); 
            if(graph_recording) command->cond_branch.record_changes = true;
 
            annotate(condition);
@@ -102,13 +102,9 @@ static void annotate(GPCommand *command)
       {
            GPCommand *loop_body = command->loop_stmt.loop_body;
            if(nullCommand(loop_body)) print_error("Warning: Possible nontermination in loop.\n"); 
-           /* Only analyse the loop body for backtracking if if it possible
-            * for the loop body to fail. */
-           if(!neverFails(loop_body))
-           {
-              bool graph_recording = getTryLoopCommandType(loop_body, true, true);
-              if(graph_recording) command->loop_stmt.record_changes = true;
-           }
+           /* A failed iteration must be undone only if the loop body can fail
+            * after modifying the host graph. */
+           if(failsAfterChange(loop_body)) command->loop_stmt.record_changes = true;
            annotate(loop_body);
            break;
       }
@@ -189,148 +185,62 @@ static bool getIfCommandType(GPCommand *command)
    return COPY;
 }
 
-/* For the purpose of this analysis, for a sequence C1; ...; Cn, it suffices
- * to establish whether all the commands C2; ... ; Cn never fail. Then
- * no backtracking is required, no matter what C1 is. This analysis
- * is complicated by the fact that the "defining command sequence"
- * is not straightforward. For instance, the defining command sequence
- * of the loop (if C1 then P1 else Q1; try C2 then P2 else Q2; P3 or Q3)!
- * is (P1 or Q1); (C2; P2 or Q2); (P3 or Q3). 
+/* Failure points. A rule call fails before it modifies the host graph, so a
+ * critical subprogram needs graph recording only if it can fail after it has 
+ * modified the host graph. In a sequence C1; ...; Cn, this is the case if some 
+ * Ci can itself fail after a modification, or if some Ci modifies the graph
+ * (it is not a null command) and a later Cj can fail. Predicates and other null
+ * commands at the head of a sequence therefore do not cause recording.
  *
- * The function below determines whether a GP 2 subprogram requires
- * backtracking or not. It takes as input the root AST node of the
- * command to be analysed, and a pointer to the first simple command
- * in that AST. */
-static bool getTryLoopCommandType(GPCommand *command, bool first_sequence,
-                                  bool first_command)
+ * Nested critical subprograms handle their own failures: a loop never fails,
+ * and the failure of a try condition or the condition of an if statement is
+ * undone by that statement. Only the branches of a conditional can fail after
+ * a modification on behalf of the enclosing subprogram: the 'then' branch of
+ * a try statement runs on the graph modified by the condition, so it fails 
+ * after a modification if it can fail at all after a condition that is not 
+ * null. */
+static bool failsAfterChange(GPCommand *command)
 {
    switch(command->type)
    {
       case COMMAND_SEQUENCE:
       {
            List *commands = command->commands;
-           /* Go to the first non-null command in the sequence. */
-           while(commands != NULL && nullCommand(commands->command))
-              commands = commands->next;
-           int command_position = 1;
-           bool graph_recording = false;
-
+           bool modified = false;
            while(commands != NULL)
            {
-              List *iterator = commands;
-              bool cannot_fail = true;
-              /* Check if the remaining commands in the sequence collectively
-               * never fail. */
-              while(iterator != NULL)
-              {
-                 if(!neverFails(iterator->command)) cannot_fail = false;
-                 iterator = iterator->next;
-              }
-              if(cannot_fail)
-              {
-                 /* If the remaining commands never fail, then find the first
-                  * loop in the remaining commands. If it exists, set its stop 
-                  * recording flag. */
-                 iterator = commands;
-                 while(iterator != NULL)
-                 {
-                    if(iterator->command->type == ALAP_STATEMENT)
-                    {
-                       iterator->command->loop_stmt.stop_recording = true;
-                       break;
-                    }
-                    iterator = iterator->next;
-                 }
-                 /* If we are at the first command in the sequence, no graph
-                  * recording is required because the whole sequence cannot fail.
-                  * graph_recording's initial value is false which is the desired
-                  * return value.
-                  * If we are at the second command in the sequence, the return
-                  * value is the 'graph recording' status of the first command.
-                  * That is, if the first command necessitates graph recording,
-                  * then the whole command sequence does, even though the remainder
-                  * cannot fail. */
-                 if(command_position <= 2) return graph_recording;
-              }
-              else
-                 graph_recording = getTryLoopCommandType(commands->command, first_sequence,
-                                                         command_position == 1);
-              command_position++;
+              if(failsAfterChange(commands->command)) return true;
+              if(modified && !neverFails(commands->command)) return true;
+              if(!nullCommand(commands->command)) modified = true;
               commands = commands->next;
            }
-           /* If there is only one command in the sequence with type false, 
-            * then no backtracking is required overall. */
-           if(command_position <= 2 && !graph_recording) return false;
-           else return true;
+           return false;
       }
       case RULE_CALL:
-           if(first_sequence && first_command) return false;
-           else
-           {
-              if(command->rule_call.rule->empty_lhs) return false;
-              else return true;
-           }
-
       case RULE_SET_CALL:
-           if(first_sequence && first_command) return false;
-           else
-           {
-              /* If all the rules in the set have an empty LHS, return false. */
-              List *rules = command->rule_set;
-              while(rules != NULL)
-              {
-                 if(!rules->rule_call.rule->empty_lhs) return true;
-              }
-              return false;
-           }
+           return false;
 
       case PROCEDURE_CALL:
-           return getTryLoopCommandType(command->proc_call.procedure->commands, 
-                                        first_sequence, first_command);
+           return failsAfterChange(command->proc_call.procedure->commands);
 
       case IF_STATEMENT:
-      {
-           GPCommand *condition = command->cond_branch.condition;
-           GPCommand *then_command = command->cond_branch.then_command;
-           GPCommand *else_command = command->cond_branch.else_command;
-           if(neverFails(then_command) && (neverFails(else_command) || neverFails(condition)))
-              return false;
-           
-           /* No graph backtracking is required in, for example, 
-            * "(if C then r1 else r2)!" because the inner if statement 
-            * simplifies to a single rule application on the current graph. */
-           bool then_recording = getTryLoopCommandType(then_command, first_sequence, first_command);
-           bool else_recording = getTryLoopCommandType(else_command, first_sequence, first_command);
-           return then_recording || else_recording;
-      }
+           return failsAfterChange(command->cond_branch.then_command) ||
+                  failsAfterChange(command->cond_branch.else_command);
+
       case TRY_STATEMENT:
       {
            GPCommand *condition = command->cond_branch.condition;
            GPCommand *then_command = command->cond_branch.then_command;
-           GPCommand *else_command = command->cond_branch.else_command;
-           if(neverFails(then_command) && (neverFails(else_command) || neverFails(condition)))
-              return NO_BACKTRACK;
-
-           bool cond_recording = getTryLoopCommandType(condition, first_sequence, first_command);
-           /* A try statement's then command "follows" the condition in that it uses the 
-            * graph state from the condition, so pass false as the second argument. */
-           bool then_recording = getTryLoopCommandType(then_command, false, first_command);
-           bool else_recording = getTryLoopCommandType(else_command, first_sequence, first_command);
-           return cond_recording || then_recording || else_recording;
+           if(!nullCommand(condition) && !neverFails(then_command)) return true;
+           return failsAfterChange(then_command) ||
+                  failsAfterChange(command->cond_branch.else_command);
       }
-
       case ALAP_STATEMENT:
-           return true;
+           return false;
 
       case PROGRAM_OR:
-      {
-           /* Return the "max" of the two branches. */
-           bool left_recording = getTryLoopCommandType(command->or_stmt.left_command, 
-                                                       first_sequence, first_command);
-           bool right_recording = getTryLoopCommandType(command->or_stmt.right_command,
-                                                         first_sequence, first_command);
-           return left_recording || right_recording;
-      }
+           return failsAfterChange(command->or_stmt.left_command) ||
+                  failsAfterChange(command->or_stmt.right_command);
 
       case SKIP_STATEMENT:
       case FAIL_STATEMENT:
@@ -338,11 +248,11 @@ static bool getTryLoopCommandType(GPCommand *command, bool first_sequence,
            return false;
 
       default:
-           print_to_log("Error (getCommandType): Unexpected command type %d.\n",
+           print_to_log("Error (failsAfterChange): Unexpected command type %d.\n",
                         command->type);
            break;
    }
-   return COPY;
+   return true;
 }
 
 /* A simple command is non-failing (NF) if it never fails. Specifically:
@@ -363,7 +273,7 @@ static bool getTryLoopCommandType(GPCommand *command, bool first_sequence,
 /* Returns true if the passed GP 2 command always succeeds. Used to test
  * conditions and loop bodies: if these always succeed, then backtracking
  * is not necessary for try statements and loops. */
-static bool neverFails(GPCommand *command)
+bool neverFails(GPCommand *command)
 {
    switch(command->type)
    {
@@ -462,6 +372,9 @@ static bool nullCommand(GPCommand *command)
 
       case IF_STATEMENT:
       case TRY_STATEMENT:
+           /* The changes made by a successful try condition are kept. */
+           if(command->type == TRY_STATEMENT && 
+              !nullCommand(command->cond_branch.condition)) return false;
            if(!nullCommand(command->cond_branch.then_command)) return false;
            if(!nullCommand(command->cond_branch.else_command)) return false;
            else return true;
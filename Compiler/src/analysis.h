@@ -32,16 +32,20 @@
 #include "globals.h"
 
 void staticAnalysis(List *declarations);
+bool neverFails(GPCommand *command);
 
 /* The static analysis for GP 2 programs annotates the AST nodes of conditional
- * branches and loops by setting some flags according to an analysis of a particular
- * subprogram. Two flags are modified by this analysis.
- * (1) The 'record' flag is set to true if an if/try condition or a loop body 
- *     (a 'critical subprogram') needs to record modifications to the host graph
- *     during its execution in order to restore the graph to a previous state.
- * (2) The 'stop recording' flag is set to true if recording of the host graph is 
- *     no longer needed after a certain point in a command sequence. This flag only
- *     exists on loops.
+ * branches and loops by setting their 'record' flag to true if an if/try 
+ * condition or a loop body (a 'critical subprogram') needs to record 
+ * modifications to the host graph during its execution in order to restore the
+ * graph to a previous state. A try condition or loop body needs recording only
+ * if it can fail after it has modified the host graph.
+ *
+ * Within a recording subprogram, the code generator records the changes of a 
+ * rule application only if a failure that undoes them can still occur. It uses
+ * neverFails to find the suffix of each command sequence that cannot fail: rule
+ * applications in that suffix are not recorded unless an enclosing subprogram
+ * can still fail or is an if condition.
  *
  * Examples
  * ========
@@ -63,9 +67,9 @@ void staticAnalysis(List *declarations);
  * taken, so the if statement's 'record' flag is set to true.
  *   
  * (4) P = try (r1; r2; r3!; r4!) then r3 else r4
- * Q = r1; r2; r3!; r4! is the critical subprogram which can fail at r1 or r2.
- * The try statement's 'record' flag is set to true. Also, the 'stop recording'
- * flag of the loop r3! is set to true. Once this point is reached, the try 
+ * Q = r1; r2; r3!; r4! is the critical subprogram which can fail at r2 after r1
+ * has modified the host graph. The try statement's 'record' flag is set to true.
+ * Only the application of r1 is recorded. Once r2 has succeeded, the try 
  * condition is guaranteed to succeed, so continuing to record changes would
  * be wasted effort.
  *
@@ -74,6 +78,10 @@ void staticAnalysis(List *declarations);
  * recording is required. If r1 succeeds, then the whole loop body will succeed
  * because only loops follow. If r1 fails, then the host graph G has not been
  * modified by the loop body, so the loop can be exited without needing to undo
- * any recorded changes. */
+ * any recorded changes.
+ *
+ * (6) P = (p1; r1)! 
+ * p1 is a predicate: it does not modify the host graph. No graph recording is
+ * required because the loop body can fail only before r1 is applied. */
 
 #endif /* INC_ANALYSIS_H */
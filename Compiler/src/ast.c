@@ -240,7 +240,6 @@ GPCommand *newASTAlap(YYLTYPE location, GPCommand *loop_body)
    GPCommand *command = makeGPCommand(location, ALAP_STATEMENT);
    command->loop_stmt.loop_body = loop_body;
    command->loop_stmt.record_changes = false;
-   command->loop_stmt.stop_recording = false;
    return command;
 }
 
@@ -520,6 +519,7 @@ GPRule *newASTRule(YYLTYPE location, string name, List *variables,
     rule->predicate_count = 0;
     rule->empty_lhs = false;
     rule->is_predicate = false;
+    rule->applies_in_batches = false;
     return rule;
 }    
 
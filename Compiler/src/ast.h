@@ -148,7 +148,6 @@ typedef struct GPCommand {
     struct {
        struct GPCommand *loop_body;
        bool record_changes;
-       bool stop_recording;
     } loop_stmt;                        /* ALAP_STATEMENT */
     struct { 
       struct GPCommand *left_command; 
@@ -281,6 +280,7 @@ typedef struct GPRule {
    int predicate_count;
    bool empty_lhs;
    bool is_predicate;
+   bool applies_in_batches;
 } GPRule;
 
 GPRule *newASTRule(YYLTYPE location, string name, List *variables, 
@@ -20,25 +20,26 @@
  * the condition always evaluates to true, so that the condition isn't erroneously
  * falsified when one of these variables is modified by the evaluation of a 
  * predicate. */
-void generateConditionVariables(Condition *condition)
+void generateConditionVariables(Condition *condition, bool per_thread)
 {
    static int bool_count = 0;
+   string storage = per_thread ? "_Thread_local " : "";
    switch(condition->type)
    {
       /* Booleans representing positive predicates are initialised with true. */
       case 'e':
-           PTF("bool b%d = true;\n", bool_count++);
+           PTF("%sbool b%d = true;\n", storage, bool_count++);
            break;
 
       /* Booleans representing 'not' predicates are initialised with false. */
       case 'n':
-           PTF("bool b%d = false;\n", bool_count++);
+           PTF("%sbool b%d = false;\n", storage, bool_count++);
            break;
 
       case 'a':
       case 'o':
-           generateConditionVariables(condition->left_condition);
-           generateConditionVariables(condition->right_condition);
+           generateConditionVariables(condition->left_condition, per_thread);
+           generateConditionVariables(condition->right_condition, per_thread);
            break;
 
       default:
@@ -97,7 +98,7 @@ void generateConditionEvaluator(Condition *condition, bool nested)
    }
 }
 
-static bool labelIsIntegerExpression(RuleLabel label)
+bool labelIsIntegerExpression(RuleLabel label)
 {
    if(label.length != 1) return false;
    switch(label.list->first->atom->type)
@@ -227,11 +228,11 @@ static void generatePredicateCode(Rule *rule, Predicate *predicate)
            int target = predicate->edge_pred.target;    
            PTFI("Node *source = getNode(host, n%d);\n", 3, source);
            PTFI("bool edge_found = false;\n", 3);
-           PTFI("int counter;\n", 3);
-           PTFI("for(counter = 0; counter < source->out_edges.size + 2; counter++)\n", 3);
+           PTFI("int counter, *edges, edge_index;\n", 3);
+           PTFI("forEachOutEdgeTo(host, source, n%d, edges, counter, edge_index)\n", 3, target);
            PTFI("{\n", 3);
-           PTFI("Edge *edge = getNthOutEdge(host, source, counter);\n", 6);
-           PTFI("if(edge != NULL && edge->target == n%d)\n", 6, target);
+           PTFI("Edge *edge = getEdge(host, edge_index);\n", 6);
+           PTFI("if(edge->target == n%d)\n", 6, target);
            if(predicate->edge_pred.label.length >= 0)
            { 
               PTFI("{\n", 6);
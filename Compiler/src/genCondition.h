@@ -72,10 +72,17 @@
  * }
  *
  * The function returns false if the values requires for the condition (node degrees
- * and variable values) have not yet been instantiated by rule matching. */
+ * and variable values) have not yet been instantiated by rule matching. 
+ *
+ * If per_thread is true, the variables are thread-local, so that the rule
+ * can be matched by several threads at once (see parallel.h). */
 
-void generateConditionVariables(Condition *condition);
+void generateConditionVariables(Condition *condition, bool per_thread);
 void generateConditionEvaluator(Condition *condition, bool nested);
 void generatePredicateEvaluators(Rule *rule, Condition *condition);
 
+/* Returns true if the label is a single integer expression. Relational 
+ * predicates over such labels are evaluated without building host lists. */
+bool labelIsIntegerExpression(RuleLabel label);
+
 #endif /* INC_GEN_CONDITION_H */
@@ -29,6 +29,7 @@ typedef struct StringList {
    struct StringList *prev;
 } StringList;
 
+static bool hashConstantList(RuleLabel label, unsigned *hash);
 static void generateAtomMatchingCode(Rule *rule, RuleAtom *atom, int indent);
 static void generateVariableMatchingCode(Rule *rule, RuleAtom *atom, int indent);
 static void generateConcatMatchingCode(Rule *rule, RuleAtom *atom, int indent);
@@ -119,6 +120,14 @@ void freeStringList(StringList *list)
  * declared at most once per label at runtime. */
 bool result_declared = false;
 
+/* Flags for the variables declared by generateStringMatchingCode, reset with
+ * result_declared. */
+bool offset_declared = false, host_character_declared = false;
+
+/* Numbers the interned string constants declared in the matching code so that
+ * their names are unique within a generated file. */
+static int constant_count = 0;
+
 void generateFixedListMatchingCode(Rule *rule, RuleLabel label, int indent)
 {
    PTFI("/* Label Matching */\n", indent);
@@ -139,25 +148,96 @@ void generateFixedListMatchingCode(Rule *rule, RuleLabel label, int indent)
       PTFI("/* The rule list does not contain a list variable, so there is no\n", indent + 3);
       PTFI(" * match if the host list has a different length. */\n", indent + 3);
       PTFI("if(label.length != %d) break;\n", indent + 3, label.length); 
+      /* A rule list of constants matches only the host list with the same 
+       * contents, so host lists with a different hash are rejected at once. */
+      unsigned hash;
+      if(hashConstantList(label, &hash))
+         PTFI("if(label.list->hash != %uu) break;\n", indent + 3, hash);
 
       /* Lists without list variables admit relatively simple code generation as each
       * rule atom maps directly to the host atom in the same position. */
       RuleListItem *item = label.list->first;
-      PTFI("HostListItem *item = label.list->first;\n", indent + 3);
+      PTFI("HostAtom *item = label.list->atoms;\n", indent + 3);
       int atom_count = 1;
       while(item != NULL)
       {
          PTFI("/* Matching rule atom %d. */\n", indent + 3, atom_count);
          generateAtomMatchingCode(rule, item->atom, indent + 3);
          atom_count++;
-         if(item->next != NULL) PTFI("item = item->next;\n\n", indent + 3);
+         if(item->next != NULL) PTFI("item++;\n\n", indent + 3);
          item = item->next;
       }
       PTFI("match = true;\n", indent + 3);
       PTFI("} while(false);\n\n", indent);
    }
-   /* Reset the flag before function exit. */
+   /* Reset the flags before function exit. */
    result_declared = false;
+   offset_declared = false;
+   host_character_declared = false;
+}
+
+/* Computes the hash that the runtime system gives to the host list with the
+ * same contents as the rule list (see hashHostList in label.c). Returns false
+ * if the rule list contains an atom that is not a constant. */
+static bool hashConstantList(RuleLabel label, unsigned *hash)
+{
+   *hash = FNV_OFFSET_BASIS;
+   RuleListItem *item;
+   for(item = label.list->first; item != NULL; item = item->next)
+   {
+      unsigned value = 0;
+      if(item->atom->type == INTEGER_CONSTANT)
+      {
+         *hash = FNV_STEP(*hash, 'i');
+         value = (unsigned)item->atom->number;
+      }
+      else if(item->atom->type == STRING_CONSTANT)
+      {
+         *hash = FNV_STEP(*hash, 's');
+         value = FNV_OFFSET_BASIS;
+         const unsigned char *c;
+         for(c = (const unsigned char *)item->atom->string; *c != '\0'; c++)
+            value = FNV_STEP(value, *c);
+      }
+      else return false;
+      int byte;
+      for(byte = 0; byte < 4; byte++)
+      {
+         *hash = FNV_STEP(*hash, value & 0xFF);
+         value >>= 8;
+      }
+   }
+   return true;
+}
+
+bool generateConstantListCode(RuleLabel label, string name, int indent)
+{
+   unsigned hash;
+   if(label.length == 0 || !hashConstantList(label, &hash)) return false;
+   /* The list is made once and kept for the rest of the program, like the 
+    * interned string constants. */
+   PTFI("static HostList *%s = NULL;\n", indent, name);
+   PTFI("if(%s == NULL)\n", indent, name);
+   PTFI("{\n", indent);
+   PTFI("HostAtom atoms[%d];\n", indent + 3, label.length);
+   RuleListItem *item;
+   int index = 0;
+   for(item = label.list->first; item != NULL; item = item->next, index++)
+   {
+      if(item->atom->type == INTEGER_CONSTANT)
+      {
+         PTFI("atoms[%d].type = 'i';\n", indent + 3, index);
+         PTFI("atoms[%d].num = %d;\n", indent + 3, index, item->atom->number);
+      }
+      else
+      {
+         PTFI("atoms[%d].type = 's';\n", indent + 3, index);
+         PTFI("atoms[%d].str = \"%s\";\n", indent + 3, index, item->atom->string);
+      }
+   }
+   PTFI("%s = makeHostList(atoms, %d, false);\n", indent + 3, name, label.length);
+   PTFI("}\n", indent);
+   return true;
 }
 
 void generateVariableListMatchingCode(Rule *rule, RuleLabel label, int indent)
@@ -188,10 +268,10 @@ void generateVariableListMatchingCode(Rule *rule, RuleLabel label, int indent)
       }
       PTFI("if(label.length == 1)\n", indent );
       PTFI("{\n", indent);
-      PTFI("if(label.list->first->atom.type == 'i')\n", indent + 3);
-      PTFI("result = addIntegerAssignment(morphism, %d, label.list->first->atom.num);\n", 
+      PTFI("if(label.list->atoms[0].type == 'i')\n", indent + 3);
+      PTFI("result = addIntegerAssignment(morphism, %d, label.list->atoms[0].num);\n", 
            indent + 6, list_variable_id);
-      PTFI("else result = addStringAssignment(morphism, %d, label.list->first->atom.str);\n",
+      PTFI("else result = addInternedStringAssignment(morphism, %d, label.list->atoms[0].str);\n",
            indent + 3, list_variable_id);
       PTFI("}\n", indent);
       PTFI("else result = addListAssignment(morphism, %d, label.list);\n",
@@ -202,7 +282,20 @@ void generateVariableListMatchingCode(Rule *rule, RuleLabel label, int indent)
       return;
    }
   
-   item = label.list->first;
+   /* The rule atoms before the list variable are matched against the host atoms
+    * at the same positions from the start of the host list. The rule atoms after 
+    * the list variable are matched against the host atoms at the same positions 
+    * from the end of the host list. The list variable is assigned the host atoms
+    * in between. All positions are known once the host list's length is known. */
+   int atoms_before = 0, atoms_after = 0;
+   bool variable_seen = false;
+   for(item = label.list->first; item != NULL; item = item->next)
+   {
+      if(item->atom->type == VARIABLE && item->atom->variable.type == LIST_VAR) 
+         variable_seen = true;
+      else if(variable_seen) atoms_after++;
+      else atoms_before++;
+   }
    /* A do-while loop is generated so that the label matching code can be exited
     * at any time with a break statement immediately after an atom match fails. */
    PTFI("do\n", indent);
@@ -212,71 +305,51 @@ void generateVariableListMatchingCode(Rule *rule, RuleLabel label, int indent)
     * contains: the list variable is not counted because it can match the
     * empty list. */
    PTFI("if(label.length < %d) break;\n", indent + 3, label.length - 1); 
-   PTFI("/* Matching from the start of the host list. */\n", indent + 3);
-   PTFI("HostListItem *item = label.list->first;\n", indent + 3);
    int atom_count = 1;
-   while(item != NULL)
-   {
-      if(item->atom->type == VARIABLE && item->atom->variable.type == LIST_VAR) break;
-      PTFI("/* Check if the end of the host list has been reached. */\n", indent + 3);
-      PTFI("if(item == NULL) break;\n", indent + 3);
-      PTFI("/* Matching rule atom %d. */\n", indent + 3, atom_count);
-      generateAtomMatchingCode(rule, item->atom, indent + 3);
-      PTFI("item = item->next;\n\n", indent + 3);
-      atom_count++;
-      item = item->next;
-   }
-
-   item = label.list->last;
-   if(!result_declared)
+   if(atoms_before > 0)
    {
-      PTFI("int result = -1;\n", indent + 3);
-      result_declared = true;
-   }
-   PTFI("HostListItem *start = item;\n", indent + 3);
-   int host_atoms_matched = atom_count -1;
-   atom_count = label.length;
-   if(item->atom->type == VARIABLE && item->atom->variable.type == LIST_VAR)
-   {
-      PTFI("/* Matching list variable %d. */\n", indent + 3, list_variable_id);
-      /* All host atoms are matched: assign the empty list to the list variable. */
-      PTFI("if(start == NULL) result = addListAssignment(morphism, %d, NULL);\n", 
-           indent + 3, list_variable_id);
+      PTFI("/* Matching from the start of the host list. */\n", indent + 3);
+      PTFI("HostAtom *item = label.list->atoms;\n", indent + 3);
+      for(item = label.list->first; atom_count <= atoms_before; item = item->next)
+      {
+         PTFI("/* Matching rule atom %d. */\n", indent + 3, atom_count);
+         generateAtomMatchingCode(rule, item->atom, indent + 3);
+         if(atom_count < atoms_before) PTFI("item++;\n\n", indent + 3);
+         atom_count++;
+      }
    }
-   else
+   if(atoms_after > 0)
    {
-      PTFI("/* The current host list position marks the start of the list that is\n", indent + 3);
-      PTFI("   assigned to the list variable. */\n", indent + 3);
-      PTFI("/* More rule atoms to match. If the end of the host list is reached, break. */\n",
-           indent + 3);
-      PTFI("if(start == NULL) break;\n\n", indent + 3);
       PTFI("/* Matching from the end of the host list. */\n", indent + 3);
-      PTFI("item = label.list->last;\n", indent + 3);
-      while(item != NULL)
+      if(atoms_before > 0) PTFI("item = label.list->atoms + label.length - 1;\n", indent + 3);
+      else PTFI("HostAtom *item = label.list->atoms + label.length - 1;\n", indent + 3);
+      atom_count = label.length;
+      for(item = label.list->last; atom_count > label.length - atoms_after; item = item->prev)
       {
-         if(item->atom->type == VARIABLE && item->atom->variable.type == LIST_VAR) break;
-         PTFI("/* Check if the host list has passed \"start\". */\n", indent + 3);
-         PTFI("if(item == start->prev) break;\n", indent + 3);
-         PTFI("/* Matching rule atom %d */\n", indent + 3, atom_count);
+         PTFI("/* Matching rule atom %d. */\n", indent + 3, atom_count);
          generateAtomMatchingCode(rule, item->atom, indent + 3);
-         PTFI("item = item->prev;\n", indent + 3);
+         if(atom_count > label.length - atoms_after + 1) PTFI("item--;\n\n", indent + 3);
          atom_count--;
-         item = item->prev;
       }
-      /* Assign the list variable to the rest of the host list. */
-      PTFI("/* Matching list variable %d. */\n", indent + 3, list_variable_id);
-
-      /* All host atoms are matched: assign the empty list to the list variable. */
-      PTFI("if(item == start->prev) ", indent + 3);
-      PTF("result = addListAssignment(morphism, %d, NULL);\n", list_variable_id);
-   }  
-
-   /* All but 1 host atoms are matched: assign the remaining host atom to the list variable. */
-   PTFI("else if(item == start)\n", indent + 3);
+   }
+   if(!result_declared)
+   {
+      PTFI("int result = -1;\n", indent + 3);
+      result_declared = true;
+   }
+   /* Assign the list variable to the rest of the host list. */
+   PTFI("/* Matching list variable %d. */\n", indent + 3, list_variable_id);
+   PTFI("int unmatched = label.length - %d;\n", indent + 3, label.length - 1);
+   /* All host atoms are matched: assign the empty list to the list variable. */
+   PTFI("if(unmatched == 0) result = addListAssignment(morphism, %d, NULL);\n", 
+        indent + 3, list_variable_id);
+   /* One host atom is unmatched: assign it to the list variable. */
+   PTFI("else if(unmatched == 1)\n", indent + 3);
    PTFI("{\n", indent + 3);
-   PTFI("if(item->atom.type == 'i') result = addIntegerAssignment(morphism, %d, item->atom.num);\n", 
+   PTFI("HostAtom atom = label.list->atoms[%d];\n", indent + 6, atoms_before);
+   PTFI("if(atom.type == 'i') result = addIntegerAssignment(morphism, %d, atom.num);\n", 
         indent + 6, list_variable_id);
-   PTFI("else result = addStringAssignment(morphism, %d, item->atom.str);\n", 
+   PTFI("else result = addInternedStringAssignment(morphism, %d, atom.str);\n", 
         indent + 6, list_variable_id);
    PTFI("}\n", indent + 3);
 
@@ -285,25 +358,18 @@ void generateVariableListMatchingCode(Rule *rule, RuleLabel label, int indent)
    PTFI("{\n", indent + 3);
    PTFI("/* Assign to variable %d the unmatched sublist of the host list. */\n",
         indent + 6, list_variable_id);
-   host_atoms_matched += (label.length - atom_count);
-   PTFI("HostAtom sublist[label.length - %d];\n", indent + 6, host_atoms_matched);
-   PTFI("int list_index = 0;\n", indent + 6);
-   PTFI("HostListItem *iterator = start;\n", indent + 6);
-   PTFI("while(iterator != item->next)\n", indent + 6);
-   PTFI("{\n", indent + 6);
-   PTFI("sublist[list_index++] = iterator->atom;\n", indent + 9);
-   PTFI("iterator = iterator->next;\n", indent + 9);
-   PTFI("}\n", indent + 6);
-   PTFI("HostList *list = makeHostList(sublist, label.length - %d, false);\n", indent + 6,  
-        host_atoms_matched);
+   PTFI("HostList *list = makeHostList(label.list->atoms + %d, unmatched, false);\n", 
+        indent + 6, atoms_before);
    PTFI("result = addListAssignment(morphism, %d, list);\n", indent + 6,
         list_variable_id);
    PTFI("}\n", indent + 3);
 
    generateVariableResultCode(rule, list_variable_id, true, indent + 3);
    PTFI("} while(false);\n\n", indent);
-   /* Reset the flag before function exit. */
+   /* Reset the flags before function exit. */
    result_declared = false;
+   offset_declared = false;
+   host_character_declared = false;
 }
 
 static void generateAtomMatchingCode(Rule *rule, RuleAtom *atom, int indent)
@@ -315,18 +381,23 @@ static void generateAtomMatchingCode(Rule *rule, RuleAtom *atom, int indent)
            break;
       
       case INTEGER_CONSTANT:
-           PTFI("if(item->atom.type != 'i') break;\n", indent);
-           PTFI("else if(item->atom.num != %d) break;\n", indent, atom->number);
+           PTFI("if(item->type != 'i') break;\n", indent);
+           PTFI("else if(item->num != %d) break;\n", indent, atom->number);
            break;
 
       case STRING_CONSTANT:
-           PTFI("if(item->atom.type != 's') break;\n", indent);
-           PTFI("else if(strcmp(item->atom.str, \"%s\") != 0) break;\n",
-                indent, atom->string);
+           /* Host strings are interned, so the constant is interned once, on
+            * the first execution of this code, and compared by pointer. */
+           PTFI("static string constant%d = NULL;\n", indent, constant_count);
+           PTFI("if(constant%d == NULL) constant%d = internString(\"%s\");\n",
+                indent, constant_count, constant_count, atom->string);
+           PTFI("if(item->type != 's') break;\n", indent);
+           PTFI("else if(item->str != constant%d) break;\n", indent, constant_count);
+           constant_count++;
            break;
 
       case CONCAT:
-           PTFI("if(item->atom.type != 's') break;\n", indent);
+           PTFI("if(item->type != 's') break;\n", indent);
            PTFI("else\n", indent);
            PTFI("{\n", indent);
            generateConcatMatchingCode(rule, atom, indent + 3);
@@ -351,35 +422,35 @@ static void generateVariableMatchingCode(Rule *rule, RuleAtom *atom, int indent)
    {
       case INTEGER_VAR:
            PTFI("/* Matching integer variable %d. */\n", indent, atom->variable.id);
-           PTFI("if(item->atom.type != 'i') break;\n", indent);
-           PTFI("result = addIntegerAssignment(morphism, %d, item->atom.num);\n",
+           PTFI("if(item->type != 'i') break;\n", indent);
+           PTFI("result = addIntegerAssignment(morphism, %d, item->num);\n",
                 indent, atom->variable.id);
            generateVariableResultCode(rule, atom->variable.id, false, indent);
            break;
 
       case CHARACTER_VAR:
            PTFI("/* Matching character variable %d. */\n", indent, atom->variable.id);
-           PTFI("if(item->atom.type != 's') break;\n", indent);
-           PTFI("if(strlen(item->atom.str) != 1) break;\n", indent);
-           PTFI("result = addStringAssignment(morphism, %d, item->atom.str);\n", 
+           PTFI("if(item->type != 's') break;\n", indent);
+           PTFI("if(item->str[0] == '\\0' || item->str[1] != '\\0') break;\n", indent);
+           PTFI("result = addInternedStringAssignment(morphism, %d, item->str);\n", 
                 indent , atom->variable.id);
            generateVariableResultCode(rule, atom->variable.id, false, indent);
            break;
 
       case STRING_VAR:
            PTFI("/* Matching string variable %d. */\n", indent, atom->variable.id);
-           PTFI("if(item->atom.type != 's') break;\n", indent);
-           PTFI("result = addStringAssignment(morphism, %d, item->atom.str);\n",
+           PTFI("if(item->type != 's') break;\n", indent);
+           PTFI("result = addInternedStringAssignment(morphism, %d, item->str);\n",
                 indent, atom->variable.id);
            generateVariableResultCode(rule, atom->variable.id, false, indent);
            break;
 
       case ATOM_VAR:
            PTFI("/* Matching atom variable %d. */\n", indent, atom->variable.id);
-           PTFI("if(item->atom.type == 'i') "
-                "result = addIntegerAssignment(morphism, %d, item->atom.num);\n",
+           PTFI("if(item->type == 'i') "
+                "result = addIntegerAssignment(morphism, %d, item->num);\n",
                 indent, atom->variable.id);
-           PTFI("else result = addStringAssignment(morphism, %d, item->atom.str);\n",
+           PTFI("else result = addInternedStringAssignment(morphism, %d, item->str);\n",
                 indent, atom->variable.id);
            generateVariableResultCode(rule, atom->variable.id, false, indent);
            break;
@@ -414,7 +485,7 @@ static void generateConcatMatchingCode(Rule *rule, RuleAtom *atom, int indent)
       iterator = iterator->next;
    }
    iterator = list;
-   PTFI("string host_string = item->atom.str;\n", indent);
+   PTFI("string host_string = item->str;\n", indent);
    PTFI("unsigned int start = 0, end = strlen(host_string) - 1;\n\n", indent);
    /* If there is no string variable, iterate through the StringList and 
     * generate code for each string expression. */
@@ -469,7 +540,7 @@ static void generateConcatMatchingCode(Rule *rule, RuleAtom *atom, int indent)
    PTF("result = addStringAssignment(morphism, %d, \"\");\n", iterator->variable_id);
    PTFI("else\n", indent);
    PTFI("{\n", indent);
-   PTFI("char substring[end - start + 1];\n", indent + 3);
+   PTFI("char substring[end - start + 2];\n", indent + 3);
    PTFI("strncpy(substring, host_string + start, end - start + 1);\n", indent + 3);
    PTFI("substring[end - start + 1] = '\\0';\n", indent + 3);
    PTFI("result = addStringAssignment(morphism, %d, substring);\n", 
@@ -479,8 +550,6 @@ static void generateConcatMatchingCode(Rule *rule, RuleAtom *atom, int indent)
    freeStringList(list);
 }
 
-bool offset_declared = false, host_character_declared = false;
-
 static void generateStringMatchingCode(Rule *rule, StringList *string_exp, 
                                        bool prefix, int indent)
 {
@@ -717,12 +786,10 @@ void generateLabelEvaluationCode(RuleLabel label, bool node, int count, int cont
               {
                  PTFI("if(var_%d.type == 'l' && var_%d.list != NULL)\n", indent, id, id);
                  PTFI("{\n", indent);
-                 PTFI("HostListItem *item%d = var_%d.list->first;\n", indent + 3, count, id);
-                 PTFI("while(item%d != NULL)\n", indent + 3, count);
-                 PTFI("{\n", indent + 3);
-                 PTFI("array%d[index%d++] = item%d->atom;\n", indent + 6, count, count, count);
-                 PTFI("item%d = item%d->next;\n", indent + 6, count, count);
-                 PTFI("}\n", indent + 3);
+                 PTFI("memcpy(array%d + index%d, var_%d.list->atoms,\n", indent + 3,
+                      count, count, id);
+                 PTFI("       var_%d.list->length * sizeof(HostAtom));\n", indent + 3, id);
+                 PTFI("index%d += var_%d.list->length;\n", indent + 3, count, id);
                  PTFI("}\n", indent);
                  PTFI("else if(var_%d.type == 'i')\n", indent, id);
                  PTFI("{\n", indent);
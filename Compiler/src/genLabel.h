@@ -38,6 +38,12 @@ void generateFixedListMatchingCode(Rule *rule, RuleLabel label, int indent);
 /* Generates code to match a rule list containing a list variable to a host graph list. */
 void generateVariableListMatchingCode(Rule *rule, RuleLabel label, int indent);
 
+/* If the rule list is not empty and contains only constants, generates code
+ * declaring the static variable <name>, which points to the host list with
+ * the same contents after the code has first been executed, and returns true.
+ * Otherwise no code is generated and false is returned. */
+bool generateConstantListCode(RuleLabel label, string name, int indent);
+
 /* Generates code to evaluate predicates containing the given variable. */
 void generateVariableResultCode(Rule *rule, int id, bool list_variable, int indent);
 
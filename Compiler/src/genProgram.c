@@ -45,16 +45,26 @@ typedef enum {MAIN_BODY, IF_BODY, TRY_BODY, LOOP_BODY} ContextType;
  * record_changes - Set to true if the command is a branch statement whose
  *                  condition requires graph recording, or if the command is
  *                  a loop whose body requires graph recording.
+ * may_fail_later - Set to true if a failure that undoes the changes made by the
+ *                  command can occur after it: the command is followed by a 
+ *                  command that can fail in its critical subprogram, or it is part
+ *                  of an if condition. Rule applications are recorded only if 
+ *                  both this flag and record_changes are set.
  * restore_point - A non-negative integer if the command is part of a command
  *                 sequence that is recording host graph changes and -1 otherwise.
  *                 Its value is assigned the value of the global restore_point_count
  *                 if a command's rrecord_changes flag is set. The count is incremented
  *                 when assigned to ensure unique restore point names at runtime.
+ * in_batches - Set to true if the command is a call to a rule with the function
+ *              apply<rule_name>Batch that is the whole body of a loop. The 
+ *              loop may then apply the rule to several matches per iteration.
  * indent - For formatting the printed C code. */
  typedef struct CommandData {
    ContextType context;
    bool record_changes;
+   bool may_fail_later;
    int restore_point;
+   bool in_batches;
    int indent;
 } CommandData;
 
@@ -140,12 +150,14 @@ void generateRuntimeMain(List *declarations, int host_nodes, int host_edges,
    PTF("static void garbageCollect(void)\n");
    PTF("{\n");
    PTF("   freeGraph(host);\n");
+   PTF("   freeMorphisms();\n");
+   if(!graph_copying) PTF("   freeGraphChangeStack();\n");
+   /* The list store goes last: the structures above release their lists and
+    * strings into it. */
    #ifdef LIST_HASHING
       PTF("   freeHostListStore();\n");
    #endif
-   PTF("   freeMorphisms();\n");
-   if(graph_copying) PTF("   freeGraphStack();\n");
-   else PTF("   freeGraphChangeStack();\n");
+   PTF("   freeEdgeBlockPool();\n");
    PTF("   closeLogFile();\n");
    #if defined GRAPH_TRACING || defined RULE_TRACING || defined BACKTRACK_TRACING
       PTF("   closeTraceFile();\n");
@@ -458,7 +470,7 @@ void generateRuntimeMain(List *declarations, int host_nodes, int host_edges,
       
       if(decl->type == MAIN_DECLARATION)
       {
-         CommandData initialData = {MAIN_BODY, false, -1, 3};
+         CommandData initialData = {MAIN_BODY, false, false, -1, false, 3};
          generateProgramCode(decl->main_program, initialData);
       }
       iterator = iterator->next;
@@ -549,16 +561,24 @@ static void generateProgramCode(GPCommand *command, CommandData data)
       {
            List *commands = command->commands;
            CommandData new_data = data;
-           bool stop_recording = false;
+           /* Set once the rest of the sequence cannot fail. It stays set for the
+            * remaining commands, whose changes are recorded only if the enclosing
+            * subprogram can still fail. */
+           bool rest_never_fails = false;
            while(commands != NULL)
            {
               GPCommand *command = commands->command;
-              if(command->type == ALAP_STATEMENT && command->loop_stmt.stop_recording)
-                 stop_recording = true;
-              /* If stop_recording is set to true above, every future iteration of this
-               * loop will unset the record_changes flag in the data it passes to
-               * generateProgramCode. */
-              if(stop_recording) new_data.record_changes = false;
+              if(!rest_never_fails)
+              {
+                 rest_never_fails = true;
+                 List *iterator = commands->next;
+                 while(iterator != NULL && rest_never_fails)
+                 {
+                    if(!neverFails(iterator->command)) rest_never_fails = false;
+                    iterator = iterator->next;
+                 }
+              }
+              new_data.may_fail_later = data.may_fail_later || !rest_never_fails;
               generateProgramCode(command, new_data);
               if(data.context == LOOP_BODY && commands->next != NULL)
                  PTFI("if(!success) break;\n\n", data.indent);             
@@ -647,11 +667,8 @@ static void generateProgramCode(GPCommand *command, CommandData data)
                       data.indent + 3, data.restore_point);
               #endif
               if(graph_copying) 
-              {
-                 PTFI("Graph *copy = popGraphs(%d);\n", data.indent, data.restore_point);
-                 PTFI("freeGraph(copy);\n", data.indent);
-              }
-              else PTFI("discardChanges(restore_point%d);\n", data.indent, data.restore_point);
+                 PTFI("discardGraphs(host, restore_point%d);\n", data.indent, data.restore_point);
+              else PTFI("releaseSavepoint(restore_point%d);\n", data.indent, data.restore_point);
            }
            PTFI("break;\n", data.indent);
            break;
@@ -694,7 +711,7 @@ static void generateRuleCall(string rule_name, bool empty_lhs, bool predicate,
               data.indent, rule_name);
       #endif
       if(predicate) return;
-      if(data.record_changes && !graph_copying) 
+      if(data.record_changes && data.may_fail_later && !graph_copying) 
          PTFI("apply%s(true);\n", data.indent, rule_name);
       else PTFI("apply%s(false);\n", data.indent, rule_name);
       #ifdef GRAPH_TRACING
@@ -721,7 +738,31 @@ static void generateRuleCall(string rule_name, bool empty_lhs, bool predicate,
       #ifdef RULE_TRACING
          PTFI("print_trace(\"Matching %s...\\n\");\n", data.indent, rule_name);
       #endif
-      PTFI("if(match%s(M_%s))\n", data.indent, rule_name, rule_name);
+      if(data.in_batches)
+      {
+         /* Each match applied by the batch counts as a step. Batches are not
+          * used when stepping through the program, so that every step can 
+          * still be stopped at. */
+         PTFI("int batch_size = 0;\n", data.indent);
+         PTFI("if(steps_to_run <= 0)\n", data.indent);
+         if(data.record_changes && data.may_fail_later && !graph_copying)
+            PTFI("batch_size = apply%sBatch(M_%s, true);\n", data.indent + 3,
+                 rule_name, rule_name);
+         else PTFI("batch_size = apply%sBatch(M_%s, false);\n", data.indent + 3,
+                   rule_name, rule_name);
+         PTFI("if(batch_size > 0)\n", data.indent);
+         PTFI("{\n", data.indent);
+         #ifdef RULE_TRACING
+            PTFI("print_trace(\"Matched %s %%d times in a batch.\\n\\n\", batch_size);\n",
+                 data.indent + 3, rule_name);
+         #endif
+         PTFI("current_step += 2 * (batch_size - 1);\n", data.indent + 3);
+         PTFI("compactGraphAtSafePoint(host);\n", data.indent + 3);
+         PTFI("success = true;\n", data.indent + 3);
+         PTFI("}\n", data.indent);
+         PTFI("else if(match%s(M_%s))\n", data.indent, rule_name, rule_name);
+      }
+      else PTFI("if(match%s(M_%s))\n", data.indent, rule_name, rule_name);
       PTFI("{\n", data.indent);
       #ifdef RULE_TRACING
          PTFI("print_trace(\"Matched %s.\\n\\n\");\n", data.indent + 3, rule_name);
@@ -751,7 +792,7 @@ static void generateRuleCall(string rule_name, bool empty_lhs, bool predicate,
             PTFI("}\n", data.indent + 3);
             PTFI("printf(\"Applying the rule...\\n\");\n", data.indent + 3); // ~IMP: debug (remove)
             
-            if(data.record_changes && !graph_copying) {
+            if(data.record_changes && data.may_fail_later && !graph_copying) {
                PTFI("apply%s(M_%s, true);\n", data.indent + 3, rule_name, rule_name);
             } else {
                PTFI("apply%s(M_%s, false);\n", data.indent + 3, rule_name, rule_name);
@@ -773,6 +814,7 @@ static void generateRuleCall(string rule_name, bool empty_lhs, bool predicate,
             PTFI("printf(\"!!! %%d nodes and %%d edges.\\n\", added_nodes, added_edges);\n", data.indent + 6);
             PTFI("highlightChanges(added_nodes, node_highlights, added_edges, edge_highlights);\n", data.indent + 6);
             PTFI("}\n", data.indent + 3);
+            PTFI("compactGraphAtSafePoint(host);\n", data.indent + 3);
          }
          else PTFI("initialiseMorphism(M_%s, host);\n", data.indent + 3, rule_name);
       }
@@ -815,6 +857,12 @@ static void generateBranchStatement(GPCommand *command, CommandData data)
    CommandData condition_data = data;
    condition_data.context = command->type == IF_STATEMENT ? IF_BODY : TRY_BODY;
    condition_data.indent = data.indent + 3;
+   /* An if condition is always undone. The changes made by a successful try
+    * condition are undone only if an enclosing recording subprogram fails later,
+    * which includes a failure of the then branch. */
+   if(condition_data.context == IF_BODY) condition_data.may_fail_later = true;
+   else condition_data.may_fail_later = data.record_changes && 
+           (data.may_fail_later || !neverFails(command->cond_branch.then_command));
    if(command->cond_branch.record_changes)
    {
       condition_data.record_changes = true;
@@ -831,9 +879,10 @@ static void generateBranchStatement(GPCommand *command, CommandData data)
          PTFI("print_trace(\"(%d) Recording graph changes.\\n\\n\");\n",
               data.indent, condition_data.restore_point);
       #endif
-      if(graph_copying) PTFI("copyGraph(host);\n", data.indent);
-      else PTFI("int restore_point%d = graph_change_stack == NULL ? 0 : topOfGraphChangeStack();\n",
-                data.indent, condition_data.restore_point);
+      if(graph_copying) PTFI("int restore_point%d = copyGraph(host);\n", data.indent,
+                             condition_data.restore_point);
+      else PTFI("int restore_point%d = beginSavepoint();\n", data.indent,
+                condition_data.restore_point);
    }
    PTFI("do\n", data.indent);
    PTFI("{\n", data.indent);
@@ -844,9 +893,9 @@ static void generateBranchStatement(GPCommand *command, CommandData data)
    {
       if(condition_data.restore_point >= 0)
       {
-         if(graph_copying) PTFI("host = popGraphs(%d);\n", data.indent, 
+         if(graph_copying) PTFI("revertGraph(host, restore_point%d);\n", data.indent, 
                                 condition_data.restore_point);
-         else PTFI("undoChanges(host, restore_point%d);\n", data.indent, 
+         else PTFI("rollbackSavepoint(host, restore_point%d);\n", data.indent, 
                    condition_data.restore_point);
          #ifdef BACKTRACK_TRACING
             PTFI("print_trace(\"(%d) Undoing graph changes.\\n\\n\");\n",
@@ -863,6 +912,14 @@ static void generateBranchStatement(GPCommand *command, CommandData data)
    PTFI("/* Then Branch */\n", data.indent);
    PTFI("if(success)\n", data.indent);
    PTFI("{\n", data.indent);
+   /* The changes made by a successful try condition are kept. */
+   if(condition_data.context == TRY_BODY && condition_data.restore_point >= 0)
+   {
+      if(graph_copying) PTFI("discardGraphs(host, restore_point%d);\n", new_data.indent, 
+                             condition_data.restore_point);
+      else PTFI("releaseSavepoint(restore_point%d);\n", new_data.indent, 
+                condition_data.restore_point);
+   }
    generateProgramCode(command->cond_branch.then_command, new_data);
    PTFI("}\n", data.indent);
    PTFI("/* Else Branch */\n", data.indent);
@@ -872,9 +929,9 @@ static void generateBranchStatement(GPCommand *command, CommandData data)
    {
       if(condition_data.restore_point >= 0)
       {
-         if(graph_copying) PTFI("host = popGraphs(%d);\n", data.indent, 
+         if(graph_copying) PTFI("revertGraph(host, restore_point%d);\n", data.indent, 
                                 condition_data.restore_point);
-         else PTFI("undoChanges(host, restore_point%d);\n", data.indent, 
+         else PTFI("rollbackSavepoint(host, restore_point%d);\n", data.indent, 
                    condition_data.restore_point);
          #ifdef BACKTRACK_TRACING
             PTFI("print_trace(\"(%d) Undoing graph changes.\\n\\n\");\n",
@@ -897,12 +954,18 @@ void generateLoopStatement(GPCommand *command, CommandData data)
    CommandData loop_data = data;
    loop_data.context = LOOP_BODY;
    loop_data.indent = data.indent + 3;
+   /* Changes made by the final iteration are undone only by an enclosing 
+    * recording subprogram. */
+   loop_data.may_fail_later = data.record_changes && data.may_fail_later;
    if(command->loop_stmt.record_changes)
    {
       loop_data.record_changes = true;
       loop_data.restore_point = restore_point_count++;
    }
    else loop_data.restore_point = -1;
+   GPCommand *body = command->loop_stmt.loop_body;
+   loop_data.in_batches = body->type == RULE_CALL && 
+                          body->rule_call.rule->applies_in_batches;
 
    PTFI("/* Loop Statement */\n", data.indent);
    if(loop_data.restore_point >= 0)
@@ -911,9 +974,10 @@ void generateLoopStatement(GPCommand *command, CommandData data)
          PTFI("print_trace(\"(%d) Recording graph changes.\\n\\n\");\n",
               data.indent, loop_data.restore_point);
       #endif
-      if(graph_copying) PTFI("copyGraph(host);\n", data.indent);
-      else PTFI("int restore_point%d = graph_change_stack == NULL ? 0 : topOfGraphChangeStack();\n",
-                data.indent, loop_data.restore_point);
+      if(graph_copying) PTFI("int restore_point%d = copyGraph(host);\n", data.indent,
+                             loop_data.restore_point);
+      else PTFI("int restore_point%d = beginSavepoint();\n", data.indent,
+                loop_data.restore_point);
    }
    PTFI("while(success)\n", data.indent);
    PTFI("{\n", data.indent);
@@ -927,16 +991,22 @@ void generateLoopStatement(GPCommand *command, CommandData data)
          PTFI("print_trace(\"(%d) Discarding graph changes.\\n\\n\");\n",
               data.indent + 3, loop_data.restore_point);
       #endif
+      /* Replace the snapshot or savepoint with one taken after this iteration. */
+      PTFI("if(success)\n", data.indent + 3);
+      PTFI("{\n", data.indent + 3);
       if(graph_copying)
       {
-         PTFI("if(success)\n", data.indent + 3);
-         PTFI("{\n", data.indent + 3);
-         PTFI("Graph *copy = popGraphs(%d);\n", data.indent + 6, loop_data.restore_point);
-         PTFI("freeGraph(copy);\n", data.indent + 6);
-         PTFI("}\n", data.indent + 3);
+         PTFI("discardGraphs(host, restore_point%d);\n", data.indent + 6, 
+              loop_data.restore_point);
+         PTFI("copyGraph(host);\n", data.indent + 6);
+      }
+      else
+      {
+         PTFI("releaseSavepoint(restore_point%d);\n", data.indent + 6, 
+              loop_data.restore_point);
+         PTFI("beginSavepoint();\n", data.indent + 6);
       }
-      else PTFI("if(success) discardChanges(restore_point%d);\n", 
-                data.indent + 3, loop_data.restore_point);
+      PTFI("}\n", data.indent + 3);
    }
    PTFI("}\n", data.indent);
    PTFI("success = true;\n", data.indent);
@@ -977,8 +1047,9 @@ static void generateFailureCode(string rule_name, CommandData data)
    {
       if(data.restore_point >= 0) 
       {
-         if(graph_copying) PTFI("host = popGraphs(%d);\n", data.indent, data.restore_point);
-         else PTFI("undoChanges(host, restore_point%d);\n", data.indent, data.restore_point);
+         if(graph_copying) PTFI("revertGraph(host, restore_point%d);\n", data.indent, 
+                                data.restore_point);
+         else PTFI("rollbackSavepoint(host, restore_point%d);\n", data.indent, data.restore_point);
          #ifdef BACKTRACK_TRACING
             PTFI("print_trace(\"(%d) Undoing graph changes.\\n\\n\");\n",
                  data.indent, data.restore_point);
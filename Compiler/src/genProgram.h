@@ -28,6 +28,7 @@
 #ifndef INC_GEN_PROGRAM_H
 #define INC_GEN_PROGRAM_H
 
+#include "analysis.h"
 #include "ast.h"
 #include "globals.h"
 
@@ -15,10 +15,30 @@
 
 #include "genRule.h"
 
-static void generateMatchingCode(Rule *rule, bool predicate);
+static bool isParallelisable(Rule *rule);
+static bool isIntegerLabel(RuleLabel label);
+static bool isParallelisableCondition(Condition *condition);
+static bool generateMatchingCode(Rule *rule, bool predicate, bool parallel);
+static void emitMatcherPrototypes(void);
+static void emitMatcherDefinitions(Rule *rule);
+static void emitMatchReporter(void);
+static void emitPlanChoice(Rule *rule, Searchplan **plans, int count);
+static void emitEnumeration(Rule *rule, Searchplan **plans, int count, char names[][16]);
 static void emitDegreeCheck(RuleNode *left_node, int indent);
+static void emitMatchedCheck(char item, string host_index, string action, int indent);
+static void emitMatchedFlag(char item, string host_index, bool matched, int indent);
+static void emitSignatureTable(int *signatures, int count);
+static void emitRelevantSignatures(RuleGraph *lhs);
 static void emitRootNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op);
-static void emitNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op);
+static int getSearchRadius(RuleGraph *lhs, SearchOp *first_op);
+static void emitNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op, int radius);
+static void emitNodeCandidateCode(Rule *rule, RuleNode *left_node, SearchOp *next_op,
+                                  bool mark_check, bool degree_check, int indent);
+static void emitParallelEntry(Rule *rule, string serial_name);
+static void emitBatchApplication(Rule *rule);
+static void emitCandidateMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op);
+static void emitLabelIndexLookup(Rule *rule, RuleNode *left_node, SearchOp *next_op,
+                                 int radius);
 static void emitNodeFromEdgeMatcher(Rule *rule, RuleNode *left_node, char type, SearchOp *next_op);
 static void emitNodeMatchResultCode(RuleNode *node, SearchOp *next_op, int indent);
 static void emitEdgeMatcher(Rule *rule, RuleEdge *left_edge, SearchOp *next_op);
@@ -31,6 +51,14 @@ static void emitNextMatcherCall(SearchOp *next_operation);
 FILE *header = NULL;
 FILE *file = NULL;
 Searchplan *searchplan = NULL;
+string plan_name = "";
+/* Set while the matching functions run by the threads of a parallel search
+ * are emitted. These functions do not write to the host graph. */
+static bool parallel_matching = false;
+/* Set while the matching functions used by enumerate<rule_name> are emitted.
+ * These functions do not write to the host graph either, and hand each
+ * complete match to reportMatch. */
+static bool enumeration_matching = false;
 
 void generateRules(List *declarations, string output_dir)
 {
@@ -55,7 +83,8 @@ void generateRules(List *declarations, string output_dir)
                * program. */
               decl->rule->empty_lhs = rule->lhs == NULL;
               decl->rule->is_predicate = isPredicate(rule);
-              generateRuleCode(rule, decl->rule->is_predicate, output_dir);
+              decl->rule->applies_in_batches =
+                 generateRuleCode(rule, decl->rule->is_predicate, output_dir);
               freeRule(rule);
               break;
          }
@@ -79,7 +108,7 @@ void generateRules(List *declarations, string output_dir)
    
 
 /* Create a C module to match and apply the rule. */
-void generateRuleCode(Rule *rule, bool predicate, string output_dir)
+bool generateRuleCode(Rule *rule, bool predicate, string output_dir)
 {
    /* Create files <output dir>/<rule name>.h and <output dir>/<rule name>.c */
    int length = strlen(output_dir) + strlen(rule->name) + 3;
@@ -115,6 +144,8 @@ void generateRuleCode(Rule *rule, bool predicate, string output_dir)
        "#include \"hostParser.h\"\n"
        "#include \"morphism.h\"\n\n");   
    PTF("#include \"%s.h\"\n\n", rule->name);
+   bool parallel = isParallelisable(rule);
+   if(parallel) PTF("#include \"parallel.h\"\n\n");
   
    // ~IMP1 
    PTH("#ifndef HIGHLIGHT_STRUCT\n");
@@ -163,14 +194,15 @@ void generateRuleCode(Rule *rule, bool predicate, string output_dir)
        * varables, one for each predicate in the condition.
        * The second iteration writes the function to evaluate the condition.
        * The third iteration writes the functions to evaluate the predicates. */
-      generateConditionVariables(rule->condition);
+      generateConditionVariables(rule->condition, parallel);
       PTF("\n");
       generateConditionEvaluator(rule->condition, false);
       generatePredicateEvaluators(rule, rule->condition);
    }
+   bool batches = false;
    if(rule->lhs != NULL) 
    {
-      generateMatchingCode(rule, predicate);
+      batches = generateMatchingCode(rule, predicate, parallel);
       if(!predicate)
       {
          if(rule->rhs == NULL) generateRemoveLHSCode(rule->name);
@@ -183,63 +215,169 @@ void generateRuleCode(Rule *rule, bool predicate, string output_dir)
    }
    fclose(header);
    fclose(file);
-   return;
+   return batches;
+}
+
+/* The first node of a searchplan of the rule is matched in parallel if the
+ * compiler is given more than one thread and if the matching code of the rule
+ * does not write to runtime data shared by the threads. This excludes string
+ * and list values, which are interned and hashed in shared tables, and
+ * predicates that build host lists. The variables, labels and condition of
+ * the rule must therefore be integer-valued. The node must not be a root node,
+ * since the root nodes are too few to share out. */
+static bool isParallelisable(Rule *rule)
+{
+   if(matching_threads < 2 || rule->lhs == NULL) return false;
+   int index;
+   for(index = 0; index < rule->variables; index++)
+      if(rule->variable_list[index].type != INTEGER_VAR) return false;
+   for(index = 0; index < rule->lhs->node_index; index++)
+      if(!isIntegerLabel(getRuleNode(rule->lhs, index)->label)) return false;
+   for(index = 0; index < rule->lhs->edge_index; index++)
+      if(!isIntegerLabel(getRuleEdge(rule->lhs, index)->label)) return false;
+   if(rule->condition != NULL) return isParallelisableCondition(rule->condition);
+   return true;
 }
 
-static void generateMatchingCode(Rule *rule, bool predicate)
+static bool isIntegerLabel(RuleLabel label)
 {
-   searchplan = generateSearchplan(rule->lhs); 
-   if(searchplan->first == NULL)
+   if(label.list == NULL) return true;
+   RuleListItem *item;
+   for(item = label.list->first; item != NULL; item = item->next)
    {
-      print_to_log("Error: empty searchplan. Aborting.\n");
-      freeSearchplan(searchplan);
-      return;
+      if(item->atom->type == INTEGER_CONSTANT) continue;
+      if(item->atom->type == VARIABLE && item->atom->variable.type == INTEGER_VAR)
+         continue;
+      return false;
    }
-   SearchOp *operation = searchplan->first;
-   /* Iterator over the searchplan to print the prototypes of the matching functions. */
-   while(operation != NULL)
+   return true;
+}
+
+static bool isParallelisableCondition(Condition *condition)
+{
+   switch(condition->type)
    {
-      char type = operation->type;
-      switch(type)
+      case 'e':
       {
-         case 'n':
-         case 'r':
-              PTF("static bool match_n%d(Morphism *morphism);\n", operation->index);
-              break;
+           Predicate *predicate = condition->predicate;
+           if(predicate->type == EDGE_PRED)
+              return predicate->edge_pred.label.length < 0;
+           if(predicate->type == EQUAL || predicate->type == NOT_EQUAL)
+              return labelIsIntegerExpression(predicate->list_comp.left_label) &&
+                     labelIsIntegerExpression(predicate->list_comp.right_label);
+           return true;
+      }
+      case 'n':
+           return isParallelisableCondition(condition->neg_condition);
 
-         case 'i': 
-         case 'o': 
-         case 'b':
-              PTF("static bool match_n%d(Morphism *morphism, Edge *host_edge);\n",
-                  operation->index);
-              break;
+      case 'a':
+      case 'o':
+           return isParallelisableCondition(condition->left_condition) &&
+                  isParallelisableCondition(condition->right_condition);
 
-         case 'e': 
-         case 's': 
-         case 't':
-         case 'l':
-              PTF("static bool match_e%d(Morphism *morphism);\n", operation->index);
-              break;
+      default:
+           print_to_log("Error (isParallelisableCondition): Unexpected condition "
+                        "type '%c'.\n", condition->type);
+           return false;
+   }
+}
 
-         default:
-              print_to_log("Error (generateMatchingCode): Unexpected "
-                           "operation type %c.\n", operation->type);
-              break;
-      }
-      operation = operation->next;
+/* Returns true if the function apply<rule_name>Batch is emitted. This is done
+ * for rules that are applied and whose only searchplan starts from a node
+ * matched in parallel. */
+static bool generateMatchingCode(Rule *rule, bool predicate, bool parallel)
+{
+   Searchplan *plans[ANY + 1];
+   int count = generateSearchplans(rule->lhs, plans), index;
+   if(plans[0]->first == NULL)
+   {
+      print_to_log("Error: empty searchplan. Aborting.\n");
+      freeSearchplan(plans[0]);
+      return false;
+   }
+   /* The matching functions of the alternative searchplans are distinguished
+    * by the suffix _p<index> after "match". */
+   char names[ANY + 1][8];
+   for(index = 0; index < count; index++)
+   {
+      if(index == 0) names[index][0] = '\0';
+      else sprintf(names[index], "_p%d", index);
+      searchplan = plans[index];
+      plan_name = names[index];
+      emitMatcherPrototypes();
+   }
+   /* The matching functions used by enumerate<rule_name> are distinguished by
+    * the suffix _enum after the searchplan's suffix. */
+   char enumeration_names[ANY + 1][16];
+   emitMatchReporter();
+   for(index = 0; index < count; index++)
+   {
+      sprintf(enumeration_names[index], "%s_enum", names[index]);
+      searchplan = plans[index];
+      plan_name = enumeration_names[index];
+      enumeration_matching = true;
+      emitMatcherPrototypes();
+      enumeration_matching = false;
+   }
+   /* The matching functions of a searchplan run by the threads of a parallel
+    * search are distinguished by the suffix _t after the searchplan's suffix.
+    * The function match<suffix>_t decides at runtime whether to search in
+    * parallel. */
+   char parallel_names[ANY + 1][12];
+   bool parallel_plan[ANY + 1];
+   for(index = 0; index < count; index++)
+   {
+      parallel_plan[index] = parallel && plans[index]->first->type == 'n';
+      if(!parallel_plan[index]) continue;
+      sprintf(parallel_names[index], "%s_t", names[index]);
+      searchplan = plans[index];
+      plan_name = parallel_names[index];
+      parallel_matching = true;
+      PTF("static bool match%s(Morphism *morphism);\n", plan_name);
+      emitMatcherPrototypes();
+      parallel_matching = false;
    }
    /* Generate the main matching function which sets up the runtime matching 
-    * environment and calls the first matching function. */
+    * environment and calls the first matching function. A rule that has failed
+    * is not searched for again until the host graph has changed at a node
+    * that one of its LHS nodes can match (see relevantChangeSince). This
+    * spares the repeated searches for rules of a looped rule set that do not 
+    * match while the other rules are applied. */
    PTH("bool match%s(Morphism *morphism);\n\n", rule->name);
-   PTF("\nbool match%s(Morphism *morphism)\n", rule->name);
+   emitRelevantSignatures(rule->lhs);
+   PTF("static long failed_at = 0;\n\n");
+   PTF("bool match%s(Morphism *morphism)\n", rule->name);
    PTF("{\n");
+   PTFI("assert(!enumerating);\n", 3);
    PTFI("if(%d > host->number_of_nodes || %d > host->number_of_edges) return false;\n",
         3, rule->lhs->node_index, rule->lhs->edge_index);
-   char item = searchplan->first->is_node ? 'n' : 'e';
+   PTFI("if(!relevantChangeSince(host, &failed_at, relevant_signatures)) return false;\n", 3);
+   if(count == 1)
+   {
+      char item = plans[0]->first->is_node ? 'n' : 'e';
+      if(parallel_plan[0]) PTFI("bool match = match_t(morphism);\n", 3);
+      else PTFI("bool match = match_%c%d(morphism);\n", 3, item, plans[0]->first->index);
+   }
+   else
+   {
+      emitPlanChoice(rule, plans, count);
+      PTFI("bool match = false;\n", 3);
+      PTFI("switch(plan)\n", 3);
+      PTFI("{\n", 3);
+      for(index = 0; index < count; index++)
+      {
+         if(parallel_plan[index])
+            PTFI("case %d: match = match%s(morphism); break;\n", 6, 
+                 index, parallel_names[index]);
+         else PTFI("case %d: match = match%s_n%d(morphism); break;\n", 6, 
+                   index, names[index], plans[index]->first->index);
+      }
+      PTFI("}\n", 3);
+   }
    
    if(predicate)
    {
-      PTFI("bool match = match_%c%d(morphism);\n", 3, item, searchplan->first->index);
+      PTFI("if(!match) failed_at = host->journal.count;\n", 3);
       /* Reset the matched flags in the host graph. This is normally done after
        * rule application, but predicate rules are not applied. */
       PTFI("initialiseMorphism(morphism, host);\n", 3);
@@ -247,17 +385,192 @@ static void generateMatchingCode(Rule *rule, bool predicate)
    }
    else 
    {
-      PTFI("if(match_%c%d(morphism)) return true;\n", 3, item, searchplan->first->index);
+      PTFI("if(match) return true;\n", 3);
       PTFI("else\n", 3);
       PTFI("{\n", 3);
+      PTFI("failed_at = host->journal.count;\n", 6);
       PTFI("initialiseMorphism(morphism, host);\n", 6);
       PTFI("return false;\n", 6);
       PTFI("}\n", 3);
    }
    PTF("}\n\n");
 
-   /* Iterator over the searchplan to print the definitions of the matching functions. */
-   operation = searchplan->first;
+   bool batches = !predicate && count == 1 && parallel_plan[0];
+   if(batches)
+   {
+      searchplan = plans[0];
+      plan_name = parallel_names[0];
+      emitBatchApplication(rule);
+   }
+   for(index = 0; index < count; index++)
+   {
+      searchplan = plans[index];
+      plan_name = names[index];
+      emitMatcherDefinitions(rule);
+      if(parallel_plan[index])
+      {
+         plan_name = parallel_names[index];
+         parallel_matching = true;
+         emitParallelEntry(rule, names[index]);
+         emitMatcherDefinitions(rule);
+         parallel_matching = false;
+      }
+      plan_name = enumeration_names[index];
+      enumeration_matching = true;
+      emitMatcherDefinitions(rule);
+      enumeration_matching = false;
+   }
+   searchplan = NULL;
+   plan_name = "";
+   emitEnumeration(rule, plans, count, enumeration_names);
+   for(index = 0; index < count; index++) freeSearchplan(plans[index]);
+   return batches;
+}
+
+/* Emits the function through which the matching functions of an enumeration
+ * hand over a complete match. It counts the match and passes it to the 
+ * callback, and the search backtracks unless the callback stops it. 
+ * enumerating is set for the duration of an enumeration, during which the
+ * callback must not match or enumerate the same rule, since that would 
+ * overwrite the state of the enumeration and of the rule's condition. */
+static void emitMatchReporter(void)
+{
+   PTF("static bool enumerating = false;\n");
+   PTF("static MatchCallback match_callback = NULL;\n");
+   PTF("static int matches_reported = 0;\n\n");
+   PTF("static bool reportMatch(Morphism *morphism)\n");
+   PTF("{\n");
+   PTFI("matches_reported++;\n", 3);
+   PTFI("return match_callback != NULL && match_callback(morphism);\n", 3);
+   PTF("}\n\n");
+}
+
+/* Emits code that sets the variable plan to the index of the searchplan to 
+ * use. Each searchplan starts from a node of a different mark. Its estimated
+ * cost is its weight times the current number of host nodes with that mark,
+ * and the cheapest searchplan is used. */
+static void emitPlanChoice(Rule *rule, Searchplan **plans, int count)
+{
+   int index;
+   PTFI("double cost[%d];\n", 3, count);
+   for(index = 0; index < count; index++)
+   {
+      RuleNode *first = getRuleNode(rule->lhs, plans[index]->first->index);
+      if(first->label.mark == ANY)
+         PTFI("cost[%d] = (host->number_of_nodes + 1) * %g;\n", 3, 
+              index, plans[index]->weight);
+      else PTFI("cost[%d] = (host->node_mark_counts[%d] + 1) * %g;\n", 3, 
+                index, first->label.mark, plans[index]->weight);
+   }
+   PTFI("int plan = 0, index;\n", 3);
+   PTFI("for(index = 1; index < %d; index++)\n", 3, count);
+   PTFI("if(cost[index] < cost[plan]) plan = index;\n", 6);
+}
+
+/* Emits enumerate<rule_name>, which passes every match of the rule to a 
+ * callback, and count<rule_name>, which only counts them. Both return the 
+ * number of matches found and leave the morphism empty. The matching 
+ * functions with the suffix _enum are used, which test injectivity against
+ * the morphism instead of the matched flags of the host graph, never resume
+ * their search, and backtrack after each match through reportMatch. So an
+ * enumeration neither writes to the host graph nor depends on the match epoch,
+ * and the callback may match other rules. 
+ * An enumeration that finds no match is skipped until a relevant change, as 
+ * match<rule_name> is, but with its own journal position, so that enumerating
+ * does not affect when the rule is searched for by the program. */
+static void emitEnumeration(Rule *rule, Searchplan **plans, int count, char names[][16])
+{
+   PTH("int enumerate%s(Morphism *morphism, MatchCallback callback);\n", rule->name);
+   PTH("int count%s(Morphism *morphism);\n\n", rule->name);
+   PTF("static long enumeration_failed_at = 0;\n\n");
+   PTF("int enumerate%s(Morphism *morphism, MatchCallback callback)\n", rule->name);
+   PTF("{\n");
+   PTFI("assert(!enumerating);\n", 3);
+   PTFI("if(%d > host->number_of_nodes || %d > host->number_of_edges) return 0;\n",
+        3, rule->lhs->node_index, rule->lhs->edge_index);
+   PTFI("if(!relevantChangeSince(host, &enumeration_failed_at, relevant_signatures))"
+        " return 0;\n", 3);
+   PTFI("enumerating = true;\n", 3);
+   PTFI("match_callback = callback;\n", 3);
+   PTFI("matches_reported = 0;\n", 3);
+   if(count > 1)
+   {
+      emitPlanChoice(rule, plans, count);
+      PTFI("switch(plan)\n", 3);
+      PTFI("{\n", 3);
+   }
+   int index;
+   for(index = 0; index < count; index++)
+   {
+      SearchOp *first = plans[index]->first;
+      int indent = 3;
+      if(count > 1)
+      {
+         PTFI("case %d:\n", 6, index);
+         indent = 9;
+      }
+      PTFI("match%s_%c%d(morphism);\n", indent, names[index], 
+           first->is_node ? 'n' : 'e', first->index);
+      if(count > 1) PTFI("break;\n", indent);
+   }
+   if(count > 1) PTFI("}\n", 3);
+   PTFI("enumerating = false;\n", 3);
+   PTFI("if(matches_reported == 0) enumeration_failed_at = host->journal.count;\n", 3);
+   PTFI("initialiseMorphism(morphism, NULL);\n", 3);
+   PTFI("return matches_reported;\n", 3);
+   PTF("}\n\n");
+   PTF("int count%s(Morphism *morphism)\n", rule->name);
+   PTF("{\n");
+   PTFI("return enumerate%s(morphism, NULL);\n", 3, rule->name);
+   PTF("}\n\n");
+}
+
+/* Prints the prototypes of the matching functions of the current searchplan. */
+static void emitMatcherPrototypes(void)
+{
+   SearchOp *operation = searchplan->first;
+   while(operation != NULL)
+   {
+      char type = operation->type;
+      switch(type)
+      {
+         case 'n':
+         case 'r':
+              if(parallel_matching && operation == searchplan->first)
+                 PTF("static bool match%s_n%d(Morphism *morphism, int host_index);\n",
+                     plan_name, operation->index);
+              else PTF("static bool match%s_n%d(Morphism *morphism);\n", plan_name, 
+                       operation->index);
+              break;
+
+         case 'i': 
+         case 'o': 
+         case 'b':
+              PTF("static bool match%s_n%d(Morphism *morphism, Edge *host_edge);\n",
+                  plan_name, operation->index);
+              break;
+
+         case 'e': 
+         case 's': 
+         case 't':
+         case 'l':
+              PTF("static bool match%s_e%d(Morphism *morphism);\n", plan_name, 
+                  operation->index);
+              break;
+
+         default:
+              print_to_log("Error (emitMatcherPrototypes): Unexpected "
+                           "operation type %c.\n", operation->type);
+              break;
+      }
+      operation = operation->next;
+   }
+}
+
+/* Prints the definitions of the matching functions of the current searchplan. */
+static void emitMatcherDefinitions(Rule *rule)
+{
+   SearchOp *operation = searchplan->first;
    RuleNode *node = NULL;
    RuleEdge *edge = NULL;
    while(operation != NULL)
@@ -271,7 +584,12 @@ static void generateMatchingCode(Rule *rule, bool predicate)
 
          case 'n': 
               node = getRuleNode(rule->lhs, operation->index);
-              emitNodeMatcher(rule, node, operation->next);
+              if(operation == searchplan->first && parallel_matching)
+                 emitCandidateMatcher(rule, node, operation->next);
+              else if(operation == searchplan->first && !enumeration_matching)
+                 emitNodeMatcher(rule, node, operation->next, 
+                                 getSearchRadius(rule->lhs, operation));
+              else emitNodeMatcher(rule, node, operation->next, -1);
               break;
 
          case 'i': 
@@ -312,16 +630,14 @@ static void generateMatchingCode(Rule *rule, bool predicate)
               break;
          
          default:
-              print_to_log("Error (generateMatchingCode): Unexpected "
+              print_to_log("Error (emitMatcherDefinitions): Unexpected "
                            "operation type %c.\n", operation->type);
               break;
       }
       operation = operation->next;
    }
-   freeSearchplan(searchplan);
 }
 
-
 /* The host node does not match the rule node if:
  * (1) The host node's indegree is strictly less than the rule node's indegree.
  * (2) The host node's outdegree is strictly less than the rule node's outdegree.
@@ -333,7 +649,10 @@ static void generateMatchingCode(Rule *rule, bool predicate)
  * (3) The number of edges incident to the host node is not equal to the 
  *     number of edges incident to the rule node. Indeed, if it is less,
  *     then standard matching is violated (above). If it is greater,
- *     then the dangling condition is violated. */
+ *     then the dangling condition is violated.
+ *
+ * emitNodeMatcher omits this check if the signatures of the host nodes it
+ * searches already guarantee that the check passes. */
 
 static void emitDegreeCheck(RuleNode *left_node, int indent)
 {
@@ -346,21 +665,46 @@ static void emitDegreeCheck(RuleNode *left_node, int indent)
    {
       /* Dangling node degree check. If the if condition evaluates to true,
        * then the node is not a valid match. */
-      PTFI("if(host_node->indegree < %d || host_node->outdegree < %d ||\n",
+      PTFI("if(host->nodes.indegrees[host_index] < %d || "
+           "host->nodes.outdegrees[host_index] < %d ||\n",
            indent, left_node->indegree, left_node->outdegree);
-      PTFI("   ((host_node->outdegree + host_node->indegree - %d - %d - %d) != 0)) ", 
+      PTFI("   ((host->nodes.outdegrees[host_index] + host->nodes.indegrees[host_index]"
+           " - %d - %d - %d) != 0)) ", 
            indent, left_node->outdegree, left_node->indegree, left_node->bidegree);
    }
    else
    {
       /* Standard node degree check. */
-      PTFI("if(host_node->indegree < %d || host_node->outdegree < %d ||\n",
+      PTFI("if(host->nodes.indegrees[host_index] < %d || "
+           "host->nodes.outdegrees[host_index] < %d ||\n",
            indent, left_node->indegree, left_node->outdegree);
-      PTFI("   ((host_node->outdegree + host_node->indegree - %d - %d - %d) < 0)) ", 
+      PTFI("   ((host->nodes.outdegrees[host_index] + host->nodes.indegrees[host_index]"
+           " - %d - %d - %d) < 0)) ", 
            indent, left_node->outdegree, left_node->indegree, left_node->bidegree);
    }
 }
 
+/* Emits a test of whether the host node or edge (item 'n' or 'e') at the given
+ * index has already been matched, followed by action. The matching functions
+ * of a parallel search or an enumeration look the item up in their own 
+ * morphism, since they do not set the matched flags of the host graph. */
+static void emitMatchedCheck(char item, string host_index, string action, int indent)
+{
+   if(parallel_matching || enumeration_matching)
+      PTFI("if(%sInMorphism(morphism, %s)) %s\n", indent, item == 'n' ? "node" : "edge",
+           host_index, action);
+   else PTFI("if(host->%s.matched[%s] == host->match_epoch) %s\n", indent,
+             item == 'n' ? "nodes" : "edges", host_index, action);
+}
+
+/* Emits code to set or clear the matched flag of a host node or edge. */
+static void emitMatchedFlag(char item, string host_index, bool matched, int indent)
+{
+   if(parallel_matching || enumeration_matching) return;
+   PTFI("host->%s.matched[%s] = %s;\n", indent, item == 'n' ? "nodes" : "edges", 
+        host_index, matched ? "host->match_epoch" : "0");
+}
+
  
 /* The emitMatcher functions in this module take an LHS item and emit a function 
  * that searches for a matching host item. The generated code queries the host graph
@@ -382,21 +726,25 @@ static void emitDegreeCheck(RuleNode *left_node, int indent)
  * If a valid host item is found, the generated code pushes its index to the
  * appropriate morphism stack and calls the function for the following 
  * searchplan operation (see emitNextMatcherCall). If there are no operations 
- * left, code is generated to return true. */
+ * left, code is generated to return true, or to hand the match to reportMatch
+ * in an enumeration. */
 static void emitRootNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op)
 {
-   PTF("static bool match_n%d(Morphism *morphism)\n", left_node->index);
+   PTF("static bool match%s_n%d(Morphism *morphism)\n", plan_name, left_node->index);
    PTF("{\n");
-   PTFI("RootNodes *nodes;\n", 3);   
-   PTFI("for(nodes = getRootNodeList(host); nodes != NULL; nodes = nodes->next)\n", 3);
+   /* The root nodes are visited from the most recently added one, which is the
+    * order in which they were visited when they were held in a linked list. */
+   PTFI("RootNodes *nodes = getRootNodeList(host);\n", 3);   
+   PTFI("int position;\n", 3);   
+   PTFI("for(position = nodes->size - 1; position >= 0; position--)\n", 3);
    PTFI("{\n", 3);
-   PTFI("Node *host_node = getNode(host, nodes->index);\n", 6);
-   PTFI("if(host_node == NULL) continue;\n", 6);
-   PTFI("if(host_node->matched) continue;\n", 6);
+   PTFI("int host_index = nodes->items[position];\n", 6);
+   emitMatchedCheck('n', "host_index", "continue;", 6);
    if(left_node->label.mark != ANY)
-      PTFI("if(host_node->label.mark != %d) continue;\n", 6, left_node->label.mark);
+      PTFI("if(host->nodes.marks[host_index] != %d) continue;\n", 6, left_node->label.mark);
    emitDegreeCheck(left_node, 6);  
    PTF("continue;\n\n");
+   PTFI("Node *host_node = getNode(host, host_index);\n", 6);
 
    PTFI("HostLabel label = host_node->label;\n", 6);
    PTFI("bool match = false;\n", 6);
@@ -409,31 +757,311 @@ static void emitRootNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_
    PTF("}\n\n");
 }
 
+/* A matcher for the first node of the searchplan can resume its search where
+ * the previous search stopped (see SearchResume in graph.h) if every other 
+ * rule node is reached through the edges of the LHS, which is the case if no
+ * other searchplan operation matches a node or an edge in isolation. Returns
+ * the largest distance from the first rule node to another rule node, ignoring
+ * edge directions, or -1 if the search cannot be resumed. */
+static int getSearchRadius(RuleGraph *lhs, SearchOp *first_op)
+{
+   SearchOp *operation;
+   for(operation = first_op->next; operation != NULL; operation = operation->next)
+      if(operation->type == 'n' || operation->type == 'r' || operation->type == 'e') 
+         return -1;
+   int *distance = malloc(lhs->node_index * sizeof(int));
+   RuleNode **queue = malloc(lhs->node_index * sizeof(RuleNode *));
+   if(distance == NULL || queue == NULL)
+   {
+      print_to_log("Error (getSearchRadius): malloc failure.\n");
+      exit(1);
+   }
+   int index, start = 0, end = 0, radius = 0;
+   for(index = 0; index < lhs->node_index; index++) distance[index] = -1;
+   queue[end++] = getRuleNode(lhs, first_op->index);
+   distance[first_op->index] = 0;
+   while(start < end)
+   {
+      RuleNode *node = queue[start++];
+      radius = distance[node->index];
+      RuleEdges *iterator;
+      for(iterator = node->outedges; iterator != NULL; iterator = iterator->next)
+      {
+         RuleNode *target = iterator->edge->target;
+         if(distance[target->index] != -1) continue;
+         distance[target->index] = radius + 1;
+         queue[end++] = target;
+      }
+      for(iterator = node->inedges; iterator != NULL; iterator = iterator->next)
+      {
+         RuleNode *source = iterator->edge->source;
+         if(distance[source->index] != -1) continue;
+         distance[source->index] = radius + 1;
+         queue[end++] = source;
+      }
+   }
+   free(distance);
+   free(queue);
+   return end == lhs->node_index ? radius : -1;
+}
+
+/* Emits a table of the signatures of the host nodes that can match some node
+ * of the LHS. */
+static void emitRelevantSignatures(RuleGraph *lhs)
+{
+   bool relevant[NUMBER_OF_SIGNATURES] = {false};
+   int signatures[NUMBER_OF_SIGNATURES];
+   bool degree_check;
+   int node_index, index;
+   for(node_index = 0; node_index < lhs->node_index; node_index++)
+   {
+      int count = getSignatures(getRuleNode(lhs, node_index), signatures, &degree_check);
+      for(index = 0; index < count; index++) relevant[signatures[index]] = true;
+   }
+   PTF("static const bool relevant_signatures[%d] = {", NUMBER_OF_SIGNATURES);
+   int signature, written = 0;
+   for(signature = 0; signature < NUMBER_OF_SIGNATURES; signature++)
+   {
+      if(!relevant[signature]) continue;
+      if(written > 0) PTF(",");
+      if(written % 8 == 0) PTF("\n%*s", 3, "");
+      else PTF(" ");
+      PTF("[%d] = true", signature);
+      written++;
+   }
+   PTF("};\n");
+}
+
 /* The rule node is matched "in isolation", in that it is not the source or
  * target of a previously-matched edge. In this case, the candidate host
- * graph nodes are obtained from the appropriate label class tables. */
-static void emitNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op)
+ * graph nodes are obtained from the buckets of the host graph's signature
+ * index that can contain a match for the rule node (see getSignatures). 
+ *
+ * If radius is not -1, the generated function keeps its place in the buckets
+ * between calls in a SearchResume. It first tries the host nodes made pending
+ * by the changes since the previous call, which are not filtered by the 
+ * signature index, and then continues the scan of the buckets from the node
+ * it last returned. A dropped position is detected by checking that the node
+ * is still in the bucket being scanned. */
+static void emitNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op, int radius)
 {
-   PTF("static bool match_n%d(Morphism *morphism)\n", left_node->index);
+   PTF("static bool match%s_n%d(Morphism *morphism)\n", plan_name, left_node->index);
    PTF("{\n");
+   int signatures[NUMBER_OF_SIGNATURES];
+   bool degree_check = false;
+   int count = getSignatures(left_node, signatures, &degree_check);
+   if(count == 0)
+   {
+      PTFI("return false;\n", 3);
+      PTF("}\n\n");
+      return;
+   }
+   emitSignatureTable(signatures, count);
+   #ifdef LIST_HASHING
+      emitLabelIndexLookup(rule, left_node, next_op, radius);
+   #endif
+   if(radius == -1)
+   {
+      PTFI("int count, host_index;\n", 3);
+      PTFI("for(count = 0; count < %d; count++)\n", 3, count);
+      PTFI("{\n", 3);
+      PTFI("for(host_index = getFirstNodeBySignature(host, signatures[count]);\n", 6);
+      PTFI("    host_index != -1; host_index = getNextNodeBySignature(host, host_index))\n", 6);
+      PTFI("{\n", 6);
+      emitNodeCandidateCode(rule, left_node, next_op, false, degree_check, 9);
+      PTFI("}\n", 6);
+      PTFI("}\n", 3);
+      PTFI("return false;\n", 3);
+      PTF("}\n\n");
+      return;
+   }
+   PTFI("static SearchResume resume;\n", 3);
    PTFI("int host_index;\n", 3);
-   PTFI("for(host_index = 0; host_index < host->nodes.size; host_index++)\n", 3);
+   PTFI("updateSearchResume(host, &resume, %d);\n", 3, radius);
+   PTFI("/* A pending node that matches stays pending. */\n", 3);
+   PTFI("for(; resume.pending_size > 0; resume.pending_size--)\n", 3);
    PTFI("{\n", 3);
-   PTFI("Node *host_node = getNode(host, host_index);\n", 6);
-   PTFI("if(host_node == NULL || host_node->index == -1) continue;\n", 6);
-   PTFI("if(host_node->matched) continue;\n", 6);
-   if(left_node->label.mark != ANY)
-      PTFI("if(host_node->label.mark != %d) continue;\n", 6, left_node->label.mark);
-   emitDegreeCheck(left_node, 6);  
-   PTF("continue;\n\n");
+   PTFI("host_index = resume.pending[resume.pending_size - 1];\n", 6);
+   PTFI("if(host_index >= host->nodes.size || host->nodes.items[host_index].index == -1)"
+        " continue;\n", 6);
+   emitNodeCandidateCode(rule, left_node, next_op, true, true, 6);
+   PTFI("}\n", 3);
+   PTFI("if(resume.index != -1 && (resume.index >= host->nodes.size ||\n", 3);
+   PTFI("   host->nodes.items[resume.index].signature != signatures[resume.bucket]))\n", 3);
+   PTFI("resume.index = -1;\n", 6);
+   PTFI("for(; resume.bucket < %d; resume.bucket++, resume.index = -1)\n", 3, count);
+   PTFI("{\n", 3);
+   PTFI("if(resume.index == -1)\n", 6);
+   PTFI("resume.index = getFirstNodeBySignature(host, signatures[resume.bucket]);\n", 9);
+   PTFI("for(; resume.index != -1; "
+        "resume.index = getNextNodeBySignature(host, resume.index))\n", 6);
+   PTFI("{\n", 6);
+   PTFI("host_index = resume.index;\n", 9);
+   emitNodeCandidateCode(rule, left_node, next_op, false, degree_check, 9);
+   PTFI("}\n", 6);
+   PTFI("}\n", 3);
+   PTFI("return false;\n", 3);
+   PTF("}\n\n");
+}
 
-   PTFI("HostLabel label = host_node->label;\n", 6);
-   PTFI("bool match = false;\n", 6);
+/* Emits the array of the signatures of the candidate host nodes of a rule
+ * node, as returned by getSignatures. */
+static void emitSignatureTable(int *signatures, int count)
+{
+   PTFI("static const int signatures[%d] = {", 3, count);
+   int index;
+   for(index = 0; index < count; index++)
+   {
+      if(index % 10 == 0) PTF("\n%*s", 6, "");
+      if(index == count - 1) PTF("%d", signatures[index]);
+      else PTF("%d, ", signatures[index]);
+   }
+   PTF("};\n");
+}
+
+/* If the label of the rule node is a constant list, the candidates can be 
+ * taken from the label index (see LabelIndex in graph.h) instead of the 
+ * signature buckets. The label index is used if the list labels fewer host 
+ * nodes than have the mark of the rule node. A search that can be resumed 
+ * passes over most of the nodes in the signature buckets, so it is given up 
+ * only if the list labels at most a quarter of those nodes. */
+static void emitLabelIndexLookup(Rule *rule, RuleNode *left_node, SearchOp *next_op,
+                                 int radius)
+{
+   if(hasListVariable(left_node->label)) return;
+   if(!generateConstantListCode(left_node->label, "label_list", 3)) return;
+   if(left_node->label.mark == ANY)
+      PTFI("if(countNodesByList(host, label_list) * %d <= host->number_of_nodes)\n", 3, 
+           radius == -1 ? 1 : 4);
+   else PTFI("if(countNodesByList(host, label_list) * %d <= host->node_mark_counts[%d])\n",
+             3, radius == -1 ? 1 : 4, left_node->label.mark);
+   PTFI("{\n", 3);
+   PTFI("int host_index;\n", 6);
+   PTFI("for(host_index = getFirstNodeByList(host, label_list); host_index != -1;\n", 6);
+   PTFI("    host_index = getNextNodeByList(host, host_index))\n", 6);
+   PTFI("{\n", 6);
+   emitNodeCandidateCode(rule, left_node, next_op, true, true, 9);
+   PTFI("}\n", 6);
+   PTFI("return false;\n", 6);
+   PTFI("}\n", 3);
+}
+
+/* Emits the body of a loop over candidate host nodes for a rule node matched
+ * in isolation. The mark check is only needed for candidates not taken from 
+ * the signature index. */
+static void emitNodeCandidateCode(Rule *rule, RuleNode *left_node, SearchOp *next_op,
+                                  bool mark_check, bool degree_check, int indent)
+{
+   emitMatchedCheck('n', "host_index", "continue;", indent);
+   if(mark_check && left_node->label.mark != ANY)
+      PTFI("if(host->nodes.marks[host_index] != %d) continue;\n", indent, 
+           left_node->label.mark);
+   if(degree_check)
+   {
+      emitDegreeCheck(left_node, indent);  
+      PTF("continue;\n");
+   }
+   PTF("\n");
+   PTFI("Node *host_node = getNode(host, host_index);\n", indent);
+   PTFI("HostLabel label = host_node->label;\n", indent);
+   PTFI("bool match = false;\n", indent);
    if(hasListVariable(left_node->label))
-      generateVariableListMatchingCode(rule, left_node->label, 6);
-   else generateFixedListMatchingCode(rule, left_node->label, 6);
-   emitNodeMatchResultCode(left_node, next_op, 6);
+      generateVariableListMatchingCode(rule, left_node->label, indent);
+   else generateFixedListMatchingCode(rule, left_node->label, indent);
+   emitNodeMatchResultCode(left_node, next_op, indent);
+}
+
+/* Emits the function that starts the search of a searchplan whose first node
+ * can be matched in parallel. If the host graph has too few nodes with the 
+ * mark of the first node, the search is left to the serial matching functions
+ * of the searchplan, named with serial_name. Otherwise, the candidate host 
+ * nodes are shared among the threads of a parallel search (see parallel.h). */
+static void emitParallelEntry(Rule *rule, string serial_name)
+{
+   SearchOp *first = searchplan->first;
+   RuleNode *left_node = getRuleNode(rule->lhs, first->index);
+   int signatures[NUMBER_OF_SIGNATURES];
+   bool degree_check = false;
+   int count = getSignatures(left_node, signatures, &degree_check);
+   PTF("static bool match%s(Morphism *morphism)\n", plan_name);
+   PTF("{\n");
+   if(count == 0)
+   {
+      PTFI("return false;\n", 3);
+      PTF("}\n\n");
+      return;
+   }
+   emitSignatureTable(signatures, count);
+   if(left_node->label.mark == ANY)
+      PTFI("if(host->number_of_nodes < PARALLEL_MIN_CANDIDATES)\n", 3);
+   else PTFI("if(host->node_mark_counts[%d] < PARALLEL_MIN_CANDIDATES)\n", 3,
+             left_node->label.mark);
+   PTFI("return match%s_n%d(morphism);\n", 6, serial_name, first->index);
+   PTFI("return matchInParallel(host, morphism, signatures, %d, match%s_n%d, %d);\n", 3,
+        count, plan_name, first->index, matching_threads);
+   PTF("}\n\n");
+}
+
+/* Emits the function apply<rule_name>Batch, called before the matching 
+ * function by a loop whose body is a call to the rule. It finds the first 
+ * match from each candidate for the first node of the searchplan, keeps a set
+ * of node-disjoint matches (see findDisjointMatches in parallel.h), applies 
+ * the rule to each of them and returns their number. It returns 0 without 
+ * searching if the host graph has too few candidates, leaving the search to 
+ * the matching function. */
+static void emitBatchApplication(Rule *rule)
+{
+   SearchOp *first = searchplan->first;
+   RuleNode *left_node = getRuleNode(rule->lhs, first->index);
+   int signatures[NUMBER_OF_SIGNATURES];
+   bool degree_check = false;
+   int count = getSignatures(left_node, signatures, &degree_check);
+   PTH("int apply%sBatch(Morphism *morphism, bool record_changes);\n\n", rule->name);
+   PTF("int apply%sBatch(Morphism *morphism, bool record_changes)\n", rule->name);
+   PTF("{\n");
+   if(count == 0)
+   {
+      PTFI("return 0;\n", 3);
+      PTF("}\n\n");
+      return;
+   }
+   emitSignatureTable(signatures, count);
+   PTFI("if(%d > host->number_of_nodes || %d > host->number_of_edges) return 0;\n",
+        3, rule->lhs->node_index, rule->lhs->edge_index);
+   PTFI("if(!relevantChangeSince(host, &failed_at, relevant_signatures)) return 0;\n", 3);
+   if(left_node->label.mark == ANY)
+      PTFI("if(host->number_of_nodes < PARALLEL_MIN_CANDIDATES) return 0;\n", 3);
+   else PTFI("if(host->node_mark_counts[%d] < PARALLEL_MIN_CANDIDATES) return 0;\n", 3,
+             left_node->label.mark);
+   PTFI("int count = findDisjointMatches(host, morphism, signatures, %d, match%s_n%d, %d);\n",
+        3, count, plan_name, first->index, matching_threads);
+   PTFI("if(count == 0) failed_at = host->journal.count;\n", 3);
+   PTFI("int index;\n", 3);
+   PTFI("for(index = 0; index < count; index++)\n", 3);
+   PTFI("{\n", 3);
+   PTFI("getDisjointMatch(index, morphism);\n", 6);
+   PTFI("apply%s(morphism, record_changes);\n", 6, rule->name);
    PTFI("}\n", 3);
+   PTFI("return count;\n", 3);
+   PTF("}\n\n");
+}
+
+/* Emits the function with which a thread of a parallel search tries to match
+ * the first node of the searchplan to a candidate host node. The candidate 
+ * code runs in a loop with a single iteration, where continue rejects the 
+ * candidate. */
+static void emitCandidateMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op)
+{
+   int signatures[NUMBER_OF_SIGNATURES];
+   bool degree_check = false;
+   getSignatures(left_node, signatures, &degree_check);
+   PTF("static bool match%s_n%d(Morphism *morphism, int host_index)\n", plan_name, 
+       left_node->index);
+   PTF("{\n");
+   PTFI("do\n", 3);
+   PTFI("{\n", 3);
+   emitNodeCandidateCode(rule, left_node, next_op, false, degree_check, 6);
+   PTFI("} while(false);\n", 3);
    PTFI("return false;\n", 3);
    PTF("}\n\n");
 }
@@ -447,19 +1075,20 @@ static void emitNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op)
 static void emitNodeFromEdgeMatcher(Rule *rule, RuleNode *left_node, char type,
                                     SearchOp *next_op)
 {
-   PTF("static bool match_n%d(Morphism *morphism, Edge *host_edge)\n",
-       left_node->index);
+   PTF("static bool match%s_n%d(Morphism *morphism, Edge *host_edge)\n",
+       plan_name, left_node->index);
    PTF("{\n");
    if(type == 'i' || type == 'b') 
-        PTFI("Node *host_node = getTarget(host, host_edge);\n\n", 3);
-   else PTFI("Node *host_node = getSource(host, host_edge);\n\n", 3);
+        PTFI("int host_index = host_edge->target;\n\n", 3);
+   else PTFI("int host_index = host_edge->source;\n\n", 3);
 
    string fail_code = (type == 'b') ? "candidate_node = false;" : "return false;";
    if(type == 'b') PTFI("bool candidate_node = true;\n", 3);
-   PTFI("if(host_node->matched) %s\n", 3, fail_code);
-   if(left_node->root) PTFI("if(!(host_node->root)) %s\n", 3, fail_code);
+   emitMatchedCheck('n', "host_index", fail_code, 3);
+   if(left_node->root) PTFI("if(!(host->nodes.roots[host_index])) %s\n", 3, fail_code);
    if(left_node->label.mark != ANY)
-      PTFI("if(host_node->label.mark != %d) %s\n", 3, left_node->label.mark, fail_code);
+      PTFI("if(host->nodes.marks[host_index] != %d) %s\n", 3, left_node->label.mark, 
+           fail_code);
    emitDegreeCheck(left_node, 6);  
    PTF("%s;\n\n", fail_code);
 
@@ -471,16 +1100,18 @@ static void emitNodeFromEdgeMatcher(Rule *rule, RuleNode *left_node, char type,
       PTFI("{\n", 3); 
       PTFI("/* Matching from bidirectional edge: check the second incident node. */\n", 6);
       if(type == 'i' || type == 'b') 
-           PTFI("host_node = getSource(host, host_edge);\n", 6);
-      else PTFI("host_node = getTarget(host, host_edge);\n", 6);
-      PTFI("if(host_node->matched) return false;\n", 6);
-      if(left_node->root) PTFI("if(!(host_node->root)) return false;\n", 6);
+           PTFI("host_index = host_edge->source;\n", 6);
+      else PTFI("host_index = host_edge->target;\n", 6);
+      emitMatchedCheck('n', "host_index", "return false;", 6);
+      if(left_node->root) PTFI("if(!(host->nodes.roots[host_index])) return false;\n", 6);
       if(left_node->label.mark != ANY)
-         PTFI("if(host_node->label.mark != %d) return false;\n", 6, left_node->label.mark);
+         PTFI("if(host->nodes.marks[host_index] != %d) return false;\n", 6, 
+              left_node->label.mark);
       emitDegreeCheck(left_node, 6);  
       PTF("return false;\n\n");
       PTFI("}\n", 3);
    }
+   PTFI("Node *host_node = getNode(host, host_index);\n", 3);
 
    PTFI("HostLabel label = host_node->label;\n", 3);
    PTFI("bool match = false;\n", 3);
@@ -505,7 +1136,7 @@ static void emitNodeMatchResultCode(RuleNode *node, SearchOp *next_op, int inden
    PTFI("{\n", indent);
    PTFI("addNodeMap(morphism, %d, host_node->index, new_assignments);\n",
         indent + 3, node->index);
-   PTFI("host_node->matched = true;\n", indent + 3);
+   emitMatchedFlag('n', "host_node->index", true, indent + 3);
    if(node->predicates != NULL)
    {
       PTFI("/* Update global booleans representing the node's predicates. */\n", indent + 3);
@@ -513,9 +1144,10 @@ static void emitNodeMatchResultCode(RuleNode *node, SearchOp *next_op, int inden
       for(index = 0; index < node->predicate_count; index++)
          PTFI("evaluatePredicate%d(morphism);\n", indent + 3, 
               node->predicates[index]->bool_id);
-      if(next_op != NULL) PTFI("bool next_match_result = false;\n", indent + 3);
+      bool report = next_op == NULL && enumeration_matching;
+      if(next_op != NULL || report) PTFI("bool next_match_result = false;\n", indent + 3);
       PTFI("if(evaluateCondition())", indent + 3);
-      if(next_op == NULL)
+      if(next_op == NULL && !report)
       { 
          PTF("\n");
          PTFI("{\n", indent + 3);
@@ -541,12 +1173,12 @@ static void emitNodeMatchResultCode(RuleNode *node, SearchOp *next_op, int inden
          else PTFI("b%d = true;\n", indent + 6, predicate->bool_id);
       }
       PTFI("removeNodeMap(morphism, %d);\n", indent + 6, node->index);
-      PTFI("host_node->matched = false;\n", indent + 6);  
+      emitMatchedFlag('n', "host_node->index", false, indent + 6);
       PTFI("}\n", indent + 3);
    }
    else
    {
-      if(next_op == NULL)
+      if(next_op == NULL && !enumeration_matching)
       {
          PTFI("/* All items matched! */\n", indent + 3);
          PTFI("return true;\n", indent + 3);
@@ -559,7 +1191,7 @@ static void emitNodeMatchResultCode(RuleNode *node, SearchOp *next_op, int inden
          PTFI("else\n", indent + 3);
          PTFI("{\n", indent + 3);  
          PTFI("removeNodeMap(morphism, %d);\n", indent + 6, node->index);
-         PTFI("host_node->matched = false;\n", indent + 6);  
+         emitMatchedFlag('n', "host_node->index", false, indent + 6);
          PTFI("}\n", indent + 3);
       }
    }
@@ -573,16 +1205,16 @@ static void emitNodeMatchResultCode(RuleNode *node, SearchOp *next_op, int inden
  * are obtained from the appropriate label class tables. */
 static void emitEdgeMatcher(Rule *rule, RuleEdge *left_edge, SearchOp *next_op)
 {
-   PTF("static bool match_e%d(Morphism *morphism)\n", left_edge->index);
+   PTF("static bool match%s_e%d(Morphism *morphism)\n", plan_name, left_edge->index);
    PTF("{\n");
    PTFI("int host_index;\n", 3);
    PTFI("for(host_index = 0; host_index < host->edges.size; host_index++)\n", 3);
    PTFI("{\n", 3);
-   PTFI("Edge *host_edge = getEdge(host, host_index);\n", 6);
-   PTFI("if(host_edge == NULL || host_edge->index == -1) continue;\n", 6);
-   PTFI("if(host_edge->matched) continue;\n", 6);
+   emitMatchedCheck('e', "host_index", "continue;", 6);
    if(left_edge->label.mark != ANY) 
-      PTFI("if(host_edge->label.mark != %d) continue;\n\n", 6, left_edge->label.mark);
+      PTFI("if(host->edges.marks[host_index] != %d) continue;\n", 6, left_edge->label.mark);
+   PTFI("Edge *host_edge = getEdge(host, host_index);\n", 6);
+   PTFI("if(host_edge->index == -1) continue;\n\n", 6);
    PTFI("HostLabel label = host_edge->label;\n", 6);
    PTFI("bool match = false;\n", 6);
    if(hasListVariable(left_edge->label))
@@ -596,22 +1228,22 @@ static void emitEdgeMatcher(Rule *rule, RuleEdge *left_edge, SearchOp *next_op)
 
 static void emitLoopEdgeMatcher(Rule *rule, RuleEdge *left_edge, SearchOp *next_op)
 {
-   PTF("static bool match_e%d(Morphism *morphism)\n", left_edge->index);
+   PTF("static bool match%s_e%d(Morphism *morphism)\n", plan_name, left_edge->index);
    PTF("{\n");
    PTFI("/* Matching a loop. */\n", 3);
    PTFI("int node_index = lookupNode(morphism, %d);\n", 3, left_edge->source->index);
    PTFI("if(node_index < 0) return false;\n", 3);
    PTFI("Node *host_node = getNode(host, node_index);\n\n", 3);
 
-   PTFI("int counter;\n", 3);
-   PTFI("for(counter = 0; counter < host_node->out_edges.size + 2; counter++)\n", 3);
+   PTFI("int counter, *edges;\n", 3);
+   PTFI("forEachOutEdge(host_node, edges, counter)\n", 3);
    PTFI("{\n", 3);
-   PTFI("Edge *host_edge = getNthOutEdge(host, host_node, counter);\n", 6);
-   PTFI("if(host_edge == NULL) continue;\n", 6);
-   PTFI("if(host_edge->matched) continue;\n", 6);
-   PTFI("if(host_edge->source != host_edge->target) continue;\n", 6);
+   PTFI("int host_index = edges[counter];\n", 6);
+   emitMatchedCheck('e', "host_index", "continue;", 6);
    if(left_edge->label.mark != ANY)
-      PTFI("if(host_edge->label.mark != %d) continue;\n\n", 6, left_edge->label.mark);
+      PTFI("if(host->edges.marks[host_index] != %d) continue;\n", 6, left_edge->label.mark);
+   PTFI("Edge *host_edge = getEdge(host, host_index);\n", 6);
+   PTFI("if(host_edge->source != host_edge->target) continue;\n\n", 6);
    PTFI("HostLabel label = host_edge->label;\n", 6);
    PTFI("bool match = false;\n", 6);
    if(hasListVariable(left_edge->label))
@@ -653,7 +1285,7 @@ static void emitEdgeFromNodeMatcher(Rule *rule, RuleEdge *left_edge, bool source
 
    if(initialise)
    {
-      PTF("static bool match_e%d(Morphism *morphism)\n", left_edge->index);
+      PTF("static bool match%s_e%d(Morphism *morphism)\n", plan_name, left_edge->index);
       PTF("{\n");
       PTFI("/* Start node is the already-matched node from which the candidate\n", 3);
       PTFI("   edges are drawn. End node may or may not have been matched already. */\n", 3);
@@ -661,26 +1293,19 @@ static void emitEdgeFromNodeMatcher(Rule *rule, RuleEdge *left_edge, bool source
       PTFI("int end_index = lookupNode(morphism, %d);\n", 3, end_index);
       PTFI("if(start_index < 0) return false;\n", 3);
       PTFI("Node *host_node = getNode(host, start_index);\n\n", 3);
-      PTFI("int counter;\n", 3);
-   }
-   if(source)
-   {
-      PTFI("for(counter = 0; counter < host_node->out_edges.size + 2; counter++)\n", 3);
-      PTFI("{\n", 3);
-      PTFI("Edge *host_edge = getNthOutEdge(host, host_node, counter);\n", 6);
+      PTFI("int counter, *edges, host_index;\n", 3);
    }
-   else
-   {
-      PTFI("for(counter = 0; counter < host_node->in_edges.size + 2; counter++)\n", 3);
-      PTFI("{\n", 3);
-      PTFI("Edge *host_edge = getNthInEdge(host, host_node, counter);\n", 6);
-   }
-
-   PTFI("if(host_edge == NULL) continue;\n", 6);
-   PTFI("if(host_edge->matched) continue;\n", 6);
-   PTFI("if(host_edge->source == host_edge->target) continue;\n", 6);
+   /* If the end node has been matched, the candidates are only the edges
+    * between the two host nodes, which are taken from the edge index if the
+    * start node has many incident edges. */
+   if(source) PTFI("forEachOutEdgeTo(host, host_node, end_index, edges, counter, host_index)\n", 3);
+   else PTFI("forEachInEdgeFrom(host, host_node, end_index, edges, counter, host_index)\n", 3);
+   PTFI("{\n", 3);
+   emitMatchedCheck('e', "host_index", "continue;", 6);
    if(left_edge->label.mark != ANY)
-      PTFI("if(host_edge->label.mark != %d) continue;\n\n", 6, left_edge->label.mark);
+      PTFI("if(host->edges.marks[host_index] != %d) continue;\n", 6, left_edge->label.mark);
+   PTFI("Edge *host_edge = getEdge(host, host_index);\n", 6);
+   PTFI("if(host_edge->source == host_edge->target) continue;\n\n", 6);
 
    PTFI("/* If the end node has been matched, check that the %s of the\n", 6, end_node_type);
    PTFI(" * host edge is the image of the end node. */\n", 6);
@@ -691,8 +1316,7 @@ static void emitEdgeFromNodeMatcher(Rule *rule, RuleEdge *left_edge, bool source
    PTFI("/* Otherwise, the %s of the host edge should be unmatched. */\n", 6, end_node_type);
    PTFI("else\n", 6);
    PTFI("{\n", 6);
-   PTFI("Node *end_node = getNode(host, host_edge->%s);\n", 9, end_node_type);
-   PTFI("if(end_node->matched) continue;\n", 9);
+   emitMatchedCheck('n', source ? "host_edge->target" : "host_edge->source", "continue;", 9);
    PTFI("}\n\n", 6);
 
    PTFI("HostLabel label = host_edge->label;\n", 6);
@@ -714,11 +1338,11 @@ static void emitEdgeMatchResultCode(int index, SearchOp *next_op, int indent)
    PTFI("if(match)\n", indent);
    PTFI("{\n", indent);
    PTFI("addEdgeMap(morphism, %d, host_edge->index, new_assignments);\n", indent + 3, index);
-   PTFI("host_edge->matched = true;\n", indent + 3);
-   if(next_op == NULL)
+   emitMatchedFlag('e', "host_edge->index", true, indent + 3);
+   if(next_op == NULL && !enumeration_matching)
    {
-      PTFI("/* All items matched! */\n", indent);
-      PTFI("return true;\n", indent);
+      PTFI("/* All items matched! */\n", indent + 3);
+      PTFI("return true;\n", indent + 3);
    }
    else
    {
@@ -728,33 +1352,40 @@ static void emitEdgeMatchResultCode(int index, SearchOp *next_op, int indent)
       PTFI("else\n", indent + 3);
       PTFI("{\n", indent + 3);                              
       PTFI("removeEdgeMap(morphism, %d);\n", indent + 6, index);
-      PTFI("host_edge->matched = false;\n", indent + 6); 
+      emitMatchedFlag('e', "host_edge->index", false, indent + 6);
       PTFI("}\n", indent + 3);
    } 
    PTFI("}\n", indent);
    PTFI("else removeAssignments(morphism, new_assignments);\n", indent);
 }
 
+/* After the last searchplan operation of an enumeration, the complete match is
+ * handed over to reportMatch (see emitMatchReporter). */
 static void emitNextMatcherCall(SearchOp *next_operation)
 {
+   if(next_operation == NULL)
+   {
+      PTF("reportMatch(morphism)");
+      return;
+   }
    switch(next_operation->type)
    {
       case 'n':
       case 'r':
-           PTF("match_n%d(morphism)", next_operation->index);
+           PTF("match%s_n%d(morphism)", plan_name, next_operation->index);
            break;
 
       case 'i':
       case 'o':
       case 'b':
-           PTF("match_n%d(morphism, host_edge)", next_operation->index);
+           PTF("match%s_n%d(morphism, host_edge)", plan_name, next_operation->index);
            break;
   
       case 'e':
       case 's':
       case 't':
       case 'l':
-           PTF("match_e%d(morphism)", next_operation->index);
+           PTF("match%s_e%d(morphism)", plan_name, next_operation->index);
            break;
 
       default:
@@ -53,13 +53,20 @@
  * it returns true. This propagates back through all the matching functions to 
  * match_R, which returns true, signalling that the rule match is a success. */
  
+/* The number of threads with which rules are matched, set by the -t option of 
+ * the compiler. If it is greater than 1, the first searchplan operation of 
+ * the rules that permit it is split among the threads (see parallel.h). */
+extern int matching_threads;
+
 /* Takes the root of the AST of a GP 2 program and generates C modules for
  * each rule in the program. */
 void generateRules(List *declarations, string output_dir);
 
 /* Create a C module to match and apply the rule. The generated files are
- * called <rule_name>.h and <rule_name>.c.*/
-void generateRuleCode(Rule *rule, bool predicate, string output_dir);
+ * called <rule_name>.h and <rule_name>.c. Returns true if the module has the
+ * function apply<rule_name>Batch, which applies the rule at once to a set of
+ * node-disjoint matches found in parallel. */
+bool generateRuleCode(Rule *rule, bool predicate, string output_dir);
 
 /* The three functions below write the function apply_<rule_name> that makes the 
  * necessary changes to the host graph according to the rule and morphism. 
@@ -56,6 +56,7 @@ extern bool syntax_error;
 /* Code placed in parser.c. */
 %{
 #include "globals.h"
+#include "searchplan.h"
 
 int yylex(void);
 
@@ -507,8 +508,9 @@ EdgeID: ID				/* default $$ = $1 */
 Variable: ID		  		/* default $$ = $1 */ 
 
 
-/* Grammar for host graphs. It is used to syntax check the host graph file 
- * and to count the number of nodes and edges in the host graph. */
+/* Grammar for host graphs. It is used to syntax check the host graph file, 
+ * to count the number of nodes and edges in the host graph, and to collect
+ * the host graph statistics used to generate searchplans. */
 HostGraph: '[' '|' ']'  		{ }
          | '[' Position '|' '|' ']'  	{ }
          | '[' HostNodeList '|' ']'  	{ }
@@ -523,29 +525,32 @@ HostNodeList: HostNode			{ host_nodes++; }
             | HostNodeList HostNode	{ host_nodes++; }
 
 HostNode: '(' HostID RootNode ',' HostLabel ')'
-    					/* default $$ = $1; */ 
+    					{ recordHostNode($2, is_root); 
+					  is_root = false; }
 HostNode: '(' HostID RootNode ',' HostLabel Position ')'
-    					/* default $$ = $1; */
+    					{ recordHostNode($2, is_root); 
+					  is_root = false; }
 
 HostEdgeList: HostEdge			{ host_edges++; }
             | HostEdgeList HostEdge	{ host_edges++; } 
 
 HostEdge: '(' HostID ',' HostID ',' HostID ',' HostLabel ')'
-    					/* default $$ = $1; */
+    					{ recordHostEdge($4, $6); }
 
 HostID:	NUM				/* default $$ = $1 */
 
 HostLabel: HostList			{ }
-         | HostList '#' MARK	  	{ }
+         | HostList '#' MARK	  	{ recordHostMark($3); }
 
 HostList: HostExp 			{ } 
         | HostList ':' HostExp 		{ }
 	| _EMPTY			{ }
         | HostList ':' _EMPTY	        { }
 
-HostExp: NUM 				{ }
-       | '-' NUM %prec UMINUS 	        { } 
-       | STR 				{ if($1) free($1); }
+HostExp: NUM 				{ recordHostInteger($1); }
+       | '-' NUM %prec UMINUS 	        { recordHostInteger(-($2)); } 
+       | STR 				{ recordHostString($1); 
+					  if($1) free($1); }
 
 %%
 
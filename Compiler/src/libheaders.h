@@ -183,104 +183,226 @@ unsigned char globals_h[] = {
   0x63, 0x6c, 0x75, 0x64, 0x65, 0x20, 0x3c, 0x73, 0x79, 0x73, 0x2f, 0x73,
   0x74, 0x61, 0x74, 0x2e, 0x68, 0x3e, 0x0a, 0x23, 0x69, 0x6e, 0x63, 0x6c,
   0x75, 0x64, 0x65, 0x20, 0x3c, 0x73, 0x79, 0x73, 0x2f, 0x74, 0x79, 0x70,
-  0x65, 0x73, 0x2e, 0x68, 0x3e, 0x0a, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64,
-  0x65, 0x66, 0x20, 0x63, 0x68, 0x61, 0x72, 0x2a, 0x20, 0x73, 0x74, 0x72,
-  0x69, 0x6e, 0x67, 0x3b, 0x0a, 0x0a, 0x65, 0x78, 0x74, 0x65, 0x72, 0x6e,
-  0x20, 0x46, 0x49, 0x4c, 0x45, 0x20, 0x2a, 0x6c, 0x6f, 0x67, 0x5f, 0x66,
-  0x69, 0x6c, 0x65, 0x3b, 0x0a, 0x65, 0x78, 0x74, 0x65, 0x72, 0x6e, 0x20,
-  0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x5f, 0x63,
-  0x6f, 0x70, 0x79, 0x69, 0x6e, 0x67, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20,
-  0x42, 0x69, 0x73, 0x6f, 0x6e, 0x20, 0x75, 0x73, 0x65, 0x73, 0x20, 0x61,
-  0x20, 0x67, 0x6c, 0x6f, 0x62, 0x61, 0x6c, 0x20, 0x76, 0x61, 0x72, 0x69,
-  0x61, 0x62, 0x6c, 0x65, 0x20, 0x79, 0x79, 0x6c, 0x6c, 0x6f, 0x63, 0x20,
-  0x6f, 0x66, 0x20, 0x74, 0x79, 0x70, 0x65, 0x20, 0x59, 0x59, 0x4c, 0x54,
-  0x59, 0x50, 0x45, 0x20, 0x74, 0x6f, 0x20, 0x6b, 0x65, 0x65, 0x70, 0x20,
-  0x74, 0x72, 0x61, 0x63, 0x6b, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65,
-  0x20, 0x0a, 0x20, 0x2a, 0x20, 0x6c, 0x6f, 0x63, 0x61, 0x74, 0x69, 0x6f,
-  0x6e, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x6f, 0x6b, 0x65, 0x6e, 0x73,
-  0x20, 0x61, 0x6e, 0x64, 0x20, 0x6e, 0x6f, 0x6e, 0x74, 0x65, 0x72, 0x6d,
-  0x69, 0x6e, 0x61, 0x6c, 0x73, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x73,
-  0x63, 0x61, 0x6e, 0x6e, 0x65, 0x72, 0x20, 0x77, 0x69, 0x6c, 0x6c, 0x20,
-  0x73, 0x65, 0x74, 0x20, 0x74, 0x68, 0x65, 0x73, 0x65, 0x20, 0x76, 0x61,
-  0x6c, 0x75, 0x65, 0x73, 0x20, 0x75, 0x70, 0x6f, 0x6e, 0x0a, 0x20, 0x2a,
-  0x20, 0x72, 0x65, 0x61, 0x64, 0x69, 0x6e, 0x67, 0x20, 0x65, 0x61, 0x63,
-  0x68, 0x20, 0x74, 0x6f, 0x6b, 0x65, 0x6e, 0x2e, 0x20, 0x54, 0x68, 0x69,
-  0x73, 0x20, 0x69, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x74, 0x61,
-  0x6e, 0x64, 0x61, 0x72, 0x64, 0x20, 0x59, 0x59, 0x4c, 0x54, 0x59, 0x50,
-  0x45, 0x20, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x69, 0x74, 0x69, 0x6f, 0x6e,
-  0x20, 0x62, 0x75, 0x74, 0x20, 0x49, 0x20, 0x64, 0x65, 0x66, 0x69, 0x6e,
-  0x65, 0x20, 0x69, 0x74, 0x0a, 0x20, 0x2a, 0x20, 0x68, 0x65, 0x72, 0x65,
-  0x20, 0x73, 0x6f, 0x20, 0x69, 0x74, 0x20, 0x69, 0x73, 0x20, 0x76, 0x69,
-  0x73, 0x69, 0x62, 0x6c, 0x65, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65,
-  0x20, 0x41, 0x53, 0x54, 0x20, 0x6d, 0x6f, 0x64, 0x75, 0x6c, 0x65, 0x2e,
+  0x65, 0x73, 0x2e, 0x68, 0x3e, 0x0a, 0x23, 0x69, 0x6e, 0x63, 0x6c, 0x75,
+  0x64, 0x65, 0x20, 0x3c, 0x75, 0x6e, 0x69, 0x73, 0x74, 0x64, 0x2e, 0x68,
+  0x3e, 0x0a, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x63,
+  0x68, 0x61, 0x72, 0x2a, 0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x3b,
+  0x0a, 0x0a, 0x65, 0x78, 0x74, 0x65, 0x72, 0x6e, 0x20, 0x46, 0x49, 0x4c,
+  0x45, 0x20, 0x2a, 0x6c, 0x6f, 0x67, 0x5f, 0x66, 0x69, 0x6c, 0x65, 0x3b,
+  0x0a, 0x65, 0x78, 0x74, 0x65, 0x72, 0x6e, 0x20, 0x62, 0x6f, 0x6f, 0x6c,
+  0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x5f, 0x63, 0x6f, 0x70, 0x79, 0x69,
+  0x6e, 0x67, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x42, 0x69, 0x73, 0x6f,
+  0x6e, 0x20, 0x75, 0x73, 0x65, 0x73, 0x20, 0x61, 0x20, 0x67, 0x6c, 0x6f,
+  0x62, 0x61, 0x6c, 0x20, 0x76, 0x61, 0x72, 0x69, 0x61, 0x62, 0x6c, 0x65,
+  0x20, 0x79, 0x79, 0x6c, 0x6c, 0x6f, 0x63, 0x20, 0x6f, 0x66, 0x20, 0x74,
+  0x79, 0x70, 0x65, 0x20, 0x59, 0x59, 0x4c, 0x54, 0x59, 0x50, 0x45, 0x20,
+  0x74, 0x6f, 0x20, 0x6b, 0x65, 0x65, 0x70, 0x20, 0x74, 0x72, 0x61, 0x63,
+  0x6b, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x0a, 0x20, 0x2a,
+  0x20, 0x6c, 0x6f, 0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x73, 0x20, 0x6f,
+  0x66, 0x20, 0x74, 0x6f, 0x6b, 0x65, 0x6e, 0x73, 0x20, 0x61, 0x6e, 0x64,
+  0x20, 0x6e, 0x6f, 0x6e, 0x74, 0x65, 0x72, 0x6d, 0x69, 0x6e, 0x61, 0x6c,
+  0x73, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x73, 0x63, 0x61, 0x6e, 0x6e,
+  0x65, 0x72, 0x20, 0x77, 0x69, 0x6c, 0x6c, 0x20, 0x73, 0x65, 0x74, 0x20,
+  0x74, 0x68, 0x65, 0x73, 0x65, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x73,
+  0x20, 0x75, 0x70, 0x6f, 0x6e, 0x0a, 0x20, 0x2a, 0x20, 0x72, 0x65, 0x61,
+  0x64, 0x69, 0x6e, 0x67, 0x20, 0x65, 0x61, 0x63, 0x68, 0x20, 0x74, 0x6f,
+  0x6b, 0x65, 0x6e, 0x2e, 0x20, 0x54, 0x68, 0x69, 0x73, 0x20, 0x69, 0x73,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x74, 0x61, 0x6e, 0x64, 0x61, 0x72,
+  0x64, 0x20, 0x59, 0x59, 0x4c, 0x54, 0x59, 0x50, 0x45, 0x20, 0x64, 0x65,
+  0x66, 0x69, 0x6e, 0x69, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x62, 0x75, 0x74,
+  0x20, 0x49, 0x20, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x20, 0x69, 0x74,
+  0x0a, 0x20, 0x2a, 0x20, 0x68, 0x65, 0x72, 0x65, 0x20, 0x73, 0x6f, 0x20,
+  0x69, 0x74, 0x20, 0x69, 0x73, 0x20, 0x76, 0x69, 0x73, 0x69, 0x62, 0x6c,
+  0x65, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x41, 0x53, 0x54,
+  0x20, 0x6d, 0x6f, 0x64, 0x75, 0x6c, 0x65, 0x2e, 0x20, 0x2a, 0x2f, 0x0a,
+  0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x73, 0x74, 0x72, 0x75,
+  0x63, 0x74, 0x20, 0x59, 0x59, 0x4c, 0x54, 0x59, 0x50, 0x45, 0x20, 0x7b,
+  0x0a, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x66, 0x69, 0x72, 0x73, 0x74,
+  0x5f, 0x6c, 0x69, 0x6e, 0x65, 0x3b, 0x0a, 0x20, 0x20, 0x69, 0x6e, 0x74,
+  0x20, 0x66, 0x69, 0x72, 0x73, 0x74, 0x5f, 0x63, 0x6f, 0x6c, 0x75, 0x6d,
+  0x6e, 0x3b, 0x0a, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6c, 0x61, 0x73,
+  0x74, 0x5f, 0x6c, 0x69, 0x6e, 0x65, 0x3b, 0x0a, 0x20, 0x20, 0x69, 0x6e,
+  0x74, 0x20, 0x6c, 0x61, 0x73, 0x74, 0x5f, 0x63, 0x6f, 0x6c, 0x75, 0x6d,
+  0x6e, 0x3b, 0x0a, 0x7d, 0x20, 0x59, 0x59, 0x4c, 0x54, 0x59, 0x50, 0x45,
+  0x3b, 0x0a, 0x0a, 0x23, 0x20, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x20,
+  0x59, 0x59, 0x4c, 0x54, 0x59, 0x50, 0x45, 0x5f, 0x49, 0x53, 0x5f, 0x44,
+  0x45, 0x43, 0x4c, 0x41, 0x52, 0x45, 0x44, 0x20, 0x31, 0x20, 0x2f, 0x2a,
+  0x20, 0x54, 0x65, 0x6c, 0x6c, 0x73, 0x20, 0x42, 0x69, 0x73, 0x6f, 0x6e,
+  0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x59, 0x59, 0x4c, 0x54, 0x59, 0x50,
+  0x45, 0x20, 0x69, 0x73, 0x20, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x64,
+  0x20, 0x68, 0x65, 0x72, 0x65, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x0a, 0x2f,
+  0x2a, 0x20, 0x47, 0x50, 0x20, 0x32, 0x27, 0x73, 0x20, 0x76, 0x61, 0x72,
+  0x69, 0x61, 0x62, 0x6c, 0x65, 0x20, 0x74, 0x79, 0x70, 0x65, 0x73, 0x2e,
   0x20, 0x2a, 0x2f, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20,
-  0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x59, 0x59, 0x4c, 0x54, 0x59,
-  0x50, 0x45, 0x20, 0x7b, 0x0a, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x66,
-  0x69, 0x72, 0x73, 0x74, 0x5f, 0x6c, 0x69, 0x6e, 0x65, 0x3b, 0x0a, 0x20,
-  0x20, 0x69, 0x6e, 0x74, 0x20, 0x66, 0x69, 0x72, 0x73, 0x74, 0x5f, 0x63,
-  0x6f, 0x6c, 0x75, 0x6d, 0x6e, 0x3b, 0x0a, 0x20, 0x20, 0x69, 0x6e, 0x74,
-  0x20, 0x6c, 0x61, 0x73, 0x74, 0x5f, 0x6c, 0x69, 0x6e, 0x65, 0x3b, 0x0a,
-  0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6c, 0x61, 0x73, 0x74, 0x5f, 0x63,
-  0x6f, 0x6c, 0x75, 0x6d, 0x6e, 0x3b, 0x0a, 0x7d, 0x20, 0x59, 0x59, 0x4c,
-  0x54, 0x59, 0x50, 0x45, 0x3b, 0x0a, 0x0a, 0x23, 0x20, 0x64, 0x65, 0x66,
-  0x69, 0x6e, 0x65, 0x20, 0x59, 0x59, 0x4c, 0x54, 0x59, 0x50, 0x45, 0x5f,
-  0x49, 0x53, 0x5f, 0x44, 0x45, 0x43, 0x4c, 0x41, 0x52, 0x45, 0x44, 0x20,
-  0x31, 0x20, 0x2f, 0x2a, 0x20, 0x54, 0x65, 0x6c, 0x6c, 0x73, 0x20, 0x42,
-  0x69, 0x73, 0x6f, 0x6e, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x59, 0x59,
-  0x4c, 0x54, 0x59, 0x50, 0x45, 0x20, 0x69, 0x73, 0x20, 0x64, 0x65, 0x66,
-  0x69, 0x6e, 0x65, 0x64, 0x20, 0x68, 0x65, 0x72, 0x65, 0x2e, 0x20, 0x2a,
-  0x2f, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x47, 0x50, 0x20, 0x32, 0x27, 0x73,
-  0x20, 0x76, 0x61, 0x72, 0x69, 0x61, 0x62, 0x6c, 0x65, 0x20, 0x74, 0x79,
-  0x70, 0x65, 0x73, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x74, 0x79, 0x70, 0x65,
-  0x64, 0x65, 0x66, 0x20, 0x65, 0x6e, 0x75, 0x6d, 0x20, 0x7b, 0x49, 0x4e,
-  0x54, 0x45, 0x47, 0x45, 0x52, 0x5f, 0x56, 0x41, 0x52, 0x20, 0x3d, 0x20,
-  0x30, 0x2c, 0x20, 0x43, 0x48, 0x41, 0x52, 0x41, 0x43, 0x54, 0x45, 0x52,
-  0x5f, 0x56, 0x41, 0x52, 0x2c, 0x20, 0x53, 0x54, 0x52, 0x49, 0x4e, 0x47,
-  0x5f, 0x56, 0x41, 0x52, 0x2c, 0x20, 0x41, 0x54, 0x4f, 0x4d, 0x5f, 0x56,
-  0x41, 0x52, 0x2c, 0x20, 0x4c, 0x49, 0x53, 0x54, 0x5f, 0x56, 0x41, 0x52,
-  0x7d, 0x20, 0x47, 0x50, 0x54, 0x79, 0x70, 0x65, 0x3b, 0x0a, 0x0a, 0x74,
+  0x65, 0x6e, 0x75, 0x6d, 0x20, 0x7b, 0x49, 0x4e, 0x54, 0x45, 0x47, 0x45,
+  0x52, 0x5f, 0x56, 0x41, 0x52, 0x20, 0x3d, 0x20, 0x30, 0x2c, 0x20, 0x43,
+  0x48, 0x41, 0x52, 0x41, 0x43, 0x54, 0x45, 0x52, 0x5f, 0x56, 0x41, 0x52,
+  0x2c, 0x20, 0x53, 0x54, 0x52, 0x49, 0x4e, 0x47, 0x5f, 0x56, 0x41, 0x52,
+  0x2c, 0x20, 0x41, 0x54, 0x4f, 0x4d, 0x5f, 0x56, 0x41, 0x52, 0x2c, 0x20,
+  0x4c, 0x49, 0x53, 0x54, 0x5f, 0x56, 0x41, 0x52, 0x7d, 0x20, 0x47, 0x50,
+  0x54, 0x79, 0x70, 0x65, 0x3b, 0x0a, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64,
+  0x65, 0x66, 0x20, 0x65, 0x6e, 0x75, 0x6d, 0x20, 0x7b, 0x4e, 0x4f, 0x4e,
+  0x45, 0x20, 0x3d, 0x20, 0x30, 0x2c, 0x20, 0x52, 0x45, 0x44, 0x2c, 0x20,
+  0x47, 0x52, 0x45, 0x45, 0x4e, 0x2c, 0x20, 0x42, 0x4c, 0x55, 0x45, 0x2c,
+  0x20, 0x47, 0x52, 0x45, 0x59, 0x2c, 0x20, 0x44, 0x41, 0x53, 0x48, 0x45,
+  0x44, 0x2c, 0x20, 0x41, 0x4e, 0x59, 0x7d, 0x20, 0x4d, 0x61, 0x72, 0x6b,
+  0x54, 0x79, 0x70, 0x65, 0x3b, 0x20, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x48,
+  0x6f, 0x73, 0x74, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x20, 0x61, 0x72,
+  0x65, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x65, 0x64, 0x20, 0x62, 0x79,
+  0x20, 0x74, 0x68, 0x65, 0x69, 0x72, 0x20, 0x73, 0x69, 0x67, 0x6e, 0x61,
+  0x74, 0x75, 0x72, 0x65, 0x2c, 0x20, 0x61, 0x20, 0x6e, 0x75, 0x6d, 0x62,
+  0x65, 0x72, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x75, 0x74, 0x65, 0x64, 0x20,
+  0x66, 0x72, 0x6f, 0x6d, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64,
+  0x65, 0x27, 0x73, 0x0a, 0x20, 0x2a, 0x20, 0x6d, 0x61, 0x72, 0x6b, 0x2c,
+  0x20, 0x6f, 0x75, 0x74, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x2c, 0x20,
+  0x69, 0x6e, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x2c, 0x20, 0x6e, 0x75,
+  0x6d, 0x62, 0x65, 0x72, 0x20, 0x6f, 0x66, 0x20, 0x6c, 0x6f, 0x6f, 0x70,
+  0x73, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x72, 0x6f, 0x6f, 0x74, 0x20, 0x73,
+  0x74, 0x61, 0x74, 0x75, 0x73, 0x2e, 0x20, 0x44, 0x65, 0x67, 0x72, 0x65,
+  0x65, 0x73, 0x20, 0x67, 0x72, 0x65, 0x61, 0x74, 0x65, 0x72, 0x0a, 0x20,
+  0x2a, 0x20, 0x74, 0x68, 0x61, 0x6e, 0x20, 0x53, 0x49, 0x47, 0x5f, 0x44,
+  0x45, 0x47, 0x52, 0x45, 0x45, 0x5f, 0x43, 0x41, 0x50, 0x20, 0x61, 0x6e,
+  0x64, 0x20, 0x6c, 0x6f, 0x6f, 0x70, 0x20, 0x63, 0x6f, 0x75, 0x6e, 0x74,
+  0x73, 0x20, 0x67, 0x72, 0x65, 0x61, 0x74, 0x65, 0x72, 0x20, 0x74, 0x68,
+  0x61, 0x6e, 0x20, 0x53, 0x49, 0x47, 0x5f, 0x4c, 0x4f, 0x4f, 0x50, 0x5f,
+  0x43, 0x41, 0x50, 0x20, 0x73, 0x68, 0x61, 0x72, 0x65, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x73, 0x69, 0x67, 0x6e, 0x61, 0x74,
+  0x75, 0x72, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x63,
+  0x61, 0x70, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x63, 0x6f, 0x6d, 0x70,
+  0x69, 0x6c, 0x65, 0x72, 0x20, 0x75, 0x73, 0x65, 0x73, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x73, 0x61, 0x6d, 0x65, 0x20, 0x64, 0x65, 0x66, 0x69, 0x6e,
+  0x69, 0x74, 0x69, 0x6f, 0x6e, 0x73, 0x20, 0x74, 0x6f, 0x20, 0x77, 0x6f,
+  0x72, 0x6b, 0x20, 0x6f, 0x75, 0x74, 0x0a, 0x20, 0x2a, 0x20, 0x77, 0x68,
+  0x69, 0x63, 0x68, 0x20, 0x73, 0x69, 0x67, 0x6e, 0x61, 0x74, 0x75, 0x72,
+  0x65, 0x73, 0x20, 0x63, 0x61, 0x6e, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68,
+  0x20, 0x61, 0x20, 0x72, 0x75, 0x6c, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65,
+  0x2c, 0x20, 0x73, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x79, 0x20, 0x61, 0x72,
+  0x65, 0x20, 0x73, 0x68, 0x61, 0x72, 0x65, 0x64, 0x20, 0x68, 0x65, 0x72,
+  0x65, 0x2e, 0x20, 0x53, 0x65, 0x74, 0x74, 0x69, 0x6e, 0x67, 0x0a, 0x20,
+  0x2a, 0x20, 0x62, 0x6f, 0x74, 0x68, 0x20, 0x63, 0x61, 0x70, 0x73, 0x20,
+  0x74, 0x6f, 0x20, 0x30, 0x20, 0x72, 0x65, 0x64, 0x75, 0x63, 0x65, 0x73,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x69, 0x67, 0x6e, 0x61, 0x74, 0x75,
+  0x72, 0x65, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f,
+  0x64, 0x65, 0x27, 0x73, 0x20, 0x6d, 0x61, 0x72, 0x6b, 0x20, 0x61, 0x6e,
+  0x64, 0x20, 0x72, 0x6f, 0x6f, 0x74, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75,
+  0x73, 0x2e, 0x0a, 0x20, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6d, 0x61,
+  0x72, 0x6b, 0x73, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x6f, 0x63, 0x63,
+  0x75, 0x72, 0x20, 0x69, 0x6e, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x20, 0x67,
+  0x72, 0x61, 0x70, 0x68, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x4d, 0x61, 0x72, 0x6b, 0x54, 0x79, 0x70, 0x65, 0x20, 0x76,
+  0x61, 0x6c, 0x75, 0x65, 0x73, 0x20, 0x62, 0x65, 0x6c, 0x6f, 0x77, 0x20,
+  0x41, 0x4e, 0x59, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x23, 0x64, 0x65, 0x66,
+  0x69, 0x6e, 0x65, 0x20, 0x53, 0x49, 0x47, 0x5f, 0x44, 0x45, 0x47, 0x52,
+  0x45, 0x45, 0x5f, 0x43, 0x41, 0x50, 0x20, 0x33, 0x0a, 0x23, 0x64, 0x65,
+  0x66, 0x69, 0x6e, 0x65, 0x20, 0x53, 0x49, 0x47, 0x5f, 0x4c, 0x4f, 0x4f,
+  0x50, 0x5f, 0x43, 0x41, 0x50, 0x20, 0x31, 0x0a, 0x23, 0x64, 0x65, 0x66,
+  0x69, 0x6e, 0x65, 0x20, 0x53, 0x49, 0x47, 0x5f, 0x43, 0x41, 0x50, 0x50,
+  0x45, 0x44, 0x28, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x2c, 0x20, 0x63, 0x61,
+  0x70, 0x29, 0x20, 0x28, 0x28, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x29, 0x20,
+  0x3c, 0x20, 0x28, 0x63, 0x61, 0x70, 0x29, 0x20, 0x3f, 0x20, 0x28, 0x76,
+  0x61, 0x6c, 0x75, 0x65, 0x29, 0x20, 0x3a, 0x20, 0x28, 0x63, 0x61, 0x70,
+  0x29, 0x29, 0x0a, 0x23, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x20, 0x53,
+  0x49, 0x47, 0x4e, 0x41, 0x54, 0x55, 0x52, 0x45, 0x28, 0x6d, 0x61, 0x72,
+  0x6b, 0x2c, 0x20, 0x6f, 0x75, 0x74, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65,
+  0x2c, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x2c, 0x20,
+  0x6c, 0x6f, 0x6f, 0x70, 0x73, 0x2c, 0x20, 0x72, 0x6f, 0x6f, 0x74, 0x29,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x5c, 0x0a, 0x20, 0x20, 0x20,
+  0x28, 0x28, 0x28, 0x28, 0x28, 0x6d, 0x61, 0x72, 0x6b, 0x29, 0x20, 0x2a,
+  0x20, 0x28, 0x53, 0x49, 0x47, 0x5f, 0x44, 0x45, 0x47, 0x52, 0x45, 0x45,
+  0x5f, 0x43, 0x41, 0x50, 0x20, 0x2b, 0x20, 0x31, 0x29, 0x20, 0x2b, 0x20,
+  0x53, 0x49, 0x47, 0x5f, 0x43, 0x41, 0x50, 0x50, 0x45, 0x44, 0x28, 0x6f,
+  0x75, 0x74, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x2c, 0x20, 0x53, 0x49,
+  0x47, 0x5f, 0x44, 0x45, 0x47, 0x52, 0x45, 0x45, 0x5f, 0x43, 0x41, 0x50,
+  0x29, 0x29, 0x20, 0x5c, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x2a,
+  0x20, 0x28, 0x53, 0x49, 0x47, 0x5f, 0x44, 0x45, 0x47, 0x52, 0x45, 0x45,
+  0x5f, 0x43, 0x41, 0x50, 0x20, 0x2b, 0x20, 0x31, 0x29, 0x20, 0x2b, 0x20,
+  0x53, 0x49, 0x47, 0x5f, 0x43, 0x41, 0x50, 0x50, 0x45, 0x44, 0x28, 0x69,
+  0x6e, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x2c, 0x20, 0x53, 0x49, 0x47,
+  0x5f, 0x44, 0x45, 0x47, 0x52, 0x45, 0x45, 0x5f, 0x43, 0x41, 0x50, 0x29,
+  0x29, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x5c,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x28, 0x53, 0x49,
+  0x47, 0x5f, 0x4c, 0x4f, 0x4f, 0x50, 0x5f, 0x43, 0x41, 0x50, 0x20, 0x2b,
+  0x20, 0x31, 0x29, 0x20, 0x2b, 0x20, 0x53, 0x49, 0x47, 0x5f, 0x43, 0x41,
+  0x50, 0x50, 0x45, 0x44, 0x28, 0x6c, 0x6f, 0x6f, 0x70, 0x73, 0x2c, 0x20,
+  0x53, 0x49, 0x47, 0x5f, 0x4c, 0x4f, 0x4f, 0x50, 0x5f, 0x43, 0x41, 0x50,
+  0x29, 0x29, 0x20, 0x2a, 0x20, 0x32, 0x20, 0x2b, 0x20, 0x28, 0x28, 0x72,
+  0x6f, 0x6f, 0x74, 0x29, 0x20, 0x3f, 0x20, 0x31, 0x20, 0x3a, 0x20, 0x30,
+  0x29, 0x29, 0x0a, 0x23, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x20, 0x4e,
+  0x55, 0x4d, 0x42, 0x45, 0x52, 0x5f, 0x4f, 0x46, 0x5f, 0x53, 0x49, 0x47,
+  0x4e, 0x41, 0x54, 0x55, 0x52, 0x45, 0x53, 0x20, 0x53, 0x49, 0x47, 0x4e,
+  0x41, 0x54, 0x55, 0x52, 0x45, 0x28, 0x41, 0x4e, 0x59, 0x2c, 0x20, 0x30,
+  0x2c, 0x20, 0x30, 0x2c, 0x20, 0x30, 0x2c, 0x20, 0x66, 0x61, 0x6c, 0x73,
+  0x65, 0x29, 0x0a, 0x23, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x20, 0x53,
+  0x49, 0x47, 0x4e, 0x41, 0x54, 0x55, 0x52, 0x45, 0x5f, 0x4d, 0x41, 0x52,
+  0x4b, 0x28, 0x73, 0x69, 0x67, 0x6e, 0x61, 0x74, 0x75, 0x72, 0x65, 0x29,
+  0x20, 0x28, 0x28, 0x73, 0x69, 0x67, 0x6e, 0x61, 0x74, 0x75, 0x72, 0x65,
+  0x29, 0x20, 0x2f, 0x20, 0x53, 0x49, 0x47, 0x4e, 0x41, 0x54, 0x55, 0x52,
+  0x45, 0x28, 0x31, 0x2c, 0x20, 0x30, 0x2c, 0x20, 0x30, 0x2c, 0x20, 0x30,
+  0x2c, 0x20, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x29, 0x29, 0x0a, 0x0a, 0x2f,
+  0x2a, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x73,
+  0x20, 0x61, 0x6e, 0x64, 0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x73,
+  0x20, 0x61, 0x72, 0x65, 0x20, 0x68, 0x61, 0x73, 0x68, 0x65, 0x64, 0x20,
+  0x77, 0x69, 0x74, 0x68, 0x20, 0x46, 0x4e, 0x56, 0x2d, 0x31, 0x61, 0x20,
+  0x28, 0x73, 0x65, 0x65, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x2e, 0x63,
+  0x29, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x69,
+  0x6c, 0x65, 0x72, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x63, 0x6f, 0x6d, 0x70,
+  0x75, 0x74, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x68, 0x61, 0x73,
+  0x68, 0x65, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x63, 0x6f, 0x6e, 0x73, 0x74,
+  0x61, 0x6e, 0x74, 0x20, 0x72, 0x75, 0x6c, 0x65, 0x20, 0x6c, 0x69, 0x73,
+  0x74, 0x73, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x61,
+  0x6d, 0x65, 0x20, 0x77, 0x61, 0x79, 0x2c, 0x20, 0x73, 0x6f, 0x20, 0x74,
+  0x68, 0x61, 0x74, 0x20, 0x74, 0x68, 0x65, 0x20, 0x0a, 0x20, 0x2a, 0x20,
+  0x6d, 0x61, 0x74, 0x63, 0x68, 0x69, 0x6e, 0x67, 0x20, 0x63, 0x6f, 0x64,
+  0x65, 0x20, 0x63, 0x61, 0x6e, 0x20, 0x72, 0x65, 0x6a, 0x65, 0x63, 0x74,
+  0x20, 0x6d, 0x6f, 0x73, 0x74, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x20, 0x6c,
+  0x69, 0x73, 0x74, 0x73, 0x20, 0x62, 0x79, 0x20, 0x63, 0x6f, 0x6d, 0x70,
+  0x61, 0x72, 0x69, 0x6e, 0x67, 0x20, 0x68, 0x61, 0x73, 0x68, 0x65, 0x73,
+  0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x23, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65,
+  0x20, 0x46, 0x4e, 0x56, 0x5f, 0x4f, 0x46, 0x46, 0x53, 0x45, 0x54, 0x5f,
+  0x42, 0x41, 0x53, 0x49, 0x53, 0x20, 0x32, 0x31, 0x36, 0x36, 0x31, 0x33,
+  0x36, 0x32, 0x36, 0x31, 0x75, 0x0a, 0x23, 0x64, 0x65, 0x66, 0x69, 0x6e,
+  0x65, 0x20, 0x46, 0x4e, 0x56, 0x5f, 0x53, 0x54, 0x45, 0x50, 0x28, 0x68,
+  0x61, 0x73, 0x68, 0x2c, 0x20, 0x62, 0x79, 0x74, 0x65, 0x29, 0x20, 0x28,
+  0x28, 0x28, 0x68, 0x61, 0x73, 0x68, 0x29, 0x20, 0x5e, 0x20, 0x28, 0x75,
+  0x6e, 0x73, 0x69, 0x67, 0x6e, 0x65, 0x64, 0x20, 0x63, 0x68, 0x61, 0x72,
+  0x29, 0x28, 0x62, 0x79, 0x74, 0x65, 0x29, 0x29, 0x20, 0x2a, 0x20, 0x31,
+  0x36, 0x37, 0x37, 0x37, 0x36, 0x31, 0x39, 0x75, 0x29, 0x0a, 0x0a, 0x74,
   0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x65, 0x6e, 0x75, 0x6d, 0x20,
-  0x7b, 0x4e, 0x4f, 0x4e, 0x45, 0x20, 0x3d, 0x20, 0x30, 0x2c, 0x20, 0x52,
-  0x45, 0x44, 0x2c, 0x20, 0x47, 0x52, 0x45, 0x45, 0x4e, 0x2c, 0x20, 0x42,
-  0x4c, 0x55, 0x45, 0x2c, 0x20, 0x47, 0x52, 0x45, 0x59, 0x2c, 0x20, 0x44,
-  0x41, 0x53, 0x48, 0x45, 0x44, 0x2c, 0x20, 0x41, 0x4e, 0x59, 0x7d, 0x20,
-  0x4d, 0x61, 0x72, 0x6b, 0x54, 0x79, 0x70, 0x65, 0x3b, 0x20, 0x0a, 0x0a,
-  0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x65, 0x6e, 0x75, 0x6d,
-  0x20, 0x7b, 0x49, 0x4e, 0x54, 0x5f, 0x43, 0x48, 0x45, 0x43, 0x4b, 0x20,
-  0x3d, 0x20, 0x30, 0x2c, 0x20, 0x43, 0x48, 0x41, 0x52, 0x5f, 0x43, 0x48,
-  0x45, 0x43, 0x4b, 0x2c, 0x20, 0x53, 0x54, 0x52, 0x49, 0x4e, 0x47, 0x5f,
-  0x43, 0x48, 0x45, 0x43, 0x4b, 0x2c, 0x20, 0x41, 0x54, 0x4f, 0x4d, 0x5f,
-  0x43, 0x48, 0x45, 0x43, 0x4b, 0x2c, 0x20, 0x45, 0x44, 0x47, 0x45, 0x5f,
-  0x50, 0x52, 0x45, 0x44, 0x2c, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x45, 0x51, 0x55, 0x41,
-  0x4c, 0x2c, 0x20, 0x4e, 0x4f, 0x54, 0x5f, 0x45, 0x51, 0x55, 0x41, 0x4c,
-  0x2c, 0x20, 0x47, 0x52, 0x45, 0x41, 0x54, 0x45, 0x52, 0x2c, 0x20, 0x47,
-  0x52, 0x45, 0x41, 0x54, 0x45, 0x52, 0x5f, 0x45, 0x51, 0x55, 0x41, 0x4c,
-  0x2c, 0x20, 0x4c, 0x45, 0x53, 0x53, 0x2c, 0x20, 0x4c, 0x45, 0x53, 0x53,
-  0x5f, 0x45, 0x51, 0x55, 0x41, 0x4c, 0x2c, 0x20, 0x0a, 0x09, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x42, 0x4f, 0x4f, 0x4c, 0x5f, 0x4e, 0x4f, 0x54,
-  0x2c, 0x20, 0x42, 0x4f, 0x4f, 0x4c, 0x5f, 0x4f, 0x52, 0x2c, 0x20, 0x42,
-  0x4f, 0x4f, 0x4c, 0x5f, 0x41, 0x4e, 0x44, 0x20, 0x7d, 0x20, 0x43, 0x6f,
-  0x6e, 0x64, 0x69, 0x74, 0x69, 0x6f, 0x6e, 0x54, 0x79, 0x70, 0x65, 0x3b,
-  0x0a, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x65, 0x6e,
-  0x75, 0x6d, 0x20, 0x7b, 0x49, 0x4e, 0x54, 0x45, 0x47, 0x45, 0x52, 0x5f,
-  0x43, 0x4f, 0x4e, 0x53, 0x54, 0x41, 0x4e, 0x54, 0x20, 0x3d, 0x20, 0x30,
-  0x2c, 0x20, 0x53, 0x54, 0x52, 0x49, 0x4e, 0x47, 0x5f, 0x43, 0x4f, 0x4e,
-  0x53, 0x54, 0x41, 0x4e, 0x54, 0x2c, 0x20, 0x56, 0x41, 0x52, 0x49, 0x41,
-  0x42, 0x4c, 0x45, 0x2c, 0x20, 0x4c, 0x45, 0x4e, 0x47, 0x54, 0x48, 0x2c,
-  0x20, 0x49, 0x4e, 0x44, 0x45, 0x47, 0x52, 0x45, 0x45, 0x2c, 0x0a, 0x20,
+  0x7b, 0x49, 0x4e, 0x54, 0x5f, 0x43, 0x48, 0x45, 0x43, 0x4b, 0x20, 0x3d,
+  0x20, 0x30, 0x2c, 0x20, 0x43, 0x48, 0x41, 0x52, 0x5f, 0x43, 0x48, 0x45,
+  0x43, 0x4b, 0x2c, 0x20, 0x53, 0x54, 0x52, 0x49, 0x4e, 0x47, 0x5f, 0x43,
+  0x48, 0x45, 0x43, 0x4b, 0x2c, 0x20, 0x41, 0x54, 0x4f, 0x4d, 0x5f, 0x43,
+  0x48, 0x45, 0x43, 0x4b, 0x2c, 0x20, 0x45, 0x44, 0x47, 0x45, 0x5f, 0x50,
+  0x52, 0x45, 0x44, 0x2c, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x45, 0x51, 0x55, 0x41, 0x4c,
+  0x2c, 0x20, 0x4e, 0x4f, 0x54, 0x5f, 0x45, 0x51, 0x55, 0x41, 0x4c, 0x2c,
+  0x20, 0x47, 0x52, 0x45, 0x41, 0x54, 0x45, 0x52, 0x2c, 0x20, 0x47, 0x52,
+  0x45, 0x41, 0x54, 0x45, 0x52, 0x5f, 0x45, 0x51, 0x55, 0x41, 0x4c, 0x2c,
+  0x20, 0x4c, 0x45, 0x53, 0x53, 0x2c, 0x20, 0x4c, 0x45, 0x53, 0x53, 0x5f,
+  0x45, 0x51, 0x55, 0x41, 0x4c, 0x2c, 0x20, 0x0a, 0x09, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x42, 0x4f, 0x4f, 0x4c, 0x5f, 0x4e, 0x4f, 0x54, 0x2c,
+  0x20, 0x42, 0x4f, 0x4f, 0x4c, 0x5f, 0x4f, 0x52, 0x2c, 0x20, 0x42, 0x4f,
+  0x4f, 0x4c, 0x5f, 0x41, 0x4e, 0x44, 0x20, 0x7d, 0x20, 0x43, 0x6f, 0x6e,
+  0x64, 0x69, 0x74, 0x69, 0x6f, 0x6e, 0x54, 0x79, 0x70, 0x65, 0x3b, 0x0a,
+  0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x65, 0x6e, 0x75,
+  0x6d, 0x20, 0x7b, 0x49, 0x4e, 0x54, 0x45, 0x47, 0x45, 0x52, 0x5f, 0x43,
+  0x4f, 0x4e, 0x53, 0x54, 0x41, 0x4e, 0x54, 0x20, 0x3d, 0x20, 0x30, 0x2c,
+  0x20, 0x53, 0x54, 0x52, 0x49, 0x4e, 0x47, 0x5f, 0x43, 0x4f, 0x4e, 0x53,
+  0x54, 0x41, 0x4e, 0x54, 0x2c, 0x20, 0x56, 0x41, 0x52, 0x49, 0x41, 0x42,
+  0x4c, 0x45, 0x2c, 0x20, 0x4c, 0x45, 0x4e, 0x47, 0x54, 0x48, 0x2c, 0x20,
+  0x49, 0x4e, 0x44, 0x45, 0x47, 0x52, 0x45, 0x45, 0x2c, 0x0a, 0x20, 0x20,
   0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x4f, 0x55, 0x54, 0x44, 0x45, 0x47, 0x52, 0x45, 0x45, 0x2c, 0x20,
-  0x4e, 0x45, 0x47, 0x2c, 0x20, 0x41, 0x44, 0x44, 0x2c, 0x20, 0x53, 0x55,
-  0x42, 0x54, 0x52, 0x41, 0x43, 0x54, 0x2c, 0x20, 0x4d, 0x55, 0x4c, 0x54,
-  0x49, 0x50, 0x4c, 0x59, 0x2c, 0x20, 0x44, 0x49, 0x56, 0x49, 0x44, 0x45,
-  0x2c, 0x20, 0x43, 0x4f, 0x4e, 0x43, 0x41, 0x54, 0x7d, 0x20, 0x41, 0x74,
-  0x6f, 0x6d, 0x54, 0x79, 0x70, 0x65, 0x3b, 0x0a, 0x0a, 0x23, 0x65, 0x6e,
-  0x64, 0x69, 0x66, 0x20, 0x2f, 0x2a, 0x20, 0x49, 0x4e, 0x43, 0x5f, 0x47,
-  0x4c, 0x4f, 0x42, 0x41, 0x4c, 0x53, 0x5f, 0x48, 0x20, 0x2a, 0x2f, 0x0a,
-  0x00
+  0x4f, 0x55, 0x54, 0x44, 0x45, 0x47, 0x52, 0x45, 0x45, 0x2c, 0x20, 0x4e,
+  0x45, 0x47, 0x2c, 0x20, 0x41, 0x44, 0x44, 0x2c, 0x20, 0x53, 0x55, 0x42,
+  0x54, 0x52, 0x41, 0x43, 0x54, 0x2c, 0x20, 0x4d, 0x55, 0x4c, 0x54, 0x49,
+  0x50, 0x4c, 0x59, 0x2c, 0x20, 0x44, 0x49, 0x56, 0x49, 0x44, 0x45, 0x2c,
+  0x20, 0x43, 0x4f, 0x4e, 0x43, 0x41, 0x54, 0x7d, 0x20, 0x41, 0x74, 0x6f,
+  0x6d, 0x54, 0x79, 0x70, 0x65, 0x3b, 0x0a, 0x0a, 0x23, 0x65, 0x6e, 0x64,
+  0x69, 0x66, 0x20, 0x2f, 0x2a, 0x20, 0x49, 0x4e, 0x43, 0x5f, 0x47, 0x4c,
+  0x4f, 0x42, 0x41, 0x4c, 0x53, 0x5f, 0x48, 0x20, 0x2a, 0x2f, 0x0a, 0x00
 };
-unsigned int globals_h_len = 3169;
+unsigned int globals_h_len = 4643;
 
 unsigned char debug_h[] = {
   0x2f, 0x2a, 0x20, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
@@ -443,347 +565,1673 @@ unsigned char graph_h[] = {
   0x6e, 0x74, 0x41, 0x72, 0x72, 0x61, 0x79, 0x28, 0x49, 0x6e, 0x74, 0x41,
   0x72, 0x72, 0x61, 0x79, 0x20, 0x2a, 0x61, 0x72, 0x72, 0x61, 0x79, 0x2c,
   0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b,
-  0x0a, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x73, 0x74,
-  0x72, 0x75, 0x63, 0x74, 0x20, 0x4e, 0x6f, 0x64, 0x65, 0x41, 0x72, 0x72,
-  0x61, 0x79, 0x20, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20,
-  0x63, 0x61, 0x70, 0x61, 0x63, 0x69, 0x74, 0x79, 0x3b, 0x0a, 0x20, 0x20,
-  0x20, 0x69, 0x6e, 0x74, 0x20, 0x73, 0x69, 0x7a, 0x65, 0x3b, 0x0a, 0x20,
-  0x20, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x4e, 0x6f, 0x64,
-  0x65, 0x20, 0x2a, 0x69, 0x74, 0x65, 0x6d, 0x73, 0x3b, 0x0a, 0x20, 0x20,
-  0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x49, 0x6e, 0x74, 0x41,
-  0x72, 0x72, 0x61, 0x79, 0x20, 0x68, 0x6f, 0x6c, 0x65, 0x73, 0x3b, 0x0a,
-  0x7d, 0x20, 0x4e, 0x6f, 0x64, 0x65, 0x41, 0x72, 0x72, 0x61, 0x79, 0x3b,
-  0x0a, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x73, 0x74,
-  0x72, 0x75, 0x63, 0x74, 0x20, 0x45, 0x64, 0x67, 0x65, 0x41, 0x72, 0x72,
-  0x61, 0x79, 0x20, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20,
-  0x63, 0x61, 0x70, 0x61, 0x63, 0x69, 0x74, 0x79, 0x3b, 0x0a, 0x20, 0x20,
-  0x20, 0x69, 0x6e, 0x74, 0x20, 0x73, 0x69, 0x7a, 0x65, 0x3b, 0x0a, 0x20,
-  0x20, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x45, 0x64, 0x67,
-  0x65, 0x20, 0x2a, 0x69, 0x74, 0x65, 0x6d, 0x73, 0x3b, 0x0a, 0x20, 0x20,
-  0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x49, 0x6e, 0x74, 0x41,
-  0x72, 0x72, 0x61, 0x79, 0x20, 0x68, 0x6f, 0x6c, 0x65, 0x73, 0x3b, 0x0a,
-  0x7d, 0x20, 0x45, 0x64, 0x67, 0x65, 0x41, 0x72, 0x72, 0x61, 0x79, 0x3b,
-  0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d,
+  0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6e, 0x75, 0x6d,
+  0x62, 0x65, 0x72, 0x20, 0x6f, 0x66, 0x20, 0x69, 0x6e, 0x63, 0x69, 0x64,
+  0x65, 0x6e, 0x74, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x20, 0x6f, 0x66,
+  0x20, 0x65, 0x61, 0x63, 0x68, 0x20, 0x64, 0x69, 0x72, 0x65, 0x63, 0x74,
+  0x69, 0x6f, 0x6e, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x64, 0x20, 0x69,
+  0x6e, 0x73, 0x69, 0x64, 0x65, 0x20, 0x61, 0x20, 0x6e, 0x6f, 0x64, 0x65,
+  0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x23, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65,
+  0x20, 0x49, 0x4e, 0x4c, 0x49, 0x4e, 0x45, 0x5f, 0x45, 0x44, 0x47, 0x45,
+  0x53, 0x20, 0x34, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20,
+  0x69, 0x6e, 0x64, 0x69, 0x63, 0x65, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x61,
+  0x20, 0x6e, 0x6f, 0x64, 0x65, 0x27, 0x73, 0x20, 0x6f, 0x75, 0x74, 0x67,
+  0x6f, 0x69, 0x6e, 0x67, 0x20, 0x6f, 0x72, 0x20, 0x69, 0x6e, 0x63, 0x6f,
+  0x6d, 0x69, 0x6e, 0x67, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x2e, 0x20,
+  0x54, 0x68, 0x65, 0x20, 0x6e, 0x75, 0x6d, 0x62, 0x65, 0x72, 0x20, 0x6f,
+  0x66, 0x20, 0x69, 0x6e, 0x64, 0x69, 0x63, 0x65, 0x73, 0x20, 0x69, 0x73,
+  0x0a, 0x20, 0x2a, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65,
+  0x27, 0x73, 0x20, 0x6f, 0x75, 0x74, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65,
+  0x20, 0x6f, 0x72, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65,
+  0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x69, 0x6e, 0x64, 0x69, 0x63, 0x65,
+  0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x64,
+  0x20, 0x63, 0x6f, 0x6e, 0x74, 0x69, 0x67, 0x75, 0x6f, 0x75, 0x73, 0x6c,
+  0x79, 0x20, 0x69, 0x6e, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x69, 0x74, 0x65,
+  0x6d, 0x73, 0x20, 0x77, 0x68, 0x69, 0x6c, 0x65, 0x20, 0x74, 0x68, 0x65,
+  0x79, 0x20, 0x66, 0x69, 0x74, 0x2e, 0x20, 0x57, 0x68, 0x65, 0x6e, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x20, 0x67,
+  0x72, 0x6f, 0x77, 0x73, 0x20, 0x70, 0x61, 0x73, 0x74, 0x20, 0x49, 0x4e,
+  0x4c, 0x49, 0x4e, 0x45, 0x5f, 0x45, 0x44, 0x47, 0x45, 0x53, 0x2c, 0x20,
+  0x61, 0x6c, 0x6c, 0x20, 0x74, 0x68, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x69,
+  0x6e, 0x64, 0x69, 0x63, 0x65, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x6d,
+  0x6f, 0x76, 0x65, 0x64, 0x20, 0x74, 0x6f, 0x20, 0x61, 0x6e, 0x20, 0x6f,
+  0x76, 0x65, 0x72, 0x66, 0x6c, 0x6f, 0x77, 0x20, 0x62, 0x6c, 0x6f, 0x63,
+  0x6b, 0x20, 0x74, 0x61, 0x6b, 0x65, 0x6e, 0x20, 0x66, 0x72, 0x6f, 0x6d,
+  0x20, 0x61, 0x20, 0x70, 0x6f, 0x6f, 0x6c, 0x20, 0x6f, 0x66, 0x20, 0x65,
+  0x64, 0x67, 0x65, 0x20, 0x62, 0x6c, 0x6f, 0x63, 0x6b, 0x73, 0x2e, 0x0a,
+  0x20, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6f, 0x76, 0x65, 0x72, 0x66,
+  0x6c, 0x6f, 0x77, 0x20, 0x62, 0x6c, 0x6f, 0x63, 0x6b, 0x20, 0x69, 0x73,
+  0x20, 0x6b, 0x65, 0x70, 0x74, 0x20, 0x75, 0x6e, 0x74, 0x69, 0x6c, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x69, 0x73, 0x20,
+  0x72, 0x65, 0x6d, 0x6f, 0x76, 0x65, 0x64, 0x2e, 0x20, 0x2a, 0x2f, 0x0a,
+  0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x73, 0x74, 0x72, 0x75,
+  0x63, 0x74, 0x20, 0x49, 0x6e, 0x63, 0x69, 0x64, 0x65, 0x6e, 0x74, 0x45,
+  0x64, 0x67, 0x65, 0x73, 0x20, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e,
+  0x74, 0x20, 0x69, 0x74, 0x65, 0x6d, 0x73, 0x5b, 0x49, 0x4e, 0x4c, 0x49,
+  0x4e, 0x45, 0x5f, 0x45, 0x44, 0x47, 0x45, 0x53, 0x5d, 0x3b, 0x0a, 0x20,
+  0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x2a, 0x6f, 0x76, 0x65, 0x72, 0x66,
+  0x6c, 0x6f, 0x77, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20,
+  0x63, 0x61, 0x70, 0x61, 0x63, 0x69, 0x74, 0x79, 0x3b, 0x0a, 0x7d, 0x20,
+  0x49, 0x6e, 0x63, 0x69, 0x64, 0x65, 0x6e, 0x74, 0x45, 0x64, 0x67, 0x65,
+  0x73, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x52, 0x65, 0x74, 0x75, 0x72,
+  0x6e, 0x73, 0x20, 0x61, 0x20, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x65, 0x72,
+  0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x63, 0x6f, 0x6e, 0x74,
+  0x69, 0x67, 0x75, 0x6f, 0x75, 0x73, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79,
+  0x20, 0x6f, 0x66, 0x20, 0x69, 0x6e, 0x64, 0x69, 0x63, 0x65, 0x73, 0x20,
+  0x6f, 0x66, 0x20, 0x61, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x27, 0x73, 0x20,
+  0x6f, 0x75, 0x74, 0x67, 0x6f, 0x69, 0x6e, 0x67, 0x0a, 0x20, 0x2a, 0x20,
+  0x6f, 0x72, 0x20, 0x69, 0x6e, 0x63, 0x6f, 0x6d, 0x69, 0x6e, 0x67, 0x20,
+  0x65, 0x64, 0x67, 0x65, 0x73, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x23, 0x64,
+  0x65, 0x66, 0x69, 0x6e, 0x65, 0x20, 0x6f, 0x75, 0x74, 0x45, 0x64, 0x67,
+  0x65, 0x49, 0x6e, 0x64, 0x69, 0x63, 0x65, 0x73, 0x28, 0x6e, 0x6f, 0x64,
+  0x65, 0x29, 0x20, 0x5c, 0x0a, 0x20, 0x20, 0x20, 0x28, 0x28, 0x6e, 0x6f,
+  0x64, 0x65, 0x29, 0x2d, 0x3e, 0x6f, 0x75, 0x74, 0x5f, 0x65, 0x64, 0x67,
+  0x65, 0x73, 0x2e, 0x6f, 0x76, 0x65, 0x72, 0x66, 0x6c, 0x6f, 0x77, 0x20,
+  0x3d, 0x3d, 0x20, 0x4e, 0x55, 0x4c, 0x4c, 0x20, 0x3f, 0x20, 0x28, 0x6e,
+  0x6f, 0x64, 0x65, 0x29, 0x2d, 0x3e, 0x6f, 0x75, 0x74, 0x5f, 0x65, 0x64,
+  0x67, 0x65, 0x73, 0x2e, 0x69, 0x74, 0x65, 0x6d, 0x73, 0x20, 0x3a, 0x20,
+  0x28, 0x6e, 0x6f, 0x64, 0x65, 0x29, 0x2d, 0x3e, 0x6f, 0x75, 0x74, 0x5f,
+  0x65, 0x64, 0x67, 0x65, 0x73, 0x2e, 0x6f, 0x76, 0x65, 0x72, 0x66, 0x6c,
+  0x6f, 0x77, 0x29, 0x0a, 0x23, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x20,
+  0x69, 0x6e, 0x45, 0x64, 0x67, 0x65, 0x49, 0x6e, 0x64, 0x69, 0x63, 0x65,
+  0x73, 0x28, 0x6e, 0x6f, 0x64, 0x65, 0x29, 0x20, 0x5c, 0x0a, 0x20, 0x20,
+  0x20, 0x28, 0x28, 0x6e, 0x6f, 0x64, 0x65, 0x29, 0x2d, 0x3e, 0x69, 0x6e,
+  0x5f, 0x65, 0x64, 0x67, 0x65, 0x73, 0x2e, 0x6f, 0x76, 0x65, 0x72, 0x66,
+  0x6c, 0x6f, 0x77, 0x20, 0x3d, 0x3d, 0x20, 0x4e, 0x55, 0x4c, 0x4c, 0x20,
+  0x3f, 0x20, 0x28, 0x6e, 0x6f, 0x64, 0x65, 0x29, 0x2d, 0x3e, 0x69, 0x6e,
+  0x5f, 0x65, 0x64, 0x67, 0x65, 0x73, 0x2e, 0x69, 0x74, 0x65, 0x6d, 0x73,
+  0x20, 0x3a, 0x20, 0x28, 0x6e, 0x6f, 0x64, 0x65, 0x29, 0x2d, 0x3e, 0x69,
+  0x6e, 0x5f, 0x65, 0x64, 0x67, 0x65, 0x73, 0x2e, 0x6f, 0x76, 0x65, 0x72,
+  0x66, 0x6c, 0x6f, 0x77, 0x29, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x4c, 0x6f,
+  0x6f, 0x70, 0x73, 0x20, 0x6f, 0x76, 0x65, 0x72, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x69, 0x6e, 0x64, 0x69, 0x63, 0x65, 0x73, 0x20, 0x6f, 0x66, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x6f, 0x75, 0x74, 0x67, 0x6f, 0x69, 0x6e, 0x67,
+  0x20, 0x6f, 0x72, 0x20, 0x69, 0x6e, 0x63, 0x6f, 0x6d, 0x69, 0x6e, 0x67,
+  0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x20,
+  0x6e, 0x6f, 0x64, 0x65, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x0a, 0x20, 0x2a,
+  0x20, 0x6c, 0x6f, 0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x6f, 0x66,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x61,
+  0x72, 0x72, 0x61, 0x79, 0x20, 0x69, 0x73, 0x20, 0x6c, 0x6f, 0x6f, 0x6b,
+  0x65, 0x64, 0x20, 0x75, 0x70, 0x20, 0x6f, 0x6e, 0x63, 0x65, 0x2c, 0x20,
+  0x62, 0x65, 0x66, 0x6f, 0x72, 0x65, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6c,
+  0x6f, 0x6f, 0x70, 0x2c, 0x20, 0x73, 0x6f, 0x20, 0x74, 0x68, 0x61, 0x74,
+  0x20, 0x74, 0x68, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x6c, 0x6f, 0x6f, 0x70,
+  0x20, 0x62, 0x6f, 0x64, 0x79, 0x20, 0x69, 0x73, 0x20, 0x61, 0x20, 0x70,
+  0x6c, 0x61, 0x69, 0x6e, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x20, 0x72,
+  0x65, 0x61, 0x64, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64,
+  0x65, 0x27, 0x73, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x20, 0x6d, 0x75,
+  0x73, 0x74, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x62, 0x65, 0x20, 0x61, 0x64,
+  0x64, 0x65, 0x64, 0x20, 0x6f, 0x72, 0x0a, 0x20, 0x2a, 0x20, 0x72, 0x65,
+  0x6d, 0x6f, 0x76, 0x65, 0x64, 0x20, 0x69, 0x6e, 0x73, 0x69, 0x64, 0x65,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x6f, 0x6f, 0x70, 0x2e, 0x20, 0x55,
+  0x73, 0x61, 0x67, 0x65, 0x3a, 0x0a, 0x20, 0x2a, 0x20, 0x69, 0x6e, 0x74,
+  0x20, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x65, 0x72, 0x2c, 0x20, 0x2a, 0x65,
+  0x64, 0x67, 0x65, 0x73, 0x3b, 0x0a, 0x20, 0x2a, 0x20, 0x66, 0x6f, 0x72,
+  0x45, 0x61, 0x63, 0x68, 0x4f, 0x75, 0x74, 0x45, 0x64, 0x67, 0x65, 0x28,
+  0x6e, 0x6f, 0x64, 0x65, 0x2c, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x2c,
+  0x20, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x65, 0x72, 0x29, 0x20, 0x7b, 0x20,
+  0x45, 0x64, 0x67, 0x65, 0x20, 0x2a, 0x65, 0x64, 0x67, 0x65, 0x20, 0x3d,
+  0x20, 0x67, 0x65, 0x74, 0x45, 0x64, 0x67, 0x65, 0x28, 0x67, 0x2c, 0x20,
+  0x65, 0x64, 0x67, 0x65, 0x73, 0x5b, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x65,
+  0x72, 0x5d, 0x29, 0x3b, 0x20, 0x7d, 0x20, 0x2a, 0x2f, 0x0a, 0x23, 0x64,
+  0x65, 0x66, 0x69, 0x6e, 0x65, 0x20, 0x66, 0x6f, 0x72, 0x45, 0x61, 0x63,
+  0x68, 0x4f, 0x75, 0x74, 0x45, 0x64, 0x67, 0x65, 0x28, 0x6e, 0x6f, 0x64,
+  0x65, 0x2c, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x2c, 0x20, 0x63, 0x6f,
+  0x75, 0x6e, 0x74, 0x65, 0x72, 0x29, 0x20, 0x5c, 0x0a, 0x20, 0x20, 0x20,
+  0x66, 0x6f, 0x72, 0x28, 0x28, 0x65, 0x64, 0x67, 0x65, 0x73, 0x29, 0x20,
+  0x3d, 0x20, 0x6f, 0x75, 0x74, 0x45, 0x64, 0x67, 0x65, 0x49, 0x6e, 0x64,
+  0x69, 0x63, 0x65, 0x73, 0x28, 0x6e, 0x6f, 0x64, 0x65, 0x29, 0x2c, 0x20,
+  0x28, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x65, 0x72, 0x29, 0x20, 0x3d, 0x20,
+  0x30, 0x3b, 0x20, 0x28, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x65, 0x72, 0x29,
+  0x20, 0x3c, 0x20, 0x28, 0x6e, 0x6f, 0x64, 0x65, 0x29, 0x2d, 0x3e, 0x6f,
+  0x75, 0x74, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x3b, 0x20, 0x28, 0x63,
+  0x6f, 0x75, 0x6e, 0x74, 0x65, 0x72, 0x29, 0x2b, 0x2b, 0x29, 0x0a, 0x23,
+  0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x20, 0x66, 0x6f, 0x72, 0x45, 0x61,
+  0x63, 0x68, 0x49, 0x6e, 0x45, 0x64, 0x67, 0x65, 0x28, 0x6e, 0x6f, 0x64,
+  0x65, 0x2c, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x2c, 0x20, 0x63, 0x6f,
+  0x75, 0x6e, 0x74, 0x65, 0x72, 0x29, 0x20, 0x5c, 0x0a, 0x20, 0x20, 0x20,
+  0x66, 0x6f, 0x72, 0x28, 0x28, 0x65, 0x64, 0x67, 0x65, 0x73, 0x29, 0x20,
+  0x3d, 0x20, 0x69, 0x6e, 0x45, 0x64, 0x67, 0x65, 0x49, 0x6e, 0x64, 0x69,
+  0x63, 0x65, 0x73, 0x28, 0x6e, 0x6f, 0x64, 0x65, 0x29, 0x2c, 0x20, 0x28,
+  0x63, 0x6f, 0x75, 0x6e, 0x74, 0x65, 0x72, 0x29, 0x20, 0x3d, 0x20, 0x30,
+  0x3b, 0x20, 0x28, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x65, 0x72, 0x29, 0x20,
+  0x3c, 0x20, 0x28, 0x6e, 0x6f, 0x64, 0x65, 0x29, 0x2d, 0x3e, 0x69, 0x6e,
+  0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x3b, 0x20, 0x28, 0x63, 0x6f, 0x75,
+  0x6e, 0x74, 0x65, 0x72, 0x29, 0x2b, 0x2b, 0x29, 0x0a, 0x0a, 0x2f, 0x2a,
+  0x20, 0x54, 0x68, 0x65, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x20, 0x62,
+  0x65, 0x74, 0x77, 0x65, 0x65, 0x6e, 0x20, 0x74, 0x77, 0x6f, 0x20, 0x6e,
+  0x6f, 0x64, 0x65, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x6c, 0x6f, 0x6f,
+  0x6b, 0x65, 0x64, 0x20, 0x75, 0x70, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x65, 0x64, 0x67, 0x65, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78,
+  0x20, 0x6f, 0x6e, 0x6c, 0x79, 0x20, 0x69, 0x66, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x6e, 0x6f, 0x64, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x77, 0x68, 0x6f,
+  0x73, 0x65, 0x20, 0x69, 0x6e, 0x63, 0x69, 0x64, 0x65, 0x6e, 0x74, 0x20,
+  0x65, 0x64, 0x67, 0x65, 0x73, 0x20, 0x77, 0x6f, 0x75, 0x6c, 0x64, 0x20,
+  0x6f, 0x74, 0x68, 0x65, 0x72, 0x77, 0x69, 0x73, 0x65, 0x20, 0x62, 0x65,
+  0x20, 0x77, 0x61, 0x6c, 0x6b, 0x65, 0x64, 0x20, 0x68, 0x61, 0x73, 0x20,
+  0x6d, 0x6f, 0x72, 0x65, 0x20, 0x74, 0x68, 0x61, 0x6e, 0x20, 0x74, 0x68,
+  0x69, 0x73, 0x20, 0x6e, 0x75, 0x6d, 0x62, 0x65, 0x72, 0x20, 0x6f, 0x66,
+  0x0a, 0x20, 0x2a, 0x20, 0x74, 0x68, 0x65, 0x6d, 0x2e, 0x20, 0x54, 0x68,
+  0x65, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x69, 0x73, 0x20, 0x6e,
+  0x6f, 0x74, 0x20, 0x62, 0x75, 0x69, 0x6c, 0x74, 0x20, 0x66, 0x6f, 0x72,
+  0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x73, 0x20, 0x77, 0x69, 0x74, 0x68,
+  0x6f, 0x75, 0x74, 0x20, 0x73, 0x75, 0x63, 0x68, 0x20, 0x6e, 0x6f, 0x64,
+  0x65, 0x73, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x23, 0x64, 0x65, 0x66, 0x69,
+  0x6e, 0x65, 0x20, 0x45, 0x44, 0x47, 0x45, 0x5f, 0x49, 0x4e, 0x44, 0x45,
+  0x58, 0x5f, 0x4d, 0x49, 0x4e, 0x5f, 0x44, 0x45, 0x47, 0x52, 0x45, 0x45,
+  0x20, 0x38, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x4c, 0x6f, 0x6f, 0x70, 0x73,
+  0x20, 0x6f, 0x76, 0x65, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x6e,
+  0x64, 0x69, 0x63, 0x65, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x6f, 0x75, 0x74, 0x67, 0x6f, 0x69, 0x6e, 0x67, 0x20, 0x65, 0x64,
+  0x67, 0x65, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x20, 0x6e, 0x6f, 0x64,
+  0x65, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x67, 0x6f, 0x20, 0x74, 0x6f,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x0a, 0x20,
+  0x2a, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78,
+  0x20, 0x74, 0x61, 0x72, 0x67, 0x65, 0x74, 0x2c, 0x20, 0x6f, 0x72, 0x20,
+  0x6f, 0x66, 0x20, 0x61, 0x6c, 0x6c, 0x20, 0x69, 0x74, 0x73, 0x20, 0x6f,
+  0x75, 0x74, 0x67, 0x6f, 0x69, 0x6e, 0x67, 0x20, 0x65, 0x64, 0x67, 0x65,
+  0x73, 0x20, 0x69, 0x66, 0x20, 0x74, 0x61, 0x72, 0x67, 0x65, 0x74, 0x20,
+  0x69, 0x73, 0x20, 0x2d, 0x31, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6c,
+  0x6f, 0x6f, 0x70, 0x0a, 0x20, 0x2a, 0x20, 0x62, 0x6f, 0x64, 0x79, 0x20,
+  0x6d, 0x75, 0x73, 0x74, 0x20, 0x63, 0x68, 0x65, 0x63, 0x6b, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x74, 0x61, 0x72, 0x67, 0x65, 0x74, 0x20, 0x6f, 0x66,
+  0x20, 0x65, 0x61, 0x63, 0x68, 0x20, 0x65, 0x64, 0x67, 0x65, 0x3a, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x69, 0x6e, 0x64, 0x69, 0x63, 0x65, 0x73, 0x20,
+  0x61, 0x72, 0x65, 0x20, 0x74, 0x61, 0x6b, 0x65, 0x6e, 0x20, 0x66, 0x72,
+  0x6f, 0x6d, 0x20, 0x74, 0x68, 0x65, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x65,
+  0x64, 0x67, 0x65, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x6f, 0x6e,
+  0x6c, 0x79, 0x20, 0x69, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f,
+  0x64, 0x65, 0x20, 0x68, 0x61, 0x73, 0x20, 0x6d, 0x6f, 0x72, 0x65, 0x20,
+  0x74, 0x68, 0x61, 0x6e, 0x20, 0x45, 0x44, 0x47, 0x45, 0x5f, 0x49, 0x4e,
+  0x44, 0x45, 0x58, 0x5f, 0x4d, 0x49, 0x4e, 0x5f, 0x44, 0x45, 0x47, 0x52,
+  0x45, 0x45, 0x20, 0x6f, 0x75, 0x74, 0x67, 0x6f, 0x69, 0x6e, 0x67, 0x0a,
+  0x20, 0x2a, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x2c, 0x20, 0x61, 0x6e,
+  0x64, 0x20, 0x6f, 0x74, 0x68, 0x65, 0x72, 0x77, 0x69, 0x73, 0x65, 0x20,
+  0x61, 0x6c, 0x6c, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6f, 0x75, 0x74, 0x67,
+  0x6f, 0x69, 0x6e, 0x67, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x20, 0x61,
+  0x72, 0x65, 0x20, 0x77, 0x61, 0x6c, 0x6b, 0x65, 0x64, 0x2e, 0x20, 0x66,
+  0x6f, 0x72, 0x45, 0x61, 0x63, 0x68, 0x49, 0x6e, 0x45, 0x64, 0x67, 0x65,
+  0x46, 0x72, 0x6f, 0x6d, 0x0a, 0x20, 0x2a, 0x20, 0x64, 0x6f, 0x65, 0x73,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x61, 0x6d, 0x65, 0x20, 0x66, 0x6f,
+  0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x6e, 0x63, 0x6f, 0x6d, 0x69,
+  0x6e, 0x67, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x20, 0x66, 0x72, 0x6f,
+  0x6d, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x77,
+  0x69, 0x74, 0x68, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x73, 0x6f,
+  0x75, 0x72, 0x63, 0x65, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x0a, 0x20, 0x2a,
+  0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x6d, 0x75, 0x73, 0x74, 0x20,
+  0x6e, 0x6f, 0x74, 0x20, 0x62, 0x65, 0x20, 0x6d, 0x6f, 0x64, 0x69, 0x66,
+  0x69, 0x65, 0x64, 0x20, 0x69, 0x6e, 0x73, 0x69, 0x64, 0x65, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x6c, 0x6f, 0x6f, 0x70, 0x2e, 0x20, 0x55, 0x73, 0x61,
+  0x67, 0x65, 0x3a, 0x0a, 0x20, 0x2a, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x63,
+  0x6f, 0x75, 0x6e, 0x74, 0x65, 0x72, 0x2c, 0x20, 0x2a, 0x65, 0x64, 0x67,
+  0x65, 0x73, 0x2c, 0x20, 0x69, 0x74, 0x65, 0x6d, 0x3b, 0x0a, 0x20, 0x2a,
+  0x20, 0x66, 0x6f, 0x72, 0x45, 0x61, 0x63, 0x68, 0x4f, 0x75, 0x74, 0x45,
+  0x64, 0x67, 0x65, 0x54, 0x6f, 0x28, 0x67, 0x2c, 0x20, 0x6e, 0x6f, 0x64,
+  0x65, 0x2c, 0x20, 0x74, 0x2c, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x2c,
+  0x20, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x65, 0x72, 0x2c, 0x20, 0x69, 0x74,
+  0x65, 0x6d, 0x29, 0x20, 0x7b, 0x20, 0x45, 0x64, 0x67, 0x65, 0x20, 0x2a,
+  0x65, 0x20, 0x3d, 0x20, 0x67, 0x65, 0x74, 0x45, 0x64, 0x67, 0x65, 0x28,
+  0x67, 0x2c, 0x20, 0x69, 0x74, 0x65, 0x6d, 0x29, 0x3b, 0x20, 0x7d, 0x20,
+  0x2a, 0x2f, 0x0a, 0x23, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x20, 0x66,
+  0x6f, 0x72, 0x45, 0x61, 0x63, 0x68, 0x4f, 0x75, 0x74, 0x45, 0x64, 0x67,
+  0x65, 0x54, 0x6f, 0x28, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x6e,
+  0x6f, 0x64, 0x65, 0x2c, 0x20, 0x74, 0x61, 0x72, 0x67, 0x65, 0x74, 0x2c,
+  0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x2c, 0x20, 0x63, 0x6f, 0x75, 0x6e,
+  0x74, 0x65, 0x72, 0x2c, 0x20, 0x69, 0x74, 0x65, 0x6d, 0x29, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x5c, 0x0a, 0x20, 0x20, 0x20, 0x66, 0x6f, 0x72, 0x28, 0x28, 0x65, 0x64,
+  0x67, 0x65, 0x73, 0x29, 0x20, 0x3d, 0x20, 0x6f, 0x75, 0x74, 0x45, 0x64,
+  0x67, 0x65, 0x49, 0x6e, 0x64, 0x69, 0x63, 0x65, 0x73, 0x28, 0x6e, 0x6f,
+  0x64, 0x65, 0x29, 0x2c, 0x20, 0x28, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x65,
+  0x72, 0x29, 0x20, 0x3d, 0x20, 0x30, 0x2c, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x5c, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x28, 0x69,
+  0x74, 0x65, 0x6d, 0x29, 0x20, 0x3d, 0x20, 0x28, 0x74, 0x61, 0x72, 0x67,
+  0x65, 0x74, 0x29, 0x20, 0x3e, 0x3d, 0x20, 0x30, 0x20, 0x26, 0x26, 0x20,
+  0x28, 0x6e, 0x6f, 0x64, 0x65, 0x29, 0x2d, 0x3e, 0x6f, 0x75, 0x74, 0x64,
+  0x65, 0x67, 0x72, 0x65, 0x65, 0x20, 0x3e, 0x20, 0x45, 0x44, 0x47, 0x45,
+  0x5f, 0x49, 0x4e, 0x44, 0x45, 0x58, 0x5f, 0x4d, 0x49, 0x4e, 0x5f, 0x44,
+  0x45, 0x47, 0x52, 0x45, 0x45, 0x20, 0x3f, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x5c, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x67, 0x65, 0x74, 0x46,
+  0x69, 0x72, 0x73, 0x74, 0x45, 0x64, 0x67, 0x65, 0x42, 0x65, 0x74, 0x77,
+  0x65, 0x65, 0x6e, 0x28, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x28,
+  0x6e, 0x6f, 0x64, 0x65, 0x29, 0x2d, 0x3e, 0x69, 0x6e, 0x64, 0x65, 0x78,
+  0x2c, 0x20, 0x74, 0x61, 0x72, 0x67, 0x65, 0x74, 0x29, 0x20, 0x3a, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x5c, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x28, 0x28, 0x6e,
+  0x6f, 0x64, 0x65, 0x29, 0x2d, 0x3e, 0x6f, 0x75, 0x74, 0x64, 0x65, 0x67,
+  0x72, 0x65, 0x65, 0x20, 0x3e, 0x20, 0x30, 0x20, 0x3f, 0x20, 0x28, 0x65,
+  0x64, 0x67, 0x65, 0x73, 0x29, 0x5b, 0x30, 0x5d, 0x20, 0x3a, 0x20, 0x2d,
+  0x31, 0x29, 0x3b, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x5c, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x28, 0x69, 0x74, 0x65, 0x6d, 0x29, 0x20, 0x21, 0x3d, 0x20, 0x2d, 0x31,
+  0x3b, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x5c, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x28, 0x69, 0x74, 0x65, 0x6d, 0x29, 0x20, 0x3d, 0x20, 0x28, 0x74, 0x61,
+  0x72, 0x67, 0x65, 0x74, 0x29, 0x20, 0x3e, 0x3d, 0x20, 0x30, 0x20, 0x26,
+  0x26, 0x20, 0x28, 0x6e, 0x6f, 0x64, 0x65, 0x29, 0x2d, 0x3e, 0x6f, 0x75,
+  0x74, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x20, 0x3e, 0x20, 0x45, 0x44,
+  0x47, 0x45, 0x5f, 0x49, 0x4e, 0x44, 0x45, 0x58, 0x5f, 0x4d, 0x49, 0x4e,
+  0x5f, 0x44, 0x45, 0x47, 0x52, 0x45, 0x45, 0x20, 0x3f, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x5c, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x67, 0x65,
+  0x74, 0x4e, 0x65, 0x78, 0x74, 0x45, 0x64, 0x67, 0x65, 0x42, 0x65, 0x74,
+  0x77, 0x65, 0x65, 0x6e, 0x28, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20,
+  0x69, 0x74, 0x65, 0x6d, 0x29, 0x20, 0x3a, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x5c, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x28, 0x2b,
+  0x2b, 0x28, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x65, 0x72, 0x29, 0x20, 0x3c,
+  0x20, 0x28, 0x6e, 0x6f, 0x64, 0x65, 0x29, 0x2d, 0x3e, 0x6f, 0x75, 0x74,
+  0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x20, 0x3f, 0x20, 0x28, 0x65, 0x64,
+  0x67, 0x65, 0x73, 0x29, 0x5b, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x65, 0x72,
+  0x5d, 0x20, 0x3a, 0x20, 0x2d, 0x31, 0x29, 0x29, 0x0a, 0x23, 0x64, 0x65,
+  0x66, 0x69, 0x6e, 0x65, 0x20, 0x66, 0x6f, 0x72, 0x45, 0x61, 0x63, 0x68,
+  0x49, 0x6e, 0x45, 0x64, 0x67, 0x65, 0x46, 0x72, 0x6f, 0x6d, 0x28, 0x67,
+  0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x2c, 0x20,
+  0x73, 0x6f, 0x75, 0x72, 0x63, 0x65, 0x2c, 0x20, 0x65, 0x64, 0x67, 0x65,
+  0x73, 0x2c, 0x20, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x65, 0x72, 0x2c, 0x20,
+  0x69, 0x74, 0x65, 0x6d, 0x29, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x5c, 0x0a, 0x20, 0x20, 0x20, 0x66,
+  0x6f, 0x72, 0x28, 0x28, 0x65, 0x64, 0x67, 0x65, 0x73, 0x29, 0x20, 0x3d,
+  0x20, 0x69, 0x6e, 0x45, 0x64, 0x67, 0x65, 0x49, 0x6e, 0x64, 0x69, 0x63,
+  0x65, 0x73, 0x28, 0x6e, 0x6f, 0x64, 0x65, 0x29, 0x2c, 0x20, 0x28, 0x63,
+  0x6f, 0x75, 0x6e, 0x74, 0x65, 0x72, 0x29, 0x20, 0x3d, 0x20, 0x30, 0x2c,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x5c, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x28, 0x69, 0x74, 0x65, 0x6d, 0x29, 0x20, 0x3d,
+  0x20, 0x28, 0x73, 0x6f, 0x75, 0x72, 0x63, 0x65, 0x29, 0x20, 0x3e, 0x3d,
+  0x20, 0x30, 0x20, 0x26, 0x26, 0x20, 0x28, 0x6e, 0x6f, 0x64, 0x65, 0x29,
+  0x2d, 0x3e, 0x69, 0x6e, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x20, 0x3e,
+  0x20, 0x45, 0x44, 0x47, 0x45, 0x5f, 0x49, 0x4e, 0x44, 0x45, 0x58, 0x5f,
+  0x4d, 0x49, 0x4e, 0x5f, 0x44, 0x45, 0x47, 0x52, 0x45, 0x45, 0x20, 0x3f,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x5c, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x67, 0x65, 0x74, 0x46, 0x69, 0x72, 0x73, 0x74, 0x45, 0x64,
+  0x67, 0x65, 0x42, 0x65, 0x74, 0x77, 0x65, 0x65, 0x6e, 0x28, 0x67, 0x72,
+  0x61, 0x70, 0x68, 0x2c, 0x20, 0x73, 0x6f, 0x75, 0x72, 0x63, 0x65, 0x2c,
+  0x20, 0x28, 0x6e, 0x6f, 0x64, 0x65, 0x29, 0x2d, 0x3e, 0x69, 0x6e, 0x64,
+  0x65, 0x78, 0x29, 0x20, 0x3a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x5c, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x28, 0x28, 0x6e, 0x6f, 0x64, 0x65, 0x29, 0x2d, 0x3e,
+  0x69, 0x6e, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x20, 0x3e, 0x20, 0x30,
+  0x20, 0x3f, 0x20, 0x28, 0x65, 0x64, 0x67, 0x65, 0x73, 0x29, 0x5b, 0x30,
+  0x5d, 0x20, 0x3a, 0x20, 0x2d, 0x31, 0x29, 0x3b, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x5c, 0x0a, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x28, 0x69, 0x74, 0x65, 0x6d, 0x29,
+  0x20, 0x21, 0x3d, 0x20, 0x2d, 0x31, 0x3b, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x5c, 0x0a, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x28, 0x69, 0x74, 0x65, 0x6d, 0x29,
+  0x20, 0x3d, 0x20, 0x28, 0x73, 0x6f, 0x75, 0x72, 0x63, 0x65, 0x29, 0x20,
+  0x3e, 0x3d, 0x20, 0x30, 0x20, 0x26, 0x26, 0x20, 0x28, 0x6e, 0x6f, 0x64,
+  0x65, 0x29, 0x2d, 0x3e, 0x69, 0x6e, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65,
+  0x20, 0x3e, 0x20, 0x45, 0x44, 0x47, 0x45, 0x5f, 0x49, 0x4e, 0x44, 0x45,
+  0x58, 0x5f, 0x4d, 0x49, 0x4e, 0x5f, 0x44, 0x45, 0x47, 0x52, 0x45, 0x45,
+  0x20, 0x3f, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x5c, 0x0a, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x67, 0x65, 0x74, 0x4e, 0x65, 0x78, 0x74, 0x45,
+  0x64, 0x67, 0x65, 0x42, 0x65, 0x74, 0x77, 0x65, 0x65, 0x6e, 0x28, 0x67,
+  0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x74, 0x65, 0x6d, 0x29, 0x20,
+  0x3a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x5c, 0x0a, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x28, 0x2b, 0x2b, 0x28, 0x63, 0x6f, 0x75, 0x6e,
+  0x74, 0x65, 0x72, 0x29, 0x20, 0x3c, 0x20, 0x28, 0x6e, 0x6f, 0x64, 0x65,
+  0x29, 0x2d, 0x3e, 0x69, 0x6e, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x20,
+  0x3f, 0x20, 0x28, 0x65, 0x64, 0x67, 0x65, 0x73, 0x29, 0x5b, 0x63, 0x6f,
+  0x75, 0x6e, 0x74, 0x65, 0x72, 0x5d, 0x20, 0x3a, 0x20, 0x2d, 0x31, 0x29,
+  0x29, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x46, 0x72, 0x65, 0x65, 0x73, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x62, 0x6c, 0x6f, 0x63, 0x6b, 0x73, 0x20, 0x63,
+  0x61, 0x63, 0x68, 0x65, 0x64, 0x20, 0x62, 0x79, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x65, 0x64, 0x67, 0x65, 0x20, 0x62, 0x6c, 0x6f, 0x63, 0x6b, 0x20,
+  0x70, 0x6f, 0x6f, 0x6c, 0x2e, 0x20, 0x43, 0x61, 0x6c, 0x6c, 0x20, 0x61,
+  0x66, 0x74, 0x65, 0x72, 0x20, 0x66, 0x72, 0x65, 0x65, 0x69, 0x6e, 0x67,
+  0x20, 0x61, 0x6c, 0x6c, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x73, 0x2e,
+  0x20, 0x2a, 0x2f, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x66, 0x72, 0x65,
+  0x65, 0x45, 0x64, 0x67, 0x65, 0x42, 0x6c, 0x6f, 0x63, 0x6b, 0x50, 0x6f,
+  0x6f, 0x6c, 0x28, 0x76, 0x6f, 0x69, 0x64, 0x29, 0x3b, 0x0a, 0x0a, 0x2f,
+  0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x61,
+  0x6e, 0x64, 0x20, 0x65, 0x64, 0x67, 0x65, 0x20, 0x61, 0x72, 0x72, 0x61,
+  0x79, 0x73, 0x20, 0x6b, 0x65, 0x65, 0x70, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x66, 0x69, 0x65, 0x6c, 0x64, 0x73, 0x20, 0x72, 0x65, 0x61, 0x64, 0x20,
+  0x62, 0x79, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x65, 0x6e, 0x65, 0x72,
+  0x61, 0x74, 0x65, 0x64, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x69, 0x6e,
+  0x67, 0x20, 0x63, 0x6f, 0x64, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x69, 0x6e,
+  0x20, 0x64, 0x65, 0x6e, 0x73, 0x65, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79,
+  0x73, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x65, 0x64, 0x20, 0x69, 0x6e,
+  0x20, 0x70, 0x61, 0x72, 0x61, 0x6c, 0x6c, 0x65, 0x6c, 0x20, 0x77, 0x69,
+  0x74, 0x68, 0x20, 0x69, 0x74, 0x65, 0x6d, 0x73, 0x2c, 0x20, 0x73, 0x6f,
+  0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x61, 0x20, 0x73, 0x63, 0x61, 0x6e,
+  0x20, 0x6f, 0x76, 0x65, 0x72, 0x20, 0x63, 0x61, 0x6e, 0x64, 0x69, 0x64,
+  0x61, 0x74, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x69, 0x74, 0x65, 0x6d, 0x73,
+  0x20, 0x74, 0x6f, 0x75, 0x63, 0x68, 0x65, 0x73, 0x20, 0x61, 0x20, 0x66,
+  0x65, 0x77, 0x20, 0x62, 0x79, 0x74, 0x65, 0x73, 0x20, 0x70, 0x65, 0x72,
+  0x20, 0x69, 0x74, 0x65, 0x6d, 0x20, 0x69, 0x6e, 0x73, 0x74, 0x65, 0x61,
+  0x64, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x77, 0x68, 0x6f,
+  0x6c, 0x65, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x75, 0x72, 0x65,
+  0x2e, 0x20, 0x4d, 0x61, 0x72, 0x6b, 0x73, 0x20, 0x61, 0x72, 0x65, 0x0a,
+  0x20, 0x2a, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x64, 0x20, 0x69, 0x6e,
+  0x20, 0x6f, 0x6e, 0x65, 0x20, 0x62, 0x79, 0x74, 0x65, 0x2e, 0x0a, 0x20,
+  0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x65,
+  0x64, 0x20, 0x65, 0x6e, 0x74, 0x72, 0x69, 0x65, 0x73, 0x20, 0x61, 0x72,
+  0x65, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x64, 0x20, 0x6f, 0x6e, 0x6c,
+  0x79, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x64, 0x65, 0x6e,
+  0x73, 0x65, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x73, 0x3a, 0x20, 0x61,
+  0x6e, 0x20, 0x69, 0x74, 0x65, 0x6d, 0x20, 0x69, 0x73, 0x20, 0x6d, 0x61,
+  0x74, 0x63, 0x68, 0x65, 0x64, 0x0a, 0x20, 0x2a, 0x20, 0x62, 0x79, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x63, 0x75, 0x72, 0x72, 0x65, 0x6e, 0x74, 0x20,
+  0x73, 0x65, 0x61, 0x72, 0x63, 0x68, 0x20, 0x69, 0x66, 0x20, 0x69, 0x74,
+  0x73, 0x20, 0x65, 0x6e, 0x74, 0x72, 0x79, 0x20, 0x69, 0x73, 0x20, 0x65,
+  0x71, 0x75, 0x61, 0x6c, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x6d, 0x61, 0x74, 0x63, 0x68, 0x20, 0x65, 0x70, 0x6f, 0x63, 0x68, 0x20,
+  0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68,
+  0x0a, 0x20, 0x2a, 0x20, 0x28, 0x73, 0x65, 0x65, 0x20, 0x72, 0x65, 0x73,
+  0x65, 0x74, 0x4d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x64, 0x46, 0x6c, 0x61,
+  0x67, 0x73, 0x29, 0x2c, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x61, 0x6e, 0x20,
+  0x65, 0x6e, 0x74, 0x72, 0x79, 0x20, 0x6f, 0x66, 0x20, 0x30, 0x20, 0x69,
+  0x73, 0x20, 0x6e, 0x65, 0x76, 0x65, 0x72, 0x20, 0x6d, 0x61, 0x74, 0x63,
+  0x68, 0x65, 0x64, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6f, 0x74, 0x68,
+  0x65, 0x72, 0x20, 0x64, 0x65, 0x6e, 0x73, 0x65, 0x20, 0x61, 0x72, 0x72,
+  0x61, 0x79, 0x73, 0x0a, 0x20, 0x2a, 0x20, 0x61, 0x72, 0x65, 0x20, 0x63,
+  0x6f, 0x70, 0x69, 0x65, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x66, 0x69, 0x65,
+  0x6c, 0x64, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e,
+  0x6f, 0x64, 0x65, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x65, 0x64, 0x67, 0x65,
+  0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x75, 0x72, 0x65, 0x73, 0x2e,
+  0x20, 0x4e, 0x6f, 0x64, 0x65, 0x20, 0x63, 0x6f, 0x70, 0x69, 0x65, 0x73,
+  0x20, 0x61, 0x72, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x72, 0x65, 0x66, 0x72,
+  0x65, 0x73, 0x68, 0x65, 0x64, 0x20, 0x62, 0x79, 0x20, 0x69, 0x6e, 0x64,
+  0x65, 0x78, 0x4e, 0x6f, 0x64, 0x65, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x65,
+  0x64, 0x67, 0x65, 0x20, 0x63, 0x6f, 0x70, 0x69, 0x65, 0x73, 0x20, 0x61,
+  0x72, 0x65, 0x20, 0x73, 0x65, 0x74, 0x20, 0x62, 0x79, 0x20, 0x6c, 0x69,
+  0x6e, 0x6b, 0x45, 0x64, 0x67, 0x65, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x65, 0x64, 0x67, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x6d,
+  0x6f, 0x64, 0x69, 0x66, 0x69, 0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x20,
+  0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x73, 0x2e, 0x20, 0x54,
+  0x68, 0x65, 0x20, 0x65, 0x6e, 0x74, 0x72, 0x69, 0x65, 0x73, 0x20, 0x6f,
+  0x66, 0x20, 0x64, 0x75, 0x6d, 0x6d, 0x79, 0x20, 0x69, 0x74, 0x65, 0x6d,
+  0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x6d, 0x65,
+  0x61, 0x6e, 0x69, 0x6e, 0x67, 0x66, 0x75, 0x6c, 0x2e, 0x20, 0x2a, 0x2f,
+  0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x73, 0x74, 0x72,
+  0x75, 0x63, 0x74, 0x20, 0x4e, 0x6f, 0x64, 0x65, 0x41, 0x72, 0x72, 0x61,
+  0x79, 0x20, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x63,
+  0x61, 0x70, 0x61, 0x63, 0x69, 0x74, 0x79, 0x3b, 0x0a, 0x20, 0x20, 0x20,
+  0x69, 0x6e, 0x74, 0x20, 0x73, 0x69, 0x7a, 0x65, 0x3b, 0x0a, 0x20, 0x20,
+  0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x4e, 0x6f, 0x64, 0x65,
+  0x20, 0x2a, 0x69, 0x74, 0x65, 0x6d, 0x73, 0x3b, 0x0a, 0x20, 0x20, 0x20,
+  0x75, 0x6e, 0x73, 0x69, 0x67, 0x6e, 0x65, 0x64, 0x20, 0x2a, 0x6d, 0x61,
+  0x74, 0x63, 0x68, 0x65, 0x64, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x75, 0x6e,
+  0x73, 0x69, 0x67, 0x6e, 0x65, 0x64, 0x20, 0x63, 0x68, 0x61, 0x72, 0x20,
+  0x2a, 0x6d, 0x61, 0x72, 0x6b, 0x73, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x62,
+  0x6f, 0x6f, 0x6c, 0x20, 0x2a, 0x72, 0x6f, 0x6f, 0x74, 0x73, 0x3b, 0x0a,
+  0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x2a, 0x6f, 0x75, 0x74, 0x64,
+  0x65, 0x67, 0x72, 0x65, 0x65, 0x73, 0x2c, 0x20, 0x2a, 0x69, 0x6e, 0x64,
+  0x65, 0x67, 0x72, 0x65, 0x65, 0x73, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x73,
+  0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x49, 0x6e, 0x74, 0x41, 0x72, 0x72,
+  0x61, 0x79, 0x20, 0x68, 0x6f, 0x6c, 0x65, 0x73, 0x3b, 0x0a, 0x7d, 0x20,
+  0x4e, 0x6f, 0x64, 0x65, 0x41, 0x72, 0x72, 0x61, 0x79, 0x3b, 0x0a, 0x0a,
+  0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x73, 0x74, 0x72, 0x75,
+  0x63, 0x74, 0x20, 0x45, 0x64, 0x67, 0x65, 0x41, 0x72, 0x72, 0x61, 0x79,
+  0x20, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x63, 0x61,
+  0x70, 0x61, 0x63, 0x69, 0x74, 0x79, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x69,
+  0x6e, 0x74, 0x20, 0x73, 0x69, 0x7a, 0x65, 0x3b, 0x0a, 0x20, 0x20, 0x20,
+  0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x45, 0x64, 0x67, 0x65, 0x20,
+  0x2a, 0x69, 0x74, 0x65, 0x6d, 0x73, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x75,
+  0x6e, 0x73, 0x69, 0x67, 0x6e, 0x65, 0x64, 0x20, 0x2a, 0x6d, 0x61, 0x74,
+  0x63, 0x68, 0x65, 0x64, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x75, 0x6e, 0x73,
+  0x69, 0x67, 0x6e, 0x65, 0x64, 0x20, 0x63, 0x68, 0x61, 0x72, 0x20, 0x2a,
+  0x6d, 0x61, 0x72, 0x6b, 0x73, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x73, 0x74,
+  0x72, 0x75, 0x63, 0x74, 0x20, 0x49, 0x6e, 0x74, 0x41, 0x72, 0x72, 0x61,
+  0x79, 0x20, 0x68, 0x6f, 0x6c, 0x65, 0x73, 0x3b, 0x0a, 0x7d, 0x20, 0x45,
+  0x64, 0x67, 0x65, 0x41, 0x72, 0x72, 0x61, 0x79, 0x3b, 0x0a, 0x0a, 0x2f,
+  0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65,
+  0x20, 0x6a, 0x6f, 0x75, 0x72, 0x6e, 0x61, 0x6c, 0x20, 0x6f, 0x66, 0x20,
+  0x61, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x72, 0x65, 0x63, 0x6f,
+  0x72, 0x64, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x6e, 0x64, 0x65,
+  0x78, 0x20, 0x6f, 0x66, 0x20, 0x65, 0x61, 0x63, 0x68, 0x20, 0x6e, 0x6f,
+  0x64, 0x65, 0x20, 0x61, 0x66, 0x66, 0x65, 0x63, 0x74, 0x65, 0x64, 0x20,
+  0x62, 0x79, 0x20, 0x61, 0x0a, 0x20, 0x2a, 0x20, 0x6d, 0x6f, 0x64, 0x69,
+  0x66, 0x69, 0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x3a, 0x20, 0x61, 0x64,
+  0x64, 0x65, 0x64, 0x2c, 0x20, 0x72, 0x65, 0x6c, 0x61, 0x62, 0x65, 0x6c,
+  0x6c, 0x65, 0x64, 0x2c, 0x20, 0x72, 0x65, 0x6d, 0x61, 0x72, 0x6b, 0x65,
+  0x64, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x72, 0x65, 0x72, 0x6f, 0x6f, 0x74,
+  0x65, 0x64, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x2c, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x65, 0x6e, 0x64, 0x20, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x73,
+  0x0a, 0x20, 0x2a, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x64, 0x64, 0x65, 0x64,
+  0x2c, 0x20, 0x72, 0x65, 0x6d, 0x6f, 0x76, 0x65, 0x64, 0x2c, 0x20, 0x72,
+  0x65, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x6c, 0x65, 0x64, 0x20, 0x61, 0x6e,
+  0x64, 0x20, 0x72, 0x65, 0x6d, 0x61, 0x72, 0x6b, 0x65, 0x64, 0x20, 0x65,
+  0x64, 0x67, 0x65, 0x73, 0x2c, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x20, 0x72, 0x65, 0x73, 0x74,
+  0x6f, 0x72, 0x65, 0x64, 0x20, 0x62, 0x79, 0x20, 0x0a, 0x20, 0x2a, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x62, 0x61,
+  0x63, 0x6b, 0x74, 0x72, 0x61, 0x63, 0x6b, 0x69, 0x6e, 0x67, 0x20, 0x63,
+  0x6f, 0x64, 0x65, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6c, 0x61, 0x73,
+  0x74, 0x20, 0x43, 0x48, 0x41, 0x4e, 0x47, 0x45, 0x5f, 0x4a, 0x4f, 0x55,
+  0x52, 0x4e, 0x41, 0x4c, 0x5f, 0x53, 0x49, 0x5a, 0x45, 0x20, 0x65, 0x6e,
+  0x74, 0x72, 0x69, 0x65, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x6b, 0x65,
+  0x70, 0x74, 0x20, 0x69, 0x6e, 0x0a, 0x20, 0x2a, 0x20, 0x61, 0x20, 0x72,
+  0x69, 0x6e, 0x67, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x6e, 0x75, 0x6d, 0x62,
+  0x65, 0x72, 0x65, 0x64, 0x20, 0x62, 0x79, 0x20, 0x61, 0x20, 0x72, 0x75,
+  0x6e, 0x6e, 0x69, 0x6e, 0x67, 0x20, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x2e,
+  0x20, 0x43, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x73, 0x20, 0x74, 0x68, 0x61,
+  0x74, 0x20, 0x61, 0x72, 0x65, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x72, 0x65,
+  0x63, 0x6f, 0x72, 0x64, 0x65, 0x64, 0x20, 0x65, 0x6e, 0x74, 0x72, 0x79,
+  0x0a, 0x20, 0x2a, 0x20, 0x62, 0x79, 0x20, 0x65, 0x6e, 0x74, 0x72, 0x79,
+  0x20, 0x28, 0x72, 0x65, 0x73, 0x74, 0x6f, 0x72, 0x69, 0x6e, 0x67, 0x20,
+  0x61, 0x20, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x2c, 0x20,
+  0x63, 0x6f, 0x6d, 0x70, 0x61, 0x63, 0x74, 0x69, 0x6e, 0x67, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x61, 0x72, 0x72, 0x61,
+  0x79, 0x2c, 0x20, 0x63, 0x72, 0x65, 0x61, 0x74, 0x69, 0x6e, 0x67, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x67, 0x72, 0x61, 0x70,
+  0x68, 0x29, 0x20, 0x72, 0x65, 0x73, 0x65, 0x74, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x6a, 0x6f, 0x75, 0x72, 0x6e, 0x61, 0x6c, 0x3a, 0x20, 0x72, 0x65,
+  0x61, 0x64, 0x65, 0x72, 0x73, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x6c,
+  0x61, 0x73, 0x74, 0x20, 0x72, 0x65, 0x61, 0x64, 0x20, 0x69, 0x74, 0x20,
+  0x62, 0x65, 0x66, 0x6f, 0x72, 0x65, 0x20, 0x61, 0x20, 0x72, 0x65, 0x73,
+  0x65, 0x74, 0x20, 0x6d, 0x75, 0x73, 0x74, 0x0a, 0x20, 0x2a, 0x20, 0x61,
+  0x73, 0x73, 0x75, 0x6d, 0x65, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x65,
+  0x76, 0x65, 0x72, 0x79, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x68, 0x61,
+  0x73, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x64, 0x2e, 0x20, 0x2a,
+  0x2f, 0x0a, 0x23, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x20, 0x43, 0x48,
+  0x41, 0x4e, 0x47, 0x45, 0x5f, 0x4a, 0x4f, 0x55, 0x52, 0x4e, 0x41, 0x4c,
+  0x5f, 0x53, 0x49, 0x5a, 0x45, 0x20, 0x31, 0x30, 0x32, 0x34, 0x0a, 0x0a,
+  0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x73, 0x74, 0x72, 0x75,
+  0x63, 0x74, 0x20, 0x43, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x4a, 0x6f, 0x75,
+  0x72, 0x6e, 0x61, 0x6c, 0x20, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x6c, 0x6f,
+  0x6e, 0x67, 0x20, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x3b, 0x0a, 0x20, 0x20,
+  0x20, 0x6c, 0x6f, 0x6e, 0x67, 0x20, 0x72, 0x65, 0x73, 0x65, 0x74, 0x3b,
+  0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6e, 0x6f, 0x64, 0x65,
+  0x73, 0x5b, 0x43, 0x48, 0x41, 0x4e, 0x47, 0x45, 0x5f, 0x4a, 0x4f, 0x55,
+  0x52, 0x4e, 0x41, 0x4c, 0x5f, 0x53, 0x49, 0x5a, 0x45, 0x5d, 0x3b, 0x0a,
+  0x20, 0x20, 0x20, 0x2f, 0x2a, 0x20, 0x53, 0x63, 0x72, 0x61, 0x74, 0x63,
+  0x68, 0x20, 0x73, 0x70, 0x61, 0x63, 0x65, 0x20, 0x66, 0x6f, 0x72, 0x20,
+  0x75, 0x70, 0x64, 0x61, 0x74, 0x65, 0x53, 0x65, 0x61, 0x72, 0x63, 0x68,
+  0x52, 0x65, 0x73, 0x75, 0x6d, 0x65, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x20,
+  0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x2a, 0x73, 0x74, 0x61, 0x6d, 0x70,
+  0x73, 0x2c, 0x20, 0x2a, 0x71, 0x75, 0x65, 0x75, 0x65, 0x3b, 0x0a, 0x20,
+  0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x63, 0x61, 0x70, 0x61, 0x63, 0x69,
+  0x74, 0x79, 0x2c, 0x20, 0x73, 0x74, 0x61, 0x6d, 0x70, 0x3b, 0x0a, 0x7d,
+  0x20, 0x43, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x4a, 0x6f, 0x75, 0x72, 0x6e,
+  0x61, 0x6c, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20,
+  0x72, 0x6f, 0x6f, 0x74, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x20, 0x6f,
+  0x66, 0x20, 0x61, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x61, 0x72,
+  0x65, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x64, 0x20, 0x61, 0x73, 0x20,
+  0x61, 0x20, 0x64, 0x65, 0x6e, 0x73, 0x65, 0x20, 0x73, 0x65, 0x74, 0x3a,
+  0x20, 0x69, 0x74, 0x65, 0x6d, 0x73, 0x5b, 0x30, 0x2e, 0x2e, 0x73, 0x69,
+  0x7a, 0x65, 0x2d, 0x31, 0x5d, 0x20, 0x61, 0x72, 0x65, 0x20, 0x74, 0x68,
+  0x65, 0x0a, 0x20, 0x2a, 0x20, 0x69, 0x6e, 0x64, 0x69, 0x63, 0x65, 0x73,
+  0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x6f, 0x6f, 0x74,
+  0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x20, 0x69, 0x6e, 0x20, 0x6e, 0x6f,
+  0x20, 0x70, 0x61, 0x72, 0x74, 0x69, 0x63, 0x75, 0x6c, 0x61, 0x72, 0x20,
+  0x6f, 0x72, 0x64, 0x65, 0x72, 0x2c, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x70,
+  0x6f, 0x73, 0x69, 0x74, 0x69, 0x6f, 0x6e, 0x5b, 0x69, 0x5d, 0x20, 0x69,
+  0x73, 0x20, 0x74, 0x68, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x70, 0x6c, 0x61,
+  0x63, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x72, 0x6f, 0x6f, 0x74, 0x20, 0x6e,
+  0x6f, 0x64, 0x65, 0x20, 0x69, 0x20, 0x69, 0x6e, 0x20, 0x69, 0x74, 0x65,
+  0x6d, 0x73, 0x2e, 0x20, 0x70, 0x6f, 0x73, 0x69, 0x74, 0x69, 0x6f, 0x6e,
+  0x20, 0x69, 0x73, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x65, 0x64, 0x20,
+  0x62, 0x79, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x69, 0x6e, 0x64, 0x65,
+  0x78, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x69, 0x74, 0x73, 0x0a, 0x20, 0x2a,
+  0x20, 0x65, 0x6e, 0x74, 0x72, 0x69, 0x65, 0x73, 0x20, 0x66, 0x6f, 0x72,
+  0x20, 0x6e, 0x6f, 0x6e, 0x2d, 0x72, 0x6f, 0x6f, 0x74, 0x20, 0x6e, 0x6f,
+  0x64, 0x65, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x6e, 0x6f, 0x74, 0x20,
+  0x6d, 0x65, 0x61, 0x6e, 0x69, 0x6e, 0x67, 0x66, 0x75, 0x6c, 0x2e, 0x20,
+  0x41, 0x20, 0x72, 0x6f, 0x6f, 0x74, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20,
+  0x69, 0x73, 0x20, 0x72, 0x65, 0x6d, 0x6f, 0x76, 0x65, 0x64, 0x20, 0x62,
+  0x79, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x6d, 0x6f, 0x76, 0x69, 0x6e, 0x67,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x61, 0x73, 0x74, 0x20, 0x69, 0x74,
+  0x65, 0x6d, 0x20, 0x69, 0x6e, 0x74, 0x6f, 0x20, 0x69, 0x74, 0x73, 0x20,
+  0x70, 0x6c, 0x61, 0x63, 0x65, 0x2c, 0x20, 0x73, 0x6f, 0x20, 0x74, 0x68,
+  0x61, 0x74, 0x20, 0x69, 0x6e, 0x73, 0x65, 0x72, 0x74, 0x69, 0x6f, 0x6e,
+  0x20, 0x61, 0x6e, 0x64, 0x20, 0x72, 0x65, 0x6d, 0x6f, 0x76, 0x61, 0x6c,
+  0x20, 0x74, 0x61, 0x6b, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x63, 0x6f, 0x6e,
+  0x73, 0x74, 0x61, 0x6e, 0x74, 0x20, 0x74, 0x69, 0x6d, 0x65, 0x20, 0x61,
+  0x6e, 0x64, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x6f, 0x6f, 0x74, 0x20,
+  0x6e, 0x6f, 0x64, 0x65, 0x73, 0x20, 0x63, 0x61, 0x6e, 0x20, 0x62, 0x65,
+  0x20, 0x69, 0x74, 0x65, 0x72, 0x61, 0x74, 0x65, 0x64, 0x20, 0x6f, 0x76,
+  0x65, 0x72, 0x20, 0x63, 0x6f, 0x6e, 0x74, 0x69, 0x67, 0x75, 0x6f, 0x75,
+  0x73, 0x6c, 0x79, 0x2c, 0x20, 0x65, 0x2e, 0x67, 0x2e, 0x0a, 0x20, 0x2a,
+  0x20, 0x66, 0x6f, 0x72, 0x28, 0x69, 0x20, 0x3d, 0x20, 0x30, 0x3b, 0x20,
+  0x69, 0x20, 0x3c, 0x20, 0x72, 0x6f, 0x6f, 0x74, 0x73, 0x2d, 0x3e, 0x73,
+  0x69, 0x7a, 0x65, 0x3b, 0x20, 0x69, 0x2b, 0x2b, 0x29, 0x20, 0x75, 0x73,
+  0x65, 0x28, 0x72, 0x6f, 0x6f, 0x74, 0x73, 0x2d, 0x3e, 0x69, 0x74, 0x65,
+  0x6d, 0x73, 0x5b, 0x69, 0x5d, 0x29, 0x3b, 0x20, 0x2a, 0x2f, 0x0a, 0x74,
+  0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63,
+  0x74, 0x20, 0x52, 0x6f, 0x6f, 0x74, 0x4e, 0x6f, 0x64, 0x65, 0x73, 0x20,
+  0x7b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x2a, 0x69, 0x74,
+  0x65, 0x6d, 0x73, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20,
+  0x73, 0x69, 0x7a, 0x65, 0x2c, 0x20, 0x63, 0x61, 0x70, 0x61, 0x63, 0x69,
+  0x74, 0x79, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x2a,
+  0x70, 0x6f, 0x73, 0x69, 0x74, 0x69, 0x6f, 0x6e, 0x3b, 0x0a, 0x20, 0x20,
+  0x20, 0x69, 0x6e, 0x74, 0x20, 0x70, 0x6f, 0x73, 0x69, 0x74, 0x69, 0x6f,
+  0x6e, 0x5f, 0x63, 0x61, 0x70, 0x61, 0x63, 0x69, 0x74, 0x79, 0x3b, 0x0a,
+  0x7d, 0x20, 0x52, 0x6f, 0x6f, 0x74, 0x4e, 0x6f, 0x64, 0x65, 0x73, 0x3b,
+  0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6c, 0x61, 0x62,
+  0x65, 0x6c, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x6f, 0x66, 0x20,
+  0x61, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x6d, 0x61, 0x70, 0x73,
+  0x20, 0x65, 0x61, 0x63, 0x68, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x20, 0x6c,
+  0x69, 0x73, 0x74, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e,
+  0x6f, 0x64, 0x65, 0x73, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x6c, 0x65,
+  0x64, 0x20, 0x77, 0x69, 0x74, 0x68, 0x0a, 0x20, 0x2a, 0x20, 0x69, 0x74,
+  0x2e, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x73,
+  0x20, 0x61, 0x72, 0x65, 0x20, 0x63, 0x61, 0x6e, 0x6f, 0x6e, 0x69, 0x63,
+  0x61, 0x6c, 0x20, 0x77, 0x68, 0x65, 0x6e, 0x20, 0x4c, 0x49, 0x53, 0x54,
+  0x5f, 0x48, 0x41, 0x53, 0x48, 0x49, 0x4e, 0x47, 0x20, 0x69, 0x73, 0x20,
+  0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x64, 0x2c, 0x20, 0x73, 0x6f, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20, 0x0a, 0x20, 0x2a,
+  0x20, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x20, 0x73, 0x74, 0x61,
+  0x6e, 0x64, 0x73, 0x20, 0x66, 0x6f, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x63, 0x6f, 0x6e, 0x74, 0x65, 0x6e, 0x74, 0x73, 0x20, 0x6f, 0x66, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x2e, 0x20, 0x54, 0x68,
+  0x65, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x69, 0x73, 0x20, 0x61,
+  0x20, 0x68, 0x61, 0x73, 0x68, 0x20, 0x74, 0x61, 0x62, 0x6c, 0x65, 0x20,
+  0x77, 0x69, 0x74, 0x68, 0x0a, 0x20, 0x2a, 0x20, 0x6c, 0x69, 0x6e, 0x65,
+  0x61, 0x72, 0x20, 0x70, 0x72, 0x6f, 0x62, 0x69, 0x6e, 0x67, 0x20, 0x6f,
+  0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x68, 0x61, 0x73, 0x68, 0x20, 0x6f,
+  0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x2e, 0x20,
+  0x54, 0x68, 0x65, 0x20, 0x62, 0x75, 0x63, 0x6b, 0x65, 0x74, 0x20, 0x6f,
+  0x66, 0x20, 0x61, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20, 0x68, 0x6f, 0x6c,
+  0x64, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x68, 0x65, 0x61, 0x64, 0x0a,
+  0x20, 0x2a, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x20, 0x64, 0x6f, 0x75, 0x62,
+  0x6c, 0x79, 0x2d, 0x6c, 0x69, 0x6e, 0x6b, 0x65, 0x64, 0x20, 0x6c, 0x69,
+  0x73, 0x74, 0x20, 0x6f, 0x66, 0x20, 0x69, 0x74, 0x73, 0x20, 0x6e, 0x6f,
+  0x64, 0x65, 0x73, 0x2c, 0x20, 0x74, 0x68, 0x72, 0x65, 0x61, 0x64, 0x65,
+  0x64, 0x20, 0x74, 0x68, 0x72, 0x6f, 0x75, 0x67, 0x68, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x6e, 0x65, 0x78, 0x74, 0x5f, 0x62, 0x79, 0x5f, 0x6c, 0x61,
+  0x62, 0x65, 0x6c, 0x20, 0x61, 0x6e, 0x64, 0x0a, 0x20, 0x2a, 0x20, 0x70,
+  0x72, 0x65, 0x76, 0x5f, 0x62, 0x79, 0x5f, 0x6c, 0x61, 0x62, 0x65, 0x6c,
+  0x20, 0x66, 0x69, 0x65, 0x6c, 0x64, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x2c, 0x20, 0x61, 0x6e,
+  0x64, 0x20, 0x74, 0x68, 0x65, 0x69, 0x72, 0x20, 0x6e, 0x75, 0x6d, 0x62,
+  0x65, 0x72, 0x2e, 0x20, 0x4e, 0x6f, 0x64, 0x65, 0x73, 0x20, 0x77, 0x69,
+  0x74, 0x68, 0x20, 0x74, 0x68, 0x65, 0x20, 0x65, 0x6d, 0x70, 0x74, 0x79,
+  0x0a, 0x20, 0x2a, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20, 0x61, 0x72, 0x65,
+  0x20, 0x6e, 0x6f, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x65, 0x64,
+  0x2e, 0x0a, 0x20, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x69, 0x6e, 0x64,
+  0x65, 0x78, 0x20, 0x69, 0x73, 0x20, 0x62, 0x75, 0x69, 0x6c, 0x74, 0x20,
+  0x62, 0x79, 0x20, 0x74, 0x68, 0x65, 0x20, 0x66, 0x69, 0x72, 0x73, 0x74,
+  0x20, 0x6c, 0x6f, 0x6f, 0x6b, 0x75, 0x70, 0x20, 0x28, 0x73, 0x65, 0x65,
+  0x20, 0x67, 0x65, 0x74, 0x46, 0x69, 0x72, 0x73, 0x74, 0x4e, 0x6f, 0x64,
+  0x65, 0x42, 0x79, 0x4c, 0x69, 0x73, 0x74, 0x29, 0x20, 0x61, 0x6e, 0x64,
+  0x20, 0x6b, 0x65, 0x70, 0x74, 0x20, 0x75, 0x70, 0x0a, 0x20, 0x2a, 0x20,
+  0x74, 0x6f, 0x20, 0x64, 0x61, 0x74, 0x65, 0x20, 0x62, 0x79, 0x20, 0x69,
+  0x6e, 0x64, 0x65, 0x78, 0x4e, 0x6f, 0x64, 0x65, 0x20, 0x61, 0x6e, 0x64,
+  0x20, 0x75, 0x6e, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x4e, 0x6f, 0x64, 0x65,
+  0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x74, 0x68, 0x65, 0x6e, 0x20, 0x6f,
+  0x6e, 0x2e, 0x20, 0x52, 0x65, 0x73, 0x74, 0x6f, 0x72, 0x69, 0x6e, 0x67,
+  0x20, 0x61, 0x20, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x20,
+  0x6f, 0x72, 0x0a, 0x20, 0x2a, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x61, 0x63,
+  0x74, 0x69, 0x6e, 0x67, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64,
+  0x65, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x20, 0x64, 0x69, 0x73, 0x63,
+  0x61, 0x72, 0x64, 0x73, 0x20, 0x69, 0x74, 0x2c, 0x20, 0x61, 0x6e, 0x64,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x65, 0x78, 0x74, 0x20, 0x6c, 0x6f,
+  0x6f, 0x6b, 0x75, 0x70, 0x20, 0x62, 0x75, 0x69, 0x6c, 0x64, 0x73, 0x20,
+  0x69, 0x74, 0x20, 0x61, 0x67, 0x61, 0x69, 0x6e, 0x2e, 0x20, 0x2a, 0x2f,
+  0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x73, 0x74, 0x72,
+  0x75, 0x63, 0x74, 0x20, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x42, 0x75, 0x63,
+  0x6b, 0x65, 0x74, 0x20, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x73, 0x74, 0x72,
+  0x75, 0x63, 0x74, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74,
+  0x20, 0x2a, 0x6c, 0x69, 0x73, 0x74, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x69,
+  0x6e, 0x74, 0x20, 0x68, 0x65, 0x61, 0x64, 0x2c, 0x20, 0x63, 0x6f, 0x75,
+  0x6e, 0x74, 0x3b, 0x0a, 0x7d, 0x20, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x42,
+  0x75, 0x63, 0x6b, 0x65, 0x74, 0x3b, 0x0a, 0x0a, 0x74, 0x79, 0x70, 0x65,
+  0x64, 0x65, 0x66, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x4c,
+  0x61, 0x62, 0x65, 0x6c, 0x49, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x7b, 0x0a,
+  0x20, 0x20, 0x20, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x62, 0x75, 0x69, 0x6c,
+  0x74, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x42,
+  0x75, 0x63, 0x6b, 0x65, 0x74, 0x20, 0x2a, 0x62, 0x75, 0x63, 0x6b, 0x65,
+  0x74, 0x73, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x2f, 0x2a, 0x20, 0x54, 0x68,
+  0x65, 0x20, 0x6e, 0x75, 0x6d, 0x62, 0x65, 0x72, 0x20, 0x6f, 0x66, 0x20,
+  0x62, 0x75, 0x63, 0x6b, 0x65, 0x74, 0x73, 0x20, 0x28, 0x61, 0x20, 0x70,
+  0x6f, 0x77, 0x65, 0x72, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x77, 0x6f, 0x29,
+  0x2c, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x75, 0x6d, 0x62, 0x65, 0x72,
+  0x20, 0x6f, 0x66, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x73, 0x20, 0x69, 0x6e,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x6e, 0x75, 0x6d, 0x62, 0x65, 0x72, 0x20, 0x6f, 0x66, 0x20,
+  0x62, 0x75, 0x63, 0x6b, 0x65, 0x74, 0x73, 0x20, 0x74, 0x68, 0x61, 0x74,
+  0x20, 0x61, 0x72, 0x65, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x65, 0x6d, 0x70,
+  0x74, 0x79, 0x20, 0x28, 0x6c, 0x69, 0x73, 0x74, 0x73, 0x20, 0x61, 0x6e,
+  0x64, 0x20, 0x64, 0x65, 0x6c, 0x65, 0x74, 0x65, 0x64, 0x20, 0x62, 0x75,
+  0x63, 0x6b, 0x65, 0x74, 0x73, 0x29, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x20,
+  0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x73, 0x69, 0x7a, 0x65, 0x2c, 0x20,
+  0x63, 0x6f, 0x75, 0x6e, 0x74, 0x2c, 0x20, 0x75, 0x73, 0x65, 0x64, 0x3b,
+  0x0a, 0x7d, 0x20, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x49, 0x6e, 0x64, 0x65,
+  0x78, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x65,
+  0x64, 0x67, 0x65, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x6f, 0x66,
+  0x20, 0x61, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x6d, 0x61, 0x70,
+  0x73, 0x20, 0x65, 0x61, 0x63, 0x68, 0x20, 0x70, 0x61, 0x69, 0x72, 0x20,
+  0x6f, 0x66, 0x20, 0x61, 0x20, 0x73, 0x6f, 0x75, 0x72, 0x63, 0x65, 0x20,
+  0x61, 0x6e, 0x64, 0x20, 0x61, 0x20, 0x74, 0x61, 0x72, 0x67, 0x65, 0x74,
+  0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x74, 0x6f, 0x20, 0x0a, 0x20, 0x2a,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x20, 0x66,
+  0x72, 0x6f, 0x6d, 0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x6f, 0x75, 0x72,
+  0x63, 0x65, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x74, 0x61,
+  0x72, 0x67, 0x65, 0x74, 0x2e, 0x20, 0x49, 0x74, 0x20, 0x69, 0x73, 0x20,
+  0x6f, 0x72, 0x67, 0x61, 0x6e, 0x69, 0x73, 0x65, 0x64, 0x20, 0x61, 0x73,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x0a,
+  0x20, 0x2a, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x3a, 0x20, 0x61, 0x20,
+  0x68, 0x61, 0x73, 0x68, 0x20, 0x74, 0x61, 0x62, 0x6c, 0x65, 0x20, 0x77,
+  0x69, 0x74, 0x68, 0x20, 0x6c, 0x69, 0x6e, 0x65, 0x61, 0x72, 0x20, 0x70,
+  0x72, 0x6f, 0x62, 0x69, 0x6e, 0x67, 0x20, 0x6f, 0x6e, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x68, 0x61, 0x73, 0x68, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x70, 0x61, 0x69, 0x72, 0x2c, 0x20, 0x77, 0x68, 0x6f, 0x73,
+  0x65, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x62, 0x75, 0x63, 0x6b, 0x65, 0x74,
+  0x20, 0x66, 0x6f, 0x72, 0x20, 0x61, 0x20, 0x70, 0x61, 0x69, 0x72, 0x20,
+  0x68, 0x6f, 0x6c, 0x64, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x68, 0x65,
+  0x61, 0x64, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x20, 0x64, 0x6f, 0x75, 0x62,
+  0x6c, 0x79, 0x2d, 0x6c, 0x69, 0x6e, 0x6b, 0x65, 0x64, 0x20, 0x6c, 0x69,
+  0x73, 0x74, 0x20, 0x6f, 0x66, 0x20, 0x69, 0x74, 0x73, 0x20, 0x65, 0x64,
+  0x67, 0x65, 0x73, 0x2c, 0x0a, 0x20, 0x2a, 0x20, 0x74, 0x68, 0x72, 0x65,
+  0x61, 0x64, 0x65, 0x64, 0x20, 0x74, 0x68, 0x72, 0x6f, 0x75, 0x67, 0x68,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x65, 0x78, 0x74, 0x5f, 0x62, 0x79,
+  0x5f, 0x65, 0x6e, 0x64, 0x73, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x70, 0x72,
+  0x65, 0x76, 0x5f, 0x62, 0x79, 0x5f, 0x65, 0x6e, 0x64, 0x73, 0x20, 0x66,
+  0x69, 0x65, 0x6c, 0x64, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x2c, 0x20, 0x61, 0x6e, 0x64, 0x0a,
+  0x20, 0x2a, 0x20, 0x74, 0x68, 0x65, 0x69, 0x72, 0x20, 0x6e, 0x75, 0x6d,
+  0x62, 0x65, 0x72, 0x2e, 0x20, 0x41, 0x6e, 0x20, 0x65, 0x6d, 0x70, 0x74,
+  0x79, 0x20, 0x62, 0x75, 0x63, 0x6b, 0x65, 0x74, 0x20, 0x68, 0x61, 0x73,
+  0x20, 0x73, 0x6f, 0x75, 0x72, 0x63, 0x65, 0x20, 0x2d, 0x31, 0x2e, 0x20,
+  0x0a, 0x20, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x69, 0x6e, 0x64, 0x65,
+  0x78, 0x20, 0x69, 0x73, 0x20, 0x62, 0x75, 0x69, 0x6c, 0x74, 0x20, 0x62,
+  0x79, 0x20, 0x74, 0x68, 0x65, 0x20, 0x66, 0x69, 0x72, 0x73, 0x74, 0x20,
+  0x6c, 0x6f, 0x6f, 0x6b, 0x75, 0x70, 0x20, 0x28, 0x73, 0x65, 0x65, 0x20,
+  0x67, 0x65, 0x74, 0x46, 0x69, 0x72, 0x73, 0x74, 0x45, 0x64, 0x67, 0x65,
+  0x42, 0x65, 0x74, 0x77, 0x65, 0x65, 0x6e, 0x29, 0x20, 0x61, 0x6e, 0x64,
+  0x20, 0x6b, 0x65, 0x70, 0x74, 0x20, 0x75, 0x70, 0x0a, 0x20, 0x2a, 0x20,
+  0x74, 0x6f, 0x20, 0x64, 0x61, 0x74, 0x65, 0x20, 0x62, 0x79, 0x20, 0x6c,
+  0x69, 0x6e, 0x6b, 0x45, 0x64, 0x67, 0x65, 0x20, 0x61, 0x6e, 0x64, 0x20,
+  0x75, 0x6e, 0x6c, 0x69, 0x6e, 0x6b, 0x45, 0x64, 0x67, 0x65, 0x20, 0x66,
+  0x72, 0x6f, 0x6d, 0x20, 0x74, 0x68, 0x65, 0x6e, 0x20, 0x6f, 0x6e, 0x2e,
+  0x20, 0x52, 0x65, 0x73, 0x74, 0x6f, 0x72, 0x69, 0x6e, 0x67, 0x20, 0x61,
+  0x20, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x20, 0x6f, 0x72,
+  0x0a, 0x20, 0x2a, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x61, 0x63, 0x74, 0x69,
+  0x6e, 0x67, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68,
+  0x20, 0x64, 0x69, 0x73, 0x63, 0x61, 0x72, 0x64, 0x73, 0x20, 0x69, 0x74,
+  0x2c, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x65,
+  0x78, 0x74, 0x20, 0x6c, 0x6f, 0x6f, 0x6b, 0x75, 0x70, 0x20, 0x62, 0x75,
+  0x69, 0x6c, 0x64, 0x73, 0x20, 0x69, 0x74, 0x20, 0x61, 0x67, 0x61, 0x69,
+  0x6e, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65,
+  0x66, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x45, 0x64, 0x67,
+  0x65, 0x42, 0x75, 0x63, 0x6b, 0x65, 0x74, 0x20, 0x7b, 0x0a, 0x20, 0x20,
+  0x20, 0x69, 0x6e, 0x74, 0x20, 0x73, 0x6f, 0x75, 0x72, 0x63, 0x65, 0x2c,
+  0x20, 0x74, 0x61, 0x72, 0x67, 0x65, 0x74, 0x3b, 0x0a, 0x20, 0x20, 0x20,
+  0x69, 0x6e, 0x74, 0x20, 0x68, 0x65, 0x61, 0x64, 0x2c, 0x20, 0x63, 0x6f,
+  0x75, 0x6e, 0x74, 0x3b, 0x0a, 0x7d, 0x20, 0x45, 0x64, 0x67, 0x65, 0x42,
+  0x75, 0x63, 0x6b, 0x65, 0x74, 0x3b, 0x0a, 0x0a, 0x74, 0x79, 0x70, 0x65,
+  0x64, 0x65, 0x66, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x45,
+  0x64, 0x67, 0x65, 0x49, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x7b, 0x0a, 0x20,
+  0x20, 0x20, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x62, 0x75, 0x69, 0x6c, 0x74,
+  0x3b, 0x0a, 0x20, 0x20, 0x20, 0x45, 0x64, 0x67, 0x65, 0x42, 0x75, 0x63,
+  0x6b, 0x65, 0x74, 0x20, 0x2a, 0x62, 0x75, 0x63, 0x6b, 0x65, 0x74, 0x73,
+  0x3b, 0x0a, 0x20, 0x20, 0x20, 0x2f, 0x2a, 0x20, 0x41, 0x73, 0x20, 0x69,
+  0x6e, 0x20, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x49, 0x6e, 0x64, 0x65, 0x78,
+  0x2c, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x70, 0x61, 0x69, 0x72, 0x73,
+  0x20, 0x69, 0x6e, 0x20, 0x70, 0x6c, 0x61, 0x63, 0x65, 0x20, 0x6f, 0x66,
+  0x20, 0x6c, 0x69, 0x73, 0x74, 0x73, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x20,
+  0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x73, 0x69, 0x7a, 0x65, 0x2c, 0x20,
+  0x63, 0x6f, 0x75, 0x6e, 0x74, 0x2c, 0x20, 0x75, 0x73, 0x65, 0x64, 0x3b,
+  0x0a, 0x7d, 0x20, 0x45, 0x64, 0x67, 0x65, 0x49, 0x6e, 0x64, 0x65, 0x78,
+  0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d,
   0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d,
   0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d,
-  0x3d, 0x0a, 0x20, 0x2a, 0x20, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x44,
-  0x61, 0x74, 0x61, 0x20, 0x53, 0x74, 0x72, 0x75, 0x63, 0x74, 0x75, 0x72,
-  0x65, 0x20, 0x2b, 0x20, 0x46, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e,
-  0x73, 0x0a, 0x20, 0x2a, 0x20, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d,
+  0x3d, 0x3d, 0x0a, 0x20, 0x2a, 0x20, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20,
+  0x44, 0x61, 0x74, 0x61, 0x20, 0x53, 0x74, 0x72, 0x75, 0x63, 0x74, 0x75,
+  0x72, 0x65, 0x20, 0x2b, 0x20, 0x46, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f,
+  0x6e, 0x73, 0x0a, 0x20, 0x2a, 0x20, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d,
   0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d,
   0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d,
-  0x3d, 0x20, 0x2a, 0x2f, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66,
-  0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x47, 0x72, 0x61, 0x70,
-  0x68, 0x20, 0x0a, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x4e, 0x6f, 0x64, 0x65,
-  0x41, 0x72, 0x72, 0x61, 0x79, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x3b,
-  0x0a, 0x20, 0x20, 0x20, 0x45, 0x64, 0x67, 0x65, 0x41, 0x72, 0x72, 0x61,
-  0x79, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x3b, 0x0a, 0x20, 0x20, 0x20,
-  0x2f, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6e, 0x75, 0x6d, 0x62, 0x65,
-  0x72, 0x20, 0x6f, 0x66, 0x20, 0x6e, 0x6f, 0x6e, 0x2d, 0x64, 0x75, 0x6d,
-  0x6d, 0x79, 0x20, 0x69, 0x74, 0x65, 0x6d, 0x73, 0x20, 0x69, 0x6e, 0x20,
-  0x74, 0x68, 0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x27, 0x73, 0x20,
-  0x6e, 0x6f, 0x64, 0x65, 0x73, 0x2f, 0x65, 0x64, 0x67, 0x65, 0x73, 0x20,
-  0x61, 0x72, 0x72, 0x61, 0x79, 0x2e, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a,
-  0x20, 0x44, 0x6f, 0x20, 0x4e, 0x4f, 0x54, 0x20, 0x75, 0x73, 0x65, 0x20,
-  0x74, 0x68, 0x65, 0x73, 0x65, 0x20, 0x61, 0x73, 0x20, 0x61, 0x6e, 0x20,
-  0x69, 0x74, 0x65, 0x72, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x69, 0x6e,
-  0x64, 0x65, 0x78, 0x20, 0x6f, 0x76, 0x65, 0x72, 0x20, 0x74, 0x68, 0x65,
-  0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x73, 0x20, 0x62, 0x65, 0x63, 0x61,
-  0x75, 0x73, 0x65, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x74, 0x65, 0x6d,
-  0x73, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x6d, 0x61, 0x79, 0x20,
-  0x6e, 0x6f, 0x74, 0x20, 0x62, 0x65, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x65,
-  0x64, 0x20, 0x63, 0x6f, 0x6e, 0x74, 0x69, 0x67, 0x75, 0x6f, 0x75, 0x73,
-  0x6c, 0x79, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x61, 0x72,
-  0x72, 0x61, 0x79, 0x2e, 0x20, 0x49, 0x6e, 0x73, 0x74, 0x65, 0x61, 0x64,
-  0x20, 0x75, 0x73, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x2e, 0x73,
-  0x69, 0x7a, 0x65, 0x20, 0x61, 0x6e, 0x64, 0x0a, 0x20, 0x20, 0x20, 0x20,
-  0x2a, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x2e, 0x73, 0x69, 0x7a, 0x65,
-  0x2e, 0x20, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x54, 0x68, 0x65,
-  0x20, 0x65, 0x71, 0x75, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x73, 0x20, 0x62,
-  0x65, 0x6c, 0x6f, 0x77, 0x20, 0x61, 0x72, 0x65, 0x20, 0x69, 0x6e, 0x76,
-  0x61, 0x72, 0x69, 0x61, 0x6e, 0x74, 0x20, 0x70, 0x72, 0x6f, 0x70, 0x65,
-  0x72, 0x74, 0x69, 0x65, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x69,
-  0x73, 0x20, 0x64, 0x61, 0x74, 0x61, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63,
-  0x74, 0x75, 0x72, 0x65, 0x2e, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20,
-  0x6e, 0x75, 0x6d, 0x62, 0x65, 0x72, 0x5f, 0x6f, 0x66, 0x5f, 0x6e, 0x6f,
-  0x64, 0x65, 0x73, 0x20, 0x2b, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x5f, 0x68,
-  0x6f, 0x6c, 0x65, 0x73, 0x2e, 0x73, 0x69, 0x7a, 0x65, 0x20, 0x3d, 0x20,
-  0x6e, 0x6f, 0x64, 0x65, 0x73, 0x2e, 0x73, 0x69, 0x7a, 0x65, 0x2e, 0x20,
-  0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x6e, 0x75, 0x6d, 0x62, 0x65,
-  0x72, 0x5f, 0x6f, 0x66, 0x5f, 0x65, 0x64, 0x67, 0x65, 0x73, 0x20, 0x2b,
-  0x20, 0x65, 0x64, 0x67, 0x65, 0x5f, 0x68, 0x6f, 0x6c, 0x65, 0x73, 0x2e,
-  0x73, 0x69, 0x7a, 0x65, 0x20, 0x3d, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73,
-  0x2e, 0x73, 0x69, 0x7a, 0x65, 0x2e, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a,
-  0x20, 0x49, 0x6e, 0x20, 0x77, 0x6f, 0x72, 0x64, 0x73, 0x2c, 0x20, 0x65,
-  0x61, 0x63, 0x68, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x66,
-  0x69, 0x72, 0x73, 0x74, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x2e, 0x73,
-  0x69, 0x7a, 0x65, 0x20, 0x69, 0x74, 0x65, 0x6d, 0x73, 0x20, 0x6f, 0x66,
-  0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x61, 0x72,
-  0x72, 0x61, 0x79, 0x20, 0x69, 0x73, 0x20, 0x65, 0x69, 0x74, 0x68, 0x65,
-  0x72, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x61, 0x20, 0x64, 0x75,
-  0x6d, 0x6d, 0x79, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x28, 0x61, 0x20,
-  0x68, 0x6f, 0x6c, 0x65, 0x20, 0x63, 0x72, 0x65, 0x61, 0x74, 0x65, 0x64,
-  0x20, 0x62, 0x79, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x65, 0x6d, 0x6f,
-  0x76, 0x61, 0x6c, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x20, 0x6e, 0x6f, 0x64,
-  0x65, 0x29, 0x2c, 0x20, 0x6f, 0x72, 0x20, 0x61, 0x20, 0x76, 0x61, 0x6c,
-  0x69, 0x64, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x2e, 0x20, 0x2a, 0x2f, 0x0a,
-  0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6e, 0x75, 0x6d, 0x62, 0x65,
-  0x72, 0x5f, 0x6f, 0x66, 0x5f, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x2c, 0x20,
-  0x6e, 0x75, 0x6d, 0x62, 0x65, 0x72, 0x5f, 0x6f, 0x66, 0x5f, 0x65, 0x64,
-  0x67, 0x65, 0x73, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x0a, 0x20, 0x20, 0x20,
-  0x2f, 0x2a, 0x20, 0x52, 0x6f, 0x6f, 0x74, 0x20, 0x6e, 0x6f, 0x64, 0x65,
-  0x73, 0x20, 0x72, 0x65, 0x66, 0x65, 0x72, 0x65, 0x6e, 0x63, 0x65, 0x64,
-  0x20, 0x69, 0x6e, 0x20, 0x61, 0x20, 0x6c, 0x69, 0x6e, 0x6b, 0x65, 0x64,
-  0x20, 0x6c, 0x69, 0x73, 0x74, 0x20, 0x66, 0x6f, 0x72, 0x20, 0x66, 0x61,
-  0x73, 0x74, 0x20, 0x61, 0x63, 0x63, 0x65, 0x73, 0x73, 0x2e, 0x20, 0x2a,
-  0x2f, 0x0a, 0x20, 0x20, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20,
-  0x52, 0x6f, 0x6f, 0x74, 0x4e, 0x6f, 0x64, 0x65, 0x73, 0x20, 0x2a, 0x72,
-  0x6f, 0x6f, 0x74, 0x5f, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x3b, 0x0a, 0x7d,
-  0x20, 0x47, 0x72, 0x61, 0x70, 0x68, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20,
-  0x54, 0x68, 0x65, 0x20, 0x61, 0x72, 0x67, 0x75, 0x6d, 0x65, 0x6e, 0x74,
-  0x73, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x20, 0x61, 0x6e, 0x64, 0x20,
-  0x65, 0x64, 0x67, 0x65, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x74, 0x68,
-  0x65, 0x20, 0x69, 0x6e, 0x69, 0x74, 0x69, 0x61, 0x6c, 0x20, 0x73, 0x69,
-  0x7a, 0x65, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e,
-  0x6f, 0x64, 0x65, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x20, 0x61, 0x6e,
-  0x64, 0x20, 0x74, 0x68, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x65, 0x64, 0x67,
-  0x65, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x20, 0x72, 0x65, 0x73, 0x70,
-  0x65, 0x63, 0x74, 0x69, 0x76, 0x65, 0x6c, 0x79, 0x2e, 0x20, 0x2a, 0x2f,
-  0x0a, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x6e, 0x65, 0x77, 0x47,
-  0x72, 0x61, 0x70, 0x68, 0x28, 0x69, 0x6e, 0x74, 0x20, 0x6e, 0x6f, 0x64,
-  0x65, 0x73, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x65, 0x64, 0x67, 0x65,
-  0x73, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x4e, 0x6f, 0x64, 0x65,
+  0x3d, 0x3d, 0x20, 0x2a, 0x2f, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65,
+  0x66, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x47, 0x72, 0x61,
+  0x70, 0x68, 0x20, 0x0a, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x4e, 0x6f, 0x64,
+  0x65, 0x41, 0x72, 0x72, 0x61, 0x79, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73,
+  0x3b, 0x0a, 0x20, 0x20, 0x20, 0x45, 0x64, 0x67, 0x65, 0x41, 0x72, 0x72,
+  0x61, 0x79, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x3b, 0x0a, 0x20, 0x20,
+  0x20, 0x2f, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6e, 0x75, 0x6d, 0x62,
+  0x65, 0x72, 0x20, 0x6f, 0x66, 0x20, 0x6e, 0x6f, 0x6e, 0x2d, 0x64, 0x75,
+  0x6d, 0x6d, 0x79, 0x20, 0x69, 0x74, 0x65, 0x6d, 0x73, 0x20, 0x69, 0x6e,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x27, 0x73,
+  0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x2f, 0x65, 0x64, 0x67, 0x65, 0x73,
+  0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x2e, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x2a, 0x20, 0x44, 0x6f, 0x20, 0x4e, 0x4f, 0x54, 0x20, 0x75, 0x73, 0x65,
+  0x20, 0x74, 0x68, 0x65, 0x73, 0x65, 0x20, 0x61, 0x73, 0x20, 0x61, 0x6e,
+  0x20, 0x69, 0x74, 0x65, 0x72, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x69,
+  0x6e, 0x64, 0x65, 0x78, 0x20, 0x6f, 0x76, 0x65, 0x72, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x73, 0x20, 0x62, 0x65, 0x63,
+  0x61, 0x75, 0x73, 0x65, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x74, 0x65,
+  0x6d, 0x73, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x6d, 0x61, 0x79,
+  0x20, 0x6e, 0x6f, 0x74, 0x20, 0x62, 0x65, 0x20, 0x73, 0x74, 0x6f, 0x72,
+  0x65, 0x64, 0x20, 0x63, 0x6f, 0x6e, 0x74, 0x69, 0x67, 0x75, 0x6f, 0x75,
+  0x73, 0x6c, 0x79, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x61,
+  0x72, 0x72, 0x61, 0x79, 0x2e, 0x20, 0x49, 0x6e, 0x73, 0x74, 0x65, 0x61,
+  0x64, 0x20, 0x75, 0x73, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x2e,
+  0x73, 0x69, 0x7a, 0x65, 0x20, 0x61, 0x6e, 0x64, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x2a, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x2e, 0x73, 0x69, 0x7a,
+  0x65, 0x2e, 0x20, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x54, 0x68,
+  0x65, 0x20, 0x65, 0x71, 0x75, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x73, 0x20,
+  0x62, 0x65, 0x6c, 0x6f, 0x77, 0x20, 0x61, 0x72, 0x65, 0x20, 0x69, 0x6e,
+  0x76, 0x61, 0x72, 0x69, 0x61, 0x6e, 0x74, 0x20, 0x70, 0x72, 0x6f, 0x70,
+  0x65, 0x72, 0x74, 0x69, 0x65, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68,
+  0x69, 0x73, 0x20, 0x64, 0x61, 0x74, 0x61, 0x20, 0x73, 0x74, 0x72, 0x75,
+  0x63, 0x74, 0x75, 0x72, 0x65, 0x2e, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a,
+  0x20, 0x6e, 0x75, 0x6d, 0x62, 0x65, 0x72, 0x5f, 0x6f, 0x66, 0x5f, 0x6e,
+  0x6f, 0x64, 0x65, 0x73, 0x20, 0x2b, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x5f,
+  0x68, 0x6f, 0x6c, 0x65, 0x73, 0x2e, 0x73, 0x69, 0x7a, 0x65, 0x20, 0x3d,
+  0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x2e, 0x73, 0x69, 0x7a, 0x65, 0x2e,
+  0x20, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x6e, 0x75, 0x6d, 0x62,
+  0x65, 0x72, 0x5f, 0x6f, 0x66, 0x5f, 0x65, 0x64, 0x67, 0x65, 0x73, 0x20,
+  0x2b, 0x20, 0x65, 0x64, 0x67, 0x65, 0x5f, 0x68, 0x6f, 0x6c, 0x65, 0x73,
+  0x2e, 0x73, 0x69, 0x7a, 0x65, 0x20, 0x3d, 0x20, 0x65, 0x64, 0x67, 0x65,
+  0x73, 0x2e, 0x73, 0x69, 0x7a, 0x65, 0x2e, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x2a, 0x20, 0x49, 0x6e, 0x20, 0x77, 0x6f, 0x72, 0x64, 0x73, 0x2c, 0x20,
+  0x65, 0x61, 0x63, 0x68, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x66, 0x69, 0x72, 0x73, 0x74, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x2e,
+  0x73, 0x69, 0x7a, 0x65, 0x20, 0x69, 0x74, 0x65, 0x6d, 0x73, 0x20, 0x6f,
+  0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x61,
+  0x72, 0x72, 0x61, 0x79, 0x20, 0x69, 0x73, 0x20, 0x65, 0x69, 0x74, 0x68,
+  0x65, 0x72, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x61, 0x20, 0x64,
+  0x75, 0x6d, 0x6d, 0x79, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x28, 0x61,
+  0x20, 0x68, 0x6f, 0x6c, 0x65, 0x20, 0x63, 0x72, 0x65, 0x61, 0x74, 0x65,
+  0x64, 0x20, 0x62, 0x79, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x65, 0x6d,
+  0x6f, 0x76, 0x61, 0x6c, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x20, 0x6e, 0x6f,
+  0x64, 0x65, 0x29, 0x2c, 0x20, 0x6f, 0x72, 0x20, 0x61, 0x20, 0x76, 0x61,
+  0x6c, 0x69, 0x64, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x2e, 0x20, 0x2a, 0x2f,
+  0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6e, 0x75, 0x6d, 0x62,
+  0x65, 0x72, 0x5f, 0x6f, 0x66, 0x5f, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x2c,
+  0x20, 0x6e, 0x75, 0x6d, 0x62, 0x65, 0x72, 0x5f, 0x6f, 0x66, 0x5f, 0x65,
+  0x64, 0x67, 0x65, 0x73, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x0a, 0x20, 0x20,
+  0x20, 0x2f, 0x2a, 0x20, 0x52, 0x6f, 0x6f, 0x74, 0x20, 0x6e, 0x6f, 0x64,
+  0x65, 0x73, 0x20, 0x72, 0x65, 0x66, 0x65, 0x72, 0x65, 0x6e, 0x63, 0x65,
+  0x64, 0x20, 0x69, 0x6e, 0x20, 0x61, 0x20, 0x64, 0x65, 0x6e, 0x73, 0x65,
+  0x20, 0x73, 0x65, 0x74, 0x20, 0x66, 0x6f, 0x72, 0x20, 0x66, 0x61, 0x73,
+  0x74, 0x20, 0x61, 0x63, 0x63, 0x65, 0x73, 0x73, 0x2e, 0x20, 0x2a, 0x2f,
+  0x0a, 0x20, 0x20, 0x20, 0x52, 0x6f, 0x6f, 0x74, 0x4e, 0x6f, 0x64, 0x65,
+  0x73, 0x20, 0x72, 0x6f, 0x6f, 0x74, 0x5f, 0x6e, 0x6f, 0x64, 0x65, 0x73,
+  0x3b, 0x0a, 0x0a, 0x20, 0x20, 0x20, 0x2f, 0x2a, 0x20, 0x48, 0x65, 0x61,
+  0x64, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f,
+  0x64, 0x65, 0x20, 0x73, 0x69, 0x67, 0x6e, 0x61, 0x74, 0x75, 0x72, 0x65,
+  0x20, 0x62, 0x75, 0x63, 0x6b, 0x65, 0x74, 0x73, 0x2c, 0x20, 0x69, 0x6e,
+  0x64, 0x65, 0x78, 0x65, 0x64, 0x20, 0x62, 0x79, 0x20, 0x73, 0x69, 0x67,
+  0x6e, 0x61, 0x74, 0x75, 0x72, 0x65, 0x20, 0x28, 0x73, 0x65, 0x65, 0x20,
+  0x53, 0x49, 0x47, 0x4e, 0x41, 0x54, 0x55, 0x52, 0x45, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x2a, 0x20, 0x69, 0x6e, 0x20, 0x67, 0x6c, 0x6f, 0x62, 0x61,
+  0x6c, 0x73, 0x2e, 0x68, 0x29, 0x2e, 0x20, 0x45, 0x61, 0x63, 0x68, 0x20,
+  0x62, 0x75, 0x63, 0x6b, 0x65, 0x74, 0x20, 0x69, 0x73, 0x20, 0x61, 0x20,
+  0x64, 0x6f, 0x75, 0x62, 0x6c, 0x79, 0x2d, 0x6c, 0x69, 0x6e, 0x6b, 0x65,
+  0x64, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x69, 0x6e, 0x64, 0x69, 0x63, 0x65, 0x73, 0x20, 0x6f, 0x66,
+  0x20, 0x74, 0x68, 0x65, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x6e,
+  0x6f, 0x64, 0x65, 0x73, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x74, 0x68,
+  0x61, 0x74, 0x20, 0x73, 0x69, 0x67, 0x6e, 0x61, 0x74, 0x75, 0x72, 0x65,
+  0x2c, 0x20, 0x74, 0x68, 0x72, 0x65, 0x61, 0x64, 0x65, 0x64, 0x20, 0x74,
+  0x68, 0x72, 0x6f, 0x75, 0x67, 0x68, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e,
+  0x65, 0x78, 0x74, 0x5f, 0x62, 0x79, 0x5f, 0x73, 0x69, 0x67, 0x6e, 0x61,
+  0x74, 0x75, 0x72, 0x65, 0x20, 0x61, 0x6e, 0x64, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x2a, 0x20, 0x70, 0x72, 0x65, 0x76, 0x5f, 0x62, 0x79, 0x5f, 0x73,
+  0x69, 0x67, 0x6e, 0x61, 0x74, 0x75, 0x72, 0x65, 0x20, 0x66, 0x69, 0x65,
+  0x6c, 0x64, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e,
+  0x6f, 0x64, 0x65, 0x73, 0x2e, 0x20, 0x41, 0x6e, 0x20, 0x65, 0x6d, 0x70,
+  0x74, 0x79, 0x20, 0x62, 0x75, 0x63, 0x6b, 0x65, 0x74, 0x20, 0x68, 0x61,
+  0x73, 0x20, 0x68, 0x65, 0x61, 0x64, 0x20, 0x2d, 0x31, 0x2e, 0x20, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x55, 0x73, 0x65, 0x64, 0x20, 0x62,
+  0x79, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x65, 0x6e, 0x65, 0x72, 0x61,
+  0x74, 0x65, 0x64, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x69, 0x6e, 0x67,
+  0x20, 0x63, 0x6f, 0x64, 0x65, 0x20, 0x73, 0x6f, 0x20, 0x74, 0x68, 0x61,
+  0x74, 0x20, 0x6f, 0x6e, 0x6c, 0x79, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e,
+  0x6f, 0x64, 0x65, 0x73, 0x20, 0x77, 0x68, 0x6f, 0x73, 0x65, 0x20, 0x6d,
+  0x61, 0x72, 0x6b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x61, 0x6e,
+  0x64, 0x20, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x73, 0x20, 0x61, 0x72,
+  0x65, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x61, 0x74, 0x69, 0x62, 0x6c, 0x65,
+  0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x75,
+  0x6c, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x61, 0x72, 0x65, 0x20,
+  0x63, 0x6f, 0x6e, 0x73, 0x69, 0x64, 0x65, 0x72, 0x65, 0x64, 0x2e, 0x20,
+  0x2a, 0x2f, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6e, 0x6f,
+  0x64, 0x65, 0x73, 0x5f, 0x62, 0x79, 0x5f, 0x73, 0x69, 0x67, 0x6e, 0x61,
+  0x74, 0x75, 0x72, 0x65, 0x5b, 0x4e, 0x55, 0x4d, 0x42, 0x45, 0x52, 0x5f,
+  0x4f, 0x46, 0x5f, 0x53, 0x49, 0x47, 0x4e, 0x41, 0x54, 0x55, 0x52, 0x45,
+  0x53, 0x5d, 0x3b, 0x0a, 0x0a, 0x20, 0x20, 0x20, 0x2f, 0x2a, 0x20, 0x54,
+  0x68, 0x65, 0x20, 0x6e, 0x75, 0x6d, 0x62, 0x65, 0x72, 0x20, 0x6f, 0x66,
+  0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20,
+  0x65, 0x61, 0x63, 0x68, 0x20, 0x6d, 0x61, 0x72, 0x6b, 0x2c, 0x20, 0x6b,
+  0x65, 0x70, 0x74, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x73, 0x69, 0x67, 0x6e, 0x61, 0x74, 0x75, 0x72, 0x65, 0x20, 0x62,
+  0x75, 0x63, 0x6b, 0x65, 0x74, 0x73, 0x2e, 0x20, 0x52, 0x65, 0x61, 0x64,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x62, 0x79, 0x20, 0x67, 0x65,
+  0x6e, 0x65, 0x72, 0x61, 0x74, 0x65, 0x64, 0x20, 0x6d, 0x61, 0x74, 0x63,
+  0x68, 0x65, 0x72, 0x73, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x63, 0x68,
+  0x6f, 0x6f, 0x73, 0x65, 0x20, 0x62, 0x65, 0x74, 0x77, 0x65, 0x65, 0x6e,
+  0x20, 0x73, 0x65, 0x61, 0x72, 0x63, 0x68, 0x70, 0x6c, 0x61, 0x6e, 0x73,
+  0x20, 0x61, 0x74, 0x20, 0x72, 0x75, 0x6e, 0x74, 0x69, 0x6d, 0x65, 0x2e,
+  0x20, 0x2a, 0x2f, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6e,
+  0x6f, 0x64, 0x65, 0x5f, 0x6d, 0x61, 0x72, 0x6b, 0x5f, 0x63, 0x6f, 0x75,
+  0x6e, 0x74, 0x73, 0x5b, 0x4e, 0x55, 0x4d, 0x42, 0x45, 0x52, 0x5f, 0x4f,
+  0x46, 0x5f, 0x4d, 0x41, 0x52, 0x4b, 0x53, 0x5d, 0x3b, 0x0a, 0x0a, 0x20,
+  0x20, 0x20, 0x2f, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6d, 0x6f, 0x73,
+  0x74, 0x20, 0x72, 0x65, 0x63, 0x65, 0x6e, 0x74, 0x20, 0x73, 0x6e, 0x61,
+  0x70, 0x73, 0x68, 0x6f, 0x74, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x6f, 0x72, 0x20, 0x4e,
+  0x55, 0x4c, 0x4c, 0x2e, 0x20, 0x53, 0x65, 0x65, 0x20, 0x70, 0x75, 0x73,
+  0x68, 0x47, 0x72, 0x61, 0x70, 0x68, 0x53, 0x6e, 0x61, 0x70, 0x73, 0x68,
+  0x6f, 0x74, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x20, 0x20, 0x20, 0x73, 0x74,
+  0x72, 0x75, 0x63, 0x74, 0x20, 0x47, 0x72, 0x61, 0x70, 0x68, 0x53, 0x6e,
+  0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x20, 0x2a, 0x73, 0x6e, 0x61, 0x70,
+  0x73, 0x68, 0x6f, 0x74, 0x3b, 0x0a, 0x0a, 0x20, 0x20, 0x20, 0x4c, 0x61,
+  0x62, 0x65, 0x6c, 0x49, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x6c, 0x61, 0x62,
+  0x65, 0x6c, 0x5f, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x3b, 0x0a, 0x20, 0x20,
+  0x20, 0x45, 0x64, 0x67, 0x65, 0x49, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x65,
+  0x64, 0x67, 0x65, 0x5f, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x3b, 0x0a, 0x20,
+  0x20, 0x20, 0x2f, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6e, 0x75, 0x6d,
+  0x62, 0x65, 0x72, 0x20, 0x6f, 0x66, 0x20, 0x69, 0x6e, 0x63, 0x69, 0x64,
+  0x65, 0x6e, 0x74, 0x20, 0x65, 0x64, 0x67, 0x65, 0x20, 0x61, 0x72, 0x72,
+  0x61, 0x79, 0x73, 0x20, 0x28, 0x6f, 0x75, 0x74, 0x67, 0x6f, 0x69, 0x6e,
+  0x67, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x69, 0x6e, 0x63, 0x6f, 0x6d, 0x69,
+  0x6e, 0x67, 0x29, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e,
+  0x6f, 0x64, 0x65, 0x73, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x74,
+  0x68, 0x61, 0x74, 0x20, 0x68, 0x6f, 0x6c, 0x64, 0x20, 0x6d, 0x6f, 0x72,
+  0x65, 0x20, 0x74, 0x68, 0x61, 0x6e, 0x20, 0x45, 0x44, 0x47, 0x45, 0x5f,
+  0x49, 0x4e, 0x44, 0x45, 0x58, 0x5f, 0x4d, 0x49, 0x4e, 0x5f, 0x44, 0x45,
+  0x47, 0x52, 0x45, 0x45, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x2e, 0x20,
+  0x49, 0x66, 0x20, 0x69, 0x74, 0x20, 0x69, 0x73, 0x20, 0x7a, 0x65, 0x72,
+  0x6f, 0x2c, 0x20, 0x6e, 0x6f, 0x20, 0x6c, 0x6f, 0x6f, 0x6b, 0x75, 0x70,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x75, 0x73, 0x65, 0x73, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x65, 0x64, 0x67, 0x65, 0x20, 0x69, 0x6e, 0x64,
+  0x65, 0x78, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e,
+  0x74, 0x20, 0x68, 0x69, 0x67, 0x68, 0x5f, 0x64, 0x65, 0x67, 0x72, 0x65,
+  0x65, 0x5f, 0x61, 0x72, 0x72, 0x61, 0x79, 0x73, 0x3b, 0x0a, 0x0a, 0x20,
+  0x20, 0x20, 0x2f, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x76, 0x61, 0x6c,
+  0x75, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6d, 0x61,
+  0x74, 0x63, 0x68, 0x65, 0x64, 0x20, 0x65, 0x6e, 0x74, 0x72, 0x69, 0x65,
+  0x73, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x74, 0x65,
+  0x6d, 0x73, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x64, 0x20, 0x62,
+  0x79, 0x20, 0x74, 0x68, 0x65, 0x20, 0x63, 0x75, 0x72, 0x72, 0x65, 0x6e,
+  0x74, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x73, 0x65, 0x61, 0x72,
+  0x63, 0x68, 0x2e, 0x20, 0x4e, 0x65, 0x76, 0x65, 0x72, 0x20, 0x30, 0x2e,
+  0x20, 0x2a, 0x2f, 0x0a, 0x20, 0x20, 0x20, 0x75, 0x6e, 0x73, 0x69, 0x67,
+  0x6e, 0x65, 0x64, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x5f, 0x65, 0x70,
+  0x6f, 0x63, 0x68, 0x3b, 0x0a, 0x0a, 0x20, 0x20, 0x20, 0x43, 0x68, 0x61,
+  0x6e, 0x67, 0x65, 0x4a, 0x6f, 0x75, 0x72, 0x6e, 0x61, 0x6c, 0x20, 0x6a,
+  0x6f, 0x75, 0x72, 0x6e, 0x61, 0x6c, 0x3b, 0x0a, 0x7d, 0x20, 0x47, 0x72,
+  0x61, 0x70, 0x68, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x54, 0x68, 0x65,
+  0x20, 0x61, 0x72, 0x67, 0x75, 0x6d, 0x65, 0x6e, 0x74, 0x73, 0x20, 0x6e,
+  0x6f, 0x64, 0x65, 0x73, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x65, 0x64, 0x67,
+  0x65, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69,
+  0x6e, 0x69, 0x74, 0x69, 0x61, 0x6c, 0x20, 0x73, 0x69, 0x7a, 0x65, 0x73,
+  0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65,
+  0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x74,
+  0x68, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x65, 0x64, 0x67, 0x65, 0x20, 0x61,
+  0x72, 0x72, 0x61, 0x79, 0x20, 0x72, 0x65, 0x73, 0x70, 0x65, 0x63, 0x74,
+  0x69, 0x76, 0x65, 0x6c, 0x79, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x47, 0x72,
+  0x61, 0x70, 0x68, 0x20, 0x2a, 0x6e, 0x65, 0x77, 0x47, 0x72, 0x61, 0x70,
+  0x68, 0x28, 0x69, 0x6e, 0x74, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x2c,
+  0x20, 0x69, 0x6e, 0x74, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x29, 0x3b,
+  0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x4e, 0x6f, 0x64, 0x65, 0x73, 0x20, 0x61,
+  0x6e, 0x64, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x20, 0x61, 0x72, 0x65,
+  0x20, 0x63, 0x72, 0x65, 0x61, 0x74, 0x65, 0x64, 0x20, 0x61, 0x6e, 0x64,
+  0x20, 0x61, 0x64, 0x64, 0x65, 0x64, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x77, 0x69, 0x74, 0x68,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x61, 0x64, 0x64, 0x4e, 0x6f, 0x64, 0x65,
+  0x20, 0x61, 0x6e, 0x64, 0x20, 0x61, 0x64, 0x64, 0x45, 0x64, 0x67, 0x65,
+  0x0a, 0x20, 0x2a, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e,
+  0x73, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x79, 0x20, 0x74, 0x61, 0x6b, 0x65,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x65, 0x63, 0x65, 0x73, 0x73, 0x61,
+  0x72, 0x79, 0x20, 0x63, 0x6f, 0x6e, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74,
+  0x69, 0x6f, 0x6e, 0x20, 0x64, 0x61, 0x74, 0x61, 0x20, 0x61, 0x73, 0x20,
+  0x74, 0x68, 0x65, 0x69, 0x72, 0x20, 0x61, 0x72, 0x67, 0x75, 0x6d, 0x65,
+  0x6e, 0x74, 0x73, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x0a, 0x20, 0x2a, 0x20,
+  0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x69, 0x72,
+  0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2e, 0x20, 0x2a, 0x2f, 0x0a,
+  0x69, 0x6e, 0x74, 0x20, 0x61, 0x64, 0x64, 0x4e, 0x6f, 0x64, 0x65, 0x28,
+  0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68,
+  0x2c, 0x20, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x72, 0x6f, 0x6f, 0x74, 0x2c,
+  0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x6c,
+  0x61, 0x62, 0x65, 0x6c, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20,
+  0x61, 0x64, 0x64, 0x52, 0x6f, 0x6f, 0x74, 0x4e, 0x6f, 0x64, 0x65, 0x28,
+  0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68,
+  0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29,
+  0x3b, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x61, 0x64, 0x64, 0x45, 0x64, 0x67,
+  0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61,
+  0x70, 0x68, 0x2c, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65,
+  0x6c, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x2c, 0x20, 0x69, 0x6e, 0x74,
+  0x20, 0x73, 0x6f, 0x75, 0x72, 0x63, 0x65, 0x5f, 0x69, 0x6e, 0x64, 0x65,
+  0x78, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x74, 0x61, 0x72, 0x67, 0x65,
+  0x74, 0x5f, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x76, 0x6f,
+  0x69, 0x64, 0x20, 0x72, 0x65, 0x6d, 0x6f, 0x76, 0x65, 0x4e, 0x6f, 0x64,
+  0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61,
+  0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65,
+  0x78, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x72, 0x65, 0x6d,
+  0x6f, 0x76, 0x65, 0x52, 0x6f, 0x6f, 0x74, 0x4e, 0x6f, 0x64, 0x65, 0x28,
+  0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68,
+  0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29,
+  0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x72, 0x65, 0x6d, 0x6f, 0x76,
+  0x65, 0x45, 0x64, 0x67, 0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20,
+  0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20,
+  0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64,
+  0x20, 0x72, 0x65, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x4e, 0x6f, 0x64, 0x65,
+  0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70,
+  0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78,
+  0x2c, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20,
+  0x6e, 0x65, 0x77, 0x5f, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x29, 0x3b, 0x0a,
+  0x76, 0x6f, 0x69, 0x64, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x4e,
+  0x6f, 0x64, 0x65, 0x4d, 0x61, 0x72, 0x6b, 0x28, 0x47, 0x72, 0x61, 0x70,
+  0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e,
+  0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20, 0x4d, 0x61, 0x72,
+  0x6b, 0x54, 0x79, 0x70, 0x65, 0x20, 0x6e, 0x65, 0x77, 0x5f, 0x6d, 0x61,
+  0x72, 0x6b, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x63, 0x68,
+  0x61, 0x6e, 0x67, 0x65, 0x52, 0x6f, 0x6f, 0x74, 0x28, 0x47, 0x72, 0x61,
+  0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69,
+  0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x76,
+  0x6f, 0x69, 0x64, 0x20, 0x72, 0x65, 0x73, 0x65, 0x74, 0x4d, 0x61, 0x74,
+  0x63, 0x68, 0x65, 0x64, 0x4e, 0x6f, 0x64, 0x65, 0x46, 0x6c, 0x61, 0x67,
+  0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70,
+  0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78,
+  0x29, 0x3b, 0x0a, 0x2f, 0x2a, 0x20, 0x55, 0x6e, 0x6d, 0x61, 0x74, 0x63,
+  0x68, 0x65, 0x73, 0x20, 0x61, 0x6c, 0x6c, 0x20, 0x6e, 0x6f, 0x64, 0x65,
   0x73, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x20,
-  0x61, 0x72, 0x65, 0x20, 0x63, 0x72, 0x65, 0x61, 0x74, 0x65, 0x64, 0x20,
-  0x61, 0x6e, 0x64, 0x20, 0x61, 0x64, 0x64, 0x65, 0x64, 0x20, 0x74, 0x6f,
-  0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x77,
-  0x69, 0x74, 0x68, 0x20, 0x74, 0x68, 0x65, 0x20, 0x61, 0x64, 0x64, 0x4e,
-  0x6f, 0x64, 0x65, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x61, 0x64, 0x64, 0x45,
-  0x64, 0x67, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74,
-  0x69, 0x6f, 0x6e, 0x73, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x79, 0x20, 0x74,
-  0x61, 0x6b, 0x65, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x65, 0x63, 0x65,
-  0x73, 0x73, 0x61, 0x72, 0x79, 0x20, 0x63, 0x6f, 0x6e, 0x73, 0x74, 0x72,
-  0x75, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x64, 0x61, 0x74, 0x61, 0x20,
-  0x61, 0x73, 0x20, 0x74, 0x68, 0x65, 0x69, 0x72, 0x20, 0x61, 0x72, 0x67,
-  0x75, 0x6d, 0x65, 0x6e, 0x74, 0x73, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x0a,
-  0x20, 0x2a, 0x20, 0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x20, 0x74, 0x68,
-  0x65, 0x69, 0x72, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x69, 0x6e,
-  0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2e, 0x20,
-  0x2a, 0x2f, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x61, 0x64, 0x64, 0x4e, 0x6f,
-  0x64, 0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72,
-  0x61, 0x70, 0x68, 0x2c, 0x20, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x72, 0x6f,
-  0x6f, 0x74, 0x2c, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65,
-  0x6c, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x29, 0x3b, 0x0a, 0x76, 0x6f,
-  0x69, 0x64, 0x20, 0x61, 0x64, 0x64, 0x52, 0x6f, 0x6f, 0x74, 0x4e, 0x6f,
-  0x64, 0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72,
-  0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64,
-  0x65, 0x78, 0x29, 0x3b, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x61, 0x64, 0x64,
+  0x62, 0x79, 0x20, 0x61, 0x64, 0x76, 0x61, 0x6e, 0x63, 0x69, 0x6e, 0x67,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x20, 0x65,
+  0x70, 0x6f, 0x63, 0x68, 0x2c, 0x20, 0x73, 0x6f, 0x20, 0x74, 0x68, 0x61,
+  0x74, 0x20, 0x74, 0x68, 0x65, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x6d, 0x61,
+  0x74, 0x63, 0x68, 0x65, 0x64, 0x20, 0x65, 0x6e, 0x74, 0x72, 0x69, 0x65,
+  0x73, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x74, 0x65,
+  0x6d, 0x73, 0x20, 0x64, 0x6f, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x68, 0x61,
+  0x76, 0x65, 0x20, 0x74, 0x6f, 0x20, 0x62, 0x65, 0x20, 0x77, 0x72, 0x69,
+  0x74, 0x74, 0x65, 0x6e, 0x20, 0x62, 0x61, 0x63, 0x6b, 0x2e, 0x20, 0x54,
+  0x68, 0x65, 0x20, 0x65, 0x6e, 0x74, 0x72, 0x69, 0x65, 0x73, 0x20, 0x0a,
+  0x20, 0x2a, 0x20, 0x61, 0x72, 0x65, 0x20, 0x63, 0x6c, 0x65, 0x61, 0x72,
+  0x65, 0x64, 0x20, 0x6f, 0x6e, 0x6c, 0x79, 0x20, 0x77, 0x68, 0x65, 0x6e,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x65, 0x70, 0x6f, 0x63, 0x68, 0x20, 0x77,
+  0x72, 0x61, 0x70, 0x73, 0x20, 0x61, 0x72, 0x6f, 0x75, 0x6e, 0x64, 0x2e,
+  0x20, 0x2a, 0x2f, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x72, 0x65, 0x73,
+  0x65, 0x74, 0x4d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x64, 0x46, 0x6c, 0x61,
+  0x67, 0x73, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72,
+  0x61, 0x70, 0x68, 0x29, 0x3b, 0x0a, 0x2f, 0x2a, 0x20, 0x52, 0x65, 0x6d,
+  0x6f, 0x76, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x68, 0x6f, 0x6c,
+  0x65, 0x73, 0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x6e, 0x6f, 0x64, 0x65, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x20, 0x61,
+  0x6e, 0x64, 0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x65, 0x64, 0x67, 0x65, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x20, 0x69,
+  0x66, 0x20, 0x61, 0x74, 0x20, 0x6c, 0x65, 0x61, 0x73, 0x74, 0x0a, 0x20,
+  0x2a, 0x20, 0x68, 0x61, 0x6c, 0x66, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x27, 0x73, 0x20, 0x73, 0x6c,
+  0x6f, 0x74, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x68, 0x6f, 0x6c, 0x65,
+  0x73, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6c, 0x69, 0x76, 0x65, 0x20,
+  0x69, 0x74, 0x65, 0x6d, 0x73, 0x20, 0x6b, 0x65, 0x65, 0x70, 0x20, 0x74,
+  0x68, 0x65, 0x69, 0x72, 0x20, 0x72, 0x65, 0x6c, 0x61, 0x74, 0x69, 0x76,
+  0x65, 0x0a, 0x20, 0x2a, 0x20, 0x6f, 0x72, 0x64, 0x65, 0x72, 0x20, 0x61,
+  0x6e, 0x64, 0x20, 0x61, 0x6c, 0x6c, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20,
+  0x61, 0x6e, 0x64, 0x20, 0x65, 0x64, 0x67, 0x65, 0x20, 0x69, 0x6e, 0x64,
+  0x69, 0x63, 0x65, 0x73, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x64, 0x20,
+  0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68,
+  0x20, 0x61, 0x72, 0x65, 0x20, 0x72, 0x65, 0x6d, 0x61, 0x70, 0x70, 0x65,
+  0x64, 0x2e, 0x0a, 0x20, 0x2a, 0x20, 0x49, 0x6e, 0x64, 0x69, 0x63, 0x65,
+  0x73, 0x20, 0x68, 0x65, 0x6c, 0x64, 0x20, 0x6f, 0x75, 0x74, 0x73, 0x69,
+  0x64, 0x65, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68,
+  0x2c, 0x20, 0x73, 0x75, 0x63, 0x68, 0x20, 0x61, 0x73, 0x20, 0x74, 0x68,
+  0x6f, 0x73, 0x65, 0x20, 0x69, 0x6e, 0x20, 0x6d, 0x6f, 0x72, 0x70, 0x68,
+  0x69, 0x73, 0x6d, 0x73, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x69, 0x6e, 0x20,
+  0x67, 0x72, 0x61, 0x70, 0x68, 0x0a, 0x20, 0x2a, 0x20, 0x63, 0x68, 0x61,
+  0x6e, 0x67, 0x65, 0x20, 0x72, 0x65, 0x63, 0x6f, 0x72, 0x64, 0x73, 0x2c,
+  0x20, 0x61, 0x72, 0x65, 0x20, 0x69, 0x6e, 0x76, 0x61, 0x6c, 0x69, 0x64,
+  0x61, 0x74, 0x65, 0x64, 0x2e, 0x20, 0x53, 0x65, 0x65, 0x20, 0x63, 0x6f,
+  0x6d, 0x70, 0x61, 0x63, 0x74, 0x47, 0x72, 0x61, 0x70, 0x68, 0x41, 0x74,
+  0x53, 0x61, 0x66, 0x65, 0x50, 0x6f, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e,
+  0x20, 0x0a, 0x20, 0x2a, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x53, 0x74,
+  0x61, 0x63, 0x6b, 0x73, 0x2e, 0x68, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x76,
+  0x6f, 0x69, 0x64, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x61, 0x63, 0x74, 0x47,
+  0x72, 0x61, 0x70, 0x68, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a,
+  0x67, 0x72, 0x61, 0x70, 0x68, 0x29, 0x3b, 0x0a, 0x2f, 0x2a, 0x20, 0x6c,
+  0x69, 0x6e, 0x6b, 0x45, 0x64, 0x67, 0x65, 0x20, 0x61, 0x64, 0x64, 0x73,
+  0x20, 0x61, 0x6e, 0x20, 0x65, 0x64, 0x67, 0x65, 0x20, 0x74, 0x6f, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x69, 0x6e, 0x63, 0x69, 0x64, 0x65, 0x6e, 0x74,
+  0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x69, 0x74,
+  0x73, 0x20, 0x73, 0x6f, 0x75, 0x72, 0x63, 0x65, 0x20, 0x61, 0x6e, 0x64,
+  0x20, 0x74, 0x61, 0x72, 0x67, 0x65, 0x74, 0x2c, 0x0a, 0x20, 0x2a, 0x20,
+  0x75, 0x70, 0x64, 0x61, 0x74, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65, 0x69,
+  0x72, 0x20, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x73, 0x20, 0x61, 0x6e,
+  0x64, 0x20, 0x73, 0x65, 0x74, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x65,
+  0x64, 0x67, 0x65, 0x27, 0x73, 0x20, 0x64, 0x65, 0x6e, 0x73, 0x65, 0x20,
+  0x61, 0x72, 0x72, 0x61, 0x79, 0x20, 0x65, 0x6e, 0x74, 0x72, 0x69, 0x65,
+  0x73, 0x2e, 0x20, 0x75, 0x6e, 0x6c, 0x69, 0x6e, 0x6b, 0x45, 0x64, 0x67,
+  0x65, 0x0a, 0x20, 0x2a, 0x20, 0x72, 0x65, 0x76, 0x65, 0x72, 0x73, 0x65,
+  0x73, 0x20, 0x6c, 0x69, 0x6e, 0x6b, 0x45, 0x64, 0x67, 0x65, 0x2e, 0x20,
+  0x2a, 0x2f, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x6c, 0x69, 0x6e, 0x6b,
   0x45, 0x64, 0x67, 0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a,
-  0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c,
-  0x61, 0x62, 0x65, 0x6c, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x2c, 0x20,
-  0x69, 0x6e, 0x74, 0x20, 0x73, 0x6f, 0x75, 0x72, 0x63, 0x65, 0x5f, 0x69,
-  0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x74, 0x61,
-  0x72, 0x67, 0x65, 0x74, 0x5f, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b,
-  0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x72, 0x65, 0x6d, 0x6f, 0x76, 0x65,
-  0x4e, 0x6f, 0x64, 0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a,
   0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69,
   0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20,
-  0x72, 0x65, 0x6d, 0x6f, 0x76, 0x65, 0x52, 0x6f, 0x6f, 0x74, 0x4e, 0x6f,
-  0x64, 0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72,
-  0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64,
-  0x65, 0x78, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x72, 0x65,
-  0x6d, 0x6f, 0x76, 0x65, 0x45, 0x64, 0x67, 0x65, 0x28, 0x47, 0x72, 0x61,
-  0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69,
-  0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x76,
-  0x6f, 0x69, 0x64, 0x20, 0x72, 0x65, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x4e,
-  0x6f, 0x64, 0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67,
-  0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e,
-  0x64, 0x65, 0x78, 0x2c, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62,
-  0x65, 0x6c, 0x20, 0x6e, 0x65, 0x77, 0x5f, 0x6c, 0x61, 0x62, 0x65, 0x6c,
-  0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x63, 0x68, 0x61, 0x6e,
-  0x67, 0x65, 0x4e, 0x6f, 0x64, 0x65, 0x4d, 0x61, 0x72, 0x6b, 0x28, 0x47,
+  0x75, 0x6e, 0x6c, 0x69, 0x6e, 0x6b, 0x45, 0x64, 0x67, 0x65, 0x28, 0x47,
   0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c,
-  0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20,
-  0x4d, 0x61, 0x72, 0x6b, 0x54, 0x79, 0x70, 0x65, 0x20, 0x6e, 0x65, 0x77,
-  0x5f, 0x6d, 0x61, 0x72, 0x6b, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64,
-  0x20, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x52, 0x6f, 0x6f, 0x74, 0x28,
+  0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b,
+  0x0a, 0x2f, 0x2a, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x4e, 0x6f, 0x64,
+  0x65, 0x20, 0x63, 0x6f, 0x70, 0x69, 0x65, 0x73, 0x20, 0x61, 0x20, 0x6e,
+  0x6f, 0x64, 0x65, 0x27, 0x73, 0x20, 0x6d, 0x61, 0x72, 0x6b, 0x2c, 0x20,
+  0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x73, 0x20, 0x61, 0x6e, 0x64, 0x20,
+  0x72, 0x6f, 0x6f, 0x74, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x20,
+  0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x64, 0x65, 0x6e, 0x73, 0x65,
+  0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x73, 0x0a, 0x20, 0x2a, 0x20, 0x61,
+  0x6e, 0x64, 0x20, 0x6d, 0x6f, 0x76, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x73, 0x69, 0x67, 0x6e, 0x61, 0x74, 0x75, 0x72, 0x65, 0x20, 0x62,
+  0x75, 0x63, 0x6b, 0x65, 0x74, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x6f,
+  0x73, 0x65, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x73, 0x2c, 0x20, 0x69,
+  0x66, 0x20, 0x69, 0x74, 0x20, 0x69, 0x73, 0x20, 0x6e, 0x6f, 0x74, 0x0a,
+  0x20, 0x2a, 0x20, 0x61, 0x6c, 0x72, 0x65, 0x61, 0x64, 0x79, 0x20, 0x74,
+  0x68, 0x65, 0x72, 0x65, 0x2c, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x74, 0x6f,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x69,
+  0x6e, 0x64, 0x65, 0x78, 0x20, 0x62, 0x75, 0x63, 0x6b, 0x65, 0x74, 0x20,
+  0x6f, 0x66, 0x20, 0x69, 0x74, 0x73, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x2e,
+  0x20, 0x75, 0x6e, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x4e, 0x6f, 0x64, 0x65,
+  0x20, 0x0a, 0x20, 0x2a, 0x20, 0x72, 0x65, 0x6d, 0x6f, 0x76, 0x65, 0x73,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x66, 0x72,
+  0x6f, 0x6d, 0x20, 0x62, 0x6f, 0x74, 0x68, 0x20, 0x69, 0x6e, 0x64, 0x69,
+  0x63, 0x65, 0x73, 0x2e, 0x20, 0x43, 0x61, 0x6c, 0x6c, 0x65, 0x64, 0x20,
+  0x62, 0x79, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68,
+  0x20, 0x6d, 0x6f, 0x64, 0x69, 0x66, 0x69, 0x63, 0x61, 0x74, 0x69, 0x6f,
+  0x6e, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x73, 0x20,
+  0x61, 0x62, 0x6f, 0x76, 0x65, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x79, 0x20,
+  0x61, 0x72, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x65, 0x78, 0x70, 0x6f, 0x73,
+  0x65, 0x64, 0x20, 0x66, 0x6f, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67,
+  0x72, 0x61, 0x70, 0x68, 0x20, 0x62, 0x61, 0x63, 0x6b, 0x74, 0x72, 0x61,
+  0x63, 0x6b, 0x69, 0x6e, 0x67, 0x20, 0x63, 0x6f, 0x64, 0x65, 0x2c, 0x20,
+  0x77, 0x68, 0x69, 0x63, 0x68, 0x20, 0x72, 0x65, 0x73, 0x74, 0x6f, 0x72,
+  0x65, 0x73, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x20, 0x61, 0x6e, 0x64,
+  0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x0a, 0x20, 0x2a, 0x20, 0x77, 0x69,
+  0x74, 0x68, 0x6f, 0x75, 0x74, 0x20, 0x63, 0x61, 0x6c, 0x6c, 0x69, 0x6e,
+  0x67, 0x20, 0x74, 0x68, 0x65, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69,
+  0x6f, 0x6e, 0x73, 0x20, 0x61, 0x62, 0x6f, 0x76, 0x65, 0x2e, 0x20, 0x2a,
+  0x2f, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78,
+  0x4e, 0x6f, 0x64, 0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a,
+  0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69,
+  0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20,
+  0x75, 0x6e, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x4e, 0x6f, 0x64, 0x65, 0x28,
   0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68,
   0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29,
-  0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x72, 0x65, 0x73, 0x65, 0x74,
-  0x4d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x64, 0x4e, 0x6f, 0x64, 0x65, 0x46,
-  0x6c, 0x61, 0x67, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67,
-  0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e,
-  0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x72,
-  0x65, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x45, 0x64, 0x67, 0x65, 0x28, 0x47,
-  0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c,
-  0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20,
-  0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x6e, 0x65,
-  0x77, 0x5f, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x29, 0x3b, 0x0a, 0x76, 0x6f,
-  0x69, 0x64, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x45, 0x64, 0x67,
-  0x65, 0x4d, 0x61, 0x72, 0x6b, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20,
-  0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20,
-  0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20, 0x4d, 0x61, 0x72, 0x6b, 0x54,
-  0x79, 0x70, 0x65, 0x20, 0x6e, 0x65, 0x77, 0x5f, 0x6d, 0x61, 0x72, 0x6b,
-  0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x72, 0x65, 0x73, 0x65,
-  0x74, 0x4d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x64, 0x45, 0x64, 0x67, 0x65,
-  0x46, 0x6c, 0x61, 0x67, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a,
-  0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69,
-  0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x3d,
-  0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d,
+  0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x72, 0x65, 0x6c, 0x61, 0x62,
+  0x65, 0x6c, 0x45, 0x64, 0x67, 0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68,
+  0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74,
+  0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20, 0x48, 0x6f, 0x73, 0x74,
+  0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x6e, 0x65, 0x77, 0x5f, 0x6c, 0x61,
+  0x62, 0x65, 0x6c, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x63,
+  0x68, 0x61, 0x6e, 0x67, 0x65, 0x45, 0x64, 0x67, 0x65, 0x4d, 0x61, 0x72,
+  0x6b, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61,
+  0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65,
+  0x78, 0x2c, 0x20, 0x4d, 0x61, 0x72, 0x6b, 0x54, 0x79, 0x70, 0x65, 0x20,
+  0x6e, 0x65, 0x77, 0x5f, 0x6d, 0x61, 0x72, 0x6b, 0x29, 0x3b, 0x0a, 0x76,
+  0x6f, 0x69, 0x64, 0x20, 0x72, 0x65, 0x73, 0x65, 0x74, 0x4d, 0x61, 0x74,
+  0x63, 0x68, 0x65, 0x64, 0x45, 0x64, 0x67, 0x65, 0x46, 0x6c, 0x61, 0x67,
+  0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70,
+  0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78,
+  0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x43, 0x6f, 0x70, 0x79, 0x2d,
+  0x6f, 0x6e, 0x2d, 0x77, 0x72, 0x69, 0x74, 0x65, 0x20, 0x73, 0x6e, 0x61,
+  0x70, 0x73, 0x68, 0x6f, 0x74, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x20,
+  0x67, 0x72, 0x61, 0x70, 0x68, 0x2e, 0x20, 0x70, 0x75, 0x73, 0x68, 0x47,
+  0x72, 0x61, 0x70, 0x68, 0x53, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74,
+  0x20, 0x72, 0x65, 0x63, 0x6f, 0x72, 0x64, 0x73, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x73, 0x69, 0x7a, 0x65, 0x73, 0x20, 0x6f, 0x66, 0x0a, 0x20, 0x2a,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x27, 0x73,
+  0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x73, 0x20, 0x61, 0x6e, 0x64, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x6f, 0x74, 0x68, 0x65, 0x72, 0x20, 0x67, 0x72,
+  0x61, 0x70, 0x68, 0x2d, 0x6c, 0x65, 0x76, 0x65, 0x6c, 0x20, 0x66, 0x69,
+  0x65, 0x6c, 0x64, 0x73, 0x2c, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x72, 0x65,
+  0x74, 0x75, 0x72, 0x6e, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x75,
+  0x6d, 0x62, 0x65, 0x72, 0x0a, 0x20, 0x2a, 0x20, 0x6f, 0x66, 0x20, 0x73,
+  0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x73, 0x20, 0x62, 0x65, 0x6c,
+  0x6f, 0x77, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x65, 0x77, 0x20, 0x6f,
+  0x6e, 0x65, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x63, 0x6f, 0x6e, 0x74,
+  0x65, 0x6e, 0x74, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x61, 0x72, 0x72, 0x61, 0x79, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x6e,
+  0x6f, 0x74, 0x20, 0x63, 0x6f, 0x70, 0x69, 0x65, 0x64, 0x2e, 0x0a, 0x20,
+  0x2a, 0x20, 0x49, 0x6e, 0x73, 0x74, 0x65, 0x61, 0x64, 0x2c, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x61, 0x72, 0x72, 0x61,
+  0x79, 0x2c, 0x20, 0x74, 0x68, 0x65, 0x20, 0x65, 0x64, 0x67, 0x65, 0x20,
+  0x61, 0x72, 0x72, 0x61, 0x79, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x68, 0x6f, 0x6c, 0x65, 0x73, 0x20, 0x61, 0x72, 0x72, 0x61,
+  0x79, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x64, 0x69, 0x76, 0x69, 0x64,
+  0x65, 0x64, 0x0a, 0x20, 0x2a, 0x20, 0x69, 0x6e, 0x74, 0x6f, 0x20, 0x70,
+  0x61, 0x67, 0x65, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x63, 0x6f, 0x6e, 0x73,
+  0x65, 0x63, 0x75, 0x74, 0x69, 0x76, 0x65, 0x20, 0x73, 0x6c, 0x6f, 0x74,
+  0x73, 0x2c, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67,
+  0x72, 0x61, 0x70, 0x68, 0x20, 0x6d, 0x6f, 0x64, 0x69, 0x66, 0x69, 0x63,
+  0x61, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69,
+  0x6f, 0x6e, 0x73, 0x20, 0x73, 0x61, 0x76, 0x65, 0x0a, 0x20, 0x2a, 0x20,
+  0x61, 0x20, 0x70, 0x61, 0x67, 0x65, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x74, 0x6f, 0x70, 0x20, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68,
+  0x6f, 0x74, 0x20, 0x62, 0x65, 0x66, 0x6f, 0x72, 0x65, 0x20, 0x74, 0x68,
+  0x65, 0x79, 0x20, 0x66, 0x69, 0x72, 0x73, 0x74, 0x20, 0x6d, 0x6f, 0x64,
+  0x69, 0x66, 0x79, 0x20, 0x69, 0x74, 0x2e, 0x20, 0x4f, 0x6e, 0x6c, 0x79,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x70, 0x61, 0x67, 0x65, 0x73, 0x20, 0x0a,
+  0x20, 0x2a, 0x20, 0x6d, 0x6f, 0x64, 0x69, 0x66, 0x69, 0x65, 0x64, 0x20,
+  0x61, 0x66, 0x74, 0x65, 0x72, 0x20, 0x61, 0x20, 0x73, 0x6e, 0x61, 0x70,
+  0x73, 0x68, 0x6f, 0x74, 0x20, 0x69, 0x73, 0x20, 0x74, 0x61, 0x6b, 0x65,
+  0x6e, 0x20, 0x61, 0x72, 0x65, 0x20, 0x65, 0x76, 0x65, 0x72, 0x20, 0x63,
+  0x6f, 0x70, 0x69, 0x65, 0x64, 0x2e, 0x0a, 0x20, 0x2a, 0x0a, 0x20, 0x2a,
+  0x20, 0x72, 0x65, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x47, 0x72, 0x61, 0x70,
+  0x68, 0x53, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x20, 0x63, 0x6f,
+  0x70, 0x69, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x61, 0x76,
+  0x65, 0x64, 0x20, 0x70, 0x61, 0x67, 0x65, 0x73, 0x20, 0x62, 0x61, 0x63,
+  0x6b, 0x2c, 0x20, 0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x69, 0x6e, 0x67,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x74,
+  0x6f, 0x20, 0x69, 0x74, 0x73, 0x0a, 0x20, 0x2a, 0x20, 0x73, 0x74, 0x61,
+  0x74, 0x65, 0x20, 0x61, 0x74, 0x20, 0x74, 0x68, 0x65, 0x20, 0x74, 0x69,
+  0x6d, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x74, 0x6f,
+  0x70, 0x20, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x2c, 0x20,
+  0x61, 0x6e, 0x64, 0x20, 0x72, 0x65, 0x6d, 0x6f, 0x76, 0x65, 0x73, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74,
+  0x2e, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x64, 0x72, 0x6f, 0x70, 0x47, 0x72,
+  0x61, 0x70, 0x68, 0x53, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x20,
+  0x72, 0x65, 0x6d, 0x6f, 0x76, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x74, 0x6f, 0x70, 0x20, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74,
+  0x20, 0x61, 0x6e, 0x64, 0x20, 0x6b, 0x65, 0x65, 0x70, 0x73, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x63, 0x75, 0x72, 0x72, 0x65, 0x6e, 0x74, 0x20, 0x73,
+  0x74, 0x61, 0x74, 0x65, 0x2e, 0x20, 0x49, 0x74, 0x73, 0x0a, 0x20, 0x2a,
+  0x20, 0x73, 0x61, 0x76, 0x65, 0x64, 0x20, 0x70, 0x61, 0x67, 0x65, 0x73,
+  0x20, 0x61, 0x72, 0x65, 0x20, 0x70, 0x61, 0x73, 0x73, 0x65, 0x64, 0x20,
+  0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x6e, 0x61, 0x70, 0x73,
+  0x68, 0x6f, 0x74, 0x20, 0x62, 0x65, 0x6c, 0x6f, 0x77, 0x20, 0x69, 0x74,
+  0x20, 0x69, 0x66, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x73, 0x6e, 0x61,
+  0x70, 0x73, 0x68, 0x6f, 0x74, 0x20, 0x68, 0x61, 0x73, 0x20, 0x6e, 0x6f,
+  0x74, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x73, 0x61, 0x76, 0x65, 0x64, 0x20,
+  0x74, 0x68, 0x65, 0x6d, 0x20, 0x69, 0x74, 0x73, 0x65, 0x6c, 0x66, 0x2e,
+  0x20, 0x54, 0x68, 0x65, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x64,
+  0x20, 0x66, 0x6c, 0x61, 0x67, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x6e,
+  0x6f, 0x74, 0x20, 0x70, 0x61, 0x72, 0x74, 0x20, 0x6f, 0x66, 0x20, 0x61,
+  0x20, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x3a, 0x20, 0x72,
+  0x65, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x64, 0x0a, 0x20, 0x2a, 0x20, 0x69,
+  0x74, 0x65, 0x6d, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x75, 0x6e, 0x6d,
+  0x61, 0x74, 0x63, 0x68, 0x65, 0x64, 0x2e, 0x20, 0x63, 0x6f, 0x6d, 0x70,
+  0x61, 0x63, 0x74, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x6d, 0x75, 0x73,
+  0x74, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x62, 0x65, 0x20, 0x63, 0x61, 0x6c,
+  0x6c, 0x65, 0x64, 0x20, 0x6f, 0x6e, 0x20, 0x61, 0x20, 0x67, 0x72, 0x61,
+  0x70, 0x68, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x61, 0x20, 0x0a, 0x20,
+  0x2a, 0x20, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x2e, 0x20,
+  0x2a, 0x2f, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x70, 0x75, 0x73, 0x68, 0x47,
+  0x72, 0x61, 0x70, 0x68, 0x53, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74,
+  0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70,
+  0x68, 0x29, 0x3b, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x63, 0x6f, 0x75, 0x6e,
+  0x74, 0x47, 0x72, 0x61, 0x70, 0x68, 0x53, 0x6e, 0x61, 0x70, 0x73, 0x68,
+  0x6f, 0x74, 0x73, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67,
+  0x72, 0x61, 0x70, 0x68, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20,
+  0x72, 0x65, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x47, 0x72, 0x61, 0x70, 0x68,
+  0x53, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x28, 0x47, 0x72, 0x61,
+  0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x29, 0x3b, 0x0a,
+  0x76, 0x6f, 0x69, 0x64, 0x20, 0x64, 0x72, 0x6f, 0x70, 0x47, 0x72, 0x61,
+  0x70, 0x68, 0x53, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x28, 0x47,
+  0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x29,
+  0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x73, 0x74,
+  0x61, 0x74, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x20, 0x67, 0x65, 0x6e,
+  0x65, 0x72, 0x61, 0x74, 0x65, 0x64, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68,
+  0x65, 0x72, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x72, 0x65, 0x73, 0x75,
+  0x6d, 0x65, 0x73, 0x20, 0x69, 0x74, 0x73, 0x20, 0x73, 0x65, 0x61, 0x72,
+  0x63, 0x68, 0x20, 0x66, 0x6f, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x66,
+  0x69, 0x72, 0x73, 0x74, 0x20, 0x72, 0x75, 0x6c, 0x65, 0x0a, 0x20, 0x2a,
+  0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x77, 0x68, 0x65, 0x72, 0x65, 0x20,
+  0x69, 0x74, 0x73, 0x20, 0x70, 0x72, 0x65, 0x76, 0x69, 0x6f, 0x75, 0x73,
+  0x20, 0x73, 0x65, 0x61, 0x72, 0x63, 0x68, 0x20, 0x73, 0x74, 0x6f, 0x70,
+  0x70, 0x65, 0x64, 0x2c, 0x20, 0x69, 0x6e, 0x73, 0x74, 0x65, 0x61, 0x64,
+  0x20, 0x6f, 0x66, 0x20, 0x72, 0x65, 0x73, 0x63, 0x61, 0x6e, 0x6e, 0x69,
+  0x6e, 0x67, 0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x69, 0x67, 0x6e, 0x61,
+  0x74, 0x75, 0x72, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x62, 0x75, 0x63, 0x6b,
+  0x65, 0x74, 0x73, 0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x73, 0x74, 0x61, 0x72, 0x74, 0x2e, 0x20, 0x41, 0x20, 0x68, 0x6f,
+  0x73, 0x74, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x70, 0x61, 0x73, 0x73,
+  0x65, 0x64, 0x20, 0x6f, 0x76, 0x65, 0x72, 0x20, 0x62, 0x79, 0x20, 0x61,
+  0x6e, 0x20, 0x65, 0x61, 0x72, 0x6c, 0x69, 0x65, 0x72, 0x20, 0x73, 0x65,
+  0x61, 0x72, 0x63, 0x68, 0x20, 0x64, 0x69, 0x64, 0x20, 0x6e, 0x6f, 0x74,
+  0x0a, 0x20, 0x2a, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x20, 0x74, 0x68,
+  0x65, 0x6e, 0x2c, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x63, 0x61, 0x6e, 0x20,
+  0x6d, 0x61, 0x74, 0x63, 0x68, 0x20, 0x6e, 0x6f, 0x77, 0x20, 0x6f, 0x6e,
+  0x6c, 0x79, 0x20, 0x69, 0x66, 0x20, 0x61, 0x20, 0x6e, 0x6f, 0x64, 0x65,
+  0x20, 0x77, 0x69, 0x74, 0x68, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x72, 0x75, 0x6c, 0x65, 0x27, 0x73, 0x20, 0x72, 0x61, 0x64, 0x69, 0x75,
+  0x73, 0x20, 0x6f, 0x66, 0x20, 0x69, 0x74, 0x0a, 0x20, 0x2a, 0x20, 0x68,
+  0x61, 0x73, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x64, 0x20, 0x73,
+  0x69, 0x6e, 0x63, 0x65, 0x3a, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x61,
+  0x64, 0x69, 0x75, 0x73, 0x20, 0x69, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x6c, 0x61, 0x72, 0x67, 0x65, 0x73, 0x74, 0x20, 0x64, 0x69, 0x73, 0x74,
+  0x61, 0x6e, 0x63, 0x65, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x4c, 0x48, 0x53, 0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x0a, 0x20, 0x2a, 0x20, 0x66, 0x69, 0x72, 0x73, 0x74, 0x20, 0x72,
+  0x75, 0x6c, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x74, 0x6f, 0x20,
+  0x61, 0x6e, 0x79, 0x20, 0x6f, 0x74, 0x68, 0x65, 0x72, 0x20, 0x72, 0x75,
+  0x6c, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x2c, 0x20, 0x77, 0x68, 0x69,
+  0x63, 0x68, 0x20, 0x6d, 0x75, 0x73, 0x74, 0x20, 0x61, 0x6c, 0x6c, 0x20,
+  0x62, 0x65, 0x20, 0x63, 0x6f, 0x6e, 0x6e, 0x65, 0x63, 0x74, 0x65, 0x64,
+  0x20, 0x74, 0x6f, 0x20, 0x69, 0x74, 0x2e, 0x0a, 0x20, 0x2a, 0x0a, 0x20,
+  0x2a, 0x20, 0x75, 0x70, 0x64, 0x61, 0x74, 0x65, 0x53, 0x65, 0x61, 0x72,
+  0x63, 0x68, 0x52, 0x65, 0x73, 0x75, 0x6d, 0x65, 0x20, 0x72, 0x65, 0x61,
+  0x64, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6a, 0x6f, 0x75, 0x72, 0x6e,
+  0x61, 0x6c, 0x20, 0x65, 0x6e, 0x74, 0x72, 0x69, 0x65, 0x73, 0x20, 0x77,
+  0x72, 0x69, 0x74, 0x74, 0x65, 0x6e, 0x20, 0x73, 0x69, 0x6e, 0x63, 0x65,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x70, 0x72, 0x65, 0x76, 0x69, 0x6f, 0x75,
+  0x73, 0x0a, 0x20, 0x2a, 0x20, 0x63, 0x61, 0x6c, 0x6c, 0x20, 0x61, 0x6e,
+  0x64, 0x20, 0x61, 0x64, 0x64, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6c,
+  0x69, 0x76, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x20, 0x77, 0x69,
+  0x74, 0x68, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x61, 0x64,
+  0x69, 0x75, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x63,
+  0x68, 0x61, 0x6e, 0x67, 0x65, 0x64, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73,
+  0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x70,
+  0x65, 0x6e, 0x64, 0x69, 0x6e, 0x67, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73,
+  0x2c, 0x20, 0x77, 0x68, 0x69, 0x63, 0x68, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x6d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x72, 0x20, 0x74, 0x72, 0x69, 0x65,
+  0x73, 0x20, 0x62, 0x65, 0x66, 0x6f, 0x72, 0x65, 0x20, 0x63, 0x6f, 0x6e,
+  0x74, 0x69, 0x6e, 0x75, 0x69, 0x6e, 0x67, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x73, 0x63, 0x61, 0x6e, 0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x0a, 0x20,
+  0x2a, 0x20, 0x62, 0x75, 0x63, 0x6b, 0x65, 0x74, 0x20, 0x61, 0x6e, 0x64,
+  0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x28, 0x2d, 0x31, 0x20, 0x66,
+  0x6f, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x74, 0x61, 0x72, 0x74,
+  0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x62, 0x75, 0x63, 0x6b,
+  0x65, 0x74, 0x29, 0x2e, 0x20, 0x49, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x6a, 0x6f, 0x75, 0x72, 0x6e, 0x61, 0x6c, 0x20, 0x68, 0x61, 0x73, 0x20,
+  0x62, 0x65, 0x65, 0x6e, 0x0a, 0x20, 0x2a, 0x20, 0x72, 0x65, 0x73, 0x65,
+  0x74, 0x20, 0x6f, 0x72, 0x20, 0x68, 0x61, 0x73, 0x20, 0x6f, 0x76, 0x65,
+  0x72, 0x66, 0x6c, 0x6f, 0x77, 0x65, 0x64, 0x20, 0x73, 0x69, 0x6e, 0x63,
+  0x65, 0x20, 0x74, 0x68, 0x65, 0x20, 0x70, 0x72, 0x65, 0x76, 0x69, 0x6f,
+  0x75, 0x73, 0x20, 0x63, 0x61, 0x6c, 0x6c, 0x2c, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x70, 0x65, 0x6e, 0x64, 0x69, 0x6e, 0x67, 0x20, 0x6e, 0x6f, 0x64,
+  0x65, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x64,
+  0x72, 0x6f, 0x70, 0x70, 0x65, 0x64, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x73, 0x63, 0x61, 0x6e, 0x20, 0x72, 0x65, 0x73, 0x74,
+  0x61, 0x72, 0x74, 0x73, 0x2e, 0x20, 0x41, 0x20, 0x7a, 0x65, 0x72, 0x6f,
+  0x2d, 0x69, 0x6e, 0x69, 0x74, 0x69, 0x61, 0x6c, 0x69, 0x73, 0x65, 0x64,
+  0x20, 0x53, 0x65, 0x61, 0x72, 0x63, 0x68, 0x52, 0x65, 0x73, 0x75, 0x6d,
+  0x65, 0x20, 0x72, 0x65, 0x73, 0x74, 0x61, 0x72, 0x74, 0x73, 0x20, 0x74,
+  0x68, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x73, 0x63, 0x61, 0x6e, 0x2e, 0x20,
+  0x41, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x72, 0x20, 0x6b, 0x65,
+  0x65, 0x70, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65,
+  0x20, 0x69, 0x74, 0x20, 0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x73, 0x20,
+  0x70, 0x65, 0x6e, 0x64, 0x69, 0x6e, 0x67, 0x2c, 0x20, 0x6f, 0x72, 0x20,
+  0x61, 0x74, 0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x63, 0x61, 0x6e, 0x20,
+  0x70, 0x6f, 0x73, 0x69, 0x74, 0x69, 0x6f, 0x6e, 0x2c, 0x0a, 0x20, 0x2a,
+  0x20, 0x62, 0x65, 0x63, 0x61, 0x75, 0x73, 0x65, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x20, 0x6d, 0x69, 0x67, 0x68, 0x74,
+  0x20, 0x6e, 0x6f, 0x74, 0x20, 0x62, 0x65, 0x20, 0x61, 0x70, 0x70, 0x6c,
+  0x69, 0x65, 0x64, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x74, 0x79, 0x70, 0x65,
+  0x64, 0x65, 0x66, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x53,
+  0x65, 0x61, 0x72, 0x63, 0x68, 0x52, 0x65, 0x73, 0x75, 0x6d, 0x65, 0x20,
+  0x7b, 0x0a, 0x20, 0x20, 0x20, 0x6c, 0x6f, 0x6e, 0x67, 0x20, 0x6a, 0x6f,
+  0x75, 0x72, 0x6e, 0x61, 0x6c, 0x5f, 0x70, 0x6f, 0x73, 0x69, 0x74, 0x69,
+  0x6f, 0x6e, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x62,
+  0x75, 0x63, 0x6b, 0x65, 0x74, 0x2c, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78,
+  0x3b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x2a, 0x70, 0x65,
+  0x6e, 0x64, 0x69, 0x6e, 0x67, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e,
+  0x74, 0x20, 0x70, 0x65, 0x6e, 0x64, 0x69, 0x6e, 0x67, 0x5f, 0x73, 0x69,
+  0x7a, 0x65, 0x2c, 0x20, 0x70, 0x65, 0x6e, 0x64, 0x69, 0x6e, 0x67, 0x5f,
+  0x63, 0x61, 0x70, 0x61, 0x63, 0x69, 0x74, 0x79, 0x3b, 0x0a, 0x7d, 0x20,
+  0x53, 0x65, 0x61, 0x72, 0x63, 0x68, 0x52, 0x65, 0x73, 0x75, 0x6d, 0x65,
+  0x3b, 0x0a, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x75, 0x70, 0x64, 0x61,
+  0x74, 0x65, 0x53, 0x65, 0x61, 0x72, 0x63, 0x68, 0x52, 0x65, 0x73, 0x75,
+  0x6d, 0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72,
+  0x61, 0x70, 0x68, 0x2c, 0x20, 0x53, 0x65, 0x61, 0x72, 0x63, 0x68, 0x52,
+  0x65, 0x73, 0x75, 0x6d, 0x65, 0x20, 0x2a, 0x72, 0x65, 0x73, 0x75, 0x6d,
+  0x65, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x72, 0x61, 0x64, 0x69, 0x75,
+  0x73, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x41, 0x20, 0x72, 0x75,
+  0x6c, 0x65, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x66, 0x61, 0x69, 0x6c,
+  0x65, 0x64, 0x20, 0x74, 0x6f, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x20,
+  0x63, 0x61, 0x6e, 0x6e, 0x6f, 0x74, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68,
+  0x20, 0x75, 0x6e, 0x74, 0x69, 0x6c, 0x20, 0x61, 0x20, 0x6e, 0x6f, 0x64,
+  0x65, 0x20, 0x69, 0x73, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x64,
+  0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x61, 0x66,
+  0x74, 0x65, 0x72, 0x77, 0x61, 0x72, 0x64, 0x73, 0x20, 0x68, 0x61, 0x73,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x69, 0x67, 0x6e, 0x61, 0x74, 0x75,
+  0x72, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x20, 0x70, 0x6f, 0x73, 0x73,
+  0x69, 0x62, 0x6c, 0x65, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x20, 0x66,
+  0x6f, 0x72, 0x20, 0x6f, 0x6e, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x69, 0x74,
+  0x73, 0x20, 0x4c, 0x48, 0x53, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x2e,
+  0x0a, 0x20, 0x2a, 0x20, 0x72, 0x65, 0x6c, 0x65, 0x76, 0x61, 0x6e, 0x74,
+  0x20, 0x69, 0x73, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x65, 0x64, 0x20,
+  0x62, 0x79, 0x20, 0x73, 0x69, 0x67, 0x6e, 0x61, 0x74, 0x75, 0x72, 0x65,
+  0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x67, 0x65, 0x6e, 0x65, 0x72, 0x61,
+  0x74, 0x65, 0x64, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x72, 0x20,
+  0x73, 0x74, 0x6f, 0x72, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6a,
+  0x6f, 0x75, 0x72, 0x6e, 0x61, 0x6c, 0x0a, 0x20, 0x2a, 0x20, 0x63, 0x6f,
+  0x75, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x20, 0x66, 0x61, 0x69, 0x6c, 0x65,
+  0x64, 0x5f, 0x61, 0x74, 0x20, 0x77, 0x68, 0x65, 0x6e, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x72, 0x75, 0x6c, 0x65, 0x20, 0x66, 0x61, 0x69, 0x6c, 0x73,
+  0x2c, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x63, 0x61, 0x6c, 0x6c, 0x73, 0x20,
+  0x72, 0x65, 0x6c, 0x65, 0x76, 0x61, 0x6e, 0x74, 0x43, 0x68, 0x61, 0x6e,
+  0x67, 0x65, 0x53, 0x69, 0x6e, 0x63, 0x65, 0x20, 0x62, 0x65, 0x66, 0x6f,
+  0x72, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x73, 0x65, 0x61, 0x72, 0x63, 0x68,
+  0x69, 0x6e, 0x67, 0x20, 0x61, 0x67, 0x61, 0x69, 0x6e, 0x2e, 0x20, 0x49,
+  0x66, 0x20, 0x6e, 0x6f, 0x20, 0x72, 0x65, 0x6c, 0x65, 0x76, 0x61, 0x6e,
+  0x74, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x20, 0x68, 0x61, 0x73,
+  0x20, 0x62, 0x65, 0x65, 0x6e, 0x20, 0x6a, 0x6f, 0x75, 0x72, 0x6e, 0x61,
+  0x6c, 0x65, 0x64, 0x20, 0x73, 0x69, 0x6e, 0x63, 0x65, 0x2c, 0x20, 0x69,
+  0x74, 0x20, 0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x73, 0x0a, 0x20, 0x2a,
+  0x20, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x6d,
+  0x6f, 0x76, 0x65, 0x73, 0x20, 0x66, 0x61, 0x69, 0x6c, 0x65, 0x64, 0x5f,
+  0x61, 0x74, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x63, 0x75,
+  0x72, 0x72, 0x65, 0x6e, 0x74, 0x20, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x2c,
+  0x20, 0x73, 0x6f, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x65, 0x61, 0x63,
+  0x68, 0x20, 0x65, 0x6e, 0x74, 0x72, 0x79, 0x20, 0x69, 0x73, 0x20, 0x72,
+  0x65, 0x61, 0x64, 0x0a, 0x20, 0x2a, 0x20, 0x6f, 0x6e, 0x63, 0x65, 0x2e,
+  0x20, 0x4f, 0x74, 0x68, 0x65, 0x72, 0x77, 0x69, 0x73, 0x65, 0x2c, 0x20,
+  0x6f, 0x72, 0x20, 0x69, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6a, 0x6f,
+  0x75, 0x72, 0x6e, 0x61, 0x6c, 0x20, 0x68, 0x61, 0x73, 0x20, 0x62, 0x65,
+  0x65, 0x6e, 0x20, 0x72, 0x65, 0x73, 0x65, 0x74, 0x20, 0x6f, 0x72, 0x20,
+  0x68, 0x61, 0x73, 0x20, 0x6f, 0x76, 0x65, 0x72, 0x66, 0x6c, 0x6f, 0x77,
+  0x65, 0x64, 0x2c, 0x20, 0x69, 0x74, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x72,
+  0x65, 0x74, 0x75, 0x72, 0x6e, 0x73, 0x20, 0x74, 0x72, 0x75, 0x65, 0x20,
+  0x61, 0x6e, 0x64, 0x20, 0x73, 0x65, 0x74, 0x73, 0x20, 0x66, 0x61, 0x69,
+  0x6c, 0x65, 0x64, 0x5f, 0x61, 0x74, 0x20, 0x74, 0x6f, 0x20, 0x30, 0x2e,
+  0x20, 0x2a, 0x2f, 0x0a, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x72, 0x65, 0x6c,
+  0x65, 0x76, 0x61, 0x6e, 0x74, 0x43, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x53,
+  0x69, 0x6e, 0x63, 0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a,
+  0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x6c, 0x6f, 0x6e, 0x67, 0x20,
+  0x2a, 0x66, 0x61, 0x69, 0x6c, 0x65, 0x64, 0x5f, 0x61, 0x74, 0x2c, 0x20,
+  0x63, 0x6f, 0x6e, 0x73, 0x74, 0x20, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x2a,
+  0x72, 0x65, 0x6c, 0x65, 0x76, 0x61, 0x6e, 0x74, 0x29, 0x3b, 0x0a, 0x0a,
+  0x2f, 0x2a, 0x20, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d,
   0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d,
-  0x0a, 0x20, 0x2a, 0x20, 0x4e, 0x6f, 0x64, 0x65, 0x20, 0x61, 0x6e, 0x64,
-  0x20, 0x45, 0x64, 0x67, 0x65, 0x20, 0x44, 0x65, 0x66, 0x69, 0x6e, 0x69,
-  0x74, 0x69, 0x6f, 0x6e, 0x73, 0x0a, 0x20, 0x2a, 0x20, 0x3d, 0x3d, 0x3d,
+  0x3d, 0x3d, 0x3d, 0x3d, 0x0a, 0x20, 0x2a, 0x20, 0x4e, 0x6f, 0x64, 0x65,
+  0x20, 0x61, 0x6e, 0x64, 0x20, 0x45, 0x64, 0x67, 0x65, 0x20, 0x44, 0x65,
+  0x66, 0x69, 0x6e, 0x69, 0x74, 0x69, 0x6f, 0x6e, 0x73, 0x0a, 0x20, 0x2a,
+  0x20, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d,
   0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d,
-  0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x20, 0x2a,
-  0x2f, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x73, 0x74,
-  0x72, 0x75, 0x63, 0x74, 0x20, 0x4e, 0x6f, 0x64, 0x65, 0x20, 0x7b, 0x0a,
-  0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78,
-  0x3b, 0x0a, 0x20, 0x20, 0x20, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x72, 0x6f,
-  0x6f, 0x74, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c,
-  0x61, 0x62, 0x65, 0x6c, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x3b, 0x0a,
-  0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6f, 0x75, 0x74, 0x64, 0x65,
-  0x67, 0x72, 0x65, 0x65, 0x2c, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x67, 0x72,
-  0x65, 0x65, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x66,
-  0x69, 0x72, 0x73, 0x74, 0x5f, 0x6f, 0x75, 0x74, 0x5f, 0x65, 0x64, 0x67,
-  0x65, 0x2c, 0x20, 0x73, 0x65, 0x63, 0x6f, 0x6e, 0x64, 0x5f, 0x6f, 0x75,
-  0x74, 0x5f, 0x65, 0x64, 0x67, 0x65, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x69,
-  0x6e, 0x74, 0x20, 0x66, 0x69, 0x72, 0x73, 0x74, 0x5f, 0x69, 0x6e, 0x5f,
-  0x65, 0x64, 0x67, 0x65, 0x2c, 0x20, 0x73, 0x65, 0x63, 0x6f, 0x6e, 0x64,
-  0x5f, 0x69, 0x6e, 0x5f, 0x65, 0x64, 0x67, 0x65, 0x3b, 0x0a, 0x20, 0x20,
-  0x20, 0x2f, 0x2a, 0x20, 0x44, 0x79, 0x6e, 0x61, 0x6d, 0x69, 0x63, 0x20,
-  0x69, 0x6e, 0x74, 0x65, 0x67, 0x65, 0x72, 0x20, 0x61, 0x72, 0x72, 0x61,
-  0x79, 0x73, 0x20, 0x66, 0x6f, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e,
-  0x6f, 0x64, 0x65, 0x27, 0x73, 0x20, 0x6f, 0x75, 0x74, 0x67, 0x6f, 0x69,
-  0x6e, 0x67, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x69, 0x6e, 0x63, 0x6f, 0x6d,
-  0x69, 0x6e, 0x67, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x2e, 0x20, 0x2a,
-  0x2f, 0x0a, 0x20, 0x20, 0x20, 0x49, 0x6e, 0x74, 0x41, 0x72, 0x72, 0x61,
-  0x79, 0x20, 0x6f, 0x75, 0x74, 0x5f, 0x65, 0x64, 0x67, 0x65, 0x73, 0x2c,
-  0x20, 0x69, 0x6e, 0x5f, 0x65, 0x64, 0x67, 0x65, 0x73, 0x3b, 0x0a, 0x20,
-  0x20, 0x20, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68,
-  0x65, 0x64, 0x3b, 0x0a, 0x7d, 0x20, 0x4e, 0x6f, 0x64, 0x65, 0x3b, 0x0a,
-  0x0a, 0x65, 0x78, 0x74, 0x65, 0x72, 0x6e, 0x20, 0x73, 0x74, 0x72, 0x75,
-  0x63, 0x74, 0x20, 0x4e, 0x6f, 0x64, 0x65, 0x20, 0x64, 0x75, 0x6d, 0x6d,
-  0x79, 0x5f, 0x6e, 0x6f, 0x64, 0x65, 0x3b, 0x0a, 0x0a, 0x74, 0x79, 0x70,
-  0x65, 0x64, 0x65, 0x66, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20,
-  0x52, 0x6f, 0x6f, 0x74, 0x4e, 0x6f, 0x64, 0x65, 0x73, 0x20, 0x7b, 0x0a,
-  0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78,
-  0x3b, 0x0a, 0x20, 0x20, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20,
-  0x52, 0x6f, 0x6f, 0x74, 0x4e, 0x6f, 0x64, 0x65, 0x73, 0x20, 0x2a, 0x6e,
-  0x65, 0x78, 0x74, 0x3b, 0x0a, 0x7d, 0x20, 0x52, 0x6f, 0x6f, 0x74, 0x4e,
-  0x6f, 0x64, 0x65, 0x73, 0x3b, 0x0a, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64,
-  0x65, 0x66, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x45, 0x64,
-  0x67, 0x65, 0x20, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20,
-  0x69, 0x6e, 0x64, 0x65, 0x78, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x48, 0x6f,
-  0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x6c, 0x61, 0x62, 0x65,
-  0x6c, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x73, 0x6f,
-  0x75, 0x72, 0x63, 0x65, 0x2c, 0x20, 0x74, 0x61, 0x72, 0x67, 0x65, 0x74,
-  0x3b, 0x0a, 0x20, 0x20, 0x20, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x6d, 0x61,
-  0x74, 0x63, 0x68, 0x65, 0x64, 0x3b, 0x0a, 0x7d, 0x20, 0x45, 0x64, 0x67,
-  0x65, 0x3b, 0x0a, 0x0a, 0x65, 0x78, 0x74, 0x65, 0x72, 0x6e, 0x20, 0x73,
-  0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x45, 0x64, 0x67, 0x65, 0x20, 0x64,
-  0x75, 0x6d, 0x6d, 0x79, 0x5f, 0x65, 0x64, 0x67, 0x65, 0x3b, 0x0a, 0x0a,
-  0x2f, 0x2a, 0x20, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d,
+  0x3d, 0x3d, 0x20, 0x2a, 0x2f, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65,
+  0x66, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x4e, 0x6f, 0x64,
+  0x65, 0x20, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69,
+  0x6e, 0x64, 0x65, 0x78, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x62, 0x6f, 0x6f,
+  0x6c, 0x20, 0x72, 0x6f, 0x6f, 0x74, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x48,
+  0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x6c, 0x61, 0x62,
+  0x65, 0x6c, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6f,
+  0x75, 0x74, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x2c, 0x20, 0x69, 0x6e,
+  0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x2f,
+  0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6e, 0x75, 0x6d, 0x62, 0x65, 0x72,
+  0x20, 0x6f, 0x66, 0x20, 0x6c, 0x6f, 0x6f, 0x70, 0x73, 0x20, 0x69, 0x6e,
+  0x63, 0x69, 0x64, 0x65, 0x6e, 0x74, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x2e, 0x20, 0x4c, 0x6f, 0x6f, 0x70,
+  0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x61, 0x6c, 0x73, 0x6f, 0x20, 0x63,
+  0x6f, 0x75, 0x6e, 0x74, 0x65, 0x64, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68,
+  0x65, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x6f, 0x75, 0x74, 0x64,
+  0x65, 0x67, 0x72, 0x65, 0x65, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x2e, 0x20,
+  0x2a, 0x2f, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6c, 0x6f,
+  0x6f, 0x70, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x3b, 0x0a, 0x20, 0x20,
+  0x20, 0x49, 0x6e, 0x63, 0x69, 0x64, 0x65, 0x6e, 0x74, 0x45, 0x64, 0x67,
+  0x65, 0x73, 0x20, 0x6f, 0x75, 0x74, 0x5f, 0x65, 0x64, 0x67, 0x65, 0x73,
+  0x2c, 0x20, 0x69, 0x6e, 0x5f, 0x65, 0x64, 0x67, 0x65, 0x73, 0x3b, 0x0a,
+  0x20, 0x20, 0x20, 0x2f, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x73, 0x69,
+  0x67, 0x6e, 0x61, 0x74, 0x75, 0x72, 0x65, 0x20, 0x62, 0x75, 0x63, 0x6b,
+  0x65, 0x74, 0x20, 0x63, 0x6f, 0x6e, 0x74, 0x61, 0x69, 0x6e, 0x69, 0x6e,
+  0x67, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x28,
+  0x2d, 0x31, 0x20, 0x69, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f,
+  0x64, 0x65, 0x20, 0x69, 0x73, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x69, 0x6e,
+  0x20, 0x74, 0x68, 0x65, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x69,
+  0x6e, 0x64, 0x65, 0x78, 0x29, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x6c, 0x69,
+  0x6e, 0x6b, 0x73, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e,
+  0x65, 0x69, 0x67, 0x68, 0x62, 0x6f, 0x75, 0x72, 0x69, 0x6e, 0x67, 0x20,
+  0x6e, 0x6f, 0x64, 0x65, 0x73, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x61,
+  0x74, 0x20, 0x62, 0x75, 0x63, 0x6b, 0x65, 0x74, 0x2e, 0x20, 0x2a, 0x2f,
+  0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x73, 0x69, 0x67, 0x6e,
+  0x61, 0x74, 0x75, 0x72, 0x65, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e,
+  0x74, 0x20, 0x6e, 0x65, 0x78, 0x74, 0x5f, 0x62, 0x79, 0x5f, 0x73, 0x69,
+  0x67, 0x6e, 0x61, 0x74, 0x75, 0x72, 0x65, 0x2c, 0x20, 0x70, 0x72, 0x65,
+  0x76, 0x5f, 0x62, 0x79, 0x5f, 0x73, 0x69, 0x67, 0x6e, 0x61, 0x74, 0x75,
+  0x72, 0x65, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x2f, 0x2a, 0x20, 0x54, 0x68,
+  0x65, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20, 0x75, 0x6e, 0x64, 0x65, 0x72,
+  0x20, 0x77, 0x68, 0x69, 0x63, 0x68, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e,
+  0x6f, 0x64, 0x65, 0x20, 0x69, 0x73, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x69, 0x6e, 0x64, 0x65,
+  0x78, 0x20, 0x28, 0x4e, 0x55, 0x4c, 0x4c, 0x20, 0x69, 0x66, 0x20, 0x69,
+  0x74, 0x20, 0x69, 0x73, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x2a, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69,
+  0x6e, 0x64, 0x65, 0x78, 0x29, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x6c, 0x69,
+  0x6e, 0x6b, 0x73, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e,
+  0x65, 0x69, 0x67, 0x68, 0x62, 0x6f, 0x75, 0x72, 0x69, 0x6e, 0x67, 0x20,
+  0x6e, 0x6f, 0x64, 0x65, 0x73, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x74,
+  0x68, 0x61, 0x74, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x2e, 0x20, 0x2a, 0x2f,
+  0x0a, 0x20, 0x20, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x48,
+  0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x20, 0x2a, 0x69, 0x6e, 0x64,
+  0x65, 0x78, 0x65, 0x64, 0x5f, 0x6c, 0x69, 0x73, 0x74, 0x3b, 0x0a, 0x20,
+  0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6e, 0x65, 0x78, 0x74, 0x5f, 0x62,
+  0x79, 0x5f, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x2c, 0x20, 0x70, 0x72, 0x65,
+  0x76, 0x5f, 0x62, 0x79, 0x5f, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x3b, 0x0a,
+  0x7d, 0x20, 0x4e, 0x6f, 0x64, 0x65, 0x3b, 0x0a, 0x0a, 0x65, 0x78, 0x74,
+  0x65, 0x72, 0x6e, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x4e,
+  0x6f, 0x64, 0x65, 0x20, 0x64, 0x75, 0x6d, 0x6d, 0x79, 0x5f, 0x6e, 0x6f,
+  0x64, 0x65, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x66, 0x72, 0x65, 0x65,
+  0x4e, 0x6f, 0x64, 0x65, 0x45, 0x64, 0x67, 0x65, 0x73, 0x20, 0x72, 0x65,
+  0x74, 0x75, 0x72, 0x6e, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f,
+  0x64, 0x65, 0x27, 0x73, 0x20, 0x6f, 0x76, 0x65, 0x72, 0x66, 0x6c, 0x6f,
+  0x77, 0x20, 0x62, 0x6c, 0x6f, 0x63, 0x6b, 0x73, 0x20, 0x74, 0x6f, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x65, 0x64, 0x67, 0x65, 0x20, 0x62, 0x6c, 0x6f,
+  0x63, 0x6b, 0x20, 0x70, 0x6f, 0x6f, 0x6c, 0x2e, 0x0a, 0x20, 0x2a, 0x20,
+  0x63, 0x6f, 0x70, 0x79, 0x4e, 0x6f, 0x64, 0x65, 0x45, 0x64, 0x67, 0x65,
+  0x73, 0x20, 0x67, 0x69, 0x76, 0x65, 0x73, 0x20, 0x61, 0x20, 0x62, 0x69,
+  0x74, 0x77, 0x69, 0x73, 0x65, 0x20, 0x63, 0x6f, 0x70, 0x79, 0x20, 0x6f,
+  0x66, 0x20, 0x61, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x69, 0x74, 0x73,
+  0x20, 0x6f, 0x77, 0x6e, 0x20, 0x6f, 0x76, 0x65, 0x72, 0x66, 0x6c, 0x6f,
+  0x77, 0x20, 0x62, 0x6c, 0x6f, 0x63, 0x6b, 0x73, 0x2e, 0x20, 0x2a, 0x2f,
+  0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x66, 0x72, 0x65, 0x65, 0x4e, 0x6f,
+  0x64, 0x65, 0x45, 0x64, 0x67, 0x65, 0x73, 0x28, 0x4e, 0x6f, 0x64, 0x65,
+  0x20, 0x2a, 0x6e, 0x6f, 0x64, 0x65, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69,
+  0x64, 0x20, 0x63, 0x6f, 0x70, 0x79, 0x4e, 0x6f, 0x64, 0x65, 0x45, 0x64,
+  0x67, 0x65, 0x73, 0x28, 0x4e, 0x6f, 0x64, 0x65, 0x20, 0x2a, 0x6e, 0x6f,
+  0x64, 0x65, 0x29, 0x3b, 0x0a, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65,
+  0x66, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x45, 0x64, 0x67,
+  0x65, 0x20, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69,
+  0x6e, 0x64, 0x65, 0x78, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x48, 0x6f, 0x73,
+  0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c,
+  0x3b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x73, 0x6f, 0x75,
+  0x72, 0x63, 0x65, 0x2c, 0x20, 0x74, 0x61, 0x72, 0x67, 0x65, 0x74, 0x3b,
+  0x0a, 0x20, 0x20, 0x20, 0x2f, 0x2a, 0x20, 0x4c, 0x69, 0x6e, 0x6b, 0x73,
+  0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x65, 0x64, 0x67, 0x65,
+  0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x62, 0x75, 0x63, 0x6b, 0x65,
+  0x74, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x65, 0x64, 0x67,
+  0x65, 0x27, 0x73, 0x20, 0x73, 0x6f, 0x75, 0x72, 0x63, 0x65, 0x20, 0x61,
+  0x6e, 0x64, 0x20, 0x74, 0x61, 0x72, 0x67, 0x65, 0x74, 0x2e, 0x20, 0x2a,
+  0x2f, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6e, 0x65, 0x78,
+  0x74, 0x5f, 0x62, 0x79, 0x5f, 0x65, 0x6e, 0x64, 0x73, 0x2c, 0x20, 0x70,
+  0x72, 0x65, 0x76, 0x5f, 0x62, 0x79, 0x5f, 0x65, 0x6e, 0x64, 0x73, 0x3b,
+  0x0a, 0x7d, 0x20, 0x45, 0x64, 0x67, 0x65, 0x3b, 0x0a, 0x0a, 0x65, 0x78,
+  0x74, 0x65, 0x72, 0x6e, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20,
+  0x45, 0x64, 0x67, 0x65, 0x20, 0x64, 0x75, 0x6d, 0x6d, 0x79, 0x5f, 0x65,
+  0x64, 0x67, 0x65, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x3d, 0x3d, 0x3d,
   0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d,
-  0x3d, 0x3d, 0x3d, 0x0a, 0x20, 0x2a, 0x20, 0x47, 0x72, 0x61, 0x70, 0x68,
-  0x20, 0x51, 0x75, 0x65, 0x72, 0x79, 0x69, 0x6e, 0x67, 0x20, 0x46, 0x75,
-  0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x73, 0x0a, 0x20, 0x2a, 0x20, 0x3d,
+  0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x0a, 0x20, 0x2a,
+  0x20, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x51, 0x75, 0x65, 0x72, 0x79,
+  0x69, 0x6e, 0x67, 0x20, 0x46, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e,
+  0x73, 0x0a, 0x20, 0x2a, 0x20, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d,
   0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d,
-  0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x20,
-  0x2a, 0x2f, 0x0a, 0x4e, 0x6f, 0x64, 0x65, 0x20, 0x2a, 0x67, 0x65, 0x74,
-  0x4e, 0x6f, 0x64, 0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a,
-  0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69,
-  0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x45, 0x64, 0x67, 0x65, 0x20,
-  0x2a, 0x67, 0x65, 0x74, 0x45, 0x64, 0x67, 0x65, 0x28, 0x47, 0x72, 0x61,
-  0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69,
-  0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x52,
-  0x6f, 0x6f, 0x74, 0x4e, 0x6f, 0x64, 0x65, 0x73, 0x20, 0x2a, 0x67, 0x65,
-  0x74, 0x52, 0x6f, 0x6f, 0x74, 0x4e, 0x6f, 0x64, 0x65, 0x4c, 0x69, 0x73,
-  0x74, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61,
-  0x70, 0x68, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x43, 0x61, 0x6c,
-  0x6c, 0x65, 0x64, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x61, 0x20, 0x70,
-  0x6f, 0x73, 0x69, 0x74, 0x69, 0x76, 0x65, 0x20, 0x69, 0x6e, 0x74, 0x65,
-  0x67, 0x65, 0x72, 0x20, 0x6e, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6e,
-  0x6f, 0x64, 0x65, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x75, 0x72,
-  0x65, 0x73, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x20, 0x74, 0x77, 0x6f,
-  0x20, 0x6f, 0x75, 0x74, 0x65, 0x64, 0x67, 0x65, 0x20, 0x69, 0x6e, 0x64,
-  0x69, 0x63, 0x65, 0x73, 0x0a, 0x20, 0x2a, 0x20, 0x61, 0x6e, 0x64, 0x20,
-  0x74, 0x77, 0x6f, 0x20, 0x69, 0x6e, 0x65, 0x64, 0x67, 0x65, 0x20, 0x69,
-  0x6e, 0x64, 0x69, 0x63, 0x65, 0x73, 0x2e, 0x20, 0x4d, 0x6f, 0x72, 0x65,
-  0x20, 0x69, 0x6e, 0x63, 0x69, 0x64, 0x65, 0x6e, 0x74, 0x20, 0x65, 0x64,
-  0x67, 0x65, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x70, 0x6c, 0x61, 0x63,
-  0x65, 0x64, 0x20, 0x69, 0x6e, 0x20, 0x61, 0x20, 0x64, 0x79, 0x6e, 0x61,
-  0x6d, 0x69, 0x63, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x2e, 0x0a, 0x20,
-  0x2a, 0x20, 0x50, 0x61, 0x73, 0x73, 0x20, 0x6e, 0x20, 0x3d, 0x20, 0x30,
-  0x20, 0x74, 0x6f, 0x20, 0x67, 0x65, 0x74, 0x20, 0x74, 0x68, 0x65, 0x20,
-  0x6e, 0x6f, 0x64, 0x65, 0x27, 0x73, 0x20, 0x66, 0x69, 0x72, 0x73, 0x74,
-  0x20, 0x69, 0x6e, 0x63, 0x69, 0x64, 0x65, 0x6e, 0x74, 0x20, 0x65, 0x64,
-  0x67, 0x65, 0x2e, 0x0a, 0x20, 0x2a, 0x20, 0x50, 0x61, 0x73, 0x73, 0x20,
-  0x6e, 0x20, 0x3d, 0x20, 0x31, 0x20, 0x74, 0x6f, 0x20, 0x67, 0x65, 0x74,
-  0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x27, 0x73, 0x20,
-  0x73, 0x65, 0x63, 0x6f, 0x6e, 0x64, 0x20, 0x69, 0x6e, 0x63, 0x69, 0x64,
-  0x65, 0x6e, 0x74, 0x20, 0x65, 0x64, 0x67, 0x65, 0x2e, 0x0a, 0x20, 0x2a,
-  0x20, 0x50, 0x61, 0x73, 0x73, 0x20, 0x6e, 0x20, 0x3e, 0x3d, 0x20, 0x32,
-  0x20, 0x74, 0x6f, 0x20, 0x67, 0x65, 0x74, 0x20, 0x74, 0x68, 0x65, 0x20,
-  0x28, 0x6e, 0x2d, 0x32, 0x29, 0x74, 0x68, 0x20, 0x69, 0x6e, 0x63, 0x69,
-  0x64, 0x65, 0x6e, 0x74, 0x20, 0x65, 0x64, 0x67, 0x65, 0x20, 0x69, 0x6e,
-  0x20, 0x74, 0x68, 0x65, 0x20, 0x61, 0x70, 0x70, 0x72, 0x6f, 0x70, 0x72,
-  0x69, 0x61, 0x74, 0x65, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x2e, 0x20,
-  0x0a, 0x20, 0x2a, 0x20, 0x44, 0x65, 0x73, 0x69, 0x67, 0x6e, 0x65, 0x64,
-  0x20, 0x66, 0x6f, 0x72, 0x20, 0x69, 0x74, 0x65, 0x72, 0x61, 0x74, 0x69,
-  0x6f, 0x6e, 0x20, 0x65, 0x2e, 0x67, 0x2e, 0x20, 0x0a, 0x20, 0x2a, 0x20,
-  0x66, 0x6f, 0x72, 0x28, 0x69, 0x20, 0x3d, 0x20, 0x30, 0x3b, 0x20, 0x69,
-  0x20, 0x3c, 0x20, 0x6e, 0x2d, 0x3e, 0x6f, 0x75, 0x74, 0x5f, 0x65, 0x64,
-  0x67, 0x65, 0x73, 0x2e, 0x73, 0x69, 0x7a, 0x65, 0x20, 0x2b, 0x20, 0x32,
-  0x3b, 0x20, 0x69, 0x2b, 0x2b, 0x29, 0x20, 0x67, 0x65, 0x74, 0x4e, 0x74,
-  0x68, 0x4f, 0x75, 0x74, 0x45, 0x64, 0x67, 0x65, 0x28, 0x67, 0x2c, 0x20,
-  0x6e, 0x2c, 0x20, 0x69, 0x29, 0x3b, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x49,
-  0x27, 0x6d, 0x20, 0x73, 0x75, 0x72, 0x65, 0x20, 0x74, 0x68, 0x65, 0x72,
-  0x65, 0x27, 0x73, 0x20, 0x61, 0x20, 0x6e, 0x69, 0x63, 0x65, 0x72, 0x20,
-  0x77, 0x61, 0x79, 0x20, 0x74, 0x6f, 0x20, 0x64, 0x6f, 0x20, 0x74, 0x68,
-  0x69, 0x73, 0x2e, 0x2e, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x45, 0x64, 0x67,
-  0x65, 0x20, 0x2a, 0x67, 0x65, 0x74, 0x4e, 0x74, 0x68, 0x4f, 0x75, 0x74,
-  0x45, 0x64, 0x67, 0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a,
-  0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x4e, 0x6f, 0x64, 0x65, 0x20,
-  0x2a, 0x6e, 0x6f, 0x64, 0x65, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6e,
-  0x29, 0x3b, 0x0a, 0x45, 0x64, 0x67, 0x65, 0x20, 0x2a, 0x67, 0x65, 0x74,
-  0x4e, 0x74, 0x68, 0x49, 0x6e, 0x45, 0x64, 0x67, 0x65, 0x28, 0x47, 0x72,
-  0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20,
-  0x4e, 0x6f, 0x64, 0x65, 0x20, 0x2a, 0x6e, 0x6f, 0x64, 0x65, 0x2c, 0x20,
-  0x69, 0x6e, 0x74, 0x20, 0x6e, 0x29, 0x3b, 0x0a, 0x4e, 0x6f, 0x64, 0x65,
-  0x20, 0x2a, 0x67, 0x65, 0x74, 0x53, 0x6f, 0x75, 0x72, 0x63, 0x65, 0x28,
+  0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x20, 0x2a, 0x2f, 0x0a, 0x4e, 0x6f, 0x64,
+  0x65, 0x20, 0x2a, 0x67, 0x65, 0x74, 0x4e, 0x6f, 0x64, 0x65, 0x28, 0x47,
+  0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c,
+  0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b,
+  0x0a, 0x45, 0x64, 0x67, 0x65, 0x20, 0x2a, 0x67, 0x65, 0x74, 0x45, 0x64,
+  0x67, 0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72,
+  0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64,
+  0x65, 0x78, 0x29, 0x3b, 0x0a, 0x52, 0x6f, 0x6f, 0x74, 0x4e, 0x6f, 0x64,
+  0x65, 0x73, 0x20, 0x2a, 0x67, 0x65, 0x74, 0x52, 0x6f, 0x6f, 0x74, 0x4e,
+  0x6f, 0x64, 0x65, 0x4c, 0x69, 0x73, 0x74, 0x28, 0x47, 0x72, 0x61, 0x70,
+  0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x29, 0x3b, 0x0a, 0x0a,
+  0x2f, 0x2a, 0x20, 0x49, 0x74, 0x65, 0x72, 0x61, 0x74, 0x69, 0x6f, 0x6e,
+  0x20, 0x6f, 0x76, 0x65, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f,
+  0x64, 0x65, 0x73, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x61, 0x20, 0x70,
+  0x61, 0x72, 0x74, 0x69, 0x63, 0x75, 0x6c, 0x61, 0x72, 0x20, 0x73, 0x69,
+  0x67, 0x6e, 0x61, 0x74, 0x75, 0x72, 0x65, 0x2e, 0x20, 0x42, 0x6f, 0x74,
+  0x68, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x73, 0x20,
+  0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x0a, 0x20, 0x2a, 0x20, 0x2d, 0x31,
+  0x20, 0x77, 0x68, 0x65, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x72, 0x65, 0x20,
+  0x61, 0x72, 0x65, 0x20, 0x6e, 0x6f, 0x20, 0x6d, 0x6f, 0x72, 0x65, 0x20,
+  0x6e, 0x6f, 0x64, 0x65, 0x73, 0x2e, 0x20, 0x44, 0x65, 0x73, 0x69, 0x67,
+  0x6e, 0x65, 0x64, 0x20, 0x66, 0x6f, 0x72, 0x20, 0x69, 0x74, 0x65, 0x72,
+  0x61, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x65, 0x2e, 0x67, 0x2e, 0x0a, 0x20,
+  0x2a, 0x20, 0x66, 0x6f, 0x72, 0x28, 0x69, 0x20, 0x3d, 0x20, 0x67, 0x65,
+  0x74, 0x46, 0x69, 0x72, 0x73, 0x74, 0x4e, 0x6f, 0x64, 0x65, 0x42, 0x79,
+  0x53, 0x69, 0x67, 0x6e, 0x61, 0x74, 0x75, 0x72, 0x65, 0x28, 0x67, 0x2c,
+  0x20, 0x73, 0x29, 0x3b, 0x20, 0x69, 0x20, 0x21, 0x3d, 0x20, 0x2d, 0x31,
+  0x3b, 0x20, 0x69, 0x20, 0x3d, 0x20, 0x67, 0x65, 0x74, 0x4e, 0x65, 0x78,
+  0x74, 0x4e, 0x6f, 0x64, 0x65, 0x42, 0x79, 0x53, 0x69, 0x67, 0x6e, 0x61,
+  0x74, 0x75, 0x72, 0x65, 0x28, 0x67, 0x2c, 0x20, 0x69, 0x29, 0x29, 0x20,
+  0x2a, 0x2f, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x67, 0x65, 0x74, 0x46, 0x69,
+  0x72, 0x73, 0x74, 0x4e, 0x6f, 0x64, 0x65, 0x42, 0x79, 0x53, 0x69, 0x67,
+  0x6e, 0x61, 0x74, 0x75, 0x72, 0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68,
+  0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74,
+  0x20, 0x73, 0x69, 0x67, 0x6e, 0x61, 0x74, 0x75, 0x72, 0x65, 0x29, 0x3b,
+  0x0a, 0x69, 0x6e, 0x74, 0x20, 0x67, 0x65, 0x74, 0x4e, 0x65, 0x78, 0x74,
+  0x4e, 0x6f, 0x64, 0x65, 0x42, 0x79, 0x53, 0x69, 0x67, 0x6e, 0x61, 0x74,
+  0x75, 0x72, 0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67,
+  0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e,
+  0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x4c, 0x6f,
+  0x6f, 0x6b, 0x75, 0x70, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x6c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2e,
+  0x20, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x4e, 0x6f, 0x64, 0x65, 0x73, 0x42,
+  0x79, 0x4c, 0x69, 0x73, 0x74, 0x20, 0x72, 0x65, 0x74, 0x75, 0x72, 0x6e,
+  0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x75, 0x6d, 0x62, 0x65, 0x72,
+  0x20, 0x6f, 0x66, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x0a, 0x20, 0x2a,
+  0x20, 0x77, 0x68, 0x6f, 0x73, 0x65, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c,
+  0x20, 0x68, 0x61, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x70, 0x61, 0x73,
+  0x73, 0x65, 0x64, 0x20, 0x6e, 0x6f, 0x6e, 0x2d, 0x65, 0x6d, 0x70, 0x74,
+  0x79, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x2e, 0x20, 0x49, 0x74, 0x65, 0x72,
+  0x61, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x69, 0x73, 0x20, 0x61, 0x73, 0x20,
+  0x61, 0x62, 0x6f, 0x76, 0x65, 0x2c, 0x20, 0x65, 0x2e, 0x67, 0x2e, 0x0a,
+  0x20, 0x2a, 0x20, 0x66, 0x6f, 0x72, 0x28, 0x69, 0x20, 0x3d, 0x20, 0x67,
+  0x65, 0x74, 0x46, 0x69, 0x72, 0x73, 0x74, 0x4e, 0x6f, 0x64, 0x65, 0x42,
+  0x79, 0x4c, 0x69, 0x73, 0x74, 0x28, 0x67, 0x2c, 0x20, 0x6c, 0x29, 0x3b,
+  0x20, 0x69, 0x20, 0x21, 0x3d, 0x20, 0x2d, 0x31, 0x3b, 0x20, 0x69, 0x20,
+  0x3d, 0x20, 0x67, 0x65, 0x74, 0x4e, 0x65, 0x78, 0x74, 0x4e, 0x6f, 0x64,
+  0x65, 0x42, 0x79, 0x4c, 0x69, 0x73, 0x74, 0x28, 0x67, 0x2c, 0x20, 0x69,
+  0x29, 0x29, 0x20, 0x2a, 0x2f, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x63, 0x6f,
+  0x75, 0x6e, 0x74, 0x4e, 0x6f, 0x64, 0x65, 0x73, 0x42, 0x79, 0x4c, 0x69,
+  0x73, 0x74, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72,
+  0x61, 0x70, 0x68, 0x2c, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20,
+  0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x20, 0x2a, 0x6c, 0x69,
+  0x73, 0x74, 0x29, 0x3b, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x67, 0x65, 0x74,
+  0x46, 0x69, 0x72, 0x73, 0x74, 0x4e, 0x6f, 0x64, 0x65, 0x42, 0x79, 0x4c,
+  0x69, 0x73, 0x74, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67,
+  0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74,
+  0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x20, 0x2a, 0x6c,
+  0x69, 0x73, 0x74, 0x29, 0x3b, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x67, 0x65,
+  0x74, 0x4e, 0x65, 0x78, 0x74, 0x4e, 0x6f, 0x64, 0x65, 0x42, 0x79, 0x4c,
+  0x69, 0x73, 0x74, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67,
+  0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e,
+  0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x4c, 0x6f,
+  0x6f, 0x6b, 0x75, 0x70, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x65, 0x64, 0x67, 0x65, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2e, 0x20,
+  0x49, 0x74, 0x65, 0x72, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x6f, 0x76,
+  0x65, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73,
+  0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x73, 0x6f, 0x75, 0x72, 0x63, 0x65,
+  0x20, 0x74, 0x6f, 0x20, 0x74, 0x61, 0x72, 0x67, 0x65, 0x74, 0x2c, 0x0a,
+  0x20, 0x2a, 0x20, 0x64, 0x65, 0x73, 0x69, 0x67, 0x6e, 0x65, 0x64, 0x20,
+  0x66, 0x6f, 0x72, 0x20, 0x69, 0x74, 0x65, 0x72, 0x61, 0x74, 0x69, 0x6f,
+  0x6e, 0x20, 0x65, 0x2e, 0x67, 0x2e, 0x0a, 0x20, 0x2a, 0x20, 0x66, 0x6f,
+  0x72, 0x28, 0x69, 0x20, 0x3d, 0x20, 0x67, 0x65, 0x74, 0x46, 0x69, 0x72,
+  0x73, 0x74, 0x45, 0x64, 0x67, 0x65, 0x42, 0x65, 0x74, 0x77, 0x65, 0x65,
+  0x6e, 0x28, 0x67, 0x2c, 0x20, 0x73, 0x2c, 0x20, 0x74, 0x29, 0x3b, 0x20,
+  0x69, 0x20, 0x21, 0x3d, 0x20, 0x2d, 0x31, 0x3b, 0x20, 0x69, 0x20, 0x3d,
+  0x20, 0x67, 0x65, 0x74, 0x4e, 0x65, 0x78, 0x74, 0x45, 0x64, 0x67, 0x65,
+  0x42, 0x65, 0x74, 0x77, 0x65, 0x65, 0x6e, 0x28, 0x67, 0x2c, 0x20, 0x69,
+  0x29, 0x29, 0x20, 0x2a, 0x2f, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x67, 0x65,
+  0x74, 0x46, 0x69, 0x72, 0x73, 0x74, 0x45, 0x64, 0x67, 0x65, 0x42, 0x65,
+  0x74, 0x77, 0x65, 0x65, 0x6e, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20,
+  0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20,
+  0x73, 0x6f, 0x75, 0x72, 0x63, 0x65, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20,
+  0x74, 0x61, 0x72, 0x67, 0x65, 0x74, 0x29, 0x3b, 0x0a, 0x69, 0x6e, 0x74,
+  0x20, 0x67, 0x65, 0x74, 0x4e, 0x65, 0x78, 0x74, 0x45, 0x64, 0x67, 0x65,
+  0x42, 0x65, 0x74, 0x77, 0x65, 0x65, 0x6e, 0x28, 0x47, 0x72, 0x61, 0x70,
+  0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e,
+  0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x0a, 0x2f,
+  0x2a, 0x20, 0x42, 0x75, 0x69, 0x6c, 0x64, 0x73, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x65, 0x64, 0x67, 0x65, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20,
+  0x69, 0x66, 0x20, 0x69, 0x74, 0x20, 0x69, 0x73, 0x20, 0x6e, 0x6f, 0x74,
+  0x20, 0x62, 0x75, 0x69, 0x6c, 0x74, 0x2e, 0x20, 0x4c, 0x6f, 0x6f, 0x6b,
+  0x75, 0x70, 0x73, 0x20, 0x62, 0x75, 0x69, 0x6c, 0x64, 0x20, 0x69, 0x74,
+  0x20, 0x74, 0x68, 0x65, 0x6d, 0x73, 0x65, 0x6c, 0x76, 0x65, 0x73, 0x2c,
+  0x20, 0x62, 0x75, 0x74, 0x0a, 0x20, 0x2a, 0x20, 0x74, 0x68, 0x65, 0x79,
+  0x20, 0x6d, 0x75, 0x73, 0x74, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x64, 0x6f,
+  0x20, 0x73, 0x6f, 0x20, 0x77, 0x68, 0x69, 0x6c, 0x65, 0x20, 0x73, 0x65,
+  0x76, 0x65, 0x72, 0x61, 0x6c, 0x20, 0x74, 0x68, 0x72, 0x65, 0x61, 0x64,
+  0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x69,
+  0x6e, 0x67, 0x2c, 0x20, 0x73, 0x6f, 0x20, 0x61, 0x20, 0x70, 0x61, 0x72,
+  0x61, 0x6c, 0x6c, 0x65, 0x6c, 0x0a, 0x20, 0x2a, 0x20, 0x73, 0x65, 0x61,
+  0x72, 0x63, 0x68, 0x20, 0x63, 0x61, 0x6c, 0x6c, 0x73, 0x20, 0x74, 0x68,
+  0x69, 0x73, 0x20, 0x66, 0x69, 0x72, 0x73, 0x74, 0x20, 0x69, 0x66, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x68, 0x61,
+  0x73, 0x20, 0x61, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x6f, 0x66, 0x20,
+  0x68, 0x69, 0x67, 0x68, 0x20, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x2e,
+  0x20, 0x2a, 0x2f, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x62, 0x75, 0x69,
+  0x6c, 0x64, 0x45, 0x64, 0x67, 0x65, 0x49, 0x6e, 0x64, 0x65, 0x78, 0x28,
+  0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68,
+  0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x43, 0x61, 0x6c, 0x6c, 0x65,
+  0x64, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x61, 0x6e, 0x20, 0x69, 0x6e,
+  0x74, 0x65, 0x67, 0x65, 0x72, 0x20, 0x30, 0x20, 0x3c, 0x3d, 0x20, 0x6e,
+  0x20, 0x3c, 0x20, 0x6f, 0x75, 0x74, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65,
+  0x20, 0x28, 0x72, 0x65, 0x73, 0x70, 0x2e, 0x20, 0x69, 0x6e, 0x64, 0x65,
+  0x67, 0x72, 0x65, 0x65, 0x29, 0x2e, 0x20, 0x52, 0x65, 0x74, 0x75, 0x72,
+  0x6e, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x74, 0x68, 0x0a, 0x20,
+  0x2a, 0x20, 0x69, 0x6e, 0x63, 0x69, 0x64, 0x65, 0x6e, 0x74, 0x20, 0x65,
+  0x64, 0x67, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e,
+  0x6f, 0x64, 0x65, 0x2e, 0x20, 0x47, 0x65, 0x6e, 0x65, 0x72, 0x61, 0x74,
+  0x65, 0x64, 0x20, 0x63, 0x6f, 0x64, 0x65, 0x20, 0x73, 0x68, 0x6f, 0x75,
+  0x6c, 0x64, 0x20, 0x70, 0x72, 0x65, 0x66, 0x65, 0x72, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x66, 0x6f, 0x72, 0x45, 0x61, 0x63, 0x68, 0x4f, 0x75, 0x74,
+  0x45, 0x64, 0x67, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x61, 0x6e, 0x64, 0x20,
+  0x66, 0x6f, 0x72, 0x45, 0x61, 0x63, 0x68, 0x49, 0x6e, 0x45, 0x64, 0x67,
+  0x65, 0x20, 0x6d, 0x61, 0x63, 0x72, 0x6f, 0x73, 0x2c, 0x20, 0x77, 0x68,
+  0x69, 0x63, 0x68, 0x20, 0x61, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x72, 0x65, 0x70, 0x65, 0x61, 0x74, 0x65, 0x64, 0x20, 0x69,
+  0x6e, 0x6c, 0x69, 0x6e, 0x65, 0x2f, 0x6f, 0x76, 0x65, 0x72, 0x66, 0x6c,
+  0x6f, 0x77, 0x20, 0x63, 0x68, 0x65, 0x63, 0x6b, 0x2e, 0x20, 0x2a, 0x2f,
+  0x0a, 0x45, 0x64, 0x67, 0x65, 0x20, 0x2a, 0x67, 0x65, 0x74, 0x4e, 0x74,
+  0x68, 0x4f, 0x75, 0x74, 0x45, 0x64, 0x67, 0x65, 0x28, 0x47, 0x72, 0x61,
+  0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x4e,
+  0x6f, 0x64, 0x65, 0x20, 0x2a, 0x6e, 0x6f, 0x64, 0x65, 0x2c, 0x20, 0x69,
+  0x6e, 0x74, 0x20, 0x6e, 0x29, 0x3b, 0x0a, 0x45, 0x64, 0x67, 0x65, 0x20,
+  0x2a, 0x67, 0x65, 0x74, 0x4e, 0x74, 0x68, 0x49, 0x6e, 0x45, 0x64, 0x67,
+  0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61,
+  0x70, 0x68, 0x2c, 0x20, 0x4e, 0x6f, 0x64, 0x65, 0x20, 0x2a, 0x6e, 0x6f,
+  0x64, 0x65, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6e, 0x29, 0x3b, 0x0a,
+  0x4e, 0x6f, 0x64, 0x65, 0x20, 0x2a, 0x67, 0x65, 0x74, 0x53, 0x6f, 0x75,
+  0x72, 0x63, 0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67,
+  0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x45, 0x64, 0x67, 0x65, 0x20, 0x2a,
+  0x65, 0x64, 0x67, 0x65, 0x29, 0x3b, 0x20, 0x0a, 0x4e, 0x6f, 0x64, 0x65,
+  0x20, 0x2a, 0x67, 0x65, 0x74, 0x54, 0x61, 0x72, 0x67, 0x65, 0x74, 0x28,
   0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68,
   0x2c, 0x20, 0x45, 0x64, 0x67, 0x65, 0x20, 0x2a, 0x65, 0x64, 0x67, 0x65,
-  0x29, 0x3b, 0x20, 0x0a, 0x4e, 0x6f, 0x64, 0x65, 0x20, 0x2a, 0x67, 0x65,
-  0x74, 0x54, 0x61, 0x72, 0x67, 0x65, 0x74, 0x28, 0x47, 0x72, 0x61, 0x70,
-  0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x45, 0x64,
-  0x67, 0x65, 0x20, 0x2a, 0x65, 0x64, 0x67, 0x65, 0x29, 0x3b, 0x0a, 0x48,
-  0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x67, 0x65, 0x74,
-  0x4e, 0x6f, 0x64, 0x65, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x28, 0x47, 0x72,
+  0x29, 0x3b, 0x0a, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c,
+  0x20, 0x67, 0x65, 0x74, 0x4e, 0x6f, 0x64, 0x65, 0x4c, 0x61, 0x62, 0x65,
+  0x6c, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61,
+  0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65,
+  0x78, 0x29, 0x3b, 0x0a, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65,
+  0x6c, 0x20, 0x67, 0x65, 0x74, 0x45, 0x64, 0x67, 0x65, 0x4c, 0x61, 0x62,
+  0x65, 0x6c, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72,
+  0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64,
+  0x65, 0x78, 0x29, 0x3b, 0x20, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x67, 0x65,
+  0x74, 0x49, 0x6e, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65, 0x28, 0x47, 0x72,
   0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20,
   0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a,
-  0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x67, 0x65,
-  0x74, 0x45, 0x64, 0x67, 0x65, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x28, 0x47,
-  0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c,
-  0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b,
-  0x20, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x67, 0x65, 0x74, 0x49, 0x6e, 0x64,
-  0x65, 0x67, 0x72, 0x65, 0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20,
-  0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20,
-  0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x69, 0x6e, 0x74, 0x20,
-  0x67, 0x65, 0x74, 0x4f, 0x75, 0x74, 0x64, 0x65, 0x67, 0x72, 0x65, 0x65,
-  0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70,
-  0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78,
-  0x29, 0x3b, 0x0a, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x70, 0x72, 0x69,
-  0x6e, 0x74, 0x47, 0x72, 0x61, 0x70, 0x68, 0x28, 0x47, 0x72, 0x61, 0x70,
-  0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x46, 0x49,
-  0x4c, 0x45, 0x20, 0x2a, 0x66, 0x69, 0x6c, 0x65, 0x29, 0x3b, 0x0a, 0x76,
-  0x6f, 0x69, 0x64, 0x20, 0x66, 0x72, 0x65, 0x65, 0x47, 0x72, 0x61, 0x70,
-  0x68, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61,
-  0x70, 0x68, 0x29, 0x3b, 0x0a, 0x0a, 0x23, 0x65, 0x6e, 0x64, 0x69, 0x66,
-  0x20, 0x2f, 0x2a, 0x20, 0x49, 0x4e, 0x43, 0x5f, 0x47, 0x52, 0x41, 0x50,
-  0x48, 0x5f, 0x48, 0x20, 0x2a, 0x2f, 0x0a
+  0x69, 0x6e, 0x74, 0x20, 0x67, 0x65, 0x74, 0x4f, 0x75, 0x74, 0x64, 0x65,
+  0x67, 0x72, 0x65, 0x65, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a,
+  0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69,
+  0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x0a, 0x76, 0x6f, 0x69, 0x64,
+  0x20, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x47, 0x72, 0x61, 0x70, 0x68, 0x28,
+  0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68,
+  0x2c, 0x20, 0x46, 0x49, 0x4c, 0x45, 0x20, 0x2a, 0x66, 0x69, 0x6c, 0x65,
+  0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x66, 0x72, 0x65, 0x65,
+  0x47, 0x72, 0x61, 0x70, 0x68, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20,
+  0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x29, 0x3b, 0x0a, 0x0a, 0x23, 0x65,
+  0x6e, 0x64, 0x69, 0x66, 0x20, 0x2f, 0x2a, 0x20, 0x49, 0x4e, 0x43, 0x5f,
+  0x47, 0x52, 0x41, 0x50, 0x48, 0x5f, 0x48, 0x20, 0x2a, 0x2f, 0x0a, 0x00
 };
-unsigned int graph_h_len = 4879;
+unsigned int graph_h_len = 20795;
 
 
 unsigned char graphStacks_h[] = {
@@ -808,317 +2256,353 @@ unsigned char graphStacks_h[] = {
   0x20, 0x74, 0x79, 0x70, 0x65, 0x73, 0x0a, 0x20, 0x20, 0x6f, 0x66, 0x20,
   0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x62, 0x61, 0x63, 0x6b, 0x74, 0x72,
   0x61, 0x63, 0x6b, 0x69, 0x6e, 0x67, 0x3a, 0x20, 0x0a, 0x20, 0x20, 0x28,
-  0x31, 0x29, 0x20, 0x41, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x6c, 0x65, 0x74,
-  0x65, 0x20, 0x6d, 0x65, 0x6d, 0x6f, 0x72, 0x79, 0x20, 0x63, 0x6f, 0x70,
-  0x79, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x77, 0x6f, 0x72,
-  0x6b, 0x69, 0x6e, 0x67, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2e, 0x0a,
-  0x20, 0x20, 0x28, 0x32, 0x29, 0x20, 0x41, 0x20, 0x73, 0x74, 0x61, 0x63,
-  0x6b, 0x20, 0x6f, 0x66, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x63,
-  0x68, 0x61, 0x6e, 0x67, 0x65, 0x73, 0x20, 0x6d, 0x61, 0x69, 0x6e, 0x74,
-  0x61, 0x69, 0x6e, 0x65, 0x64, 0x20, 0x73, 0x6f, 0x20, 0x74, 0x68, 0x61,
-  0x74, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20,
-  0x63, 0x61, 0x6e, 0x20, 0x62, 0x65, 0x20, 0x72, 0x6f, 0x6c, 0x6c, 0x65,
-  0x64, 0x20, 0x62, 0x61, 0x63, 0x6b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x69, 0x66, 0x20, 0x6e, 0x65, 0x63, 0x65, 0x73, 0x73, 0x61, 0x72,
-  0x79, 0x2e, 0x0a, 0x0a, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
-  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
-  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
-  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
-  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
-  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
-  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x20, 0x2a, 0x2f, 0x0a, 0x0a,
-  0x23, 0x69, 0x66, 0x6e, 0x64, 0x65, 0x66, 0x20, 0x49, 0x4e, 0x43, 0x5f,
-  0x47, 0x52, 0x41, 0x50, 0x48, 0x5f, 0x53, 0x54, 0x41, 0x43, 0x4b, 0x53,
-  0x5f, 0x48, 0x0a, 0x23, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x20, 0x49,
-  0x4e, 0x43, 0x5f, 0x47, 0x52, 0x41, 0x50, 0x48, 0x5f, 0x53, 0x54, 0x41,
-  0x43, 0x4b, 0x53, 0x5f, 0x48, 0x0a, 0x0a, 0x23, 0x64, 0x65, 0x66, 0x69,
-  0x6e, 0x65, 0x20, 0x47, 0x52, 0x41, 0x50, 0x48, 0x5f, 0x53, 0x54, 0x41,
-  0x43, 0x4b, 0x5f, 0x53, 0x49, 0x5a, 0x45, 0x20, 0x34, 0x0a, 0x0a, 0x23,
-  0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64, 0x65, 0x20, 0x22, 0x67, 0x6c, 0x6f,
-  0x62, 0x61, 0x6c, 0x73, 0x2e, 0x68, 0x22, 0x0a, 0x23, 0x69, 0x6e, 0x63,
-  0x6c, 0x75, 0x64, 0x65, 0x20, 0x22, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2e,
-  0x68, 0x22, 0x0a, 0x23, 0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64, 0x65, 0x20,
-  0x22, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x2e, 0x68, 0x22, 0x0a, 0x0a, 0x2f,
-  0x2a, 0x20, 0x41, 0x20, 0x47, 0x72, 0x61, 0x70, 0x68, 0x43, 0x68, 0x61,
-  0x6e, 0x67, 0x65, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x73, 0x20, 0x74,
-  0x68, 0x65, 0x20, 0x64, 0x61, 0x74, 0x61, 0x20, 0x73, 0x75, 0x66, 0x66,
-  0x69, 0x63, 0x69, 0x65, 0x6e, 0x74, 0x20, 0x74, 0x6f, 0x20, 0x75, 0x6e,
-  0x64, 0x6f, 0x20, 0x61, 0x20, 0x70, 0x61, 0x72, 0x74, 0x69, 0x63, 0x75,
-  0x6c, 0x61, 0x72, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x6d, 0x6f,
-  0x64, 0x69, 0x66, 0x69, 0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x2e, 0x0a,
-  0x20, 0x2a, 0x20, 0x53, 0x70, 0x65, 0x63, 0x69, 0x66, 0x69, 0x63, 0x61,
-  0x6c, 0x6c, 0x79, 0x2c, 0x20, 0x61, 0x6e, 0x20, 0x75, 0x6e, 0x64, 0x6f,
-  0x20, 0x6f, 0x70, 0x65, 0x72, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x6d,
-  0x75, 0x73, 0x74, 0x20, 0x72, 0x65, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x20,
-  0x74, 0x68, 0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x74, 0x6f,
-  0x20, 0x69, 0x74, 0x73, 0x20, 0x65, 0x78, 0x61, 0x63, 0x74, 0x20, 0x73,
-  0x74, 0x61, 0x74, 0x65, 0x2c, 0x0a, 0x20, 0x2a, 0x20, 0x77, 0x68, 0x69,
+  0x31, 0x29, 0x20, 0x41, 0x20, 0x63, 0x6f, 0x70, 0x79, 0x2d, 0x6f, 0x6e,
+  0x2d, 0x77, 0x72, 0x69, 0x74, 0x65, 0x20, 0x73, 0x6e, 0x61, 0x70, 0x73,
+  0x68, 0x6f, 0x74, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x77,
+  0x6f, 0x72, 0x6b, 0x69, 0x6e, 0x67, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68,
+  0x20, 0x28, 0x73, 0x65, 0x65, 0x20, 0x70, 0x75, 0x73, 0x68, 0x47, 0x72,
+  0x61, 0x70, 0x68, 0x53, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x20, 0x67, 0x72, 0x61,
+  0x70, 0x68, 0x2e, 0x68, 0x29, 0x2e, 0x0a, 0x20, 0x20, 0x28, 0x32, 0x29,
+  0x20, 0x41, 0x20, 0x73, 0x74, 0x61, 0x63, 0x6b, 0x20, 0x6f, 0x66, 0x20,
+  0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65,
+  0x73, 0x20, 0x6d, 0x61, 0x69, 0x6e, 0x74, 0x61, 0x69, 0x6e, 0x65, 0x64,
+  0x20, 0x73, 0x6f, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x63, 0x61, 0x6e, 0x20, 0x62,
+  0x65, 0x20, 0x72, 0x6f, 0x6c, 0x6c, 0x65, 0x64, 0x20, 0x62, 0x61, 0x63,
+  0x6b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x69, 0x66, 0x20, 0x6e,
+  0x65, 0x63, 0x65, 0x73, 0x73, 0x61, 0x72, 0x79, 0x2e, 0x0a, 0x0a, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x20, 0x2a, 0x2f, 0x0a, 0x0a, 0x23, 0x69, 0x66, 0x6e, 0x64,
+  0x65, 0x66, 0x20, 0x49, 0x4e, 0x43, 0x5f, 0x47, 0x52, 0x41, 0x50, 0x48,
+  0x5f, 0x53, 0x54, 0x41, 0x43, 0x4b, 0x53, 0x5f, 0x48, 0x0a, 0x23, 0x64,
+  0x65, 0x66, 0x69, 0x6e, 0x65, 0x20, 0x49, 0x4e, 0x43, 0x5f, 0x47, 0x52,
+  0x41, 0x50, 0x48, 0x5f, 0x53, 0x54, 0x41, 0x43, 0x4b, 0x53, 0x5f, 0x48,
+  0x0a, 0x0a, 0x23, 0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64, 0x65, 0x20, 0x22,
+  0x67, 0x6c, 0x6f, 0x62, 0x61, 0x6c, 0x73, 0x2e, 0x68, 0x22, 0x0a, 0x23,
+  0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64, 0x65, 0x20, 0x22, 0x67, 0x72, 0x61,
+  0x70, 0x68, 0x2e, 0x68, 0x22, 0x0a, 0x23, 0x69, 0x6e, 0x63, 0x6c, 0x75,
+  0x64, 0x65, 0x20, 0x22, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x2e, 0x68, 0x22,
+  0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x41, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68,
+  0x20, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x20, 0x72, 0x65, 0x63, 0x6f,
+  0x72, 0x64, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x73, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x64, 0x61, 0x74, 0x61, 0x20, 0x73, 0x75, 0x66, 0x66, 0x69,
+  0x63, 0x69, 0x65, 0x6e, 0x74, 0x20, 0x74, 0x6f, 0x20, 0x75, 0x6e, 0x64,
+  0x6f, 0x20, 0x61, 0x20, 0x70, 0x61, 0x72, 0x74, 0x69, 0x63, 0x75, 0x6c,
+  0x61, 0x72, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x0a, 0x20, 0x2a, 0x20,
+  0x6d, 0x6f, 0x64, 0x69, 0x66, 0x69, 0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e,
+  0x2e, 0x20, 0x53, 0x70, 0x65, 0x63, 0x69, 0x66, 0x69, 0x63, 0x61, 0x6c,
+  0x6c, 0x79, 0x2c, 0x20, 0x61, 0x6e, 0x20, 0x75, 0x6e, 0x64, 0x6f, 0x20,
+  0x6f, 0x70, 0x65, 0x72, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x6d, 0x75,
+  0x73, 0x74, 0x20, 0x72, 0x65, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x74, 0x6f, 0x20,
+  0x69, 0x74, 0x73, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x65, 0x78, 0x61, 0x63,
+  0x74, 0x20, 0x73, 0x74, 0x61, 0x74, 0x65, 0x2c, 0x20, 0x77, 0x68, 0x69,
   0x63, 0x68, 0x20, 0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64, 0x65, 0x73, 0x20,
   0x74, 0x68, 0x65, 0x20, 0x69, 0x6e, 0x64, 0x69, 0x63, 0x65, 0x73, 0x20,
   0x6f, 0x66, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x20, 0x61, 0x6e, 0x64,
   0x20, 0x65, 0x64, 0x67, 0x65, 0x73, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68,
   0x65, 0x69, 0x72, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x73, 0x20, 0x61,
-  0x6e, 0x64, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68,
-  0x27, 0x73, 0x0a, 0x20, 0x2a, 0x20, 0x68, 0x6f, 0x6c, 0x65, 0x73, 0x20,
-  0x61, 0x72, 0x72, 0x61, 0x79, 0x73, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x74,
-  0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x65, 0x6e, 0x75, 0x6d, 0x20,
-  0x7b, 0x20, 0x41, 0x44, 0x44, 0x45, 0x44, 0x5f, 0x4e, 0x4f, 0x44, 0x45,
-  0x20, 0x3d, 0x20, 0x30, 0x2c, 0x20, 0x41, 0x44, 0x44, 0x45, 0x44, 0x5f,
-  0x45, 0x44, 0x47, 0x45, 0x2c, 0x20, 0x52, 0x45, 0x4d, 0x4f, 0x56, 0x45,
-  0x44, 0x5f, 0x4e, 0x4f, 0x44, 0x45, 0x2c, 0x20, 0x52, 0x45, 0x4d, 0x4f,
-  0x56, 0x45, 0x44, 0x5f, 0x45, 0x44, 0x47, 0x45, 0x2c, 0x20, 0x0a, 0x09,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x52, 0x45, 0x4c, 0x41, 0x42,
-  0x45, 0x4c, 0x4c, 0x45, 0x44, 0x5f, 0x4e, 0x4f, 0x44, 0x45, 0x2c, 0x20,
-  0x52, 0x45, 0x4c, 0x41, 0x42, 0x45, 0x4c, 0x4c, 0x45, 0x44, 0x5f, 0x45,
-  0x44, 0x47, 0x45, 0x2c, 0x20, 0x52, 0x45, 0x4d, 0x41, 0x52, 0x4b, 0x45,
-  0x44, 0x5f, 0x4e, 0x4f, 0x44, 0x45, 0x2c, 0x20, 0x52, 0x45, 0x4d, 0x41,
-  0x52, 0x4b, 0x45, 0x44, 0x5f, 0x45, 0x44, 0x47, 0x45, 0x2c, 0x0a, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x43, 0x48, 0x41, 0x4e, 0x47, 0x45, 0x44, 0x5f, 0x52, 0x4f,
-  0x4f, 0x54, 0x5f, 0x4e, 0x4f, 0x44, 0x45, 0x7d, 0x20, 0x47, 0x72, 0x61,
-  0x70, 0x68, 0x43, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x54, 0x79, 0x70, 0x65,
-  0x3b, 0x20, 0x0a, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20,
-  0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x47, 0x72, 0x61, 0x70, 0x68,
-  0x43, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x20, 0x0a, 0x7b, 0x0a, 0x20, 0x20,
-  0x20, 0x47, 0x72, 0x61, 0x70, 0x68, 0x43, 0x68, 0x61, 0x6e, 0x67, 0x65,
-  0x54, 0x79, 0x70, 0x65, 0x20, 0x74, 0x79, 0x70, 0x65, 0x3b, 0x0a, 0x20,
-  0x20, 0x20, 0x75, 0x6e, 0x69, 0x6f, 0x6e, 0x0a, 0x20, 0x20, 0x20, 0x7b,
-  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x2f, 0x2a, 0x20, 0x52, 0x65,
-  0x63, 0x6f, 0x72, 0x64, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x61, 0x72,
-  0x72, 0x61, 0x79, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x74, 0x6f,
-  0x20, 0x77, 0x68, 0x69, 0x63, 0x68, 0x20, 0x74, 0x68, 0x69, 0x73, 0x20,
-  0x69, 0x74, 0x65, 0x6d, 0x20, 0x77, 0x61, 0x73, 0x20, 0x61, 0x64, 0x64,
-  0x65, 0x64, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x61, 0x20, 0x66, 0x6c, 0x61,
-  0x67, 0x20, 0x74, 0x6f, 0x20, 0x73, 0x69, 0x67, 0x6e, 0x61, 0x6c, 0x0a,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x77, 0x68, 0x65,
-  0x74, 0x68, 0x65, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x74, 0x65,
-  0x6d, 0x20, 0x77, 0x61, 0x73, 0x20, 0x61, 0x64, 0x64, 0x65, 0x64, 0x20,
-  0x75, 0x73, 0x69, 0x6e, 0x67, 0x20, 0x61, 0x6e, 0x20, 0x69, 0x6e, 0x64,
-  0x65, 0x78, 0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x74, 0x68, 0x65, 0x20,
-  0x68, 0x6f, 0x6c, 0x65, 0x73, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x20,
-  0x6f, 0x72, 0x20, 0x6e, 0x6f, 0x74, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20,
-  0x7b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x69,
-  0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x3b, 0x20, 0x0a, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x62, 0x6f, 0x6f, 0x6c,
-  0x20, 0x68, 0x6f, 0x6c, 0x65, 0x5f, 0x66, 0x69, 0x6c, 0x6c, 0x65, 0x64,
-  0x3b, 0x20, 0x20, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x20,
-  0x61, 0x64, 0x64, 0x65, 0x64, 0x5f, 0x6e, 0x6f, 0x64, 0x65, 0x2c, 0x20,
-  0x61, 0x64, 0x64, 0x65, 0x64, 0x5f, 0x65, 0x64, 0x67, 0x65, 0x3b, 0x0a,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x2f, 0x2a, 0x20, 0x52, 0x65, 0x63,
-  0x6f, 0x72, 0x64, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x6f, 0x6f,
-  0x74, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x20, 0x61, 0x6e, 0x64,
-  0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68,
-  0x65, 0x20, 0x72, 0x65, 0x6d, 0x6f, 0x76, 0x65, 0x64, 0x20, 0x6e, 0x6f,
-  0x64, 0x65, 0x2c, 0x20, 0x61, 0x6c, 0x6f, 0x6e, 0x67, 0x20, 0x77, 0x69,
-  0x74, 0x68, 0x20, 0x69, 0x74, 0x73, 0x20, 0x0a, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x2a, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x69,
-  0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x61,
-  0x72, 0x72, 0x61, 0x79, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x61, 0x20, 0x66,
-  0x6c, 0x61, 0x67, 0x20, 0x73, 0x65, 0x74, 0x20, 0x74, 0x6f, 0x20, 0x74,
-  0x72, 0x75, 0x65, 0x20, 0x69, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72,
-  0x65, 0x6d, 0x6f, 0x76, 0x61, 0x6c, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68,
-  0x69, 0x73, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20,
-  0x6e, 0x6f, 0x64, 0x65, 0x20, 0x63, 0x72, 0x65, 0x61, 0x74, 0x65, 0x64,
-  0x20, 0x61, 0x20, 0x68, 0x6f, 0x6c, 0x65, 0x20, 0x69, 0x6e, 0x20, 0x74,
-  0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x61, 0x72, 0x72, 0x61,
-  0x79, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x7b, 0x0a, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x72,
-  0x6f, 0x6f, 0x74, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20,
-  0x6c, 0x61, 0x62, 0x65, 0x6c, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65,
-  0x78, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x68, 0x6f, 0x6c, 0x65, 0x5f, 0x63, 0x72,
-  0x65, 0x61, 0x74, 0x65, 0x64, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x7d, 0x20, 0x72, 0x65, 0x6d, 0x6f, 0x76, 0x65, 0x64, 0x5f, 0x6e,
-  0x6f, 0x64, 0x65, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x2f,
-  0x2a, 0x20, 0x52, 0x65, 0x63, 0x6f, 0x72, 0x64, 0x73, 0x20, 0x74, 0x68,
-  0x65, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x2c, 0x20, 0x73, 0x6f, 0x75,
+  0x6e, 0x64, 0x0a, 0x20, 0x2a, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x72,
+  0x61, 0x70, 0x68, 0x27, 0x73, 0x20, 0x68, 0x6f, 0x6c, 0x65, 0x73, 0x20,
+  0x61, 0x72, 0x72, 0x61, 0x79, 0x73, 0x2e, 0x20, 0x0a, 0x20, 0x2a, 0x0a,
+  0x20, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x72, 0x65, 0x63, 0x6f, 0x72,
+  0x64, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x70, 0x61, 0x63, 0x6b, 0x65,
+  0x64, 0x20, 0x69, 0x6e, 0x74, 0x6f, 0x20, 0x61, 0x20, 0x62, 0x79, 0x74,
+  0x65, 0x20, 0x6c, 0x6f, 0x67, 0x3a, 0x20, 0x65, 0x61, 0x63, 0x68, 0x20,
+  0x72, 0x65, 0x63, 0x6f, 0x72, 0x64, 0x20, 0x68, 0x6f, 0x6c, 0x64, 0x73,
+  0x20, 0x6f, 0x6e, 0x6c, 0x79, 0x20, 0x74, 0x68, 0x65, 0x20, 0x66, 0x69,
+  0x65, 0x6c, 0x64, 0x73, 0x20, 0x69, 0x74, 0x73, 0x0a, 0x20, 0x2a, 0x20,
+  0x74, 0x79, 0x70, 0x65, 0x20, 0x6e, 0x65, 0x65, 0x64, 0x73, 0x20, 0x28,
+  0x69, 0x6e, 0x64, 0x69, 0x63, 0x65, 0x73, 0x2c, 0x20, 0x61, 0x20, 0x6d,
+  0x61, 0x72, 0x6b, 0x2c, 0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x6f, 0x75,
   0x72, 0x63, 0x65, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x74, 0x61, 0x72, 0x67,
-  0x65, 0x74, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x65,
-  0x6d, 0x6f, 0x76, 0x65, 0x64, 0x20, 0x65, 0x64, 0x67, 0x65, 0x2c, 0x20,
-  0x61, 0x6c, 0x6f, 0x6e, 0x67, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x69,
-  0x74, 0x73, 0x20, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x2a,
-  0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68,
-  0x65, 0x20, 0x65, 0x64, 0x67, 0x65, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79,
-  0x20, 0x61, 0x6e, 0x64, 0x20, 0x61, 0x20, 0x66, 0x6c, 0x61, 0x67, 0x20,
-  0x73, 0x65, 0x74, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x72, 0x75, 0x65, 0x20,
-  0x69, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x65, 0x6d, 0x6f, 0x76,
-  0x61, 0x6c, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x69, 0x73, 0x0a, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x65, 0x64, 0x67, 0x65,
-  0x20, 0x63, 0x72, 0x65, 0x61, 0x74, 0x65, 0x64, 0x20, 0x61, 0x20, 0x68,
-  0x6f, 0x6c, 0x65, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x65,
-  0x64, 0x67, 0x65, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x2e, 0x20, 0x2a,
-  0x2f, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x74, 0x72, 0x75,
-  0x63, 0x74, 0x20, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20,
-  0x6c, 0x61, 0x62, 0x65, 0x6c, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x73, 0x6f, 0x75, 0x72,
-  0x63, 0x65, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x69, 0x6e, 0x74, 0x20, 0x74, 0x61, 0x72, 0x67, 0x65, 0x74, 0x3b,
-  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x69, 0x6e,
-  0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x3b, 0x0a, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x68,
-  0x6f, 0x6c, 0x65, 0x5f, 0x63, 0x72, 0x65, 0x61, 0x74, 0x65, 0x64, 0x3b,
-  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x20, 0x72, 0x65, 0x6d,
-  0x6f, 0x76, 0x65, 0x64, 0x5f, 0x65, 0x64, 0x67, 0x65, 0x3b, 0x0a, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x2f, 0x2a, 0x20, 0x52, 0x65, 0x63, 0x6f,
-  0x72, 0x64, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x6e, 0x64, 0x65,
-  0x78, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x65, 0x6c,
-  0x61, 0x62, 0x65, 0x6c, 0x6c, 0x65, 0x64, 0x20, 0x69, 0x74, 0x65, 0x6d,
-  0x20, 0x61, 0x6e, 0x64, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x74, 0x65,
-  0x6d, 0x27, 0x73, 0x20, 0x70, 0x72, 0x65, 0x76, 0x69, 0x6f, 0x75, 0x73,
-  0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20,
-  0x7b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x69,
-  0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x3b, 0x0a, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c,
-  0x61, 0x62, 0x65, 0x6c, 0x20, 0x6f, 0x6c, 0x64, 0x5f, 0x6c, 0x61, 0x62,
-  0x65, 0x6c, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x20,
-  0x72, 0x65, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x6c, 0x65, 0x64, 0x5f, 0x6e,
-  0x6f, 0x64, 0x65, 0x2c, 0x20, 0x72, 0x65, 0x6c, 0x61, 0x62, 0x65, 0x6c,
-  0x6c, 0x65, 0x64, 0x5f, 0x65, 0x64, 0x67, 0x65, 0x3b, 0x20, 0x20, 0x20,
-  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x2f, 0x2a, 0x20, 0x52, 0x65,
-  0x63, 0x6f, 0x72, 0x64, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x6e,
-  0x64, 0x65, 0x78, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72,
-  0x65, 0x6d, 0x61, 0x72, 0x6b, 0x65, 0x64, 0x20, 0x69, 0x74, 0x65, 0x6d,
-  0x20, 0x61, 0x6e, 0x64, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x74, 0x65,
-  0x6d, 0x27, 0x73, 0x20, 0x70, 0x72, 0x65, 0x76, 0x69, 0x6f, 0x75, 0x73,
-  0x20, 0x6d, 0x61, 0x72, 0x6b, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x7b,
-  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x69, 0x6e,
-  0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x3b, 0x0a, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x4d, 0x61, 0x72, 0x6b, 0x54, 0x79,
-  0x70, 0x65, 0x20, 0x6f, 0x6c, 0x64, 0x5f, 0x6d, 0x61, 0x72, 0x6b, 0x3b,
-  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x20, 0x72, 0x65, 0x6d,
-  0x61, 0x72, 0x6b, 0x65, 0x64, 0x5f, 0x6e, 0x6f, 0x64, 0x65, 0x2c, 0x20,
-  0x72, 0x65, 0x6d, 0x61, 0x72, 0x6b, 0x65, 0x64, 0x5f, 0x65, 0x64, 0x67,
-  0x65, 0x3b, 0x20, 0x20, 0x20, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x2f, 0x2a, 0x20, 0x52, 0x65, 0x63, 0x6f, 0x72, 0x64, 0x73, 0x20, 0x74,
-  0x68, 0x65, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x6f, 0x66, 0x20,
-  0x74, 0x68, 0x65, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x77, 0x68, 0x6f,
-  0x73, 0x65, 0x20, 0x72, 0x6f, 0x6f, 0x74, 0x20, 0x73, 0x74, 0x61, 0x74,
-  0x75, 0x73, 0x20, 0x77, 0x61, 0x73, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x67,
-  0x65, 0x64, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x69, 0x6e, 0x74, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x64,
-  0x5f, 0x72, 0x6f, 0x6f, 0x74, 0x5f, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x3b,
-  0x0a, 0x20, 0x20, 0x20, 0x7d, 0x3b, 0x0a, 0x7d, 0x20, 0x47, 0x72, 0x61,
-  0x70, 0x68, 0x43, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x3b, 0x20, 0x0a, 0x0a,
-  0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x47, 0x72, 0x61, 0x70, 0x68,
-  0x43, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x53, 0x74, 0x61, 0x63, 0x6b, 0x3b,
-  0x0a, 0x65, 0x78, 0x74, 0x65, 0x72, 0x6e, 0x20, 0x73, 0x74, 0x72, 0x75,
+  0x65, 0x74, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x20, 0x72, 0x65, 0x6d, 0x6f,
+  0x76, 0x65, 0x64, 0x20, 0x65, 0x64, 0x67, 0x65, 0x29, 0x20, 0x61, 0x6e,
+  0x64, 0x20, 0x65, 0x6e, 0x64, 0x73, 0x0a, 0x20, 0x2a, 0x20, 0x77, 0x69,
+  0x74, 0x68, 0x20, 0x61, 0x20, 0x62, 0x79, 0x74, 0x65, 0x20, 0x67, 0x69,
+  0x76, 0x69, 0x6e, 0x67, 0x20, 0x69, 0x74, 0x73, 0x20, 0x74, 0x79, 0x70,
+  0x65, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x69, 0x74, 0x73, 0x20, 0x66, 0x6c,
+  0x61, 0x67, 0x73, 0x20, 0x28, 0x68, 0x6f, 0x6c, 0x65, 0x20, 0x66, 0x69,
+  0x6c, 0x6c, 0x65, 0x64, 0x20, 0x6f, 0x72, 0x20, 0x63, 0x72, 0x65, 0x61,
+  0x74, 0x65, 0x64, 0x2c, 0x20, 0x72, 0x6f, 0x6f, 0x74, 0x29, 0x2c, 0x20,
+  0x73, 0x6f, 0x0a, 0x20, 0x2a, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x6c, 0x6f, 0x67, 0x20, 0x63, 0x61, 0x6e, 0x20, 0x62,
+  0x65, 0x20, 0x72, 0x65, 0x61, 0x64, 0x20, 0x62, 0x61, 0x63, 0x6b, 0x77,
+  0x61, 0x72, 0x64, 0x73, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6c, 0x6f,
+  0x67, 0x20, 0x69, 0x73, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x64, 0x20,
+  0x69, 0x6e, 0x20, 0x66, 0x69, 0x78, 0x65, 0x64, 0x2d, 0x73, 0x69, 0x7a,
+  0x65, 0x20, 0x63, 0x68, 0x75, 0x6e, 0x6b, 0x73, 0x0a, 0x20, 0x2a, 0x20,
+  0x74, 0x68, 0x61, 0x74, 0x20, 0x61, 0x72, 0x65, 0x20, 0x6b, 0x65, 0x70,
+  0x74, 0x20, 0x66, 0x6f, 0x72, 0x20, 0x72, 0x65, 0x75, 0x73, 0x65, 0x20,
+  0x77, 0x68, 0x65, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x6f, 0x67,
+  0x20, 0x73, 0x68, 0x72, 0x69, 0x6e, 0x6b, 0x73, 0x2e, 0x20, 0x54, 0x68,
+  0x65, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x6f, 0x66, 0x20, 0x61,
+  0x20, 0x72, 0x65, 0x6d, 0x6f, 0x76, 0x65, 0x64, 0x20, 0x6f, 0x72, 0x20,
+  0x0a, 0x20, 0x2a, 0x20, 0x72, 0x65, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x6c,
+  0x65, 0x64, 0x20, 0x69, 0x74, 0x65, 0x6d, 0x20, 0x69, 0x73, 0x20, 0x6b,
+  0x65, 0x70, 0x74, 0x20, 0x61, 0x73, 0x20, 0x61, 0x20, 0x72, 0x65, 0x66,
+  0x65, 0x72, 0x65, 0x6e, 0x63, 0x65, 0x20, 0x74, 0x6f, 0x20, 0x69, 0x74,
+  0x73, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20,
+  0x69, 0x6e, 0x20, 0x61, 0x20, 0x73, 0x65, 0x70, 0x61, 0x72, 0x61, 0x74,
+  0x65, 0x20, 0x73, 0x74, 0x61, 0x63, 0x6b, 0x2c, 0x0a, 0x20, 0x2a, 0x20,
+  0x73, 0x6f, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x64, 0x69, 0x73, 0x63,
+  0x61, 0x72, 0x64, 0x69, 0x6e, 0x67, 0x20, 0x72, 0x65, 0x63, 0x6f, 0x72,
+  0x64, 0x73, 0x20, 0x6e, 0x65, 0x65, 0x64, 0x73, 0x20, 0x74, 0x6f, 0x20,
+  0x76, 0x69, 0x73, 0x69, 0x74, 0x20, 0x6f, 0x6e, 0x6c, 0x79, 0x20, 0x74,
+  0x68, 0x6f, 0x73, 0x65, 0x20, 0x68, 0x6f, 0x6c, 0x64, 0x69, 0x6e, 0x67,
+  0x20, 0x61, 0x20, 0x72, 0x65, 0x66, 0x65, 0x72, 0x65, 0x6e, 0x63, 0x65,
+  0x2e, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x41, 0x20, 0x72, 0x65, 0x73, 0x74,
+  0x6f, 0x72, 0x65, 0x20, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x73,
+  0x20, 0x61, 0x20, 0x70, 0x6f, 0x73, 0x69, 0x74, 0x69, 0x6f, 0x6e, 0x20,
+  0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x6f, 0x67, 0x2e, 0x20,
+  0x2a, 0x2f, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x65,
+  0x6e, 0x75, 0x6d, 0x20, 0x7b, 0x20, 0x41, 0x44, 0x44, 0x45, 0x44, 0x5f,
+  0x4e, 0x4f, 0x44, 0x45, 0x20, 0x3d, 0x20, 0x30, 0x2c, 0x20, 0x41, 0x44,
+  0x44, 0x45, 0x44, 0x5f, 0x45, 0x44, 0x47, 0x45, 0x2c, 0x20, 0x52, 0x45,
+  0x4d, 0x4f, 0x56, 0x45, 0x44, 0x5f, 0x4e, 0x4f, 0x44, 0x45, 0x2c, 0x20,
+  0x52, 0x45, 0x4d, 0x4f, 0x56, 0x45, 0x44, 0x5f, 0x45, 0x44, 0x47, 0x45,
+  0x2c, 0x20, 0x0a, 0x09, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x52,
+  0x45, 0x4c, 0x41, 0x42, 0x45, 0x4c, 0x4c, 0x45, 0x44, 0x5f, 0x4e, 0x4f,
+  0x44, 0x45, 0x2c, 0x20, 0x52, 0x45, 0x4c, 0x41, 0x42, 0x45, 0x4c, 0x4c,
+  0x45, 0x44, 0x5f, 0x45, 0x44, 0x47, 0x45, 0x2c, 0x20, 0x52, 0x45, 0x4d,
+  0x41, 0x52, 0x4b, 0x45, 0x44, 0x5f, 0x4e, 0x4f, 0x44, 0x45, 0x2c, 0x20,
+  0x52, 0x45, 0x4d, 0x41, 0x52, 0x4b, 0x45, 0x44, 0x5f, 0x45, 0x44, 0x47,
+  0x45, 0x2c, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x43, 0x48, 0x41, 0x4e, 0x47, 0x45,
+  0x44, 0x5f, 0x52, 0x4f, 0x4f, 0x54, 0x5f, 0x4e, 0x4f, 0x44, 0x45, 0x7d,
+  0x20, 0x47, 0x72, 0x61, 0x70, 0x68, 0x43, 0x68, 0x61, 0x6e, 0x67, 0x65,
+  0x54, 0x79, 0x70, 0x65, 0x3b, 0x20, 0x0a, 0x0a, 0x73, 0x74, 0x72, 0x75,
   0x63, 0x74, 0x20, 0x47, 0x72, 0x61, 0x70, 0x68, 0x43, 0x68, 0x61, 0x6e,
-  0x67, 0x65, 0x53, 0x74, 0x61, 0x63, 0x6b, 0x20, 0x2a, 0x67, 0x72, 0x61,
-  0x70, 0x68, 0x5f, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x5f, 0x73, 0x74,
-  0x61, 0x63, 0x6b, 0x3b, 0x0a, 0x65, 0x78, 0x74, 0x65, 0x72, 0x6e, 0x20,
-  0x69, 0x6e, 0x74, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x5f, 0x63, 0x68,
-  0x61, 0x6e, 0x67, 0x65, 0x5f, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x3b, 0x0a,
-  0x0a, 0x69, 0x6e, 0x74, 0x20, 0x74, 0x6f, 0x70, 0x4f, 0x66, 0x47, 0x72,
-  0x61, 0x70, 0x68, 0x43, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x53, 0x74, 0x61,
-  0x63, 0x6b, 0x28, 0x76, 0x6f, 0x69, 0x64, 0x29, 0x3b, 0x0a, 0x76, 0x6f,
-  0x69, 0x64, 0x20, 0x70, 0x75, 0x73, 0x68, 0x41, 0x64, 0x64, 0x65, 0x64,
-  0x4e, 0x6f, 0x64, 0x65, 0x28, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64,
-  0x65, 0x78, 0x2c, 0x20, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x68, 0x6f, 0x6c,
-  0x65, 0x5f, 0x66, 0x69, 0x6c, 0x6c, 0x65, 0x64, 0x29, 0x3b, 0x0a, 0x76,
-  0x6f, 0x69, 0x64, 0x20, 0x70, 0x75, 0x73, 0x68, 0x41, 0x64, 0x64, 0x65,
-  0x64, 0x45, 0x64, 0x67, 0x65, 0x28, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e,
-  0x64, 0x65, 0x78, 0x2c, 0x20, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x68, 0x6f,
-  0x6c, 0x65, 0x5f, 0x66, 0x69, 0x6c, 0x6c, 0x65, 0x64, 0x29, 0x3b, 0x0a,
-  0x76, 0x6f, 0x69, 0x64, 0x20, 0x70, 0x75, 0x73, 0x68, 0x52, 0x65, 0x6d,
-  0x6f, 0x76, 0x65, 0x64, 0x4e, 0x6f, 0x64, 0x65, 0x28, 0x62, 0x6f, 0x6f,
-  0x6c, 0x20, 0x72, 0x6f, 0x6f, 0x74, 0x2c, 0x20, 0x48, 0x6f, 0x73, 0x74,
-  0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x2c,
-  0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20,
-  0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x68, 0x6f, 0x6c, 0x65, 0x5f, 0x63, 0x72,
-  0x65, 0x61, 0x74, 0x65, 0x64, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64,
+  0x67, 0x65, 0x53, 0x74, 0x61, 0x63, 0x6b, 0x3b, 0x0a, 0x65, 0x78, 0x74,
+  0x65, 0x72, 0x6e, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x47,
+  0x72, 0x61, 0x70, 0x68, 0x43, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x53, 0x74,
+  0x61, 0x63, 0x6b, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x5f, 0x63,
+  0x68, 0x61, 0x6e, 0x67, 0x65, 0x5f, 0x73, 0x74, 0x61, 0x63, 0x6b, 0x3b,
+  0x0a, 0x65, 0x78, 0x74, 0x65, 0x72, 0x6e, 0x20, 0x69, 0x6e, 0x74, 0x20,
+  0x67, 0x72, 0x61, 0x70, 0x68, 0x5f, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65,
+  0x5f, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x3b, 0x0a, 0x0a, 0x69, 0x6e, 0x74,
+  0x20, 0x74, 0x6f, 0x70, 0x4f, 0x66, 0x47, 0x72, 0x61, 0x70, 0x68, 0x43,
+  0x68, 0x61, 0x6e, 0x67, 0x65, 0x53, 0x74, 0x61, 0x63, 0x6b, 0x28, 0x76,
+  0x6f, 0x69, 0x64, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x70,
+  0x75, 0x73, 0x68, 0x41, 0x64, 0x64, 0x65, 0x64, 0x4e, 0x6f, 0x64, 0x65,
+  0x28, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20,
+  0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x68, 0x6f, 0x6c, 0x65, 0x5f, 0x66, 0x69,
+  0x6c, 0x6c, 0x65, 0x64, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20,
+  0x70, 0x75, 0x73, 0x68, 0x41, 0x64, 0x64, 0x65, 0x64, 0x45, 0x64, 0x67,
+  0x65, 0x28, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c,
+  0x20, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x68, 0x6f, 0x6c, 0x65, 0x5f, 0x66,
+  0x69, 0x6c, 0x6c, 0x65, 0x64, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64,
   0x20, 0x70, 0x75, 0x73, 0x68, 0x52, 0x65, 0x6d, 0x6f, 0x76, 0x65, 0x64,
-  0x45, 0x64, 0x67, 0x65, 0x28, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62,
-  0x65, 0x6c, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x2c, 0x20, 0x69, 0x6e,
-  0x74, 0x20, 0x73, 0x6f, 0x75, 0x72, 0x63, 0x65, 0x2c, 0x20, 0x69, 0x6e,
-  0x74, 0x20, 0x74, 0x61, 0x72, 0x67, 0x65, 0x74, 0x2c, 0x20, 0x69, 0x6e,
-  0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20, 0x62, 0x6f, 0x6f,
-  0x6c, 0x20, 0x68, 0x6f, 0x6c, 0x65, 0x5f, 0x63, 0x72, 0x65, 0x61, 0x74,
-  0x65, 0x64, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x70, 0x75,
-  0x73, 0x68, 0x52, 0x65, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x6c, 0x65, 0x64,
+  0x4e, 0x6f, 0x64, 0x65, 0x28, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x72, 0x6f,
+  0x6f, 0x74, 0x2c, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65,
+  0x6c, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x2c, 0x20, 0x69, 0x6e, 0x74,
+  0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20, 0x62, 0x6f, 0x6f, 0x6c,
+  0x20, 0x68, 0x6f, 0x6c, 0x65, 0x5f, 0x63, 0x72, 0x65, 0x61, 0x74, 0x65,
+  0x64, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x70, 0x75, 0x73,
+  0x68, 0x52, 0x65, 0x6d, 0x6f, 0x76, 0x65, 0x64, 0x45, 0x64, 0x67, 0x65,
+  0x28, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x6c,
+  0x61, 0x62, 0x65, 0x6c, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x73, 0x6f,
+  0x75, 0x72, 0x63, 0x65, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x74, 0x61,
+  0x72, 0x67, 0x65, 0x74, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e,
+  0x64, 0x65, 0x78, 0x2c, 0x20, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x68, 0x6f,
+  0x6c, 0x65, 0x5f, 0x63, 0x72, 0x65, 0x61, 0x74, 0x65, 0x64, 0x29, 0x3b,
+  0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x70, 0x75, 0x73, 0x68, 0x52, 0x65,
+  0x6c, 0x61, 0x62, 0x65, 0x6c, 0x6c, 0x65, 0x64, 0x4e, 0x6f, 0x64, 0x65,
+  0x28, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20,
+  0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x6f, 0x6c,
+  0x64, 0x5f, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x29, 0x3b, 0x0a, 0x76, 0x6f,
+  0x69, 0x64, 0x20, 0x70, 0x75, 0x73, 0x68, 0x52, 0x65, 0x6c, 0x61, 0x62,
+  0x65, 0x6c, 0x6c, 0x65, 0x64, 0x45, 0x64, 0x67, 0x65, 0x28, 0x69, 0x6e,
+  0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20, 0x48, 0x6f, 0x73,
+  0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x6f, 0x6c, 0x64, 0x5f, 0x6c,
+  0x61, 0x62, 0x65, 0x6c, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20,
+  0x70, 0x75, 0x73, 0x68, 0x52, 0x65, 0x6d, 0x61, 0x72, 0x6b, 0x65, 0x64,
   0x4e, 0x6f, 0x64, 0x65, 0x28, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64,
-  0x65, 0x78, 0x2c, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65,
-  0x6c, 0x20, 0x6f, 0x6c, 0x64, 0x5f, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x29,
-  0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x70, 0x75, 0x73, 0x68, 0x52,
-  0x65, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x6c, 0x65, 0x64, 0x45, 0x64, 0x67,
-  0x65, 0x28, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c,
-  0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x6f,
-  0x6c, 0x64, 0x5f, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x29, 0x3b, 0x0a, 0x76,
-  0x6f, 0x69, 0x64, 0x20, 0x70, 0x75, 0x73, 0x68, 0x52, 0x65, 0x6d, 0x61,
-  0x72, 0x6b, 0x65, 0x64, 0x4e, 0x6f, 0x64, 0x65, 0x28, 0x69, 0x6e, 0x74,
-  0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20, 0x4d, 0x61, 0x72, 0x6b,
-  0x54, 0x79, 0x70, 0x65, 0x20, 0x6f, 0x6c, 0x64, 0x5f, 0x6d, 0x61, 0x72,
-  0x6b, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x70, 0x75, 0x73,
-  0x68, 0x52, 0x65, 0x6d, 0x61, 0x72, 0x6b, 0x65, 0x64, 0x45, 0x64, 0x67,
-  0x65, 0x28, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c,
-  0x20, 0x4d, 0x61, 0x72, 0x6b, 0x54, 0x79, 0x70, 0x65, 0x20, 0x6f, 0x6c,
-  0x64, 0x5f, 0x6d, 0x61, 0x72, 0x6b, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69,
-  0x64, 0x20, 0x70, 0x75, 0x73, 0x68, 0x43, 0x68, 0x61, 0x6e, 0x67, 0x65,
-  0x64, 0x52, 0x6f, 0x6f, 0x74, 0x4e, 0x6f, 0x64, 0x65, 0x28, 0x69, 0x6e,
-  0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x76, 0x6f,
-  0x69, 0x64, 0x20, 0x75, 0x6e, 0x64, 0x6f, 0x43, 0x68, 0x61, 0x6e, 0x67,
-  0x65, 0x73, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72,
-  0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x72, 0x65, 0x73,
+  0x65, 0x78, 0x2c, 0x20, 0x4d, 0x61, 0x72, 0x6b, 0x54, 0x79, 0x70, 0x65,
+  0x20, 0x6f, 0x6c, 0x64, 0x5f, 0x6d, 0x61, 0x72, 0x6b, 0x29, 0x3b, 0x0a,
+  0x76, 0x6f, 0x69, 0x64, 0x20, 0x70, 0x75, 0x73, 0x68, 0x52, 0x65, 0x6d,
+  0x61, 0x72, 0x6b, 0x65, 0x64, 0x45, 0x64, 0x67, 0x65, 0x28, 0x69, 0x6e,
+  0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20, 0x4d, 0x61, 0x72,
+  0x6b, 0x54, 0x79, 0x70, 0x65, 0x20, 0x6f, 0x6c, 0x64, 0x5f, 0x6d, 0x61,
+  0x72, 0x6b, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x70, 0x75,
+  0x73, 0x68, 0x43, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x64, 0x52, 0x6f, 0x6f,
+  0x74, 0x4e, 0x6f, 0x64, 0x65, 0x28, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e,
+  0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x75,
+  0x6e, 0x64, 0x6f, 0x43, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x73, 0x28, 0x47,
+  0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c,
+  0x20, 0x69, 0x6e, 0x74, 0x20, 0x72, 0x65, 0x73, 0x74, 0x6f, 0x72, 0x65,
+  0x5f, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69,
+  0x64, 0x20, 0x64, 0x69, 0x73, 0x63, 0x61, 0x72, 0x64, 0x43, 0x68, 0x61,
+  0x6e, 0x67, 0x65, 0x73, 0x28, 0x69, 0x6e, 0x74, 0x20, 0x72, 0x65, 0x73,
   0x74, 0x6f, 0x72, 0x65, 0x5f, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x29, 0x3b,
-  0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x64, 0x69, 0x73, 0x63, 0x61, 0x72,
-  0x64, 0x43, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x73, 0x28, 0x69, 0x6e, 0x74,
-  0x20, 0x72, 0x65, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x5f, 0x70, 0x6f, 0x69,
-  0x6e, 0x74, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x66, 0x72,
-  0x65, 0x65, 0x47, 0x72, 0x61, 0x70, 0x68, 0x43, 0x68, 0x61, 0x6e, 0x67,
-  0x65, 0x53, 0x74, 0x61, 0x63, 0x6b, 0x28, 0x76, 0x6f, 0x69, 0x64, 0x29,
-  0x3b, 0x0a, 0x0a, 0x0a, 0x65, 0x78, 0x74, 0x65, 0x72, 0x6e, 0x20, 0x47,
-  0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68,
-  0x5f, 0x73, 0x74, 0x61, 0x63, 0x6b, 0x3b, 0x0a, 0x65, 0x78, 0x74, 0x65,
-  0x72, 0x6e, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68,
-  0x5f, 0x73, 0x74, 0x61, 0x63, 0x6b, 0x5f, 0x69, 0x6e, 0x64, 0x65, 0x78,
-  0x3b, 0x0a, 0x65, 0x78, 0x74, 0x65, 0x72, 0x6e, 0x20, 0x69, 0x6e, 0x74,
-  0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x5f, 0x63, 0x6f, 0x70, 0x79, 0x5f,
-  0x63, 0x6f, 0x75, 0x6e, 0x74, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x43,
-  0x72, 0x65, 0x61, 0x74, 0x65, 0x73, 0x20, 0x61, 0x20, 0x6d, 0x65, 0x6d,
-  0x6f, 0x72, 0x79, 0x20, 0x63, 0x6f, 0x70, 0x79, 0x20, 0x6f, 0x66, 0x20,
-  0x74, 0x68, 0x65, 0x20, 0x70, 0x61, 0x73, 0x73, 0x65, 0x64, 0x20, 0x67,
-  0x72, 0x61, 0x70, 0x68, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x70, 0x75, 0x73,
-  0x68, 0x65, 0x73, 0x20, 0x69, 0x74, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68,
-  0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x73, 0x74, 0x61, 0x63,
-  0x6b, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x63,
+  0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x66, 0x72, 0x65, 0x65, 0x47, 0x72,
+  0x61, 0x70, 0x68, 0x43, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x53, 0x74, 0x61,
+  0x63, 0x6b, 0x28, 0x76, 0x6f, 0x69, 0x64, 0x29, 0x3b, 0x0a, 0x0a, 0x2f,
+  0x2a, 0x20, 0x53, 0x61, 0x76, 0x65, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x73,
+  0x20, 0x61, 0x72, 0x65, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x6e, 0x74,
+  0x65, 0x72, 0x66, 0x61, 0x63, 0x65, 0x20, 0x75, 0x73, 0x65, 0x64, 0x20,
+  0x62, 0x79, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x65, 0x6e, 0x65, 0x72,
+  0x61, 0x74, 0x65, 0x64, 0x20, 0x63, 0x6f, 0x64, 0x65, 0x20, 0x74, 0x6f,
+  0x20, 0x72, 0x65, 0x63, 0x6f, 0x72, 0x64, 0x20, 0x63, 0x68, 0x61, 0x6e,
+  0x67, 0x65, 0x73, 0x2e, 0x0a, 0x20, 0x2a, 0x20, 0x62, 0x65, 0x67, 0x69,
+  0x6e, 0x53, 0x61, 0x76, 0x65, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x20, 0x6f,
+  0x70, 0x65, 0x6e, 0x73, 0x20, 0x61, 0x20, 0x73, 0x61, 0x76, 0x65, 0x70,
+  0x6f, 0x69, 0x6e, 0x74, 0x20, 0x61, 0x74, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x74, 0x6f, 0x70, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67,
+  0x72, 0x61, 0x70, 0x68, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x20,
+  0x73, 0x74, 0x61, 0x63, 0x6b, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x0a, 0x20,
+  0x2a, 0x20, 0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x73, 0x20, 0x69, 0x74,
+  0x73, 0x20, 0x68, 0x61, 0x6e, 0x64, 0x6c, 0x65, 0x3a, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x6e, 0x75, 0x6d, 0x62, 0x65, 0x72, 0x20, 0x6f, 0x66, 0x20,
+  0x73, 0x61, 0x76, 0x65, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x73, 0x20, 0x6f,
+  0x70, 0x65, 0x6e, 0x20, 0x62, 0x65, 0x6c, 0x6f, 0x77, 0x20, 0x69, 0x74,
+  0x2e, 0x20, 0x72, 0x6f, 0x6c, 0x6c, 0x62, 0x61, 0x63, 0x6b, 0x53, 0x61,
+  0x76, 0x65, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x0a, 0x20, 0x2a, 0x20, 0x75,
+  0x6e, 0x64, 0x6f, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x63, 0x68,
+  0x61, 0x6e, 0x67, 0x65, 0x73, 0x20, 0x6d, 0x61, 0x64, 0x65, 0x20, 0x73,
+  0x69, 0x6e, 0x63, 0x65, 0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x61, 0x76,
+  0x65, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x70, 0x61, 0x73, 0x73, 0x65, 0x64, 0x20, 0x68,
+  0x61, 0x6e, 0x64, 0x6c, 0x65, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x63, 0x6c,
+  0x6f, 0x73, 0x65, 0x73, 0x0a, 0x20, 0x2a, 0x20, 0x69, 0x74, 0x20, 0x61,
+  0x6e, 0x64, 0x20, 0x65, 0x76, 0x65, 0x72, 0x79, 0x20, 0x73, 0x61, 0x76,
+  0x65, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x20, 0x6f, 0x70, 0x65, 0x6e, 0x65,
+  0x64, 0x20, 0x61, 0x66, 0x74, 0x65, 0x72, 0x20, 0x69, 0x74, 0x2e, 0x20,
+  0x72, 0x65, 0x6c, 0x65, 0x61, 0x73, 0x65, 0x53, 0x61, 0x76, 0x65, 0x70,
+  0x6f, 0x69, 0x6e, 0x74, 0x20, 0x63, 0x6c, 0x6f, 0x73, 0x65, 0x73, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x73, 0x61, 0x6d, 0x65, 0x20, 0x0a, 0x20, 0x2a,
+  0x20, 0x73, 0x61, 0x76, 0x65, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x73, 0x20,
+  0x62, 0x75, 0x74, 0x20, 0x6b, 0x65, 0x65, 0x70, 0x73, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x73, 0x2e, 0x20, 0x49,
+  0x66, 0x20, 0x61, 0x6e, 0x20, 0x65, 0x6e, 0x63, 0x6c, 0x6f, 0x73, 0x69,
+  0x6e, 0x67, 0x20, 0x73, 0x61, 0x76, 0x65, 0x70, 0x6f, 0x69, 0x6e, 0x74,
+  0x20, 0x69, 0x73, 0x20, 0x73, 0x74, 0x69, 0x6c, 0x6c, 0x20, 0x6f, 0x70,
+  0x65, 0x6e, 0x2c, 0x0a, 0x20, 0x2a, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72,
+  0x65, 0x6c, 0x65, 0x61, 0x73, 0x65, 0x64, 0x20, 0x63, 0x68, 0x61, 0x6e,
+  0x67, 0x65, 0x73, 0x20, 0x62, 0x65, 0x63, 0x6f, 0x6d, 0x65, 0x20, 0x70,
+  0x61, 0x72, 0x74, 0x20, 0x6f, 0x66, 0x20, 0x69, 0x74, 0x20, 0x77, 0x69,
+  0x74, 0x68, 0x6f, 0x75, 0x74, 0x20, 0x74, 0x6f, 0x75, 0x63, 0x68, 0x69,
+  0x6e, 0x67, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x65, 0x63, 0x6f, 0x72,
+  0x64, 0x73, 0x3b, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x6f, 0x74, 0x68, 0x65,
+  0x72, 0x77, 0x69, 0x73, 0x65, 0x20, 0x6e, 0x6f, 0x74, 0x68, 0x69, 0x6e,
+  0x67, 0x20, 0x63, 0x61, 0x6e, 0x20, 0x72, 0x6f, 0x6c, 0x6c, 0x20, 0x74,
+  0x68, 0x65, 0x6d, 0x20, 0x62, 0x61, 0x63, 0x6b, 0x20, 0x61, 0x6e, 0x64,
+  0x20, 0x74, 0x68, 0x65, 0x79, 0x20, 0x61, 0x72, 0x65, 0x20, 0x64, 0x69,
+  0x73, 0x63, 0x61, 0x72, 0x64, 0x65, 0x64, 0x2e, 0x20, 0x42, 0x6f, 0x74,
+  0x68, 0x20, 0x64, 0x6f, 0x20, 0x6e, 0x6f, 0x74, 0x68, 0x69, 0x6e, 0x67,
+  0x0a, 0x20, 0x2a, 0x20, 0x69, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x73,
+  0x61, 0x76, 0x65, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x73, 0x20,
+  0x61, 0x6c, 0x72, 0x65, 0x61, 0x64, 0x79, 0x20, 0x63, 0x6c, 0x6f, 0x73,
+  0x65, 0x64, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x62,
+  0x65, 0x67, 0x69, 0x6e, 0x53, 0x61, 0x76, 0x65, 0x70, 0x6f, 0x69, 0x6e,
+  0x74, 0x28, 0x76, 0x6f, 0x69, 0x64, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69,
+  0x64, 0x20, 0x72, 0x6f, 0x6c, 0x6c, 0x62, 0x61, 0x63, 0x6b, 0x53, 0x61,
+  0x76, 0x65, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x28, 0x47, 0x72, 0x61, 0x70,
+  0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e,
+  0x74, 0x20, 0x73, 0x61, 0x76, 0x65, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x29,
+  0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x72, 0x65, 0x6c, 0x65, 0x61,
+  0x73, 0x65, 0x53, 0x61, 0x76, 0x65, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x28,
+  0x69, 0x6e, 0x74, 0x20, 0x73, 0x61, 0x76, 0x65, 0x70, 0x6f, 0x69, 0x6e,
+  0x74, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x43, 0x61, 0x6c, 0x6c,
+  0x73, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x61, 0x63, 0x74, 0x47, 0x72, 0x61,
+  0x70, 0x68, 0x20, 0x69, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x72,
+  0x61, 0x70, 0x68, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x20, 0x73,
+  0x74, 0x61, 0x63, 0x6b, 0x20, 0x69, 0x73, 0x20, 0x65, 0x6d, 0x70, 0x74,
+  0x79, 0x2c, 0x20, 0x6e, 0x6f, 0x20, 0x73, 0x61, 0x76, 0x65, 0x70, 0x6f,
+  0x69, 0x6e, 0x74, 0x20, 0x69, 0x73, 0x20, 0x6f, 0x70, 0x65, 0x6e, 0x0a,
+  0x20, 0x2a, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67,
+  0x72, 0x61, 0x70, 0x68, 0x20, 0x68, 0x61, 0x73, 0x20, 0x6e, 0x6f, 0x20,
+  0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x2e, 0x20, 0x54, 0x68,
+  0x65, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x20, 0x72, 0x65, 0x63,
+  0x6f, 0x72, 0x64, 0x73, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x73, 0x6e, 0x61,
+  0x70, 0x73, 0x68, 0x6f, 0x74, 0x73, 0x20, 0x72, 0x65, 0x66, 0x65, 0x72,
+  0x20, 0x74, 0x6f, 0x20, 0x69, 0x74, 0x65, 0x6d, 0x73, 0x20, 0x62, 0x79,
+  0x20, 0x74, 0x68, 0x65, 0x69, 0x72, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79,
+  0x0a, 0x20, 0x2a, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x61, 0x6e,
+  0x64, 0x20, 0x72, 0x65, 0x6c, 0x79, 0x20, 0x6f, 0x6e, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x68, 0x6f, 0x6c, 0x65, 0x73, 0x20, 0x74, 0x68, 0x61, 0x74,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x65, 0x63, 0x6f, 0x72, 0x64, 0x65,
+  0x64, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x73, 0x20, 0x63, 0x72,
+  0x65, 0x61, 0x74, 0x65, 0x64, 0x2c, 0x20, 0x73, 0x6f, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x73, 0x0a, 0x20, 0x2a, 0x20,
+  0x61, 0x72, 0x65, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x63, 0x6f, 0x6d, 0x70,
+  0x61, 0x63, 0x74, 0x65, 0x64, 0x20, 0x77, 0x68, 0x69, 0x6c, 0x65, 0x20,
+  0x61, 0x6e, 0x79, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x20, 0x69,
+  0x73, 0x20, 0x72, 0x65, 0x63, 0x6f, 0x72, 0x64, 0x65, 0x64, 0x2e, 0x20,
+  0x43, 0x61, 0x6c, 0x6c, 0x65, 0x64, 0x20, 0x62, 0x79, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x67, 0x65, 0x6e, 0x65, 0x72, 0x61, 0x74, 0x65, 0x64, 0x20,
+  0x63, 0x6f, 0x64, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x61, 0x66, 0x74, 0x65,
+  0x72, 0x20, 0x72, 0x75, 0x6c, 0x65, 0x20, 0x61, 0x70, 0x70, 0x6c, 0x69,
+  0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x73, 0x2e, 0x20, 0x2a, 0x2f, 0x0a,
+  0x76, 0x6f, 0x69, 0x64, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x61, 0x63, 0x74,
+  0x47, 0x72, 0x61, 0x70, 0x68, 0x41, 0x74, 0x53, 0x61, 0x66, 0x65, 0x50,
+  0x6f, 0x69, 0x6e, 0x74, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a,
+  0x67, 0x72, 0x61, 0x70, 0x68, 0x29, 0x3b, 0x0a, 0x0a, 0x0a, 0x65, 0x78,
+  0x74, 0x65, 0x72, 0x6e, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x67, 0x72, 0x61,
+  0x70, 0x68, 0x5f, 0x63, 0x6f, 0x70, 0x79, 0x5f, 0x63, 0x6f, 0x75, 0x6e,
+  0x74, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x55, 0x73, 0x65, 0x64, 0x20,
+  0x62, 0x79, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x65, 0x6e, 0x65, 0x72,
+  0x61, 0x74, 0x65, 0x64, 0x20, 0x63, 0x6f, 0x64, 0x65, 0x20, 0x77, 0x68,
+  0x65, 0x6e, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x63, 0x6f, 0x70,
+  0x79, 0x69, 0x6e, 0x67, 0x20, 0x69, 0x73, 0x20, 0x65, 0x6e, 0x61, 0x62,
+  0x6c, 0x65, 0x64, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x73, 0x6e, 0x61,
+  0x70, 0x73, 0x68, 0x6f, 0x74, 0x73, 0x20, 0x6f, 0x66, 0x0a, 0x20, 0x2a,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x70, 0x61, 0x73, 0x73, 0x65, 0x64, 0x20,
+  0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x66, 0x6f, 0x72, 0x6d, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x73, 0x74, 0x61, 0x63, 0x6b, 0x2e, 0x20, 0x63, 0x6f,
+  0x70, 0x79, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x70, 0x75, 0x73, 0x68,
+  0x65, 0x73, 0x20, 0x61, 0x20, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f,
+  0x74, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x72, 0x65, 0x74, 0x75, 0x72, 0x6e,
+  0x73, 0x20, 0x69, 0x74, 0x73, 0x0a, 0x20, 0x2a, 0x20, 0x72, 0x65, 0x73,
+  0x74, 0x6f, 0x72, 0x65, 0x20, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x3a, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x6e, 0x75, 0x6d, 0x62, 0x65, 0x72, 0x20, 0x6f,
+  0x66, 0x20, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x73, 0x20,
+  0x62, 0x65, 0x6c, 0x6f, 0x77, 0x20, 0x69, 0x74, 0x2e, 0x20, 0x72, 0x65,
+  0x76, 0x65, 0x72, 0x74, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x72, 0x65,
+  0x74, 0x75, 0x72, 0x6e, 0x73, 0x20, 0x74, 0x68, 0x65, 0x0a, 0x20, 0x2a,
+  0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x74, 0x6f, 0x20, 0x69, 0x74,
+  0x73, 0x20, 0x73, 0x74, 0x61, 0x74, 0x65, 0x20, 0x61, 0x74, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x20,
+  0x77, 0x69, 0x74, 0x68, 0x20, 0x74, 0x68, 0x65, 0x20, 0x70, 0x61, 0x73,
+  0x73, 0x65, 0x64, 0x20, 0x72, 0x65, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x20,
+  0x70, 0x6f, 0x69, 0x6e, 0x74, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x72, 0x65,
+  0x6d, 0x6f, 0x76, 0x65, 0x73, 0x0a, 0x20, 0x2a, 0x20, 0x74, 0x68, 0x61,
+  0x74, 0x20, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x20, 0x61,
+  0x6e, 0x64, 0x20, 0x74, 0x68, 0x6f, 0x73, 0x65, 0x20, 0x61, 0x62, 0x6f,
+  0x76, 0x65, 0x20, 0x69, 0x74, 0x2e, 0x20, 0x64, 0x69, 0x73, 0x63, 0x61,
+  0x72, 0x64, 0x47, 0x72, 0x61, 0x70, 0x68, 0x73, 0x20, 0x72, 0x65, 0x6d,
+  0x6f, 0x76, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x61, 0x6d,
+  0x65, 0x20, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x73, 0x20,
+  0x0a, 0x20, 0x2a, 0x20, 0x62, 0x75, 0x74, 0x20, 0x6b, 0x65, 0x65, 0x70,
+  0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x63, 0x75, 0x72, 0x72, 0x65, 0x6e,
+  0x74, 0x20, 0x73, 0x74, 0x61, 0x74, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2e, 0x20, 0x54, 0x68,
+  0x65, 0x20, 0x73, 0x6e, 0x61, 0x70, 0x73, 0x68, 0x6f, 0x74, 0x73, 0x20,
+  0x61, 0x72, 0x65, 0x20, 0x66, 0x72, 0x65, 0x65, 0x64, 0x20, 0x62, 0x79,
+  0x20, 0x0a, 0x20, 0x2a, 0x20, 0x66, 0x72, 0x65, 0x65, 0x47, 0x72, 0x61,
+  0x70, 0x68, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x63,
   0x6f, 0x70, 0x79, 0x47, 0x72, 0x61, 0x70, 0x68, 0x28, 0x47, 0x72, 0x61,
   0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x29, 0x3b, 0x0a,
-  0x0a, 0x2f, 0x2a, 0x20, 0x52, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x73, 0x20,
-  0x74, 0x68, 0x65, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x61, 0x74,
-  0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x74, 0x61, 0x63, 0x6b, 0x20, 0x65,
-  0x6e, 0x74, 0x72, 0x79, 0x20, 0x3c, 0x72, 0x65, 0x73, 0x74, 0x6f, 0x72,
-  0x65, 0x5f, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x3e, 0x20, 0x65, 0x6e, 0x74,
-  0x72, 0x69, 0x65, 0x73, 0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x74, 0x68,
-  0x65, 0x0a, 0x20, 0x2a, 0x20, 0x62, 0x6f, 0x74, 0x74, 0x6f, 0x6d, 0x20,
-  0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x74, 0x61, 0x63, 0x6b,
-  0x2e, 0x20, 0x46, 0x72, 0x65, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20,
-  0x70, 0x61, 0x73, 0x73, 0x65, 0x64, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68,
-  0x20, 0x75, 0x6e, 0x6c, 0x65, 0x73, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20,
-  0x72, 0x65, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x20, 0x70, 0x6f, 0x69, 0x6e,
-  0x74, 0x0a, 0x20, 0x2a, 0x20, 0x72, 0x65, 0x66, 0x65, 0x72, 0x73, 0x20,
-  0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x74, 0x61, 0x63, 0x6b,
-  0x27, 0x73, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2e, 0x20, 0x2a, 0x2f,
-  0x0a, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x72, 0x65, 0x76, 0x65,
-  0x72, 0x74, 0x47, 0x72, 0x61, 0x70, 0x68, 0x28, 0x47, 0x72, 0x61, 0x70,
-  0x68, 0x20, 0x2a, 0x63, 0x75, 0x72, 0x72, 0x65, 0x6e, 0x74, 0x5f, 0x67,
-  0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x72, 0x65,
-  0x73, 0x74, 0x6f, 0x72, 0x65, 0x5f, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x29,
-  0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x64, 0x69, 0x73, 0x63, 0x61,
-  0x72, 0x64, 0x47, 0x72, 0x61, 0x70, 0x68, 0x73, 0x28, 0x69, 0x6e, 0x74,
-  0x20, 0x64, 0x65, 0x70, 0x74, 0x68, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69,
-  0x64, 0x20, 0x66, 0x72, 0x65, 0x65, 0x47, 0x72, 0x61, 0x70, 0x68, 0x53,
-  0x74, 0x61, 0x63, 0x6b, 0x28, 0x76, 0x6f, 0x69, 0x64, 0x29, 0x3b, 0x0a,
-  0x0a, 0x23, 0x65, 0x6e, 0x64, 0x69, 0x66, 0x20, 0x2f, 0x2a, 0x20, 0x49,
-  0x4e, 0x43, 0x5f, 0x47, 0x52, 0x41, 0x50, 0x48, 0x5f, 0x53, 0x54, 0x41,
-  0x43, 0x4b, 0x53, 0x5f, 0x48, 0x20, 0x2a, 0x2f, 0x0a, 0x00
+  0x76, 0x6f, 0x69, 0x64, 0x20, 0x72, 0x65, 0x76, 0x65, 0x72, 0x74, 0x47,
+  0x72, 0x61, 0x70, 0x68, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a,
+  0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x72,
+  0x65, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x5f, 0x70, 0x6f, 0x69, 0x6e, 0x74,
+  0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x64, 0x69, 0x73, 0x63,
+  0x61, 0x72, 0x64, 0x47, 0x72, 0x61, 0x70, 0x68, 0x73, 0x28, 0x47, 0x72,
+  0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20,
+  0x69, 0x6e, 0x74, 0x20, 0x72, 0x65, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x5f,
+  0x70, 0x6f, 0x69, 0x6e, 0x74, 0x29, 0x3b, 0x0a, 0x0a, 0x23, 0x65, 0x6e,
+  0x64, 0x69, 0x66, 0x20, 0x2f, 0x2a, 0x20, 0x49, 0x4e, 0x43, 0x5f, 0x47,
+  0x52, 0x41, 0x50, 0x48, 0x5f, 0x53, 0x54, 0x41, 0x43, 0x4b, 0x53, 0x5f,
+  0x48, 0x20, 0x2a, 0x2f, 0x0a, 0x00
 };
-unsigned int graphStacks_h_len = 3957;
+unsigned int graphStacks_h_len = 4385;
 
 
 unsigned char hostParser_h[] = {
@@ -1420,56 +2904,62 @@ unsigned char label_h[] = {
   0x61, 0x62, 0x65, 0x6c, 0x73, 0x2e, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x20,
   0x6c, 0x69, 0x73, 0x74, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x69, 0x6d,
   0x70, 0x6c, 0x65, 0x6d, 0x65, 0x6e, 0x74, 0x65, 0x64, 0x20, 0x0a, 0x20,
-  0x20, 0x61, 0x73, 0x20, 0x64, 0x6f, 0x75, 0x62, 0x6c, 0x79, 0x2d, 0x6c,
-  0x69, 0x6e, 0x6b, 0x65, 0x64, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x73, 0x2c,
-  0x20, 0x61, 0x6e, 0x64, 0x20, 0x61, 0x72, 0x65, 0x20, 0x73, 0x74, 0x6f,
-  0x72, 0x65, 0x64, 0x20, 0x69, 0x6e, 0x20, 0x61, 0x20, 0x68, 0x61, 0x73,
-  0x68, 0x20, 0x74, 0x61, 0x62, 0x6c, 0x65, 0x20, 0x74, 0x6f, 0x20, 0x61,
-  0x76, 0x6f, 0x69, 0x64, 0x20, 0x64, 0x75, 0x70, 0x6c, 0x69, 0x63, 0x61,
-  0x74, 0x69, 0x6f, 0x6e, 0x0a, 0x20, 0x20, 0x6f, 0x66, 0x20, 0x6c, 0x69,
-  0x73, 0x74, 0x73, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x6f, 0x63, 0x63,
-  0x75, 0x72, 0x20, 0x6d, 0x75, 0x6c, 0x74, 0x69, 0x70, 0x6c, 0x65, 0x20,
-  0x74, 0x69, 0x6d, 0x65, 0x73, 0x20, 0x69, 0x6e, 0x20, 0x61, 0x20, 0x67,
-  0x72, 0x61, 0x70, 0x68, 0x20, 0x6f, 0x76, 0x65, 0x72, 0x20, 0x74, 0x68,
-  0x65, 0x20, 0x63, 0x6f, 0x75, 0x72, 0x73, 0x65, 0x20, 0x6f, 0x66, 0x20,
-  0x61, 0x20, 0x70, 0x72, 0x6f, 0x67, 0x72, 0x61, 0x6d, 0x0a, 0x20, 0x20,
-  0x65, 0x78, 0x65, 0x63, 0x75, 0x74, 0x69, 0x6f, 0x6e, 0x2e, 0x0a, 0x0a,
-  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
-  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
-  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
-  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
-  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
-  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
-  0x2f, 0x2f, 0x2f, 0x20, 0x2a, 0x2f, 0x0a, 0x0a, 0x23, 0x69, 0x66, 0x6e,
-  0x64, 0x65, 0x66, 0x20, 0x49, 0x4e, 0x43, 0x5f, 0x4c, 0x41, 0x42, 0x45,
-  0x4c, 0x5f, 0x48, 0x0a, 0x23, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x20,
-  0x49, 0x4e, 0x43, 0x5f, 0x4c, 0x41, 0x42, 0x45, 0x4c, 0x5f, 0x48, 0x0a,
-  0x0a, 0x23, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x20, 0x4c, 0x49, 0x53,
-  0x54, 0x5f, 0x54, 0x41, 0x42, 0x4c, 0x45, 0x5f, 0x53, 0x49, 0x5a, 0x45,
-  0x20, 0x31, 0x30, 0x30, 0x30, 0x30, 0x33, 0x0a, 0x0a, 0x23, 0x69, 0x6e,
-  0x63, 0x6c, 0x75, 0x64, 0x65, 0x20, 0x22, 0x67, 0x6c, 0x6f, 0x62, 0x61,
-  0x6c, 0x73, 0x2e, 0x68, 0x22, 0x0a, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64,
-  0x65, 0x66, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x48, 0x6f,
-  0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x7b, 0x0a, 0x20, 0x20,
-  0x20, 0x4d, 0x61, 0x72, 0x6b, 0x54, 0x79, 0x70, 0x65, 0x20, 0x6d, 0x61,
-  0x72, 0x6b, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6c,
-  0x65, 0x6e, 0x67, 0x74, 0x68, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x73, 0x74,
-  0x72, 0x75, 0x63, 0x74, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73,
-  0x74, 0x20, 0x2a, 0x6c, 0x69, 0x73, 0x74, 0x3b, 0x0a, 0x7d, 0x20, 0x48,
-  0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x3b, 0x0a, 0x0a, 0x65,
-  0x78, 0x74, 0x65, 0x72, 0x6e, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74,
-  0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x62,
-  0x6c, 0x61, 0x6e, 0x6b, 0x5f, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x3b, 0x0a,
-  0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x73, 0x74, 0x72,
-  0x75, 0x63, 0x74, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74,
-  0x20, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x68, 0x61,
-  0x73, 0x68, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63,
-  0x74, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x49, 0x74,
-  0x65, 0x6d, 0x20, 0x2a, 0x66, 0x69, 0x72, 0x73, 0x74, 0x3b, 0x0a, 0x20,
-  0x20, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x48, 0x6f, 0x73,
-  0x74, 0x4c, 0x69, 0x73, 0x74, 0x49, 0x74, 0x65, 0x6d, 0x20, 0x2a, 0x6c,
-  0x61, 0x73, 0x74, 0x3b, 0x0a, 0x7d, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c,
-  0x69, 0x73, 0x74, 0x3b, 0x0a, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65,
+  0x20, 0x61, 0x73, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x73, 0x20, 0x6f,
+  0x66, 0x20, 0x61, 0x74, 0x6f, 0x6d, 0x73, 0x20, 0x73, 0x74, 0x6f, 0x72,
+  0x65, 0x64, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x74, 0x68, 0x65, 0x69,
+  0x72, 0x20, 0x68, 0x65, 0x61, 0x64, 0x65, 0x72, 0x2c, 0x20, 0x61, 0x6e,
+  0x64, 0x20, 0x61, 0x72, 0x65, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x64,
+  0x20, 0x69, 0x6e, 0x20, 0x61, 0x20, 0x68, 0x61, 0x73, 0x68, 0x20, 0x74,
+  0x61, 0x62, 0x6c, 0x65, 0x20, 0x74, 0x6f, 0x20, 0x61, 0x76, 0x6f, 0x69,
+  0x64, 0x20, 0x64, 0x75, 0x70, 0x6c, 0x69, 0x63, 0x61, 0x74, 0x69, 0x6f,
+  0x6e, 0x0a, 0x20, 0x20, 0x6f, 0x66, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x73,
+  0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x6f, 0x63, 0x63, 0x75, 0x72, 0x20,
+  0x6d, 0x75, 0x6c, 0x74, 0x69, 0x70, 0x6c, 0x65, 0x20, 0x74, 0x69, 0x6d,
+  0x65, 0x73, 0x20, 0x69, 0x6e, 0x20, 0x61, 0x20, 0x67, 0x72, 0x61, 0x70,
+  0x68, 0x20, 0x6f, 0x76, 0x65, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x63,
+  0x6f, 0x75, 0x72, 0x73, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x20, 0x70,
+  0x72, 0x6f, 0x67, 0x72, 0x61, 0x6d, 0x0a, 0x20, 0x20, 0x65, 0x78, 0x65,
+  0x63, 0x75, 0x74, 0x69, 0x6f, 0x6e, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20,
+  0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x73, 0x20, 0x69, 0x6e, 0x20, 0x73,
+  0x74, 0x72, 0x69, 0x6e, 0x67, 0x20, 0x61, 0x74, 0x6f, 0x6d, 0x73, 0x20,
+  0x61, 0x72, 0x65, 0x20, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x6e, 0x65, 0x64,
+  0x2c, 0x20, 0x73, 0x6f, 0x20, 0x65, 0x71, 0x75, 0x61, 0x6c, 0x20, 0x73,
+  0x74, 0x72, 0x69, 0x6e, 0x67, 0x73, 0x20, 0x61, 0x72, 0x65, 0x0a, 0x20,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x61, 0x6d, 0x65, 0x20, 0x70, 0x6f,
+  0x69, 0x6e, 0x74, 0x65, 0x72, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6c,
+  0x69, 0x73, 0x74, 0x73, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x74, 0x68, 0x65,
+  0x69, 0x72, 0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x73, 0x20, 0x61,
+  0x72, 0x65, 0x20, 0x61, 0x6c, 0x6c, 0x6f, 0x63, 0x61, 0x74, 0x65, 0x64,
+  0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x61, 0x6e, 0x20, 0x61, 0x72, 0x65,
+  0x6e, 0x61, 0x20, 0x74, 0x68, 0x61, 0x74, 0x0a, 0x20, 0x20, 0x69, 0x73,
+  0x20, 0x72, 0x65, 0x6c, 0x65, 0x61, 0x73, 0x65, 0x64, 0x20, 0x69, 0x6e,
+  0x20, 0x62, 0x75, 0x6c, 0x6b, 0x20, 0x77, 0x68, 0x65, 0x6e, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20, 0x73, 0x74, 0x6f, 0x72,
+  0x65, 0x20, 0x69, 0x73, 0x20, 0x66, 0x72, 0x65, 0x65, 0x64, 0x2e, 0x0a,
+  0x0a, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x20, 0x2a, 0x2f, 0x0a, 0x0a, 0x23, 0x69, 0x66,
+  0x6e, 0x64, 0x65, 0x66, 0x20, 0x49, 0x4e, 0x43, 0x5f, 0x4c, 0x41, 0x42,
+  0x45, 0x4c, 0x5f, 0x48, 0x0a, 0x23, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65,
+  0x20, 0x49, 0x4e, 0x43, 0x5f, 0x4c, 0x41, 0x42, 0x45, 0x4c, 0x5f, 0x48,
+  0x0a, 0x0a, 0x23, 0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64, 0x65, 0x20, 0x22,
+  0x67, 0x6c, 0x6f, 0x62, 0x61, 0x6c, 0x73, 0x2e, 0x68, 0x22, 0x0a, 0x0a,
+  0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x73, 0x74, 0x72, 0x75,
+  0x63, 0x74, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c,
+  0x20, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x4d, 0x61, 0x72, 0x6b, 0x54, 0x79,
+  0x70, 0x65, 0x20, 0x6d, 0x61, 0x72, 0x6b, 0x3b, 0x0a, 0x20, 0x20, 0x20,
+  0x69, 0x6e, 0x74, 0x20, 0x6c, 0x65, 0x6e, 0x67, 0x74, 0x68, 0x3b, 0x0a,
+  0x20, 0x20, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x48, 0x6f,
+  0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x20, 0x2a, 0x6c, 0x69, 0x73, 0x74,
+  0x3b, 0x0a, 0x7d, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65,
+  0x6c, 0x3b, 0x0a, 0x0a, 0x65, 0x78, 0x74, 0x65, 0x72, 0x6e, 0x20, 0x73,
+  0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61,
+  0x62, 0x65, 0x6c, 0x20, 0x62, 0x6c, 0x61, 0x6e, 0x6b, 0x5f, 0x6c, 0x61,
+  0x62, 0x65, 0x6c, 0x3b, 0x0a, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65,
   0x66, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x48, 0x6f, 0x73,
   0x74, 0x41, 0x74, 0x6f, 0x6d, 0x20, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x63,
   0x68, 0x61, 0x72, 0x20, 0x74, 0x79, 0x70, 0x65, 0x3b, 0x20, 0x2f, 0x2a,
@@ -1480,193 +2970,278 @@ unsigned char label_h[] = {
   0x75, 0x6d, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x74,
   0x72, 0x69, 0x6e, 0x67, 0x20, 0x73, 0x74, 0x72, 0x3b, 0x0a, 0x20, 0x20,
   0x20, 0x7d, 0x3b, 0x0a, 0x7d, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x41, 0x74,
-  0x6f, 0x6d, 0x3b, 0x0a, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66,
-  0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x48, 0x6f, 0x73, 0x74,
-  0x4c, 0x69, 0x73, 0x74, 0x49, 0x74, 0x65, 0x6d, 0x20, 0x7b, 0x0a, 0x20,
-  0x20, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x48, 0x6f, 0x73,
-  0x74, 0x41, 0x74, 0x6f, 0x6d, 0x20, 0x61, 0x74, 0x6f, 0x6d, 0x3b, 0x0a,
-  0x20, 0x20, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x48, 0x6f,
-  0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x49, 0x74, 0x65, 0x6d, 0x20, 0x2a,
-  0x6e, 0x65, 0x78, 0x74, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x73, 0x74, 0x72,
-  0x75, 0x63, 0x74, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74,
-  0x49, 0x74, 0x65, 0x6d, 0x20, 0x2a, 0x70, 0x72, 0x65, 0x76, 0x3b, 0x0a,
-  0x7d, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x49, 0x74,
-  0x65, 0x6d, 0x3b, 0x0a, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64, 0x65, 0x66,
-  0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x42, 0x75, 0x63, 0x6b,
-  0x65, 0x74, 0x20, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x48, 0x6f, 0x73, 0x74,
-  0x4c, 0x69, 0x73, 0x74, 0x20, 0x2a, 0x6c, 0x69, 0x73, 0x74, 0x3b, 0x0a,
-  0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x72, 0x65, 0x66, 0x65, 0x72,
-  0x65, 0x6e, 0x63, 0x65, 0x5f, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x3b, 0x0a,
-  0x20, 0x20, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x42, 0x75,
-  0x63, 0x6b, 0x65, 0x74, 0x20, 0x2a, 0x6e, 0x65, 0x78, 0x74, 0x3b, 0x0a,
-  0x20, 0x20, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74, 0x20, 0x42, 0x75,
-  0x63, 0x6b, 0x65, 0x74, 0x20, 0x2a, 0x70, 0x72, 0x65, 0x76, 0x3b, 0x0a,
-  0x7d, 0x20, 0x42, 0x75, 0x63, 0x6b, 0x65, 0x74, 0x3b, 0x0a, 0x0a, 0x2f,
-  0x2a, 0x20, 0x48, 0x61, 0x73, 0x68, 0x20, 0x74, 0x61, 0x62, 0x6c, 0x65,
-  0x20, 0x74, 0x6f, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x20, 0x6c, 0x69,
-  0x73, 0x74, 0x73, 0x20, 0x61, 0x74, 0x20, 0x72, 0x75, 0x6e, 0x74, 0x69,
-  0x6d, 0x65, 0x2e, 0x20, 0x43, 0x6f, 0x6c, 0x6c, 0x69, 0x73, 0x69, 0x6f,
-  0x6e, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x68, 0x61, 0x6e, 0x64, 0x6c,
-  0x65, 0x64, 0x20, 0x62, 0x79, 0x20, 0x73, 0x65, 0x70, 0x61, 0x72, 0x61,
-  0x74, 0x65, 0x20, 0x63, 0x68, 0x61, 0x69, 0x6e, 0x69, 0x6e, 0x67, 0x0a,
-  0x20, 0x2a, 0x20, 0x69, 0x6d, 0x70, 0x6c, 0x65, 0x6d, 0x65, 0x6e, 0x74,
-  0x65, 0x64, 0x20, 0x62, 0x79, 0x20, 0x73, 0x69, 0x6e, 0x67, 0x6c, 0x79,
-  0x2d, 0x6c, 0x69, 0x6e, 0x6b, 0x65, 0x64, 0x20, 0x6c, 0x69, 0x73, 0x74,
-  0x73, 0x20, 0x28, 0x22, 0x62, 0x75, 0x63, 0x6b, 0x65, 0x74, 0x73, 0x22,
-  0x20, 0x61, 0x73, 0x20, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x64, 0x20,
-  0x61, 0x62, 0x6f, 0x76, 0x65, 0x29, 0x2e, 0x20, 0x4c, 0x69, 0x73, 0x74,
-  0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x61, 0x64, 0x64, 0x65, 0x64, 0x0a,
-  0x20, 0x2a, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x68, 0x6f,
-  0x73, 0x74, 0x20, 0x74, 0x61, 0x62, 0x6c, 0x65, 0x20, 0x62, 0x79, 0x20,
-  0x6d, 0x61, 0x6b, 0x69, 0x6e, 0x67, 0x20, 0x61, 0x6e, 0x20, 0x61, 0x72,
-  0x72, 0x61, 0x79, 0x20, 0x6f, 0x66, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x41,
-  0x74, 0x6f, 0x6d, 0x73, 0x20, 0x72, 0x65, 0x70, 0x72, 0x65, 0x73, 0x65,
-  0x6e, 0x74, 0x69, 0x6e, 0x67, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x69,
-  0x73, 0x74, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x70,
-  0x61, 0x73, 0x73, 0x69, 0x6e, 0x67, 0x20, 0x69, 0x74, 0x20, 0x74, 0x6f,
-  0x20, 0x6d, 0x61, 0x6b, 0x65, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73,
-  0x74, 0x2e, 0x20, 0x49, 0x6e, 0x20, 0x74, 0x68, 0x69, 0x73, 0x20, 0x77,
-  0x61, 0x79, 0x2c, 0x20, 0x65, 0x61, 0x63, 0x68, 0x20, 0x73, 0x70, 0x65,
-  0x63, 0x69, 0x66, 0x69, 0x63, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20, 0x69,
-  0x73, 0x20, 0x61, 0x6c, 0x6c, 0x6f, 0x63, 0x61, 0x74, 0x65, 0x64, 0x20,
-  0x74, 0x6f, 0x20, 0x68, 0x65, 0x61, 0x70, 0x0a, 0x20, 0x2a, 0x20, 0x65,
-  0x78, 0x61, 0x63, 0x74, 0x6c, 0x79, 0x20, 0x6f, 0x6e, 0x63, 0x65, 0x20,
-  0x61, 0x6e, 0x64, 0x20, 0x68, 0x61, 0x73, 0x20, 0x61, 0x20, 0x73, 0x69,
-  0x6e, 0x67, 0x6c, 0x65, 0x20, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x20, 0x6f,
-  0x66, 0x20, 0x72, 0x65, 0x66, 0x65, 0x72, 0x65, 0x6e, 0x63, 0x65, 0x2e,
-  0x20, 0x2a, 0x2f, 0x0a, 0x65, 0x78, 0x74, 0x65, 0x72, 0x6e, 0x20, 0x42,
-  0x75, 0x63, 0x6b, 0x65, 0x74, 0x20, 0x2a, 0x2a, 0x6c, 0x69, 0x73, 0x74,
-  0x5f, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20,
-  0x49, 0x66, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20, 0x68, 0x61, 0x73, 0x68,
-  0x69, 0x6e, 0x67, 0x20, 0x69, 0x73, 0x20, 0x65, 0x6e, 0x61, 0x62, 0x6c,
-  0x65, 0x64, 0x2c, 0x20, 0x6d, 0x61, 0x6b, 0x65, 0x48, 0x6f, 0x73, 0x74,
-  0x4c, 0x69, 0x73, 0x74, 0x20, 0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x73,
-  0x20, 0x61, 0x20, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x20, 0x74,
-  0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69,
-  0x73, 0x74, 0x20, 0x72, 0x65, 0x70, 0x72, 0x65, 0x73, 0x65, 0x6e, 0x74,
-  0x65, 0x64, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x62, 0x79, 0x20, 0x74, 0x68,
-  0x65, 0x20, 0x70, 0x61, 0x73, 0x73, 0x65, 0x64, 0x20, 0x61, 0x72, 0x72,
-  0x61, 0x79, 0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x74, 0x68, 0x65, 0x20,
-  0x68, 0x61, 0x73, 0x68, 0x20, 0x74, 0x61, 0x62, 0x6c, 0x65, 0x20, 0x28,
-  0x6c, 0x69, 0x73, 0x74, 0x5f, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x29, 0x2e,
-  0x20, 0x49, 0x66, 0x20, 0x6e, 0x6f, 0x74, 0x2c, 0x20, 0x74, 0x68, 0x65,
-  0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x72, 0x65,
-  0x74, 0x75, 0x72, 0x6e, 0x73, 0x20, 0x61, 0x0a, 0x20, 0x2a, 0x20, 0x70,
-  0x6f, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x20, 0x74, 0x6f, 0x20, 0x61, 0x20,
-  0x6e, 0x65, 0x77, 0x6c, 0x79, 0x2d, 0x61, 0x6c, 0x6c, 0x6f, 0x63, 0x61,
-  0x74, 0x65, 0x64, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74,
-  0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73,
-  0x74, 0x20, 0x2a, 0x6d, 0x61, 0x6b, 0x65, 0x48, 0x6f, 0x73, 0x74, 0x4c,
-  0x69, 0x73, 0x74, 0x28, 0x48, 0x6f, 0x73, 0x74, 0x41, 0x74, 0x6f, 0x6d,
-  0x20, 0x2a, 0x61, 0x72, 0x72, 0x61, 0x79, 0x2c, 0x20, 0x69, 0x6e, 0x74,
-  0x20, 0x6c, 0x65, 0x6e, 0x67, 0x74, 0x68, 0x2c, 0x20, 0x62, 0x6f, 0x6f,
-  0x6c, 0x20, 0x66, 0x72, 0x65, 0x65, 0x5f, 0x73, 0x74, 0x72, 0x69, 0x6e,
-  0x67, 0x73, 0x29, 0x3b, 0x0a, 0x2f, 0x2a, 0x20, 0x45, 0x78, 0x70, 0x65,
-  0x63, 0x74, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x70, 0x61, 0x73, 0x73,
-  0x65, 0x64, 0x20, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x20, 0x74,
-  0x6f, 0x20, 0x65, 0x78, 0x69, 0x73, 0x74, 0x20, 0x69, 0x6e, 0x20, 0x74,
-  0x68, 0x65, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20, 0x68, 0x61, 0x73, 0x68,
-  0x20, 0x74, 0x61, 0x62, 0x6c, 0x65, 0x2e, 0x20, 0x49, 0x6e, 0x63, 0x72,
-  0x65, 0x6d, 0x65, 0x6e, 0x74, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72,
-  0x65, 0x66, 0x65, 0x72, 0x65, 0x6e, 0x63, 0x65, 0x0a, 0x20, 0x2a, 0x20,
-  0x63, 0x6f, 0x75, 0x6e, 0x74, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65,
-  0x20, 0x6c, 0x69, 0x73, 0x74, 0x27, 0x73, 0x20, 0x62, 0x75, 0x63, 0x6b,
-  0x65, 0x74, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20,
-  0x61, 0x64, 0x64, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x28,
-  0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x20, 0x2a, 0x6c, 0x69,
-  0x73, 0x74, 0x29, 0x3b, 0x0a, 0x2f, 0x2a, 0x20, 0x45, 0x78, 0x70, 0x65,
-  0x63, 0x74, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x70, 0x61, 0x73, 0x73,
-  0x65, 0x64, 0x20, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x20, 0x74,
-  0x6f, 0x20, 0x65, 0x78, 0x69, 0x73, 0x74, 0x20, 0x69, 0x6e, 0x20, 0x74,
-  0x68, 0x65, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20, 0x68, 0x61, 0x73, 0x68,
-  0x20, 0x74, 0x61, 0x62, 0x6c, 0x65, 0x2e, 0x20, 0x44, 0x65, 0x63, 0x72,
-  0x65, 0x6d, 0x65, 0x6e, 0x74, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72,
-  0x65, 0x66, 0x65, 0x72, 0x65, 0x6e, 0x63, 0x65, 0x0a, 0x20, 0x2a, 0x20,
-  0x63, 0x6f, 0x75, 0x6e, 0x74, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65,
-  0x20, 0x6c, 0x69, 0x73, 0x74, 0x27, 0x73, 0x20, 0x62, 0x75, 0x63, 0x6b,
-  0x65, 0x74, 0x2e, 0x20, 0x44, 0x65, 0x6c, 0x65, 0x74, 0x65, 0x73, 0x2f,
-  0x66, 0x72, 0x65, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x69,
-  0x73, 0x74, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x69, 0x74, 0x73, 0x20, 0x63,
-  0x6f, 0x6e, 0x74, 0x61, 0x69, 0x6e, 0x69, 0x6e, 0x67, 0x20, 0x62, 0x75,
-  0x63, 0x6b, 0x65, 0x74, 0x20, 0x69, 0x66, 0x0a, 0x20, 0x2a, 0x20, 0x74,
-  0x68, 0x65, 0x20, 0x6e, 0x65, 0x77, 0x20, 0x72, 0x65, 0x66, 0x65, 0x72,
-  0x65, 0x6e, 0x63, 0x65, 0x20, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x20, 0x69,
-  0x73, 0x20, 0x30, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x76, 0x6f, 0x69, 0x64,
-  0x20, 0x72, 0x65, 0x6d, 0x6f, 0x76, 0x65, 0x48, 0x6f, 0x73, 0x74, 0x4c,
-  0x69, 0x73, 0x74, 0x28, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74,
-  0x20, 0x2a, 0x6c, 0x69, 0x73, 0x74, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a,
-  0x20, 0x43, 0x61, 0x6c, 0x6c, 0x65, 0x64, 0x20, 0x61, 0x74, 0x20, 0x72,
-  0x75, 0x6e, 0x74, 0x69, 0x6d, 0x65, 0x20, 0x74, 0x6f, 0x20, 0x62, 0x75,
-  0x69, 0x6c, 0x64, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x73, 0x2e, 0x20,
-  0x2a, 0x2f, 0x0a, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c,
-  0x20, 0x6d, 0x61, 0x6b, 0x65, 0x45, 0x6d, 0x70, 0x74, 0x79, 0x4c, 0x61,
-  0x62, 0x65, 0x6c, 0x28, 0x4d, 0x61, 0x72, 0x6b, 0x54, 0x79, 0x70, 0x65,
-  0x20, 0x6d, 0x61, 0x72, 0x6b, 0x29, 0x3b, 0x0a, 0x48, 0x6f, 0x73, 0x74,
-  0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x6d, 0x61, 0x6b, 0x65, 0x48, 0x6f,
-  0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x28, 0x4d, 0x61, 0x72, 0x6b,
-  0x54, 0x79, 0x70, 0x65, 0x20, 0x6d, 0x61, 0x72, 0x6b, 0x2c, 0x20, 0x69,
-  0x6e, 0x74, 0x20, 0x6c, 0x65, 0x6e, 0x67, 0x74, 0x68, 0x2c, 0x20, 0x48,
-  0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x20, 0x2a, 0x6c, 0x69, 0x73,
-  0x74, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x55, 0x73, 0x65, 0x64,
-  0x20, 0x74, 0x6f, 0x20, 0x64, 0x65, 0x74, 0x65, 0x72, 0x6d, 0x69, 0x6e,
-  0x65, 0x20, 0x77, 0x68, 0x65, 0x74, 0x68, 0x65, 0x72, 0x20, 0x61, 0x20,
-  0x6e, 0x6f, 0x64, 0x65, 0x20, 0x6f, 0x72, 0x20, 0x65, 0x64, 0x67, 0x65,
-  0x20, 0x6e, 0x65, 0x65, 0x64, 0x73, 0x20, 0x72, 0x65, 0x6c, 0x61, 0x62,
-  0x65, 0x6c, 0x6c, 0x69, 0x6e, 0x67, 0x2c, 0x20, 0x61, 0x6e, 0x64, 0x20,
-  0x74, 0x6f, 0x20, 0x65, 0x76, 0x61, 0x6c, 0x75, 0x61, 0x74, 0x65, 0x0a,
-  0x20, 0x2a, 0x20, 0x74, 0x68, 0x65, 0x20, 0x65, 0x64, 0x67, 0x65, 0x20,
-  0x70, 0x72, 0x65, 0x64, 0x69, 0x63, 0x61, 0x74, 0x65, 0x20, 0x69, 0x66,
-  0x20, 0x61, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x61, 0x72, 0x67,
-  0x75, 0x6d, 0x65, 0x6e, 0x74, 0x20, 0x69, 0x73, 0x20, 0x70, 0x72, 0x6f,
-  0x76, 0x69, 0x64, 0x65, 0x64, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x62, 0x6f,
-  0x6f, 0x6c, 0x20, 0x65, 0x71, 0x75, 0x61, 0x6c, 0x48, 0x6f, 0x73, 0x74,
-  0x4c, 0x61, 0x62, 0x65, 0x6c, 0x73, 0x28, 0x48, 0x6f, 0x73, 0x74, 0x4c,
-  0x61, 0x62, 0x65, 0x6c, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x31, 0x2c,
-  0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x6c,
-  0x61, 0x62, 0x65, 0x6c, 0x32, 0x29, 0x3b, 0x0a, 0x2f, 0x2a, 0x20, 0x55,
-  0x73, 0x65, 0x64, 0x20, 0x74, 0x6f, 0x20, 0x65, 0x76, 0x61, 0x6c, 0x75,
-  0x61, 0x74, 0x65, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20, 0x63, 0x6f, 0x6d,
-  0x70, 0x61, 0x72, 0x69, 0x73, 0x6f, 0x6e, 0x20, 0x70, 0x72, 0x65, 0x64,
-  0x69, 0x63, 0x61, 0x74, 0x65, 0x73, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x62,
-  0x6f, 0x6f, 0x6c, 0x20, 0x65, 0x71, 0x75, 0x61, 0x6c, 0x48, 0x6f, 0x73,
-  0x74, 0x4c, 0x69, 0x73, 0x74, 0x73, 0x28, 0x48, 0x6f, 0x73, 0x74, 0x41,
-  0x74, 0x6f, 0x6d, 0x20, 0x2a, 0x6c, 0x65, 0x66, 0x74, 0x5f, 0x6c, 0x69,
-  0x73, 0x74, 0x2c, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x41, 0x74, 0x6f, 0x6d,
-  0x20, 0x2a, 0x72, 0x69, 0x67, 0x68, 0x74, 0x5f, 0x6c, 0x69, 0x73, 0x74,
-  0x2c, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x69, 0x6e,
-  0x74, 0x20, 0x6c, 0x65, 0x66, 0x74, 0x5f, 0x6c, 0x65, 0x6e, 0x67, 0x74,
-  0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x72, 0x69, 0x67, 0x68, 0x74,
-  0x5f, 0x6c, 0x65, 0x6e, 0x67, 0x74, 0x68, 0x29, 0x3b, 0x0a, 0x2f, 0x2a,
-  0x20, 0x55, 0x73, 0x65, 0x64, 0x20, 0x77, 0x68, 0x65, 0x6e, 0x20, 0x61,
-  0x64, 0x64, 0x69, 0x6e, 0x67, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20, 0x61,
-  0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x73, 0x20, 0x74,
-  0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69,
-  0x73, 0x6d, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x77, 0x68, 0x65, 0x6e, 0x20,
-  0x63, 0x6f, 0x70, 0x79, 0x69, 0x6e, 0x67, 0x20, 0x74, 0x68, 0x65, 0x20,
-  0x68, 0x6f, 0x73, 0x74, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2e, 0x20,
-  0x2a, 0x2f, 0x0a, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x20,
-  0x2a, 0x63, 0x6f, 0x70, 0x79, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73,
-  0x74, 0x28, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x20, 0x2a,
-  0x6c, 0x69, 0x73, 0x74, 0x29, 0x3b, 0x0a, 0x0a, 0x76, 0x6f, 0x69, 0x64,
-  0x20, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61,
-  0x62, 0x65, 0x6c, 0x28, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65,
-  0x6c, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x2c, 0x20, 0x46, 0x49, 0x4c,
-  0x45, 0x20, 0x2a, 0x66, 0x69, 0x6c, 0x65, 0x29, 0x3b, 0x0a, 0x76, 0x6f,
-  0x69, 0x64, 0x20, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x48, 0x6f, 0x73, 0x74,
+  0x6f, 0x6d, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20,
+  0x61, 0x74, 0x6f, 0x6d, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x20, 0x6c,
+  0x69, 0x73, 0x74, 0x20, 0x61, 0x72, 0x65, 0x20, 0x73, 0x74, 0x6f, 0x72,
+  0x65, 0x64, 0x20, 0x63, 0x6f, 0x6e, 0x74, 0x69, 0x67, 0x75, 0x6f, 0x75,
+  0x73, 0x6c, 0x79, 0x20, 0x69, 0x6e, 0x20, 0x61, 0x20, 0x73, 0x69, 0x6e,
+  0x67, 0x6c, 0x65, 0x20, 0x61, 0x6c, 0x6c, 0x6f, 0x63, 0x61, 0x74, 0x69,
+  0x6f, 0x6e, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x0a, 0x20, 0x2a, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20, 0x68, 0x65, 0x61,
+  0x64, 0x65, 0x72, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x66, 0x69, 0x72,
+  0x73, 0x74, 0x20, 0x61, 0x74, 0x6f, 0x6d, 0x20, 0x69, 0x73, 0x20, 0x61,
+  0x74, 0x6f, 0x6d, 0x73, 0x5b, 0x30, 0x5d, 0x20, 0x61, 0x6e, 0x64, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x6c, 0x61, 0x73, 0x74, 0x20, 0x69, 0x73, 0x20,
+  0x61, 0x74, 0x6f, 0x6d, 0x73, 0x5b, 0x6c, 0x65, 0x6e, 0x67, 0x74, 0x68,
+  0x20, 0x2d, 0x20, 0x31, 0x5d, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x74, 0x79,
+  0x70, 0x65, 0x64, 0x65, 0x66, 0x20, 0x73, 0x74, 0x72, 0x75, 0x63, 0x74,
+  0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x20, 0x7b, 0x0a,
+  0x20, 0x20, 0x20, 0x2f, 0x2a, 0x20, 0x48, 0x61, 0x73, 0x68, 0x20, 0x6f,
+  0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x66, 0x75, 0x6c, 0x6c, 0x20, 0x63,
+  0x6f, 0x6e, 0x74, 0x65, 0x6e, 0x74, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x2c, 0x20, 0x63, 0x6f, 0x6d,
+  0x70, 0x75, 0x74, 0x65, 0x64, 0x20, 0x6f, 0x6e, 0x63, 0x65, 0x20, 0x77,
+  0x68, 0x65, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x69, 0x73, 0x74,
+  0x20, 0x69, 0x73, 0x20, 0x6d, 0x61, 0x64, 0x65, 0x2e, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x2a, 0x20, 0x49, 0x74, 0x20, 0x64, 0x6f, 0x65, 0x73, 0x20,
+  0x6e, 0x6f, 0x74, 0x20, 0x64, 0x65, 0x70, 0x65, 0x6e, 0x64, 0x20, 0x6f,
+  0x6e, 0x20, 0x77, 0x68, 0x65, 0x72, 0x65, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20,
+  0x73, 0x74, 0x6f, 0x72, 0x65, 0x64, 0x2c, 0x20, 0x73, 0x6f, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x67, 0x65, 0x6e, 0x65, 0x72, 0x61, 0x74, 0x65, 0x64,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68,
+  0x69, 0x6e, 0x67, 0x20, 0x63, 0x6f, 0x64, 0x65, 0x20, 0x63, 0x6f, 0x6d,
+  0x70, 0x61, 0x72, 0x65, 0x73, 0x20, 0x69, 0x74, 0x20, 0x77, 0x69, 0x74,
+  0x68, 0x20, 0x74, 0x68, 0x65, 0x20, 0x70, 0x72, 0x65, 0x63, 0x6f, 0x6d,
+  0x70, 0x75, 0x74, 0x65, 0x64, 0x20, 0x68, 0x61, 0x73, 0x68, 0x65, 0x73,
+  0x20, 0x6f, 0x66, 0x20, 0x63, 0x6f, 0x6e, 0x73, 0x74, 0x61, 0x6e, 0x74,
+  0x20, 0x72, 0x75, 0x6c, 0x65, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x2a, 0x20,
+  0x6c, 0x69, 0x73, 0x74, 0x73, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x20, 0x20,
+  0x20, 0x75, 0x6e, 0x73, 0x69, 0x67, 0x6e, 0x65, 0x64, 0x20, 0x68, 0x61,
+  0x73, 0x68, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x72,
+  0x65, 0x66, 0x65, 0x72, 0x65, 0x6e, 0x63, 0x65, 0x5f, 0x63, 0x6f, 0x75,
+  0x6e, 0x74, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6c,
+  0x65, 0x6e, 0x67, 0x74, 0x68, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x48, 0x6f,
+  0x73, 0x74, 0x41, 0x74, 0x6f, 0x6d, 0x20, 0x61, 0x74, 0x6f, 0x6d, 0x73,
+  0x5b, 0x5d, 0x3b, 0x0a, 0x7d, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69,
+  0x73, 0x74, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x48, 0x61, 0x73, 0x68,
+  0x20, 0x74, 0x61, 0x62, 0x6c, 0x65, 0x20, 0x74, 0x6f, 0x20, 0x73, 0x74,
+  0x6f, 0x72, 0x65, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x73, 0x20, 0x61, 0x74,
+  0x20, 0x72, 0x75, 0x6e, 0x74, 0x69, 0x6d, 0x65, 0x2e, 0x20, 0x43, 0x6f,
+  0x6c, 0x6c, 0x69, 0x73, 0x69, 0x6f, 0x6e, 0x73, 0x20, 0x61, 0x72, 0x65,
+  0x20, 0x68, 0x61, 0x6e, 0x64, 0x6c, 0x65, 0x64, 0x20, 0x62, 0x79, 0x20,
+  0x6f, 0x70, 0x65, 0x6e, 0x20, 0x61, 0x64, 0x64, 0x72, 0x65, 0x73, 0x73,
+  0x69, 0x6e, 0x67, 0x0a, 0x20, 0x2a, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20,
+  0x6c, 0x69, 0x6e, 0x65, 0x61, 0x72, 0x20, 0x70, 0x72, 0x6f, 0x62, 0x69,
+  0x6e, 0x67, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x74, 0x61, 0x62, 0x6c,
+  0x65, 0x20, 0x73, 0x69, 0x7a, 0x65, 0x20, 0x69, 0x73, 0x20, 0x61, 0x20,
+  0x70, 0x6f, 0x77, 0x65, 0x72, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x77, 0x6f,
+  0x2e, 0x20, 0x57, 0x68, 0x65, 0x6e, 0x20, 0x74, 0x68, 0x72, 0x65, 0x65,
+  0x20, 0x71, 0x75, 0x61, 0x72, 0x74, 0x65, 0x72, 0x73, 0x20, 0x6f, 0x66,
+  0x0a, 0x20, 0x2a, 0x20, 0x69, 0x74, 0x73, 0x20, 0x73, 0x6c, 0x6f, 0x74,
+  0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x69, 0x6e, 0x20, 0x75, 0x73, 0x65,
+  0x2c, 0x20, 0x62, 0x79, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x73, 0x20, 0x6f,
+  0x72, 0x20, 0x62, 0x79, 0x20, 0x64, 0x65, 0x6c, 0x65, 0x74, 0x65, 0x64,
+  0x20, 0x73, 0x6c, 0x6f, 0x74, 0x73, 0x2c, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x74, 0x61, 0x62, 0x6c, 0x65, 0x20, 0x69, 0x73, 0x20, 0x72, 0x65, 0x62,
+  0x75, 0x69, 0x6c, 0x74, 0x20, 0x77, 0x69, 0x74, 0x68, 0x6f, 0x75, 0x74,
+  0x0a, 0x20, 0x2a, 0x20, 0x74, 0x68, 0x65, 0x20, 0x64, 0x65, 0x6c, 0x65,
+  0x74, 0x65, 0x64, 0x20, 0x73, 0x6c, 0x6f, 0x74, 0x73, 0x2c, 0x20, 0x61,
+  0x6e, 0x64, 0x20, 0x64, 0x6f, 0x75, 0x62, 0x6c, 0x65, 0x64, 0x20, 0x69,
+  0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x73, 0x20,
+  0x61, 0x6c, 0x6f, 0x6e, 0x65, 0x20, 0x66, 0x69, 0x6c, 0x6c, 0x20, 0x61,
+  0x74, 0x20, 0x6c, 0x65, 0x61, 0x73, 0x74, 0x20, 0x68, 0x61, 0x6c, 0x66,
+  0x20, 0x6f, 0x66, 0x20, 0x69, 0x74, 0x2e, 0x0a, 0x20, 0x2a, 0x20, 0x4c,
+  0x69, 0x73, 0x74, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x61, 0x64, 0x64,
+  0x65, 0x64, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x74, 0x61,
+  0x62, 0x6c, 0x65, 0x20, 0x62, 0x79, 0x20, 0x6d, 0x61, 0x6b, 0x69, 0x6e,
+  0x67, 0x20, 0x61, 0x6e, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x20, 0x6f,
+  0x66, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x41, 0x74, 0x6f, 0x6d, 0x73, 0x20,
+  0x72, 0x65, 0x70, 0x72, 0x65, 0x73, 0x65, 0x6e, 0x74, 0x69, 0x6e, 0x67,
+  0x20, 0x74, 0x68, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x6c, 0x69, 0x73, 0x74,
+  0x20, 0x61, 0x6e, 0x64, 0x20, 0x70, 0x61, 0x73, 0x73, 0x69, 0x6e, 0x67,
+  0x20, 0x69, 0x74, 0x20, 0x74, 0x6f, 0x20, 0x6d, 0x61, 0x6b, 0x65, 0x48,
+  0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x2e, 0x20, 0x49, 0x6e, 0x20,
+  0x74, 0x68, 0x69, 0x73, 0x20, 0x77, 0x61, 0x79, 0x2c, 0x20, 0x65, 0x61,
+  0x63, 0x68, 0x20, 0x73, 0x70, 0x65, 0x63, 0x69, 0x66, 0x69, 0x63, 0x20,
+  0x6c, 0x69, 0x73, 0x74, 0x20, 0x69, 0x73, 0x20, 0x0a, 0x20, 0x2a, 0x20,
+  0x61, 0x6c, 0x6c, 0x6f, 0x63, 0x61, 0x74, 0x65, 0x64, 0x20, 0x74, 0x6f,
+  0x20, 0x68, 0x65, 0x61, 0x70, 0x20, 0x65, 0x78, 0x61, 0x63, 0x74, 0x6c,
+  0x79, 0x20, 0x6f, 0x6e, 0x63, 0x65, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x68,
+  0x61, 0x73, 0x20, 0x61, 0x20, 0x73, 0x69, 0x6e, 0x67, 0x6c, 0x65, 0x20,
+  0x70, 0x6f, 0x69, 0x6e, 0x74, 0x20, 0x6f, 0x66, 0x20, 0x72, 0x65, 0x66,
+  0x65, 0x72, 0x65, 0x6e, 0x63, 0x65, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x65,
+  0x78, 0x74, 0x65, 0x72, 0x6e, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69,
+  0x73, 0x74, 0x20, 0x2a, 0x2a, 0x6c, 0x69, 0x73, 0x74, 0x5f, 0x73, 0x74,
+  0x6f, 0x72, 0x65, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x52, 0x65, 0x74,
+  0x75, 0x72, 0x6e, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x6e, 0x74,
+  0x65, 0x72, 0x6e, 0x65, 0x64, 0x20, 0x63, 0x6f, 0x70, 0x79, 0x20, 0x6f,
+  0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x70, 0x61, 0x73, 0x73, 0x65, 0x64,
+  0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x2c, 0x20, 0x61, 0x64, 0x64,
+  0x69, 0x6e, 0x67, 0x20, 0x69, 0x74, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x20, 0x74, 0x61, 0x62,
+  0x6c, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x69, 0x66, 0x20, 0x6e, 0x65, 0x63,
+  0x65, 0x73, 0x73, 0x61, 0x72, 0x79, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20,
+  0x63, 0x61, 0x6c, 0x6c, 0x65, 0x72, 0x20, 0x6f, 0x77, 0x6e, 0x73, 0x20,
+  0x6f, 0x6e, 0x65, 0x20, 0x72, 0x65, 0x66, 0x65, 0x72, 0x65, 0x6e, 0x63,
+  0x65, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x65, 0x74,
+  0x75, 0x72, 0x6e, 0x65, 0x64, 0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67,
+  0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x20,
+  0x69, 0x6e, 0x74, 0x65, 0x72, 0x6e, 0x53, 0x74, 0x72, 0x69, 0x6e, 0x67,
+  0x28, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x20, 0x73, 0x74, 0x72, 0x29,
+  0x3b, 0x0a, 0x2f, 0x2a, 0x20, 0x41, 0x64, 0x64, 0x20, 0x61, 0x6e, 0x64,
+  0x20, 0x64, 0x72, 0x6f, 0x70, 0x20, 0x61, 0x20, 0x72, 0x65, 0x66, 0x65,
+  0x72, 0x65, 0x6e, 0x63, 0x65, 0x20, 0x74, 0x6f, 0x20, 0x61, 0x6e, 0x20,
+  0x69, 0x6e, 0x74, 0x65, 0x72, 0x6e, 0x65, 0x64, 0x20, 0x73, 0x74, 0x72,
+  0x69, 0x6e, 0x67, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x73, 0x74, 0x72,
+  0x69, 0x6e, 0x67, 0x20, 0x69, 0x73, 0x20, 0x66, 0x72, 0x65, 0x65, 0x64,
+  0x20, 0x77, 0x68, 0x65, 0x6e, 0x20, 0x69, 0x74, 0x73, 0x0a, 0x20, 0x2a,
+  0x20, 0x6c, 0x61, 0x73, 0x74, 0x20, 0x72, 0x65, 0x66, 0x65, 0x72, 0x65,
+  0x6e, 0x63, 0x65, 0x20, 0x69, 0x73, 0x20, 0x64, 0x72, 0x6f, 0x70, 0x70,
+  0x65, 0x64, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20,
+  0x72, 0x65, 0x74, 0x61, 0x69, 0x6e, 0x53, 0x74, 0x72, 0x69, 0x6e, 0x67,
+  0x28, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x20, 0x73, 0x74, 0x72, 0x29,
+  0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x72, 0x65, 0x6c, 0x65, 0x61,
+  0x73, 0x65, 0x53, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x28, 0x73, 0x74, 0x72,
+  0x69, 0x6e, 0x67, 0x20, 0x73, 0x74, 0x72, 0x29, 0x3b, 0x0a, 0x0a, 0x2f,
+  0x2a, 0x20, 0x49, 0x66, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20, 0x68, 0x61,
+  0x73, 0x68, 0x69, 0x6e, 0x67, 0x20, 0x69, 0x73, 0x20, 0x65, 0x6e, 0x61,
+  0x62, 0x6c, 0x65, 0x64, 0x2c, 0x20, 0x6d, 0x61, 0x6b, 0x65, 0x48, 0x6f,
+  0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x20, 0x72, 0x65, 0x74, 0x75, 0x72,
+  0x6e, 0x73, 0x20, 0x61, 0x20, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x65, 0x72,
+  0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x48, 0x6f, 0x73, 0x74,
+  0x4c, 0x69, 0x73, 0x74, 0x20, 0x72, 0x65, 0x70, 0x72, 0x65, 0x73, 0x65,
+  0x6e, 0x74, 0x65, 0x64, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x62, 0x79, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x70, 0x61, 0x73, 0x73, 0x65, 0x64, 0x20, 0x61,
+  0x72, 0x72, 0x61, 0x79, 0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x68, 0x61, 0x73, 0x68, 0x20, 0x74, 0x61, 0x62, 0x6c, 0x65,
+  0x20, 0x28, 0x6c, 0x69, 0x73, 0x74, 0x5f, 0x73, 0x74, 0x6f, 0x72, 0x65,
+  0x29, 0x2e, 0x20, 0x49, 0x66, 0x20, 0x6e, 0x6f, 0x74, 0x2c, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20,
+  0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x73, 0x20, 0x61, 0x0a, 0x20, 0x2a,
+  0x20, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x20, 0x74, 0x6f, 0x20,
+  0x61, 0x20, 0x6e, 0x65, 0x77, 0x6c, 0x79, 0x2d, 0x61, 0x6c, 0x6c, 0x6f,
+  0x63, 0x61, 0x74, 0x65, 0x64, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69,
+  0x73, 0x74, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x48, 0x6f, 0x73, 0x74, 0x4c,
+  0x69, 0x73, 0x74, 0x20, 0x2a, 0x6d, 0x61, 0x6b, 0x65, 0x48, 0x6f, 0x73,
+  0x74, 0x4c, 0x69, 0x73, 0x74, 0x28, 0x48, 0x6f, 0x73, 0x74, 0x41, 0x74,
+  0x6f, 0x6d, 0x20, 0x2a, 0x61, 0x72, 0x72, 0x61, 0x79, 0x2c, 0x20, 0x69,
+  0x6e, 0x74, 0x20, 0x6c, 0x65, 0x6e, 0x67, 0x74, 0x68, 0x2c, 0x20, 0x62,
+  0x6f, 0x6f, 0x6c, 0x20, 0x66, 0x72, 0x65, 0x65, 0x5f, 0x73, 0x74, 0x72,
+  0x69, 0x6e, 0x67, 0x73, 0x29, 0x3b, 0x0a, 0x2f, 0x2a, 0x20, 0x45, 0x78,
+  0x70, 0x65, 0x63, 0x74, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x70, 0x61,
+  0x73, 0x73, 0x65, 0x64, 0x20, 0x70, 0x6f, 0x69, 0x6e, 0x74, 0x65, 0x72,
+  0x20, 0x74, 0x6f, 0x20, 0x65, 0x78, 0x69, 0x73, 0x74, 0x20, 0x69, 0x6e,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20, 0x68, 0x61,
+  0x73, 0x68, 0x20, 0x74, 0x61, 0x62, 0x6c, 0x65, 0x2e, 0x20, 0x49, 0x6e,
+  0x63, 0x72, 0x65, 0x6d, 0x65, 0x6e, 0x74, 0x73, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x72, 0x65, 0x66, 0x65, 0x72, 0x65, 0x6e, 0x63, 0x65, 0x0a, 0x20,
+  0x2a, 0x20, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x20, 0x6f, 0x66, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x2e, 0x20, 0x2a, 0x2f, 0x0a,
+  0x76, 0x6f, 0x69, 0x64, 0x20, 0x61, 0x64, 0x64, 0x48, 0x6f, 0x73, 0x74,
   0x4c, 0x69, 0x73, 0x74, 0x28, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73,
-  0x74, 0x49, 0x74, 0x65, 0x6d, 0x20, 0x2a, 0x69, 0x74, 0x65, 0x6d, 0x2c,
-  0x20, 0x46, 0x49, 0x4c, 0x45, 0x20, 0x2a, 0x66, 0x69, 0x6c, 0x65, 0x29,
-  0x3b, 0x0a, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x66, 0x72, 0x65, 0x65,
+  0x74, 0x20, 0x2a, 0x6c, 0x69, 0x73, 0x74, 0x29, 0x3b, 0x0a, 0x2f, 0x2a,
+  0x20, 0x45, 0x78, 0x70, 0x65, 0x63, 0x74, 0x73, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x70, 0x61, 0x73, 0x73, 0x65, 0x64, 0x20, 0x70, 0x6f, 0x69, 0x6e,
+  0x74, 0x65, 0x72, 0x20, 0x74, 0x6f, 0x20, 0x65, 0x78, 0x69, 0x73, 0x74,
+  0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x69, 0x73, 0x74,
+  0x20, 0x68, 0x61, 0x73, 0x68, 0x20, 0x74, 0x61, 0x62, 0x6c, 0x65, 0x2e,
+  0x20, 0x44, 0x65, 0x63, 0x72, 0x65, 0x6d, 0x65, 0x6e, 0x74, 0x73, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x72, 0x65, 0x66, 0x65, 0x72, 0x65, 0x6e, 0x63,
+  0x65, 0x0a, 0x20, 0x2a, 0x20, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x20, 0x6f,
+  0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x2e, 0x20,
+  0x52, 0x65, 0x6d, 0x6f, 0x76, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x6c, 0x69, 0x73, 0x74, 0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x74, 0x61, 0x62, 0x6c, 0x65, 0x20, 0x61, 0x6e, 0x64, 0x20,
+  0x66, 0x72, 0x65, 0x65, 0x73, 0x20, 0x69, 0x74, 0x20, 0x69, 0x66, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x6e, 0x65, 0x77, 0x20, 0x0a, 0x20, 0x2a, 0x20,
+  0x72, 0x65, 0x66, 0x65, 0x72, 0x65, 0x6e, 0x63, 0x65, 0x20, 0x63, 0x6f,
+  0x75, 0x6e, 0x74, 0x20, 0x69, 0x73, 0x20, 0x30, 0x2e, 0x20, 0x2a, 0x2f,
+  0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x72, 0x65, 0x6d, 0x6f, 0x76, 0x65,
   0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x28, 0x48, 0x6f, 0x73,
   0x74, 0x4c, 0x69, 0x73, 0x74, 0x20, 0x2a, 0x6c, 0x69, 0x73, 0x74, 0x29,
-  0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x66, 0x72, 0x65, 0x65, 0x48,
-  0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x53, 0x74, 0x6f, 0x72, 0x65,
-  0x28, 0x76, 0x6f, 0x69, 0x64, 0x29, 0x3b, 0x0a, 0x0a, 0x23, 0x65, 0x6e,
-  0x64, 0x69, 0x66, 0x20, 0x2f, 0x2a, 0x20, 0x49, 0x4e, 0x43, 0x5f, 0x4c,
-  0x41, 0x42, 0x45, 0x4c, 0x5f, 0x48, 0x20, 0x2a, 0x2f, 0x0a, 0x00
+  0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x43, 0x61, 0x6c, 0x6c, 0x65, 0x64,
+  0x20, 0x61, 0x74, 0x20, 0x72, 0x75, 0x6e, 0x74, 0x69, 0x6d, 0x65, 0x20,
+  0x74, 0x6f, 0x20, 0x62, 0x75, 0x69, 0x6c, 0x64, 0x20, 0x6c, 0x61, 0x62,
+  0x65, 0x6c, 0x73, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x48, 0x6f, 0x73, 0x74,
+  0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x6d, 0x61, 0x6b, 0x65, 0x45, 0x6d,
+  0x70, 0x74, 0x79, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x28, 0x4d, 0x61, 0x72,
+  0x6b, 0x54, 0x79, 0x70, 0x65, 0x20, 0x6d, 0x61, 0x72, 0x6b, 0x29, 0x3b,
+  0x0a, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x6d,
+  0x61, 0x6b, 0x65, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c,
+  0x28, 0x4d, 0x61, 0x72, 0x6b, 0x54, 0x79, 0x70, 0x65, 0x20, 0x6d, 0x61,
+  0x72, 0x6b, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6c, 0x65, 0x6e, 0x67,
+  0x74, 0x68, 0x2c, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74,
+  0x20, 0x2a, 0x6c, 0x69, 0x73, 0x74, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a,
+  0x20, 0x55, 0x73, 0x65, 0x64, 0x20, 0x74, 0x6f, 0x20, 0x64, 0x65, 0x74,
+  0x65, 0x72, 0x6d, 0x69, 0x6e, 0x65, 0x20, 0x77, 0x68, 0x65, 0x74, 0x68,
+  0x65, 0x72, 0x20, 0x61, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x6f, 0x72,
+  0x20, 0x65, 0x64, 0x67, 0x65, 0x20, 0x6e, 0x65, 0x65, 0x64, 0x73, 0x20,
+  0x72, 0x65, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x6c, 0x69, 0x6e, 0x67, 0x2c,
+  0x20, 0x61, 0x6e, 0x64, 0x20, 0x74, 0x6f, 0x20, 0x65, 0x76, 0x61, 0x6c,
+  0x75, 0x61, 0x74, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x65, 0x64, 0x67, 0x65, 0x20, 0x70, 0x72, 0x65, 0x64, 0x69, 0x63, 0x61,
+  0x74, 0x65, 0x20, 0x69, 0x66, 0x20, 0x61, 0x20, 0x6c, 0x61, 0x62, 0x65,
+  0x6c, 0x20, 0x61, 0x72, 0x67, 0x75, 0x6d, 0x65, 0x6e, 0x74, 0x20, 0x69,
+  0x73, 0x20, 0x70, 0x72, 0x6f, 0x76, 0x69, 0x64, 0x65, 0x64, 0x2e, 0x20,
+  0x2a, 0x2f, 0x0a, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x65, 0x71, 0x75, 0x61,
+  0x6c, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x73, 0x28,
+  0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x6c, 0x61,
+  0x62, 0x65, 0x6c, 0x31, 0x2c, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x61,
+  0x62, 0x65, 0x6c, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x32, 0x29, 0x3b,
+  0x0a, 0x2f, 0x2a, 0x20, 0x55, 0x73, 0x65, 0x64, 0x20, 0x74, 0x6f, 0x20,
+  0x65, 0x76, 0x61, 0x6c, 0x75, 0x61, 0x74, 0x65, 0x20, 0x6c, 0x69, 0x73,
+  0x74, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x61, 0x72, 0x69, 0x73, 0x6f, 0x6e,
+  0x20, 0x70, 0x72, 0x65, 0x64, 0x69, 0x63, 0x61, 0x74, 0x65, 0x73, 0x2e,
+  0x20, 0x2a, 0x2f, 0x0a, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x65, 0x71, 0x75,
+  0x61, 0x6c, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x73, 0x28,
+  0x48, 0x6f, 0x73, 0x74, 0x41, 0x74, 0x6f, 0x6d, 0x20, 0x2a, 0x6c, 0x65,
+  0x66, 0x74, 0x5f, 0x6c, 0x69, 0x73, 0x74, 0x2c, 0x20, 0x48, 0x6f, 0x73,
+  0x74, 0x41, 0x74, 0x6f, 0x6d, 0x20, 0x2a, 0x72, 0x69, 0x67, 0x68, 0x74,
+  0x5f, 0x6c, 0x69, 0x73, 0x74, 0x2c, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6c, 0x65, 0x66, 0x74, 0x5f,
+  0x6c, 0x65, 0x6e, 0x67, 0x74, 0x68, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20,
+  0x72, 0x69, 0x67, 0x68, 0x74, 0x5f, 0x6c, 0x65, 0x6e, 0x67, 0x74, 0x68,
+  0x29, 0x3b, 0x0a, 0x2f, 0x2a, 0x20, 0x55, 0x73, 0x65, 0x64, 0x20, 0x77,
+  0x68, 0x65, 0x6e, 0x20, 0x61, 0x64, 0x64, 0x69, 0x6e, 0x67, 0x20, 0x6c,
+  0x69, 0x73, 0x74, 0x20, 0x61, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65,
+  0x6e, 0x74, 0x73, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6d,
+  0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x61, 0x6e, 0x64, 0x20,
+  0x77, 0x68, 0x65, 0x6e, 0x20, 0x63, 0x6f, 0x70, 0x79, 0x69, 0x6e, 0x67,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x20, 0x67, 0x72,
+  0x61, 0x70, 0x68, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x48, 0x6f, 0x73, 0x74,
+  0x4c, 0x69, 0x73, 0x74, 0x20, 0x2a, 0x63, 0x6f, 0x70, 0x79, 0x48, 0x6f,
+  0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x28, 0x48, 0x6f, 0x73, 0x74, 0x4c,
+  0x69, 0x73, 0x74, 0x20, 0x2a, 0x6c, 0x69, 0x73, 0x74, 0x29, 0x3b, 0x0a,
+  0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x48,
+  0x6f, 0x73, 0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x28, 0x48, 0x6f, 0x73,
+  0x74, 0x4c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c,
+  0x2c, 0x20, 0x46, 0x49, 0x4c, 0x45, 0x20, 0x2a, 0x66, 0x69, 0x6c, 0x65,
+  0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x70, 0x72, 0x69, 0x6e,
+  0x74, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x28, 0x48, 0x6f,
+  0x73, 0x74, 0x41, 0x74, 0x6f, 0x6d, 0x20, 0x2a, 0x61, 0x74, 0x6f, 0x6d,
+  0x73, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6c, 0x65, 0x6e, 0x67, 0x74,
+  0x68, 0x2c, 0x20, 0x46, 0x49, 0x4c, 0x45, 0x20, 0x2a, 0x66, 0x69, 0x6c,
+  0x65, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x52, 0x65, 0x74, 0x75,
+  0x72, 0x6e, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x74, 0x65, 0x6d,
+  0x73, 0x2c, 0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x73, 0x20, 0x61,
+  0x6e, 0x64, 0x20, 0x68, 0x65, 0x61, 0x64, 0x65, 0x72, 0x20, 0x6f, 0x66,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20, 0x74, 0x6f,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x20, 0x61,
+  0x72, 0x65, 0x6e, 0x61, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x76, 0x6f, 0x69,
+  0x64, 0x20, 0x66, 0x72, 0x65, 0x65, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69,
+  0x73, 0x74, 0x28, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x20,
+  0x2a, 0x6c, 0x69, 0x73, 0x74, 0x29, 0x3b, 0x0a, 0x2f, 0x2a, 0x20, 0x46,
+  0x72, 0x65, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x69, 0x73,
+  0x74, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x20, 0x61, 0x6e, 0x64, 0x20,
+  0x72, 0x65, 0x6c, 0x65, 0x61, 0x73, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x77, 0x68, 0x6f, 0x6c, 0x65, 0x20, 0x6c, 0x61, 0x62, 0x65, 0x6c,
+  0x20, 0x61, 0x72, 0x65, 0x6e, 0x61, 0x2c, 0x20, 0x69, 0x6e, 0x63, 0x6c,
+  0x75, 0x64, 0x69, 0x6e, 0x67, 0x20, 0x61, 0x6e, 0x79, 0x20, 0x6c, 0x69,
+  0x73, 0x74, 0x73, 0x0a, 0x20, 0x2a, 0x20, 0x73, 0x74, 0x69, 0x6c, 0x6c,
+  0x20, 0x72, 0x65, 0x66, 0x65, 0x72, 0x65, 0x6e, 0x63, 0x65, 0x64, 0x2e,
+  0x20, 0x43, 0x61, 0x6c, 0x6c, 0x65, 0x64, 0x20, 0x6f, 0x6e, 0x63, 0x65,
+  0x20, 0x61, 0x74, 0x20, 0x74, 0x68, 0x65, 0x20, 0x65, 0x6e, 0x64, 0x20,
+  0x6f, 0x66, 0x20, 0x61, 0x20, 0x70, 0x72, 0x6f, 0x67, 0x72, 0x61, 0x6d,
+  0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x66, 0x72,
+  0x65, 0x65, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x53, 0x74,
+  0x6f, 0x72, 0x65, 0x28, 0x76, 0x6f, 0x69, 0x64, 0x29, 0x3b, 0x0a, 0x0a,
+  0x23, 0x65, 0x6e, 0x64, 0x69, 0x66, 0x20, 0x2f, 0x2a, 0x20, 0x49, 0x4e,
+  0x43, 0x5f, 0x4c, 0x41, 0x42, 0x45, 0x4c, 0x5f, 0x48, 0x20, 0x2a, 0x2f,
+  0x0a, 0x00
 };
-unsigned int label_h_len = 3142;
+unsigned int label_h_len = 4225;
 
 unsigned char morphism_h[] = {
   0x2f, 0x2a, 0x20, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
@@ -1806,263 +3381,649 @@ unsigned char morphism_h[] = {
   0x62, 0x6c, 0x65, 0x73, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x69, 0x6e, 0x74,
   0x20, 0x76, 0x61, 0x72, 0x69, 0x61, 0x62, 0x6c, 0x65, 0x5f, 0x69, 0x6e,
   0x64, 0x65, 0x78, 0x3b, 0x0a, 0x7d, 0x20, 0x4d, 0x6f, 0x72, 0x70, 0x68,
-  0x69, 0x73, 0x6d, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x41, 0x6c, 0x6c,
-  0x6f, 0x63, 0x61, 0x74, 0x65, 0x73, 0x20, 0x6d, 0x65, 0x6d, 0x6f, 0x72,
-  0x79, 0x20, 0x66, 0x6f, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6d, 0x6f,
-  0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c, 0x20, 0x61, 0x6e, 0x64, 0x20,
-  0x63, 0x61, 0x6c, 0x6c, 0x73, 0x20, 0x69, 0x6e, 0x69, 0x74, 0x69, 0x61,
-  0x6c, 0x69, 0x73, 0x65, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d,
-  0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73,
-  0x6d, 0x20, 0x2a, 0x6d, 0x61, 0x6b, 0x65, 0x4d, 0x6f, 0x72, 0x70, 0x68,
-  0x69, 0x73, 0x6d, 0x28, 0x69, 0x6e, 0x74, 0x20, 0x6e, 0x6f, 0x64, 0x65,
-  0x73, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x65, 0x64, 0x67, 0x65, 0x73,
-  0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x76, 0x61, 0x72, 0x69, 0x61, 0x62,
-  0x6c, 0x65, 0x73, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x54, 0x68,
-  0x69, 0x73, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20,
-  0x69, 0x73, 0x20, 0x75, 0x73, 0x65, 0x64, 0x20, 0x74, 0x6f, 0x20, 0x62,
-  0x6f, 0x74, 0x68, 0x20, 0x69, 0x6e, 0x69, 0x74, 0x69, 0x61, 0x6c, 0x69,
-  0x73, 0x65, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6d, 0x6f, 0x72, 0x70, 0x68,
-  0x69, 0x73, 0x6d, 0x20, 0x6f, 0x6e, 0x20, 0x63, 0x72, 0x65, 0x61, 0x74,
-  0x69, 0x6f, 0x6e, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x74, 0x6f, 0x20, 0x0a,
-  0x20, 0x2a, 0x20, 0x72, 0x65, 0x73, 0x65, 0x74, 0x20, 0x74, 0x68, 0x65,
-  0x20, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x61, 0x66,
-  0x74, 0x65, 0x72, 0x20, 0x65, 0x61, 0x63, 0x68, 0x20, 0x72, 0x75, 0x6c,
-  0x65, 0x20, 0x61, 0x70, 0x70, 0x6c, 0x69, 0x63, 0x61, 0x74, 0x69, 0x6f,
-  0x6e, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x64, 0x61, 0x74, 0x61, 0x20,
-  0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6d, 0x6f, 0x72, 0x70, 0x68,
-  0x69, 0x73, 0x6d, 0x0a, 0x20, 0x2a, 0x20, 0x61, 0x72, 0x65, 0x20, 0x72,
-  0x65, 0x73, 0x65, 0x74, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x69,
-  0x72, 0x20, 0x64, 0x65, 0x66, 0x61, 0x75, 0x6c, 0x74, 0x20, 0x76, 0x61,
-  0x6c, 0x75, 0x65, 0x73, 0x2e, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x54, 0x68,
-  0x65, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68,
-  0x20, 0x69, 0x73, 0x20, 0x70, 0x61, 0x73, 0x73, 0x65, 0x64, 0x20, 0x61,
-  0x73, 0x20, 0x61, 0x6e, 0x20, 0x6f, 0x70, 0x74, 0x69, 0x6f, 0x6e, 0x61,
-  0x6c, 0x20, 0x73, 0x65, 0x63, 0x6f, 0x6e, 0x64, 0x20, 0x61, 0x72, 0x67,
-  0x75, 0x6d, 0x65, 0x6e, 0x74, 0x20, 0x74, 0x6f, 0x20, 0x72, 0x65, 0x73,
-  0x65, 0x74, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68,
-  0x65, 0x64, 0x20, 0x66, 0x6c, 0x61, 0x67, 0x73, 0x0a, 0x20, 0x2a, 0x20,
-  0x6f, 0x66, 0x20, 0x61, 0x6c, 0x6c, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x20,
-  0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x69, 0x74, 0x65, 0x6d, 0x73, 0x20,
-  0x6d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x64, 0x20, 0x62, 0x79, 0x20, 0x74,
-  0x68, 0x65, 0x20, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2e,
-  0x20, 0x2a, 0x2f, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x69, 0x6e, 0x69,
-  0x74, 0x69, 0x61, 0x6c, 0x69, 0x73, 0x65, 0x4d, 0x6f, 0x72, 0x70, 0x68,
-  0x69, 0x73, 0x6d, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d,
-  0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c, 0x20,
-  0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61, 0x70, 0x68,
-  0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x61, 0x64, 0x64, 0x4e,
-  0x6f, 0x64, 0x65, 0x4d, 0x61, 0x70, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68,
-  0x69, 0x73, 0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73,
-  0x6d, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6c, 0x65, 0x66, 0x74, 0x5f,
-  0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x68,
-  0x6f, 0x73, 0x74, 0x5f, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20, 0x69,
-  0x6e, 0x74, 0x20, 0x61, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e,
-  0x74, 0x73, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x72, 0x65,
-  0x6d, 0x6f, 0x76, 0x65, 0x4e, 0x6f, 0x64, 0x65, 0x4d, 0x61, 0x70, 0x28,
+  0x69, 0x73, 0x6d, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x43, 0x61, 0x6c,
+  0x6c, 0x65, 0x64, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x65, 0x61, 0x63,
+  0x68, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x20, 0x66, 0x6f, 0x75, 0x6e,
+  0x64, 0x20, 0x62, 0x79, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x65, 0x6e,
+  0x65, 0x72, 0x61, 0x74, 0x65, 0x64, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74,
+  0x69, 0x6f, 0x6e, 0x20, 0x65, 0x6e, 0x75, 0x6d, 0x65, 0x72, 0x61, 0x74,
+  0x65, 0x3c, 0x72, 0x75, 0x6c, 0x65, 0x5f, 0x6e, 0x61, 0x6d, 0x65, 0x3e,
+  0x2e, 0x0a, 0x20, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x6d, 0x6f, 0x72,
+  0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x68, 0x6f, 0x6c, 0x64, 0x73, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x20, 0x61, 0x6e,
+  0x64, 0x20, 0x6d, 0x75, 0x73, 0x74, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x62,
+  0x65, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x64, 0x2e, 0x20, 0x52,
+  0x65, 0x74, 0x75, 0x72, 0x6e, 0x69, 0x6e, 0x67, 0x20, 0x74, 0x72, 0x75,
+  0x65, 0x20, 0x73, 0x74, 0x6f, 0x70, 0x73, 0x0a, 0x20, 0x2a, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x65, 0x6e, 0x75, 0x6d, 0x65, 0x72, 0x61, 0x74, 0x69,
+  0x6f, 0x6e, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x65, 0x6e, 0x75, 0x6d,
+  0x65, 0x72, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x64, 0x6f, 0x65, 0x73,
+  0x20, 0x6e, 0x6f, 0x74, 0x20, 0x75, 0x73, 0x65, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x64, 0x20, 0x66, 0x6c, 0x61,
+  0x67, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x68, 0x6f,
+  0x73, 0x74, 0x0a, 0x20, 0x2a, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x2c,
+  0x20, 0x73, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x63, 0x61, 0x6c, 0x6c,
+  0x62, 0x61, 0x63, 0x6b, 0x20, 0x6d, 0x61, 0x79, 0x20, 0x6d, 0x61, 0x74,
+  0x63, 0x68, 0x2c, 0x20, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x20, 0x6f, 0x72,
+  0x20, 0x65, 0x6e, 0x75, 0x6d, 0x65, 0x72, 0x61, 0x74, 0x65, 0x20, 0x6f,
+  0x74, 0x68, 0x65, 0x72, 0x20, 0x72, 0x75, 0x6c, 0x65, 0x73, 0x2c, 0x20,
+  0x62, 0x75, 0x74, 0x20, 0x69, 0x74, 0x20, 0x6d, 0x75, 0x73, 0x74, 0x0a,
+  0x20, 0x2a, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x67,
+  0x65, 0x20, 0x74, 0x68, 0x65, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x20, 0x67,
+  0x72, 0x61, 0x70, 0x68, 0x20, 0x6f, 0x72, 0x20, 0x6d, 0x61, 0x74, 0x63,
+  0x68, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x75, 0x6c, 0x65, 0x20, 0x62,
+  0x65, 0x69, 0x6e, 0x67, 0x20, 0x65, 0x6e, 0x75, 0x6d, 0x65, 0x72, 0x61,
+  0x74, 0x65, 0x64, 0x2c, 0x20, 0x77, 0x68, 0x69, 0x63, 0x68, 0x20, 0x69,
+  0x73, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x61, 0x73, 0x73, 0x65, 0x72, 0x74,
+  0x65, 0x64, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64,
+  0x65, 0x66, 0x20, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x28, 0x2a, 0x4d, 0x61,
+  0x74, 0x63, 0x68, 0x43, 0x61, 0x6c, 0x6c, 0x62, 0x61, 0x63, 0x6b, 0x29,
+  0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a, 0x6d,
+  0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x29, 0x3b, 0x0a, 0x0a, 0x2f,
+  0x2a, 0x20, 0x41, 0x6c, 0x6c, 0x6f, 0x63, 0x61, 0x74, 0x65, 0x73, 0x20,
+  0x6d, 0x65, 0x6d, 0x6f, 0x72, 0x79, 0x20, 0x66, 0x6f, 0x72, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c,
+  0x20, 0x61, 0x6e, 0x64, 0x20, 0x63, 0x61, 0x6c, 0x6c, 0x73, 0x20, 0x69,
+  0x6e, 0x69, 0x74, 0x69, 0x61, 0x6c, 0x69, 0x73, 0x65, 0x4d, 0x6f, 0x72,
+  0x70, 0x68, 0x69, 0x73, 0x6d, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x4d, 0x6f,
+  0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a, 0x6d, 0x61, 0x6b, 0x65,
+  0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x28, 0x69, 0x6e, 0x74,
+  0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20,
+  0x65, 0x64, 0x67, 0x65, 0x73, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x76,
+  0x61, 0x72, 0x69, 0x61, 0x62, 0x6c, 0x65, 0x73, 0x29, 0x3b, 0x0a, 0x0a,
+  0x2f, 0x2a, 0x20, 0x54, 0x68, 0x69, 0x73, 0x20, 0x66, 0x75, 0x6e, 0x63,
+  0x74, 0x69, 0x6f, 0x6e, 0x20, 0x69, 0x73, 0x20, 0x75, 0x73, 0x65, 0x64,
+  0x20, 0x74, 0x6f, 0x20, 0x62, 0x6f, 0x74, 0x68, 0x20, 0x69, 0x6e, 0x69,
+  0x74, 0x69, 0x61, 0x6c, 0x69, 0x73, 0x65, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x6f, 0x6e, 0x20,
+  0x63, 0x72, 0x65, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x61, 0x6e, 0x64,
+  0x20, 0x74, 0x6f, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x72, 0x65, 0x73, 0x65,
+  0x74, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69,
+  0x73, 0x6d, 0x20, 0x61, 0x66, 0x74, 0x65, 0x72, 0x20, 0x65, 0x61, 0x63,
+  0x68, 0x20, 0x72, 0x75, 0x6c, 0x65, 0x20, 0x61, 0x70, 0x70, 0x6c, 0x69,
+  0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20,
+  0x64, 0x61, 0x74, 0x61, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x0a, 0x20, 0x2a, 0x20,
+  0x61, 0x72, 0x65, 0x20, 0x72, 0x65, 0x73, 0x65, 0x74, 0x20, 0x74, 0x6f,
+  0x20, 0x74, 0x68, 0x65, 0x69, 0x72, 0x20, 0x64, 0x65, 0x66, 0x61, 0x75,
+  0x6c, 0x74, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x73, 0x2e, 0x20, 0x0a,
+  0x20, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x20,
+  0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x69, 0x73, 0x20, 0x70, 0x61, 0x73,
+  0x73, 0x65, 0x64, 0x20, 0x61, 0x73, 0x20, 0x61, 0x6e, 0x20, 0x6f, 0x70,
+  0x74, 0x69, 0x6f, 0x6e, 0x61, 0x6c, 0x20, 0x73, 0x65, 0x63, 0x6f, 0x6e,
+  0x64, 0x20, 0x61, 0x72, 0x67, 0x75, 0x6d, 0x65, 0x6e, 0x74, 0x20, 0x74,
+  0x6f, 0x20, 0x72, 0x65, 0x73, 0x65, 0x74, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x6d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x64, 0x20, 0x66, 0x6c, 0x61, 0x67,
+  0x73, 0x0a, 0x20, 0x2a, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x6c, 0x6c, 0x20,
+  0x68, 0x6f, 0x73, 0x74, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x69,
+  0x74, 0x65, 0x6d, 0x73, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x64,
+  0x20, 0x62, 0x79, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6d, 0x6f, 0x72, 0x70,
+  0x68, 0x69, 0x73, 0x6d, 0x2c, 0x20, 0x77, 0x68, 0x69, 0x63, 0x68, 0x20,
+  0x69, 0x73, 0x20, 0x64, 0x6f, 0x6e, 0x65, 0x20, 0x62, 0x79, 0x20, 0x61,
+  0x64, 0x76, 0x61, 0x6e, 0x63, 0x69, 0x6e, 0x67, 0x0a, 0x20, 0x2a, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x20, 0x65, 0x70,
+  0x6f, 0x63, 0x68, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67,
+  0x72, 0x61, 0x70, 0x68, 0x20, 0x28, 0x73, 0x65, 0x65, 0x20, 0x72, 0x65,
+  0x73, 0x65, 0x74, 0x4d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x64, 0x46, 0x6c,
+  0x61, 0x67, 0x73, 0x29, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x76, 0x6f, 0x69,
+  0x64, 0x20, 0x69, 0x6e, 0x69, 0x74, 0x69, 0x61, 0x6c, 0x69, 0x73, 0x65,
+  0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x28, 0x4d, 0x6f, 0x72,
+  0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68,
+  0x69, 0x73, 0x6d, 0x2c, 0x20, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a,
+  0x67, 0x72, 0x61, 0x70, 0x68, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64,
+  0x20, 0x61, 0x64, 0x64, 0x4e, 0x6f, 0x64, 0x65, 0x4d, 0x61, 0x70, 0x28,
   0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a, 0x6d, 0x6f,
   0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20,
-  0x6c, 0x65, 0x66, 0x74, 0x5f, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b,
-  0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x61, 0x64, 0x64, 0x45, 0x64, 0x67,
+  0x6c, 0x65, 0x66, 0x74, 0x5f, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20,
+  0x69, 0x6e, 0x74, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x5f, 0x69, 0x6e, 0x64,
+  0x65, 0x78, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x61, 0x73, 0x73, 0x69,
+  0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x73, 0x29, 0x3b, 0x0a, 0x76, 0x6f,
+  0x69, 0x64, 0x20, 0x72, 0x65, 0x6d, 0x6f, 0x76, 0x65, 0x4e, 0x6f, 0x64,
   0x65, 0x4d, 0x61, 0x70, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73,
   0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c,
   0x20, 0x69, 0x6e, 0x74, 0x20, 0x6c, 0x65, 0x66, 0x74, 0x5f, 0x69, 0x6e,
-  0x64, 0x65, 0x78, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x68, 0x6f, 0x73,
-  0x74, 0x5f, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20, 0x69, 0x6e, 0x74,
-  0x20, 0x61, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x73,
-  0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x72, 0x65, 0x6d, 0x6f,
-  0x76, 0x65, 0x45, 0x64, 0x67, 0x65, 0x4d, 0x61, 0x70, 0x28, 0x4d, 0x6f,
+  0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x61,
+  0x64, 0x64, 0x45, 0x64, 0x67, 0x65, 0x4d, 0x61, 0x70, 0x28, 0x4d, 0x6f,
   0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70,
   0x68, 0x69, 0x73, 0x6d, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6c, 0x65,
-  0x66, 0x74, 0x5f, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x0a,
-  0x2f, 0x2a, 0x20, 0x54, 0x65, 0x73, 0x74, 0x73, 0x20, 0x61, 0x20, 0x70,
-  0x6f, 0x74, 0x65, 0x6e, 0x74, 0x69, 0x61, 0x6c, 0x20, 0x76, 0x61, 0x72,
-  0x69, 0x61, 0x62, 0x6c, 0x65, 0x2d, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x20,
-  0x61, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x20, 0x61,
-  0x67, 0x61, 0x69, 0x6e, 0x73, 0x74, 0x20, 0x74, 0x68, 0x65, 0x20, 0x61,
-  0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x73, 0x20, 0x69,
-  0x6e, 0x20, 0x74, 0x68, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x6d, 0x6f, 0x72,
-  0x70, 0x68, 0x69, 0x73, 0x6d, 0x2e, 0x20, 0x49, 0x66, 0x20, 0x74, 0x68,
-  0x65, 0x20, 0x76, 0x61, 0x72, 0x69, 0x61, 0x62, 0x6c, 0x65, 0x20, 0x69,
-  0x73, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65,
-  0x20, 0x61, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x2c,
-  0x20, 0x69, 0x74, 0x73, 0x20, 0x6e, 0x61, 0x6d, 0x65, 0x20, 0x61, 0x6e,
-  0x64, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x20, 0x61, 0x72, 0x65, 0x20,
-  0x0a, 0x20, 0x2a, 0x20, 0x61, 0x64, 0x64, 0x65, 0x64, 0x20, 0x74, 0x6f,
-  0x20, 0x74, 0x68, 0x65, 0x20, 0x61, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d,
-  0x65, 0x6e, 0x74, 0x73, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x20, 0x69,
-  0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69,
-  0x73, 0x6d, 0x2e, 0x20, 0x0a, 0x20, 0x2a, 0x0a, 0x20, 0x2a, 0x20, 0x52,
-  0x65, 0x74, 0x75, 0x72, 0x6e, 0x73, 0x20, 0x2d, 0x31, 0x20, 0x69, 0x66,
-  0x20, 0x74, 0x68, 0x65, 0x20, 0x76, 0x61, 0x72, 0x69, 0x61, 0x62, 0x6c,
-  0x65, 0x20, 0x68, 0x61, 0x73, 0x20, 0x61, 0x6c, 0x72, 0x65, 0x61, 0x64,
-  0x79, 0x20, 0x62, 0x65, 0x65, 0x6e, 0x20, 0x61, 0x73, 0x73, 0x69, 0x67,
-  0x6e, 0x65, 0x64, 0x20, 0x74, 0x6f, 0x20, 0x61, 0x20, 0x64, 0x69, 0x66,
-  0x66, 0x65, 0x72, 0x65, 0x6e, 0x74, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65,
-  0x0a, 0x20, 0x2a, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x61,
-  0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x2e, 0x0a, 0x20,
-  0x2a, 0x20, 0x52, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x73, 0x20, 0x30, 0x20,
-  0x69, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x76, 0x61, 0x72, 0x69, 0x61,
-  0x62, 0x6c, 0x65, 0x20, 0x68, 0x61, 0x73, 0x20, 0x61, 0x20, 0x76, 0x61,
-  0x6c, 0x75, 0x65, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x61,
-  0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x20, 0x74, 0x68,
-  0x61, 0x74, 0x20, 0x69, 0x73, 0x20, 0x65, 0x71, 0x75, 0x61, 0x6c, 0x20,
-  0x74, 0x6f, 0x0a, 0x20, 0x2a, 0x20, 0x74, 0x68, 0x65, 0x20, 0x70, 0x61,
-  0x73, 0x73, 0x65, 0x64, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x2e, 0x0a,
-  0x20, 0x2a, 0x20, 0x52, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x73, 0x20, 0x31,
-  0x20, 0x69, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x76, 0x61, 0x72, 0x69,
-  0x61, 0x62, 0x6c, 0x65, 0x20, 0x64, 0x69, 0x64, 0x20, 0x6e, 0x6f, 0x74,
-  0x20, 0x70, 0x72, 0x65, 0x76, 0x69, 0x6f, 0x75, 0x73, 0x6c, 0x79, 0x20,
-  0x65, 0x78, 0x69, 0x73, 0x74, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65,
-  0x20, 0x61, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x2e,
-  0x20, 0x2a, 0x2f, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x61, 0x64, 0x64, 0x4c,
-  0x69, 0x73, 0x74, 0x41, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e,
-  0x74, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a,
-  0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c, 0x20, 0x69, 0x6e,
-  0x74, 0x20, 0x69, 0x64, 0x2c, 0x20, 0x48, 0x6f, 0x73, 0x74, 0x4c, 0x69,
-  0x73, 0x74, 0x20, 0x2a, 0x6c, 0x69, 0x73, 0x74, 0x29, 0x3b, 0x0a, 0x69,
-  0x6e, 0x74, 0x20, 0x61, 0x64, 0x64, 0x49, 0x6e, 0x74, 0x65, 0x67, 0x65,
-  0x72, 0x41, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x28,
-  0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a, 0x6d, 0x6f,
-  0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20,
-  0x69, 0x64, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6e, 0x75, 0x6d, 0x29,
-  0x3b, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x61, 0x64, 0x64, 0x53, 0x74, 0x72,
-  0x69, 0x6e, 0x67, 0x41, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e,
-  0x74, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a,
-  0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c, 0x20, 0x69, 0x6e,
-  0x74, 0x20, 0x69, 0x64, 0x2c, 0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67,
-  0x20, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x29, 0x3b, 0x0a, 0x0a, 0x76, 0x6f,
-  0x69, 0x64, 0x20, 0x72, 0x65, 0x6d, 0x6f, 0x76, 0x65, 0x41, 0x73, 0x73,
-  0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x73, 0x28, 0x4d, 0x6f, 0x72,
-  0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68,
-  0x69, 0x73, 0x6d, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6e, 0x75, 0x6d,
-  0x62, 0x65, 0x72, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x70,
-  0x75, 0x73, 0x68, 0x56, 0x61, 0x72, 0x69, 0x61, 0x62, 0x6c, 0x65, 0x49,
-  0x64, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a,
-  0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c, 0x20, 0x69, 0x6e,
-  0x74, 0x20, 0x69, 0x64, 0x29, 0x3b, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x70,
-  0x6f, 0x70, 0x56, 0x61, 0x72, 0x69, 0x61, 0x62, 0x6c, 0x65, 0x49, 0x64,
+  0x66, 0x74, 0x5f, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20, 0x69, 0x6e,
+  0x74, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x5f, 0x69, 0x6e, 0x64, 0x65, 0x78,
+  0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x61, 0x73, 0x73, 0x69, 0x67, 0x6e,
+  0x6d, 0x65, 0x6e, 0x74, 0x73, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64,
+  0x20, 0x72, 0x65, 0x6d, 0x6f, 0x76, 0x65, 0x45, 0x64, 0x67, 0x65, 0x4d,
+  0x61, 0x70, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20,
+  0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c, 0x20, 0x69,
+  0x6e, 0x74, 0x20, 0x6c, 0x65, 0x66, 0x74, 0x5f, 0x69, 0x6e, 0x64, 0x65,
+  0x78, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x54, 0x65, 0x73, 0x74,
+  0x73, 0x20, 0x61, 0x20, 0x70, 0x6f, 0x74, 0x65, 0x6e, 0x74, 0x69, 0x61,
+  0x6c, 0x20, 0x76, 0x61, 0x72, 0x69, 0x61, 0x62, 0x6c, 0x65, 0x2d, 0x76,
+  0x61, 0x6c, 0x75, 0x65, 0x20, 0x61, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d,
+  0x65, 0x6e, 0x74, 0x20, 0x61, 0x67, 0x61, 0x69, 0x6e, 0x73, 0x74, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x61, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65,
+  0x6e, 0x74, 0x73, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x0a, 0x20,
+  0x2a, 0x20, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2e, 0x20,
+  0x49, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x76, 0x61, 0x72, 0x69, 0x61,
+  0x62, 0x6c, 0x65, 0x20, 0x69, 0x73, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x69,
+  0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x61, 0x73, 0x73, 0x69, 0x67, 0x6e,
+  0x6d, 0x65, 0x6e, 0x74, 0x2c, 0x20, 0x69, 0x74, 0x73, 0x20, 0x6e, 0x61,
+  0x6d, 0x65, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65,
+  0x20, 0x61, 0x72, 0x65, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x61, 0x64, 0x64,
+  0x65, 0x64, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x61, 0x73,
+  0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x73, 0x20, 0x61, 0x72,
+  0x72, 0x61, 0x79, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6d,
+  0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2e, 0x20, 0x0a, 0x20, 0x2a,
+  0x0a, 0x20, 0x2a, 0x20, 0x52, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x73, 0x20,
+  0x2d, 0x31, 0x20, 0x69, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x76, 0x61,
+  0x72, 0x69, 0x61, 0x62, 0x6c, 0x65, 0x20, 0x68, 0x61, 0x73, 0x20, 0x61,
+  0x6c, 0x72, 0x65, 0x61, 0x64, 0x79, 0x20, 0x62, 0x65, 0x65, 0x6e, 0x20,
+  0x61, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x65, 0x64, 0x20, 0x74, 0x6f, 0x20,
+  0x61, 0x20, 0x64, 0x69, 0x66, 0x66, 0x65, 0x72, 0x65, 0x6e, 0x74, 0x20,
+  0x76, 0x61, 0x6c, 0x75, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x69, 0x6e, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x61, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65,
+  0x6e, 0x74, 0x2e, 0x0a, 0x20, 0x2a, 0x20, 0x52, 0x65, 0x74, 0x75, 0x72,
+  0x6e, 0x73, 0x20, 0x30, 0x20, 0x69, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x76, 0x61, 0x72, 0x69, 0x61, 0x62, 0x6c, 0x65, 0x20, 0x68, 0x61, 0x73,
+  0x20, 0x61, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x20, 0x69, 0x6e, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x61, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65,
+  0x6e, 0x74, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x69, 0x73, 0x20, 0x65,
+  0x71, 0x75, 0x61, 0x6c, 0x20, 0x74, 0x6f, 0x0a, 0x20, 0x2a, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x70, 0x61, 0x73, 0x73, 0x65, 0x64, 0x20, 0x76, 0x61,
+  0x6c, 0x75, 0x65, 0x2e, 0x0a, 0x20, 0x2a, 0x20, 0x52, 0x65, 0x74, 0x75,
+  0x72, 0x6e, 0x73, 0x20, 0x31, 0x20, 0x69, 0x66, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x76, 0x61, 0x72, 0x69, 0x61, 0x62, 0x6c, 0x65, 0x20, 0x64, 0x69,
+  0x64, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x70, 0x72, 0x65, 0x76, 0x69, 0x6f,
+  0x75, 0x73, 0x6c, 0x79, 0x20, 0x65, 0x78, 0x69, 0x73, 0x74, 0x20, 0x69,
+  0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x61, 0x73, 0x73, 0x69, 0x67, 0x6e,
+  0x6d, 0x65, 0x6e, 0x74, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x69, 0x6e, 0x74,
+  0x20, 0x61, 0x64, 0x64, 0x4c, 0x69, 0x73, 0x74, 0x41, 0x73, 0x73, 0x69,
+  0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68,
+  0x69, 0x73, 0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73,
+  0x6d, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x64, 0x2c, 0x20, 0x48,
+  0x6f, 0x73, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x20, 0x2a, 0x6c, 0x69, 0x73,
+  0x74, 0x29, 0x3b, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x61, 0x64, 0x64, 0x49,
+  0x6e, 0x74, 0x65, 0x67, 0x65, 0x72, 0x41, 0x73, 0x73, 0x69, 0x67, 0x6e,
+  0x6d, 0x65, 0x6e, 0x74, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73,
+  0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c,
+  0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x64, 0x2c, 0x20, 0x69, 0x6e, 0x74,
+  0x20, 0x6e, 0x75, 0x6d, 0x29, 0x3b, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x61,
+  0x64, 0x64, 0x53, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x41, 0x73, 0x73, 0x69,
+  0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68,
+  0x69, 0x73, 0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73,
+  0x6d, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x64, 0x2c, 0x20, 0x73,
+  0x74, 0x72, 0x69, 0x6e, 0x67, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x29,
+  0x3b, 0x0a, 0x2f, 0x2a, 0x20, 0x41, 0x73, 0x20, 0x61, 0x64, 0x64, 0x53,
+  0x74, 0x72, 0x69, 0x6e, 0x67, 0x41, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d,
+  0x65, 0x6e, 0x74, 0x2c, 0x20, 0x66, 0x6f, 0x72, 0x20, 0x73, 0x74, 0x72,
+  0x69, 0x6e, 0x67, 0x73, 0x20, 0x74, 0x61, 0x6b, 0x65, 0x6e, 0x20, 0x66,
+  0x72, 0x6f, 0x6d, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x20, 0x6c, 0x69, 0x73,
+  0x74, 0x20, 0x61, 0x74, 0x6f, 0x6d, 0x73, 0x2e, 0x20, 0x54, 0x68, 0x65,
+  0x73, 0x65, 0x20, 0x61, 0x72, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x69, 0x6e,
+  0x74, 0x65, 0x72, 0x6e, 0x65, 0x64, 0x2c, 0x20, 0x73, 0x6f, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x61, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e,
+  0x74, 0x20, 0x73, 0x68, 0x61, 0x72, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x20, 0x61, 0x6e, 0x64, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x61, 0x72, 0x69, 0x73,
+  0x6f, 0x6e, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x61, 0x6e, 0x20, 0x0a,
+  0x20, 0x2a, 0x20, 0x65, 0x78, 0x69, 0x73, 0x74, 0x69, 0x6e, 0x67, 0x20,
+  0x76, 0x61, 0x6c, 0x75, 0x65, 0x20, 0x69, 0x73, 0x20, 0x61, 0x20, 0x70,
+  0x6f, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x61,
+  0x72, 0x69, 0x73, 0x6f, 0x6e, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x69, 0x6e,
+  0x74, 0x20, 0x61, 0x64, 0x64, 0x49, 0x6e, 0x74, 0x65, 0x72, 0x6e, 0x65,
+  0x64, 0x53, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x41, 0x73, 0x73, 0x69, 0x67,
+  0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69,
+  0x73, 0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d,
+  0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x64, 0x2c, 0x20, 0x73, 0x74,
+  0x72, 0x69, 0x6e, 0x67, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x29, 0x3b,
+  0x0a, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x72, 0x65, 0x6d, 0x6f, 0x76,
+  0x65, 0x41, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x73,
   0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a, 0x6d,
-  0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x29, 0x3b, 0x0a, 0x0a, 0x69,
-  0x6e, 0x74, 0x20, 0x6c, 0x6f, 0x6f, 0x6b, 0x75, 0x70, 0x4e, 0x6f, 0x64,
-  0x65, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a,
-  0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c, 0x20, 0x69, 0x6e,
-  0x74, 0x20, 0x6c, 0x65, 0x66, 0x74, 0x5f, 0x69, 0x6e, 0x64, 0x65, 0x78,
-  0x29, 0x3b, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x6c, 0x6f, 0x6f, 0x6b, 0x75,
-  0x70, 0x45, 0x64, 0x67, 0x65, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69,
+  0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c, 0x20, 0x69, 0x6e, 0x74,
+  0x20, 0x6e, 0x75, 0x6d, 0x62, 0x65, 0x72, 0x29, 0x3b, 0x0a, 0x76, 0x6f,
+  0x69, 0x64, 0x20, 0x70, 0x75, 0x73, 0x68, 0x56, 0x61, 0x72, 0x69, 0x61,
+  0x62, 0x6c, 0x65, 0x49, 0x64, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69,
+  0x73, 0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d,
+  0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x64, 0x29, 0x3b, 0x0a, 0x69,
+  0x6e, 0x74, 0x20, 0x70, 0x6f, 0x70, 0x56, 0x61, 0x72, 0x69, 0x61, 0x62,
+  0x6c, 0x65, 0x49, 0x64, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73,
+  0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x29,
+  0x3b, 0x0a, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x6c, 0x6f, 0x6f, 0x6b, 0x75,
+  0x70, 0x4e, 0x6f, 0x64, 0x65, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69,
   0x73, 0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d,
   0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6c, 0x65, 0x66, 0x74, 0x5f, 0x69,
-  0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x54,
-  0x68, 0x65, 0x73, 0x65, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f,
-  0x6e, 0x73, 0x20, 0x65, 0x78, 0x70, 0x65, 0x63, 0x74, 0x20, 0x74, 0x6f,
-  0x20, 0x62, 0x65, 0x20, 0x70, 0x61, 0x73, 0x73, 0x65, 0x64, 0x20, 0x74,
-  0x68, 0x65, 0x20, 0x69, 0x64, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x20, 0x76,
-  0x61, 0x72, 0x69, 0x61, 0x62, 0x6c, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x74,
-  0x68, 0x65, 0x20, 0x61, 0x70, 0x70, 0x72, 0x6f, 0x70, 0x72, 0x69, 0x61,
-  0x74, 0x65, 0x20, 0x74, 0x79, 0x70, 0x65, 0x2e, 0x20, 0x2a, 0x2f, 0x0a,
-  0x69, 0x6e, 0x74, 0x20, 0x67, 0x65, 0x74, 0x49, 0x6e, 0x74, 0x65, 0x67,
-  0x65, 0x72, 0x56, 0x61, 0x6c, 0x75, 0x65, 0x28, 0x4d, 0x6f, 0x72, 0x70,
+  0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x6c,
+  0x6f, 0x6f, 0x6b, 0x75, 0x70, 0x45, 0x64, 0x67, 0x65, 0x28, 0x4d, 0x6f,
+  0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70,
+  0x68, 0x69, 0x73, 0x6d, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x6c, 0x65,
+  0x66, 0x74, 0x5f, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x0a,
+  0x2f, 0x2a, 0x20, 0x52, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x20, 0x74, 0x72,
+  0x75, 0x65, 0x20, 0x69, 0x66, 0x20, 0x73, 0x6f, 0x6d, 0x65, 0x20, 0x69,
+  0x74, 0x65, 0x6d, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6d,
+  0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x69, 0x73, 0x20, 0x6d,
+  0x61, 0x70, 0x70, 0x65, 0x64, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x68, 0x6f, 0x73, 0x74, 0x20, 0x69, 0x74, 0x65, 0x6d, 0x2e, 0x20,
+  0x55, 0x73, 0x65, 0x64, 0x20, 0x69, 0x6e, 0x0a, 0x20, 0x2a, 0x20, 0x70,
+  0x6c, 0x61, 0x63, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x6d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x64, 0x20, 0x66, 0x6c, 0x61, 0x67,
+  0x73, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x68, 0x6f, 0x73,
+  0x74, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x62, 0x79, 0x20, 0x6d,
+  0x61, 0x74, 0x63, 0x68, 0x69, 0x6e, 0x67, 0x20, 0x63, 0x6f, 0x64, 0x65,
+  0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x72, 0x75, 0x6e, 0x73, 0x20, 0x69,
+  0x6e, 0x0a, 0x20, 0x2a, 0x20, 0x70, 0x61, 0x72, 0x61, 0x6c, 0x6c, 0x65,
+  0x6c, 0x20, 0x28, 0x73, 0x65, 0x65, 0x20, 0x70, 0x61, 0x72, 0x61, 0x6c,
+  0x6c, 0x65, 0x6c, 0x2e, 0x68, 0x29, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x62,
+  0x6f, 0x6f, 0x6c, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x49, 0x6e, 0x4d, 0x6f,
+  0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68,
+  0x69, 0x73, 0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73,
+  0x6d, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x5f,
+  0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0a, 0x62, 0x6f, 0x6f, 0x6c,
+  0x20, 0x65, 0x64, 0x67, 0x65, 0x49, 0x6e, 0x4d, 0x6f, 0x72, 0x70, 0x68,
+  0x69, 0x73, 0x6d, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d,
+  0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c, 0x20,
+  0x69, 0x6e, 0x74, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x5f, 0x69, 0x6e, 0x64,
+  0x65, 0x78, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x4d, 0x6f, 0x76,
+  0x65, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6d, 0x61, 0x70, 0x73, 0x20,
+  0x61, 0x6e, 0x64, 0x20, 0x61, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65,
+  0x6e, 0x74, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x73, 0x6f, 0x75, 0x72, 0x63,
+  0x65, 0x20, 0x69, 0x6e, 0x74, 0x6f, 0x20, 0x74, 0x61, 0x72, 0x67, 0x65,
+  0x74, 0x2c, 0x20, 0x77, 0x68, 0x69, 0x63, 0x68, 0x20, 0x6d, 0x75, 0x73,
+  0x74, 0x20, 0x68, 0x61, 0x76, 0x65, 0x20, 0x74, 0x68, 0x65, 0x0a, 0x20,
+  0x2a, 0x20, 0x73, 0x61, 0x6d, 0x65, 0x20, 0x64, 0x69, 0x6d, 0x65, 0x6e,
+  0x73, 0x69, 0x6f, 0x6e, 0x73, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x62, 0x65,
+  0x20, 0x65, 0x6d, 0x70, 0x74, 0x79, 0x2e, 0x20, 0x73, 0x6f, 0x75, 0x72,
+  0x63, 0x65, 0x20, 0x69, 0x73, 0x20, 0x6c, 0x65, 0x66, 0x74, 0x20, 0x65,
+  0x6d, 0x70, 0x74, 0x79, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x76, 0x6f, 0x69,
+  0x64, 0x20, 0x6d, 0x6f, 0x76, 0x65, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69,
+  0x73, 0x6d, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20,
+  0x2a, 0x73, 0x6f, 0x75, 0x72, 0x63, 0x65, 0x2c, 0x20, 0x4d, 0x6f, 0x72,
+  0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a, 0x74, 0x61, 0x72, 0x67, 0x65,
+  0x74, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x73,
+  0x65, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x73, 0x20,
+  0x65, 0x78, 0x70, 0x65, 0x63, 0x74, 0x20, 0x74, 0x6f, 0x20, 0x62, 0x65,
+  0x20, 0x70, 0x61, 0x73, 0x73, 0x65, 0x64, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x69, 0x64, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x20, 0x76, 0x61, 0x72, 0x69,
+  0x61, 0x62, 0x6c, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x61, 0x70, 0x70, 0x72, 0x6f, 0x70, 0x72, 0x69, 0x61, 0x74, 0x65, 0x20,
+  0x74, 0x79, 0x70, 0x65, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x69, 0x6e, 0x74,
+  0x20, 0x67, 0x65, 0x74, 0x49, 0x6e, 0x74, 0x65, 0x67, 0x65, 0x72, 0x56,
+  0x61, 0x6c, 0x75, 0x65, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73,
+  0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c,
+  0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x64, 0x29, 0x3b, 0x0a, 0x73, 0x74,
+  0x72, 0x69, 0x6e, 0x67, 0x20, 0x67, 0x65, 0x74, 0x53, 0x74, 0x72, 0x69,
+  0x6e, 0x67, 0x56, 0x61, 0x6c, 0x75, 0x65, 0x28, 0x4d, 0x6f, 0x72, 0x70,
   0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69,
   0x73, 0x6d, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x64, 0x29, 0x3b,
-  0x0a, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x20, 0x67, 0x65, 0x74, 0x53,
-  0x74, 0x72, 0x69, 0x6e, 0x67, 0x56, 0x61, 0x6c, 0x75, 0x65, 0x28, 0x4d,
-  0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72,
-  0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x69,
-  0x64, 0x29, 0x3b, 0x0a, 0x41, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65,
-  0x6e, 0x74, 0x20, 0x67, 0x65, 0x74, 0x41, 0x73, 0x73, 0x69, 0x67, 0x6e,
-  0x6d, 0x65, 0x6e, 0x74, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73,
-  0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c,
-  0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x64, 0x29, 0x3b, 0x0a, 0x2f, 0x2a,
-  0x20, 0x55, 0x73, 0x65, 0x64, 0x20, 0x69, 0x6e, 0x20, 0x72, 0x75, 0x6c,
-  0x65, 0x20, 0x61, 0x70, 0x70, 0x6c, 0x69, 0x63, 0x61, 0x74, 0x69, 0x6f,
-  0x6e, 0x20, 0x74, 0x6f, 0x20, 0x67, 0x65, 0x74, 0x20, 0x74, 0x68, 0x65,
-  0x20, 0x6c, 0x65, 0x6e, 0x67, 0x74, 0x68, 0x20, 0x6f, 0x66, 0x20, 0x74,
-  0x68, 0x65, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x20, 0x6d, 0x61, 0x74,
-  0x63, 0x68, 0x65, 0x64, 0x20, 0x62, 0x79, 0x20, 0x61, 0x20, 0x6c, 0x69,
-  0x73, 0x74, 0x20, 0x76, 0x61, 0x72, 0x69, 0x61, 0x62, 0x6c, 0x65, 0x2e,
-  0x20, 0x2a, 0x2f, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x67, 0x65, 0x74, 0x41,
-  0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x4c, 0x65, 0x6e,
-  0x67, 0x74, 0x68, 0x28, 0x41, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65,
-  0x6e, 0x74, 0x20, 0x61, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e,
-  0x74, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x55, 0x73, 0x65, 0x64,
-  0x20, 0x74, 0x6f, 0x20, 0x74, 0x65, 0x73, 0x74, 0x20, 0x73, 0x74, 0x72,
-  0x69, 0x6e, 0x67, 0x20, 0x63, 0x6f, 0x6e, 0x73, 0x74, 0x61, 0x6e, 0x74,
-  0x73, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x75, 0x6c,
-  0x65, 0x20, 0x61, 0x67, 0x61, 0x69, 0x6e, 0x73, 0x74, 0x20, 0x61, 0x20,
-  0x68, 0x6f, 0x73, 0x74, 0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x2e,
-  0x20, 0x49, 0x66, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x72, 0x75, 0x6c, 0x65,
-  0x5f, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x20, 0x69, 0x73, 0x20, 0x61,
-  0x20, 0x70, 0x72, 0x65, 0x66, 0x69, 0x78, 0x20, 0x6f, 0x66, 0x20, 0x74,
-  0x68, 0x65, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x5f, 0x73, 0x74, 0x72, 0x69,
-  0x6e, 0x67, 0x2c, 0x20, 0x74, 0x68, 0x65, 0x6e, 0x20, 0x74, 0x68, 0x65,
-  0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68,
-  0x65, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x63,
-  0x68, 0x61, 0x72, 0x61, 0x63, 0x74, 0x65, 0x72, 0x20, 0x64, 0x69, 0x72,
-  0x65, 0x63, 0x74, 0x6c, 0x79, 0x20, 0x61, 0x66, 0x74, 0x65, 0x72, 0x20,
-  0x74, 0x68, 0x69, 0x73, 0x20, 0x70, 0x72, 0x65, 0x66, 0x69, 0x78, 0x20,
-  0x69, 0x73, 0x20, 0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x65, 0x64, 0x2c,
-  0x20, 0x73, 0x6f, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x74, 0x68, 0x65,
-  0x20, 0x63, 0x61, 0x6c, 0x6c, 0x65, 0x72, 0x20, 0x6b, 0x6e, 0x6f, 0x77,
-  0x73, 0x0a, 0x20, 0x2a, 0x20, 0x77, 0x68, 0x65, 0x72, 0x65, 0x20, 0x69,
-  0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x20, 0x73,
-  0x74, 0x72, 0x69, 0x6e, 0x67, 0x20, 0x74, 0x6f, 0x20, 0x72, 0x65, 0x73,
-  0x75, 0x6d, 0x65, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x69, 0x6e, 0x67,
-  0x2e, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x46, 0x6f, 0x72, 0x20, 0x65, 0x78,
-  0x61, 0x6d, 0x70, 0x6c, 0x65, 0x2c, 0x20, 0x69, 0x73, 0x50, 0x72, 0x65,
-  0x66, 0x69, 0x78, 0x28, 0x22, 0x61, 0x62, 0x22, 0x2c, 0x20, 0x22, 0x61,
-  0x62, 0x63, 0x64, 0x22, 0x29, 0x20, 0x72, 0x65, 0x74, 0x75, 0x72, 0x6e,
-  0x73, 0x20, 0x32, 0x2c, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x6e, 0x64,
-  0x65, 0x78, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x66, 0x69,
-  0x72, 0x73, 0x74, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x63, 0x68, 0x61, 0x72,
-  0x61, 0x63, 0x74, 0x65, 0x72, 0x20, 0x28, 0x27, 0x63, 0x27, 0x29, 0x20,
-  0x61, 0x66, 0x74, 0x65, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6d, 0x61,
-  0x74, 0x63, 0x68, 0x65, 0x64, 0x20, 0x73, 0x75, 0x62, 0x73, 0x74, 0x72,
-  0x69, 0x6e, 0x67, 0x20, 0x28, 0x22, 0x61, 0x62, 0x22, 0x29, 0x2e, 0x0a,
-  0x20, 0x2a, 0x20, 0x52, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x73, 0x20, 0x2d,
-  0x31, 0x20, 0x69, 0x66, 0x20, 0x69, 0x74, 0x20, 0x74, 0x68, 0x65, 0x20,
-  0x72, 0x75, 0x6c, 0x65, 0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x20,
-  0x69, 0x73, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x61, 0x20, 0x70, 0x72, 0x65,
-  0x66, 0x69, 0x78, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x68,
-  0x6f, 0x73, 0x74, 0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x2e, 0x20,
-  0x2a, 0x2f, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x73, 0x50, 0x72, 0x65,
-  0x66, 0x69, 0x78, 0x28, 0x63, 0x6f, 0x6e, 0x73, 0x74, 0x20, 0x73, 0x74,
-  0x72, 0x69, 0x6e, 0x67, 0x20, 0x72, 0x75, 0x6c, 0x65, 0x5f, 0x73, 0x74,
-  0x72, 0x69, 0x6e, 0x67, 0x2c, 0x20, 0x63, 0x6f, 0x6e, 0x73, 0x74, 0x20,
-  0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x5f,
-  0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a,
-  0x20, 0x41, 0x6e, 0x61, 0x6c, 0x6f, 0x67, 0x6f, 0x75, 0x73, 0x20, 0x74,
-  0x6f, 0x20, 0x69, 0x73, 0x50, 0x72, 0x65, 0x66, 0x69, 0x78, 0x2e, 0x20,
-  0x45, 0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x3a, 0x20, 0x69, 0x73, 0x53,
-  0x75, 0x66, 0x66, 0x69, 0x78, 0x28, 0x22, 0x63, 0x64, 0x22, 0x2c, 0x20,
-  0x22, 0x61, 0x62, 0x63, 0x64, 0x22, 0x29, 0x20, 0x72, 0x65, 0x74, 0x75,
-  0x72, 0x6e, 0x73, 0x20, 0x31, 0x2c, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69,
-  0x6e, 0x64, 0x65, 0x78, 0x0a, 0x20, 0x2a, 0x20, 0x6f, 0x66, 0x20, 0x74,
-  0x68, 0x65, 0x20, 0x63, 0x68, 0x61, 0x72, 0x61, 0x63, 0x74, 0x65, 0x72,
-  0x20, 0x28, 0x27, 0x62, 0x27, 0x29, 0x20, 0x64, 0x69, 0x72, 0x65, 0x63,
-  0x74, 0x6c, 0x79, 0x20, 0x70, 0x72, 0x65, 0x63, 0x65, 0x64, 0x69, 0x6e,
-  0x67, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x65,
-  0x64, 0x20, 0x73, 0x75, 0x66, 0x66, 0x69, 0x78, 0x20, 0x28, 0x22, 0x63,
-  0x64, 0x22, 0x29, 0x2e, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x54, 0x68, 0x65,
-  0x20, 0x65, 0x78, 0x63, 0x65, 0x70, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x69,
-  0x73, 0x20, 0x69, 0x66, 0x20, 0x72, 0x75, 0x6c, 0x65, 0x5f, 0x73, 0x74,
-  0x72, 0x69, 0x6e, 0x67, 0x20, 0x65, 0x71, 0x75, 0x61, 0x6c, 0x73, 0x20,
+  0x0a, 0x41, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x20,
+  0x67, 0x65, 0x74, 0x41, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e,
+  0x74, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a,
+  0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c, 0x20, 0x69, 0x6e,
+  0x74, 0x20, 0x69, 0x64, 0x29, 0x3b, 0x0a, 0x2f, 0x2a, 0x20, 0x55, 0x73,
+  0x65, 0x64, 0x20, 0x69, 0x6e, 0x20, 0x72, 0x75, 0x6c, 0x65, 0x20, 0x61,
+  0x70, 0x70, 0x6c, 0x69, 0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x74,
+  0x6f, 0x20, 0x67, 0x65, 0x74, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x65,
+  0x6e, 0x67, 0x74, 0x68, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x76, 0x61, 0x6c, 0x75, 0x65, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x65,
+  0x64, 0x20, 0x62, 0x79, 0x20, 0x61, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20,
+  0x76, 0x61, 0x72, 0x69, 0x61, 0x62, 0x6c, 0x65, 0x2e, 0x20, 0x2a, 0x2f,
+  0x0a, 0x69, 0x6e, 0x74, 0x20, 0x67, 0x65, 0x74, 0x41, 0x73, 0x73, 0x69,
+  0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x4c, 0x65, 0x6e, 0x67, 0x74, 0x68,
+  0x28, 0x41, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x20,
+  0x61, 0x73, 0x73, 0x69, 0x67, 0x6e, 0x6d, 0x65, 0x6e, 0x74, 0x29, 0x3b,
+  0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x55, 0x73, 0x65, 0x64, 0x20, 0x74, 0x6f,
+  0x20, 0x74, 0x65, 0x73, 0x74, 0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67,
+  0x20, 0x63, 0x6f, 0x6e, 0x73, 0x74, 0x61, 0x6e, 0x74, 0x73, 0x20, 0x69,
+  0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x75, 0x6c, 0x65, 0x20, 0x61,
+  0x67, 0x61, 0x69, 0x6e, 0x73, 0x74, 0x20, 0x61, 0x20, 0x68, 0x6f, 0x73,
+  0x74, 0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x2e, 0x20, 0x49, 0x66,
+  0x20, 0x0a, 0x20, 0x2a, 0x20, 0x72, 0x75, 0x6c, 0x65, 0x5f, 0x73, 0x74,
+  0x72, 0x69, 0x6e, 0x67, 0x20, 0x69, 0x73, 0x20, 0x61, 0x20, 0x70, 0x72,
+  0x65, 0x66, 0x69, 0x78, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20,
   0x68, 0x6f, 0x73, 0x74, 0x5f, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x2c,
-  0x20, 0x69, 0x6e, 0x20, 0x77, 0x68, 0x69, 0x63, 0x68, 0x20, 0x63, 0x61,
-  0x73, 0x65, 0x20, 0x30, 0x20, 0x69, 0x73, 0x0a, 0x20, 0x2a, 0x20, 0x72,
-  0x65, 0x74, 0x75, 0x72, 0x6e, 0x65, 0x64, 0x2e, 0x20, 0x2a, 0x2f, 0x0a,
-  0x69, 0x6e, 0x74, 0x20, 0x69, 0x73, 0x53, 0x75, 0x66, 0x66, 0x69, 0x78,
+  0x20, 0x74, 0x68, 0x65, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x6e,
+  0x64, 0x65, 0x78, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x68,
+  0x6f, 0x73, 0x74, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x63, 0x68, 0x61, 0x72,
+  0x61, 0x63, 0x74, 0x65, 0x72, 0x20, 0x64, 0x69, 0x72, 0x65, 0x63, 0x74,
+  0x6c, 0x79, 0x20, 0x61, 0x66, 0x74, 0x65, 0x72, 0x20, 0x74, 0x68, 0x69,
+  0x73, 0x20, 0x70, 0x72, 0x65, 0x66, 0x69, 0x78, 0x20, 0x69, 0x73, 0x20,
+  0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x65, 0x64, 0x2c, 0x20, 0x73, 0x6f,
+  0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x74, 0x68, 0x65, 0x20, 0x63, 0x61,
+  0x6c, 0x6c, 0x65, 0x72, 0x20, 0x6b, 0x6e, 0x6f, 0x77, 0x73, 0x0a, 0x20,
+  0x2a, 0x20, 0x77, 0x68, 0x65, 0x72, 0x65, 0x20, 0x69, 0x6e, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x20, 0x73, 0x74, 0x72, 0x69,
+  0x6e, 0x67, 0x20, 0x74, 0x6f, 0x20, 0x72, 0x65, 0x73, 0x75, 0x6d, 0x65,
+  0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x69, 0x6e, 0x67, 0x2e, 0x20, 0x0a,
+  0x20, 0x2a, 0x20, 0x46, 0x6f, 0x72, 0x20, 0x65, 0x78, 0x61, 0x6d, 0x70,
+  0x6c, 0x65, 0x2c, 0x20, 0x69, 0x73, 0x50, 0x72, 0x65, 0x66, 0x69, 0x78,
+  0x28, 0x22, 0x61, 0x62, 0x22, 0x2c, 0x20, 0x22, 0x61, 0x62, 0x63, 0x64,
+  0x22, 0x29, 0x20, 0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x73, 0x20, 0x32,
+  0x2c, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20,
+  0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x66, 0x69, 0x72, 0x73, 0x74,
+  0x20, 0x0a, 0x20, 0x2a, 0x20, 0x63, 0x68, 0x61, 0x72, 0x61, 0x63, 0x74,
+  0x65, 0x72, 0x20, 0x28, 0x27, 0x63, 0x27, 0x29, 0x20, 0x61, 0x66, 0x74,
+  0x65, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68,
+  0x65, 0x64, 0x20, 0x73, 0x75, 0x62, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67,
+  0x20, 0x28, 0x22, 0x61, 0x62, 0x22, 0x29, 0x2e, 0x0a, 0x20, 0x2a, 0x20,
+  0x52, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x73, 0x20, 0x2d, 0x31, 0x20, 0x69,
+  0x66, 0x20, 0x69, 0x74, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x75, 0x6c,
+  0x65, 0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x20, 0x69, 0x73, 0x20,
+  0x6e, 0x6f, 0x74, 0x20, 0x61, 0x20, 0x70, 0x72, 0x65, 0x66, 0x69, 0x78,
+  0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x68, 0x6f, 0x73, 0x74,
+  0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x2e, 0x20, 0x2a, 0x2f, 0x0a,
+  0x69, 0x6e, 0x74, 0x20, 0x69, 0x73, 0x50, 0x72, 0x65, 0x66, 0x69, 0x78,
   0x28, 0x63, 0x6f, 0x6e, 0x73, 0x74, 0x20, 0x73, 0x74, 0x72, 0x69, 0x6e,
   0x67, 0x20, 0x72, 0x75, 0x6c, 0x65, 0x5f, 0x73, 0x74, 0x72, 0x69, 0x6e,
   0x67, 0x2c, 0x20, 0x63, 0x6f, 0x6e, 0x73, 0x74, 0x20, 0x73, 0x74, 0x72,
   0x69, 0x6e, 0x67, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x5f, 0x73, 0x74, 0x72,
-  0x69, 0x6e, 0x67, 0x29, 0x3b, 0x0a, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20,
-  0x70, 0x72, 0x69, 0x6e, 0x74, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73,
+  0x69, 0x6e, 0x67, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x41, 0x6e,
+  0x61, 0x6c, 0x6f, 0x67, 0x6f, 0x75, 0x73, 0x20, 0x74, 0x6f, 0x20, 0x69,
+  0x73, 0x50, 0x72, 0x65, 0x66, 0x69, 0x78, 0x2e, 0x20, 0x45, 0x78, 0x61,
+  0x6d, 0x70, 0x6c, 0x65, 0x3a, 0x20, 0x69, 0x73, 0x53, 0x75, 0x66, 0x66,
+  0x69, 0x78, 0x28, 0x22, 0x63, 0x64, 0x22, 0x2c, 0x20, 0x22, 0x61, 0x62,
+  0x63, 0x64, 0x22, 0x29, 0x20, 0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x73,
+  0x20, 0x31, 0x2c, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x6e, 0x64, 0x65,
+  0x78, 0x0a, 0x20, 0x2a, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x63, 0x68, 0x61, 0x72, 0x61, 0x63, 0x74, 0x65, 0x72, 0x20, 0x28, 0x27,
+  0x62, 0x27, 0x29, 0x20, 0x64, 0x69, 0x72, 0x65, 0x63, 0x74, 0x6c, 0x79,
+  0x20, 0x70, 0x72, 0x65, 0x63, 0x65, 0x64, 0x69, 0x6e, 0x67, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x64, 0x20, 0x73,
+  0x75, 0x66, 0x66, 0x69, 0x78, 0x20, 0x28, 0x22, 0x63, 0x64, 0x22, 0x29,
+  0x2e, 0x20, 0x0a, 0x20, 0x2a, 0x20, 0x54, 0x68, 0x65, 0x20, 0x65, 0x78,
+  0x63, 0x65, 0x70, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x69, 0x73, 0x20, 0x69,
+  0x66, 0x20, 0x72, 0x75, 0x6c, 0x65, 0x5f, 0x73, 0x74, 0x72, 0x69, 0x6e,
+  0x67, 0x20, 0x65, 0x71, 0x75, 0x61, 0x6c, 0x73, 0x20, 0x68, 0x6f, 0x73,
+  0x74, 0x5f, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x2c, 0x20, 0x69, 0x6e,
+  0x20, 0x77, 0x68, 0x69, 0x63, 0x68, 0x20, 0x63, 0x61, 0x73, 0x65, 0x20,
+  0x30, 0x20, 0x69, 0x73, 0x0a, 0x20, 0x2a, 0x20, 0x72, 0x65, 0x74, 0x75,
+  0x72, 0x6e, 0x65, 0x64, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x69, 0x6e, 0x74,
+  0x20, 0x69, 0x73, 0x53, 0x75, 0x66, 0x66, 0x69, 0x78, 0x28, 0x63, 0x6f,
+  0x6e, 0x73, 0x74, 0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x20, 0x72,
+  0x75, 0x6c, 0x65, 0x5f, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x2c, 0x20,
+  0x63, 0x6f, 0x6e, 0x73, 0x74, 0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67,
+  0x20, 0x68, 0x6f, 0x73, 0x74, 0x5f, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67,
+  0x29, 0x3b, 0x0a, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x70, 0x72, 0x69,
+  0x6e, 0x74, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x28, 0x4d,
+  0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72,
+  0x70, 0x68, 0x69, 0x73, 0x6d, 0x29, 0x3b, 0x0a, 0x76, 0x6f, 0x69, 0x64,
+  0x20, 0x66, 0x72, 0x65, 0x65, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73,
   0x6d, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a,
-  0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x29, 0x3b, 0x0a, 0x76,
-  0x6f, 0x69, 0x64, 0x20, 0x66, 0x72, 0x65, 0x65, 0x4d, 0x6f, 0x72, 0x70,
-  0x68, 0x69, 0x73, 0x6d, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73,
-  0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x29,
-  0x3b, 0x0a, 0x20, 0x0a, 0x23, 0x65, 0x6e, 0x64, 0x69, 0x66, 0x20, 0x2f,
-  0x2a, 0x20, 0x49, 0x4e, 0x43, 0x5f, 0x4d, 0x41, 0x54, 0x43, 0x48, 0x5f,
-  0x48, 0x20, 0x2a, 0x2f, 0x0a, 0x00
+  0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x29, 0x3b, 0x0a, 0x20,
+  0x0a, 0x23, 0x65, 0x6e, 0x64, 0x69, 0x66, 0x20, 0x2f, 0x2a, 0x20, 0x49,
+  0x4e, 0x43, 0x5f, 0x4d, 0x41, 0x54, 0x43, 0x48, 0x5f, 0x48, 0x20, 0x2a,
+  0x2f, 0x0a, 0x00
+};
+unsigned int morphism_h_len = 6050;
+unsigned char parallel_h[] = {
+  0x2f, 0x2a, 0x20, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x0a, 0x0a, 0x20, 0x20, 0x3d, 0x3d,
+  0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d,
+  0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x0a, 0x20, 0x20, 0x50,
+  0x61, 0x72, 0x61, 0x6c, 0x6c, 0x65, 0x6c, 0x20, 0x53, 0x65, 0x61, 0x72,
+  0x63, 0x68, 0x20, 0x4d, 0x6f, 0x64, 0x75, 0x6c, 0x65, 0x0a, 0x20, 0x20,
+  0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d,
+  0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x3d, 0x0a, 0x0a,
+  0x20, 0x20, 0x53, 0x65, 0x61, 0x72, 0x63, 0x68, 0x65, 0x73, 0x20, 0x66,
+  0x6f, 0x72, 0x20, 0x61, 0x20, 0x72, 0x75, 0x6c, 0x65, 0x20, 0x6d, 0x61,
+  0x74, 0x63, 0x68, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x61, 0x20, 0x70,
+  0x6f, 0x6f, 0x6c, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x72, 0x65, 0x61,
+  0x64, 0x73, 0x2e, 0x20, 0x55, 0x73, 0x65, 0x64, 0x20, 0x62, 0x79, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x69, 0x6e, 0x67,
+  0x20, 0x63, 0x6f, 0x64, 0x65, 0x0a, 0x20, 0x20, 0x6f, 0x66, 0x20, 0x72,
+  0x75, 0x6c, 0x65, 0x73, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x69, 0x6c, 0x65,
+  0x64, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x74, 0x68, 0x65, 0x20, 0x2d,
+  0x74, 0x20, 0x6f, 0x70, 0x74, 0x69, 0x6f, 0x6e, 0x2e, 0x20, 0x54, 0x68,
+  0x65, 0x20, 0x63, 0x61, 0x6e, 0x64, 0x69, 0x64, 0x61, 0x74, 0x65, 0x20,
+  0x68, 0x6f, 0x73, 0x74, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x20, 0x66,
+  0x6f, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x66, 0x69, 0x72, 0x73, 0x74,
+  0x0a, 0x20, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x73, 0x65, 0x61, 0x72, 0x63, 0x68, 0x70, 0x6c, 0x61,
+  0x6e, 0x20, 0x61, 0x72, 0x65, 0x20, 0x73, 0x70, 0x6c, 0x69, 0x74, 0x20,
+  0x61, 0x6d, 0x6f, 0x6e, 0x67, 0x20, 0x74, 0x68, 0x65, 0x20, 0x74, 0x68,
+  0x72, 0x65, 0x61, 0x64, 0x73, 0x2c, 0x20, 0x65, 0x61, 0x63, 0x68, 0x20,
+  0x6f, 0x66, 0x20, 0x77, 0x68, 0x69, 0x63, 0x68, 0x20, 0x63, 0x6f, 0x6d,
+  0x70, 0x6c, 0x65, 0x74, 0x65, 0x73, 0x0a, 0x20, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20,
+  0x69, 0x74, 0x73, 0x20, 0x63, 0x61, 0x6e, 0x64, 0x69, 0x64, 0x61, 0x74,
+  0x65, 0x73, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x69, 0x74, 0x73, 0x20,
+  0x6f, 0x77, 0x6e, 0x20, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d,
+  0x2e, 0x0a, 0x0a, 0x20, 0x20, 0x54, 0x68, 0x65, 0x20, 0x67, 0x65, 0x6e,
+  0x65, 0x72, 0x61, 0x74, 0x65, 0x64, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68,
+  0x69, 0x6e, 0x67, 0x20, 0x63, 0x6f, 0x64, 0x65, 0x20, 0x72, 0x75, 0x6e,
+  0x20, 0x62, 0x79, 0x20, 0x74, 0x68, 0x65, 0x20, 0x74, 0x68, 0x72, 0x65,
+  0x61, 0x64, 0x73, 0x20, 0x64, 0x6f, 0x65, 0x73, 0x20, 0x6e, 0x6f, 0x74,
+  0x20, 0x77, 0x72, 0x69, 0x74, 0x65, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x0a, 0x20, 0x20, 0x67, 0x72, 0x61,
+  0x70, 0x68, 0x20, 0x6f, 0x72, 0x20, 0x74, 0x6f, 0x20, 0x61, 0x6e, 0x79,
+  0x20, 0x6f, 0x74, 0x68, 0x65, 0x72, 0x20, 0x73, 0x68, 0x61, 0x72, 0x65,
+  0x64, 0x20, 0x64, 0x61, 0x74, 0x61, 0x2e, 0x20, 0x49, 0x6e, 0x20, 0x70,
+  0x61, 0x72, 0x74, 0x69, 0x63, 0x75, 0x6c, 0x61, 0x72, 0x2c, 0x20, 0x69,
+  0x74, 0x20, 0x74, 0x65, 0x73, 0x74, 0x73, 0x20, 0x69, 0x6e, 0x6a, 0x65,
+  0x63, 0x74, 0x69, 0x76, 0x69, 0x74, 0x79, 0x20, 0x77, 0x69, 0x74, 0x68,
+  0x0a, 0x20, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x49, 0x6e, 0x4d, 0x6f, 0x72,
+  0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x65, 0x64,
+  0x67, 0x65, 0x49, 0x6e, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d,
+  0x20, 0x69, 0x6e, 0x73, 0x74, 0x65, 0x61, 0x64, 0x20, 0x6f, 0x66, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x64, 0x20,
+  0x66, 0x6c, 0x61, 0x67, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x68, 0x6f, 0x73, 0x74, 0x0a, 0x20, 0x20, 0x67, 0x72, 0x61, 0x70,
+  0x68, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x70, 0x72, 0x6f, 0x67, 0x72,
+  0x61, 0x6d, 0x20, 0x6d, 0x75, 0x73, 0x74, 0x20, 0x62, 0x65, 0x20, 0x6c,
+  0x69, 0x6e, 0x6b, 0x65, 0x64, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x2d,
+  0x70, 0x74, 0x68, 0x72, 0x65, 0x61, 0x64, 0x2e, 0x0a, 0x0a, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f, 0x2f,
+  0x2f, 0x20, 0x2a, 0x2f, 0x0a, 0x0a, 0x23, 0x69, 0x66, 0x6e, 0x64, 0x65,
+  0x66, 0x20, 0x49, 0x4e, 0x43, 0x5f, 0x50, 0x41, 0x52, 0x41, 0x4c, 0x4c,
+  0x45, 0x4c, 0x5f, 0x48, 0x0a, 0x23, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65,
+  0x20, 0x49, 0x4e, 0x43, 0x5f, 0x50, 0x41, 0x52, 0x41, 0x4c, 0x4c, 0x45,
+  0x4c, 0x5f, 0x48, 0x0a, 0x0a, 0x23, 0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64,
+  0x65, 0x20, 0x22, 0x67, 0x6c, 0x6f, 0x62, 0x61, 0x6c, 0x73, 0x2e, 0x68,
+  0x22, 0x0a, 0x23, 0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64, 0x65, 0x20, 0x22,
+  0x67, 0x72, 0x61, 0x70, 0x68, 0x2e, 0x68, 0x22, 0x0a, 0x23, 0x69, 0x6e,
+  0x63, 0x6c, 0x75, 0x64, 0x65, 0x20, 0x22, 0x6d, 0x6f, 0x72, 0x70, 0x68,
+  0x69, 0x73, 0x6d, 0x2e, 0x68, 0x22, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x42,
+  0x65, 0x6c, 0x6f, 0x77, 0x20, 0x74, 0x68, 0x69, 0x73, 0x20, 0x6e, 0x75,
+  0x6d, 0x62, 0x65, 0x72, 0x20, 0x6f, 0x66, 0x20, 0x63, 0x61, 0x6e, 0x64,
+  0x69, 0x64, 0x61, 0x74, 0x65, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x20, 0x6e,
+  0x6f, 0x64, 0x65, 0x73, 0x2c, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x65,
+  0x6e, 0x65, 0x72, 0x61, 0x74, 0x65, 0x64, 0x20, 0x63, 0x6f, 0x64, 0x65,
+  0x20, 0x73, 0x65, 0x61, 0x72, 0x63, 0x68, 0x65, 0x73, 0x0a, 0x20, 0x2a,
+  0x20, 0x73, 0x65, 0x72, 0x69, 0x61, 0x6c, 0x6c, 0x79, 0x2c, 0x20, 0x61,
+  0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x74, 0x68, 0x72, 0x65, 0x61, 0x64,
+  0x73, 0x20, 0x63, 0x6f, 0x73, 0x74, 0x20, 0x6d, 0x6f, 0x72, 0x65, 0x20,
+  0x74, 0x6f, 0x20, 0x77, 0x61, 0x6b, 0x65, 0x20, 0x74, 0x68, 0x61, 0x6e,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x65, 0x61, 0x72, 0x63, 0x68, 0x20,
+  0x69, 0x74, 0x73, 0x65, 0x6c, 0x66, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x23,
+  0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x20, 0x50, 0x41, 0x52, 0x41, 0x4c,
+  0x4c, 0x45, 0x4c, 0x5f, 0x4d, 0x49, 0x4e, 0x5f, 0x43, 0x41, 0x4e, 0x44,
+  0x49, 0x44, 0x41, 0x54, 0x45, 0x53, 0x20, 0x32, 0x35, 0x36, 0x0a, 0x0a,
+  0x2f, 0x2a, 0x20, 0x41, 0x20, 0x67, 0x65, 0x6e, 0x65, 0x72, 0x61, 0x74,
+  0x65, 0x64, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20,
+  0x74, 0x68, 0x61, 0x74, 0x20, 0x74, 0x72, 0x69, 0x65, 0x73, 0x20, 0x74,
+  0x6f, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x6c, 0x65, 0x74, 0x65, 0x20, 0x61,
+  0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x72, 0x75, 0x6c, 0x65, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20,
+  0x74, 0x68, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x66, 0x69, 0x72, 0x73, 0x74,
+  0x20, 0x6e, 0x6f, 0x64, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x73, 0x65, 0x61, 0x72, 0x63, 0x68, 0x70, 0x6c, 0x61, 0x6e, 0x20,
+  0x6d, 0x61, 0x70, 0x70, 0x65, 0x64, 0x20, 0x74, 0x6f, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x67, 0x69, 0x76, 0x65, 0x6e, 0x20, 0x68, 0x6f, 0x73, 0x74,
+  0x20, 0x6e, 0x6f, 0x64, 0x65, 0x2e, 0x20, 0x49, 0x74, 0x20, 0x6c, 0x65,
+  0x61, 0x76, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65, 0x0a, 0x20, 0x2a, 0x20,
+  0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x65, 0x6d, 0x70,
+  0x74, 0x79, 0x20, 0x69, 0x66, 0x20, 0x69, 0x74, 0x20, 0x66, 0x61, 0x69,
+  0x6c, 0x73, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x74, 0x79, 0x70, 0x65, 0x64,
+  0x65, 0x66, 0x20, 0x62, 0x6f, 0x6f, 0x6c, 0x20, 0x28, 0x2a, 0x43, 0x61,
+  0x6e, 0x64, 0x69, 0x64, 0x61, 0x74, 0x65, 0x4d, 0x61, 0x74, 0x63, 0x68,
+  0x65, 0x72, 0x29, 0x28, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d,
+  0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c, 0x20,
+  0x69, 0x6e, 0x74, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x5f, 0x69, 0x6e, 0x64,
+  0x65, 0x78, 0x29, 0x3b, 0x0a, 0x0a, 0x2f, 0x2a, 0x20, 0x4d, 0x61, 0x74,
+  0x63, 0x68, 0x65, 0x73, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73,
+  0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x69, 0x67, 0x6e,
+  0x61, 0x74, 0x75, 0x72, 0x65, 0x20, 0x62, 0x75, 0x63, 0x6b, 0x65, 0x74,
+  0x73, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x67, 0x72, 0x61,
+  0x70, 0x68, 0x20, 0x67, 0x69, 0x76, 0x65, 0x6e, 0x20, 0x62, 0x79, 0x0a,
+  0x20, 0x2a, 0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x69, 0x67, 0x6e, 0x61,
+  0x74, 0x75, 0x72, 0x65, 0x73, 0x20, 0x61, 0x72, 0x72, 0x61, 0x79, 0x20,
+  0x61, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x63, 0x61, 0x6e, 0x64, 0x69,
+  0x64, 0x61, 0x74, 0x65, 0x73, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20, 0x74,
+  0x68, 0x72, 0x65, 0x61, 0x64, 0x73, 0x20, 0x74, 0x61, 0x6b, 0x65, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x63, 0x61, 0x6e, 0x64, 0x69, 0x64, 0x61, 0x74,
+  0x65, 0x73, 0x20, 0x69, 0x6e, 0x0a, 0x20, 0x2a, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x6f, 0x72, 0x64, 0x65, 0x72, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x20,
+  0x73, 0x65, 0x72, 0x69, 0x61, 0x6c, 0x20, 0x73, 0x63, 0x61, 0x6e, 0x20,
+  0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x62, 0x75, 0x63, 0x6b, 0x65,
+  0x74, 0x73, 0x2c, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x6d, 0x61, 0x74, 0x63, 0x68, 0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x65, 0x61, 0x72, 0x6c, 0x69, 0x65, 0x73, 0x74, 0x0a,
+  0x20, 0x2a, 0x20, 0x63, 0x61, 0x6e, 0x64, 0x69, 0x64, 0x61, 0x74, 0x65,
+  0x20, 0x69, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6f, 0x6e, 0x65, 0x20,
+  0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x65, 0x64, 0x2c, 0x20, 0x73, 0x6f,
+  0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x65,
+  0x73, 0x75, 0x6c, 0x74, 0x20, 0x64, 0x6f, 0x65, 0x73, 0x20, 0x6e, 0x6f,
+  0x74, 0x20, 0x64, 0x65, 0x70, 0x65, 0x6e, 0x64, 0x20, 0x6f, 0x6e, 0x20,
+  0x74, 0x68, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x73, 0x63, 0x68, 0x65, 0x64,
+  0x75, 0x6c, 0x69, 0x6e, 0x67, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x74, 0x68, 0x72, 0x65, 0x61, 0x64, 0x73, 0x2e, 0x0a, 0x20, 0x2a,
+  0x0a, 0x20, 0x2a, 0x20, 0x49, 0x66, 0x20, 0x61, 0x20, 0x6d, 0x61, 0x74,
+  0x63, 0x68, 0x20, 0x69, 0x73, 0x20, 0x66, 0x6f, 0x75, 0x6e, 0x64, 0x2c,
+  0x20, 0x69, 0x74, 0x20, 0x69, 0x73, 0x20, 0x6d, 0x6f, 0x76, 0x65, 0x64,
+  0x20, 0x69, 0x6e, 0x74, 0x6f, 0x20, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69,
+  0x73, 0x6d, 0x2c, 0x20, 0x77, 0x68, 0x69, 0x63, 0x68, 0x20, 0x6d, 0x75,
+  0x73, 0x74, 0x20, 0x62, 0x65, 0x20, 0x65, 0x6d, 0x70, 0x74, 0x79, 0x2c,
+  0x20, 0x61, 0x6e, 0x64, 0x0a, 0x20, 0x2a, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x6d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x64, 0x20, 0x66, 0x6c, 0x61, 0x67,
+  0x73, 0x20, 0x6f, 0x66, 0x20, 0x69, 0x74, 0x73, 0x20, 0x68, 0x6f, 0x73,
+  0x74, 0x20, 0x69, 0x74, 0x65, 0x6d, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20,
+  0x73, 0x65, 0x74, 0x20, 0x61, 0x73, 0x20, 0x69, 0x6e, 0x20, 0x73, 0x65,
+  0x72, 0x69, 0x61, 0x6c, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x69, 0x6e,
+  0x67, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x74, 0x68,
+  0x72, 0x65, 0x61, 0x64, 0x20, 0x70, 0x6f, 0x6f, 0x6c, 0x20, 0x69, 0x73,
+  0x20, 0x73, 0x74, 0x61, 0x72, 0x74, 0x65, 0x64, 0x20, 0x77, 0x69, 0x74,
+  0x68, 0x20, 0x74, 0x68, 0x72, 0x65, 0x61, 0x64, 0x73, 0x20, 0x2d, 0x20,
+  0x31, 0x20, 0x74, 0x68, 0x72, 0x65, 0x61, 0x64, 0x73, 0x20, 0x6f, 0x6e,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x66, 0x69, 0x72, 0x73, 0x74, 0x20, 0x63,
+  0x61, 0x6c, 0x6c, 0x3b, 0x20, 0x74, 0x68, 0x65, 0x0a, 0x20, 0x2a, 0x20,
+  0x63, 0x61, 0x6c, 0x6c, 0x69, 0x6e, 0x67, 0x20, 0x74, 0x68, 0x72, 0x65,
+  0x61, 0x64, 0x20, 0x74, 0x61, 0x6b, 0x65, 0x73, 0x20, 0x70, 0x61, 0x72,
+  0x74, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x65, 0x61,
+  0x72, 0x63, 0x68, 0x2e, 0x20, 0x2a, 0x2f, 0x0a, 0x62, 0x6f, 0x6f, 0x6c,
+  0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x49, 0x6e, 0x50, 0x61, 0x72, 0x61,
+  0x6c, 0x6c, 0x65, 0x6c, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a,
+  0x67, 0x72, 0x61, 0x70, 0x68, 0x2c, 0x20, 0x4d, 0x6f, 0x72, 0x70, 0x68,
+  0x69, 0x73, 0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73,
+  0x6d, 0x2c, 0x20, 0x63, 0x6f, 0x6e, 0x73, 0x74, 0x20, 0x69, 0x6e, 0x74,
+  0x20, 0x2a, 0x73, 0x69, 0x67, 0x6e, 0x61, 0x74, 0x75, 0x72, 0x65, 0x73,
+  0x2c, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x69,
+  0x6e, 0x74, 0x20, 0x73, 0x69, 0x67, 0x6e, 0x61, 0x74, 0x75, 0x72, 0x65,
+  0x5f, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x2c, 0x20, 0x43, 0x61, 0x6e, 0x64,
+  0x69, 0x64, 0x61, 0x74, 0x65, 0x4d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x72,
+  0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x72, 0x2c, 0x20, 0x69, 0x6e,
+  0x74, 0x20, 0x74, 0x68, 0x72, 0x65, 0x61, 0x64, 0x73, 0x29, 0x3b, 0x0a,
+  0x0a, 0x2f, 0x2a, 0x20, 0x55, 0x73, 0x65, 0x64, 0x20, 0x74, 0x6f, 0x20,
+  0x61, 0x70, 0x70, 0x6c, 0x79, 0x20, 0x61, 0x20, 0x72, 0x75, 0x6c, 0x65,
+  0x20, 0x61, 0x73, 0x20, 0x6c, 0x6f, 0x6e, 0x67, 0x20, 0x61, 0x73, 0x20,
+  0x70, 0x6f, 0x73, 0x73, 0x69, 0x62, 0x6c, 0x65, 0x20, 0x69, 0x6e, 0x20,
+  0x62, 0x61, 0x74, 0x63, 0x68, 0x65, 0x73, 0x2e, 0x20, 0x53, 0x65, 0x61,
+  0x72, 0x63, 0x68, 0x65, 0x73, 0x20, 0x65, 0x76, 0x65, 0x72, 0x79, 0x0a,
+  0x20, 0x2a, 0x20, 0x63, 0x61, 0x6e, 0x64, 0x69, 0x64, 0x61, 0x74, 0x65,
+  0x2c, 0x20, 0x61, 0x73, 0x20, 0x69, 0x6e, 0x20, 0x6d, 0x61, 0x74, 0x63,
+  0x68, 0x49, 0x6e, 0x50, 0x61, 0x72, 0x61, 0x6c, 0x6c, 0x65, 0x6c, 0x2c,
+  0x20, 0x66, 0x6f, 0x72, 0x20, 0x69, 0x74, 0x73, 0x20, 0x66, 0x69, 0x72,
+  0x73, 0x74, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x2c, 0x20, 0x61, 0x6e,
+  0x64, 0x20, 0x73, 0x65, 0x6c, 0x65, 0x63, 0x74, 0x73, 0x20, 0x66, 0x72,
+  0x6f, 0x6d, 0x0a, 0x20, 0x2a, 0x20, 0x74, 0x68, 0x65, 0x73, 0x65, 0x2c,
+  0x20, 0x69, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6f, 0x72, 0x64, 0x65,
+  0x72, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x69, 0x72, 0x20, 0x63,
+  0x61, 0x6e, 0x64, 0x69, 0x64, 0x61, 0x74, 0x65, 0x73, 0x2c, 0x20, 0x61,
+  0x20, 0x73, 0x65, 0x74, 0x20, 0x6f, 0x66, 0x20, 0x6d, 0x61, 0x74, 0x63,
+  0x68, 0x65, 0x73, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x70, 0x61, 0x69,
+  0x72, 0x77, 0x69, 0x73, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x73, 0x68, 0x61,
+  0x72, 0x65, 0x20, 0x6e, 0x6f, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x20, 0x6e,
+  0x6f, 0x64, 0x65, 0x2e, 0x20, 0x52, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x73,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x6e, 0x75, 0x6d, 0x62, 0x65, 0x72, 0x20,
+  0x6f, 0x66, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x73, 0x20, 0x73,
+  0x65, 0x6c, 0x65, 0x63, 0x74, 0x65, 0x64, 0x2e, 0x20, 0x54, 0x68, 0x65,
+  0x20, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x69, 0x73,
+  0x0a, 0x20, 0x2a, 0x20, 0x75, 0x73, 0x65, 0x64, 0x20, 0x6f, 0x6e, 0x6c,
+  0x79, 0x20, 0x66, 0x6f, 0x72, 0x20, 0x69, 0x74, 0x73, 0x20, 0x64, 0x69,
+  0x6d, 0x65, 0x6e, 0x73, 0x69, 0x6f, 0x6e, 0x73, 0x3b, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x68, 0x6f, 0x73, 0x74, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68,
+  0x20, 0x69, 0x73, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x63, 0x68, 0x61, 0x6e,
+  0x67, 0x65, 0x64, 0x2e, 0x0a, 0x20, 0x2a, 0x0a, 0x20, 0x2a, 0x20, 0x4d,
+  0x61, 0x74, 0x63, 0x68, 0x65, 0x73, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20,
+  0x64, 0x69, 0x73, 0x6a, 0x6f, 0x69, 0x6e, 0x74, 0x20, 0x6e, 0x6f, 0x64,
+  0x65, 0x20, 0x73, 0x65, 0x74, 0x73, 0x20, 0x61, 0x72, 0x65, 0x20, 0x70,
+  0x61, 0x72, 0x61, 0x6c, 0x6c, 0x65, 0x6c, 0x20, 0x69, 0x6e, 0x64, 0x65,
+  0x70, 0x65, 0x6e, 0x64, 0x65, 0x6e, 0x74, 0x3a, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x61, 0x70, 0x70, 0x6c, 0x69, 0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e,
+  0x0a, 0x20, 0x2a, 0x20, 0x6f, 0x66, 0x20, 0x6f, 0x6e, 0x65, 0x20, 0x6f,
+  0x6e, 0x6c, 0x79, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x73, 0x20,
+  0x65, 0x64, 0x67, 0x65, 0x73, 0x20, 0x69, 0x6e, 0x63, 0x69, 0x64, 0x65,
+  0x6e, 0x74, 0x20, 0x74, 0x6f, 0x20, 0x69, 0x74, 0x73, 0x20, 0x6f, 0x77,
+  0x6e, 0x20, 0x6e, 0x6f, 0x64, 0x65, 0x73, 0x2c, 0x20, 0x73, 0x6f, 0x20,
+  0x69, 0x74, 0x20, 0x6e, 0x65, 0x69, 0x74, 0x68, 0x65, 0x72, 0x20, 0x72,
+  0x65, 0x6d, 0x6f, 0x76, 0x65, 0x73, 0x0a, 0x20, 0x2a, 0x20, 0x6e, 0x6f,
+  0x72, 0x20, 0x69, 0x6e, 0x76, 0x61, 0x6c, 0x69, 0x64, 0x61, 0x74, 0x65,
+  0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6f, 0x74, 0x68, 0x65, 0x72, 0x73,
+  0x2e, 0x20, 0x41, 0x70, 0x70, 0x6c, 0x79, 0x69, 0x6e, 0x67, 0x20, 0x74,
+  0x68, 0x65, 0x6d, 0x20, 0x69, 0x6e, 0x20, 0x74, 0x75, 0x72, 0x6e, 0x20,
+  0x74, 0x68, 0x65, 0x72, 0x65, 0x66, 0x6f, 0x72, 0x65, 0x20, 0x67, 0x69,
+  0x76, 0x65, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x61, 0x6d, 0x65,
+  0x0a, 0x20, 0x2a, 0x20, 0x72, 0x65, 0x73, 0x75, 0x6c, 0x74, 0x20, 0x61,
+  0x73, 0x20, 0x61, 0x20, 0x73, 0x65, 0x72, 0x69, 0x61, 0x6c, 0x20, 0x6c,
+  0x6f, 0x6f, 0x70, 0x20, 0x74, 0x68, 0x61, 0x74, 0x20, 0x68, 0x61, 0x70,
+  0x70, 0x65, 0x6e, 0x73, 0x20, 0x74, 0x6f, 0x20, 0x63, 0x68, 0x6f, 0x6f,
+  0x73, 0x65, 0x20, 0x74, 0x68, 0x65, 0x6d, 0x20, 0x69, 0x6e, 0x20, 0x74,
+  0x68, 0x61, 0x74, 0x20, 0x6f, 0x72, 0x64, 0x65, 0x72, 0x2e, 0x20, 0x2a,
+  0x2f, 0x0a, 0x69, 0x6e, 0x74, 0x20, 0x66, 0x69, 0x6e, 0x64, 0x44, 0x69,
+  0x73, 0x6a, 0x6f, 0x69, 0x6e, 0x74, 0x4d, 0x61, 0x74, 0x63, 0x68, 0x65,
+  0x73, 0x28, 0x47, 0x72, 0x61, 0x70, 0x68, 0x20, 0x2a, 0x67, 0x72, 0x61,
+  0x70, 0x68, 0x2c, 0x20, 0x4d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d,
+  0x20, 0x2a, 0x6d, 0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x2c, 0x20,
+  0x63, 0x6f, 0x6e, 0x73, 0x74, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x2a, 0x73,
+  0x69, 0x67, 0x6e, 0x61, 0x74, 0x75, 0x72, 0x65, 0x73, 0x2c, 0x0a, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x69,
+  0x6e, 0x74, 0x20, 0x73, 0x69, 0x67, 0x6e, 0x61, 0x74, 0x75, 0x72, 0x65,
+  0x5f, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x2c, 0x20, 0x43, 0x61, 0x6e, 0x64,
+  0x69, 0x64, 0x61, 0x74, 0x65, 0x4d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x72,
+  0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x72, 0x2c, 0x20, 0x69, 0x6e,
+  0x74, 0x20, 0x74, 0x68, 0x72, 0x65, 0x61, 0x64, 0x73, 0x29, 0x3b, 0x0a,
+  0x0a, 0x2f, 0x2a, 0x20, 0x46, 0x69, 0x6c, 0x6c, 0x73, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x65, 0x6d, 0x70, 0x74, 0x79, 0x20, 0x6d, 0x6f, 0x72, 0x70,
+  0x68, 0x69, 0x73, 0x6d, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x20, 0x61, 0x74, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x67, 0x69, 0x76, 0x65, 0x6e, 0x20, 0x69, 0x6e, 0x64,
+  0x65, 0x78, 0x2c, 0x20, 0x77, 0x68, 0x69, 0x63, 0x68, 0x20, 0x6d, 0x75,
+  0x73, 0x74, 0x20, 0x62, 0x65, 0x0a, 0x20, 0x2a, 0x20, 0x6c, 0x65, 0x73,
+  0x73, 0x20, 0x74, 0x68, 0x61, 0x6e, 0x20, 0x74, 0x68, 0x65, 0x20, 0x76,
+  0x61, 0x6c, 0x75, 0x65, 0x20, 0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x65,
+  0x64, 0x20, 0x62, 0x79, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6c, 0x61, 0x73,
+  0x74, 0x20, 0x63, 0x61, 0x6c, 0x6c, 0x20, 0x74, 0x6f, 0x20, 0x66, 0x69,
+  0x6e, 0x64, 0x44, 0x69, 0x73, 0x6a, 0x6f, 0x69, 0x6e, 0x74, 0x4d, 0x61,
+  0x74, 0x63, 0x68, 0x65, 0x73, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x0a, 0x20,
+  0x2a, 0x20, 0x6d, 0x61, 0x74, 0x63, 0x68, 0x65, 0x64, 0x20, 0x66, 0x6c,
+  0x61, 0x67, 0x73, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x68,
+  0x6f, 0x73, 0x74, 0x20, 0x67, 0x72, 0x61, 0x70, 0x68, 0x20, 0x61, 0x72,
+  0x65, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x73, 0x65, 0x74, 0x2e, 0x20, 0x2a,
+  0x2f, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x67, 0x65, 0x74, 0x44, 0x69,
+  0x73, 0x6a, 0x6f, 0x69, 0x6e, 0x74, 0x4d, 0x61, 0x74, 0x63, 0x68, 0x28,
+  0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x2c, 0x20, 0x4d,
+  0x6f, 0x72, 0x70, 0x68, 0x69, 0x73, 0x6d, 0x20, 0x2a, 0x6d, 0x6f, 0x72,
+  0x70, 0x68, 0x69, 0x73, 0x6d, 0x29, 0x3b, 0x0a, 0x0a, 0x23, 0x65, 0x6e,
+  0x64, 0x69, 0x66, 0x20, 0x2f, 0x2a, 0x20, 0x49, 0x4e, 0x43, 0x5f, 0x50,
+  0x41, 0x52, 0x41, 0x4c, 0x4c, 0x45, 0x4c, 0x5f, 0x48, 0x20, 0x2a, 0x2f,
+  0x0a, 0x00
 };
-unsigned int morphism_h_len = 4734;
+unsigned int parallel_h_len = 3265;
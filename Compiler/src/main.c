@@ -111,12 +111,12 @@ static bool validateHostGraph(string host_file)
  * to disk in the same directory as the generated code. This is achieved by printing a
  * C array of a hex dump (generated by xxd -i). It will suffice until a proper build 
  * system is created. The C arrays are defined in libheaders.h. */
-#define LIB_HEADERS 7
+#define LIB_HEADERS 8
 unsigned char *headers[LIB_HEADERS] = {globals_h, debug_h, graph_h, graphStacks_h,
-                                       hostParser_h, label_h, morphism_h};
+                                       hostParser_h, label_h, morphism_h, parallel_h};
 
 string file_names[LIB_HEADERS] = {"globals.h", "debug.h", "graph.h", "graphStacks.h", 
-                                  "hostParser.h", "label.h", "morphism.h"};
+                                  "hostParser.h", "label.h", "morphism.h", "parallel.h"};
 
 void makeLibHeaders(string output_dir, unsigned char **headers, string *file_names,
                     int header_count)
@@ -166,8 +166,12 @@ void printMakeFile(string output_dir)
    fprintf(makefile, "OBJECTS := $(patsubst %%.c, %%.o, $(wildcard *.c))\n");  
    fprintf(makefile, "CC=gcc\n\n");
 
-   if(debug_flags) fprintf(makefile, "CFLAGS = -g -L$(LIB) -Wall -Wextra -lgp2debug\n\n");
-   else fprintf(makefile, "CFLAGS = -L$(LIB) -fomit-frame-pointer -O2 -Wall -Wextra -lgp2\n\n");
+   /* Rules matched in parallel need the POSIX threads library. */
+   string threads = matching_threads > 1 ? " -pthread" : "";
+   if(debug_flags) fprintf(makefile, "CFLAGS = -g -L$(LIB) -Wall -Wextra -lgp2debug%s\n\n",
+                           threads);
+   else fprintf(makefile, "CFLAGS = -L$(LIB) -fomit-frame-pointer -O2 -Wall -Wextra -lgp2%s\n\n",
+                threads);
 
    fprintf(makefile, "default:\t$(OBJECTS)\n\t\t$(CC) $(OBJECTS) $(CFLAGS) -o GP2-run\n\n");
    fprintf(makefile, "%%.o:\t\t%%.c\n\t\t$(CC) -c $(CFLAGS) -o $@ $<\n\n");
@@ -177,17 +181,20 @@ void printMakeFile(string output_dir)
 
    
 bool graph_copying = false;
+int matching_threads = 1;
 
 int main(int argc, char **argv)
 {
    string const usage = "Usage:\n"
-                        "GP2-compile [-c] [-d] [-o <outdir>] <program_file> <host_file>\n"
+                        "GP2-compile [-c] [-d] [-t <threads>] [-o <outdir>] <program_file> <host_file>\n"
                         "GP2-compile -p <program_file>\n"
                         "GP2-compile -r <rule_file>\n"
                         "GP2-compile -h <host_file>\n\n"
                         "Flags:\n"
                         "-c - Enable graph copying.\n"
                         "-d - Compile program with GCC debugging flags.\n"
+                        "-t - Match rules in parallel with the given number of threads\n"
+                        "     where possible.\n"
                         "-r - Validate a GP 2 rule.\n"
                         "-p - Validate a GP 2 program.\n"
                         "-h - Validate a GP 2 host graph.\n"
@@ -252,6 +259,15 @@ int main(int argc, char **argv)
                  debug_flags = true;
                  break;
 
+            case 't':
+                 argv_index++;
+                 if(argv_index == argc || atoi(argv[argv_index]) < 1)
+                 {
+                    print_to_console("%s", usage);
+                    return 0; 
+                 }
+                 matching_threads = atoi(argv[argv_index]);
+                 break;
             case 'o':
                  argv_index++;
                  if(argv_index == argc)
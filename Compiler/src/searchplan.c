@@ -15,11 +15,6 @@
 
 #include "searchplan.h"
 
-static void traverseNode(Searchplan *searchplan, RuleNode *node, char type, 
-                         bool *tagged_nodes, bool *tagged_edges);
-static void traverseEdge(Searchplan *searchplan, RuleEdge *node, char type, 
-                         bool *tagged_nodes, bool *tagged_edges);
-
 static Searchplan *makeSearchplan(void)
 {
    Searchplan *plan = malloc(sizeof(Searchplan));
@@ -30,6 +25,7 @@ static Searchplan *makeSearchplan(void)
    }   
    plan->first = NULL;
    plan->last = NULL;
+   plan->weight = 0.0;
    return plan;
 }
 
@@ -61,101 +57,461 @@ static void appendSearchOp(Searchplan *plan, char type, int index)
    }
 }  
 
-Searchplan *generateSearchplan(RuleGraph *lhs)
+/* ========================
+ * Host Graph Statistics
+ * ======================== */
+HostStatistics host_statistics;
+
+/* The atoms and mark of the host label being parsed. */
+static int *label_atoms = NULL;
+static int label_length = 0, label_capacity = 0;
+static int label_mark = NONE;
+
+static void recordHostAtom(unsigned int hash)
 {
-   Searchplan *searchplan = makeSearchplan();
-   bool tagged_nodes[lhs->node_index]; 
-   bool tagged_edges[lhs->edge_index];  
+   if(label_length == label_capacity)
+   {
+      label_capacity = label_capacity == 0 ? 8 : 2 * label_capacity;
+      label_atoms = realloc(label_atoms, label_capacity * sizeof(int));
+      if(label_atoms == NULL)
+      {
+         print_to_log("Error (recordHostAtom): malloc failure.\n");
+         exit(1);
+      }
+   }
+   label_atoms[label_length++] = hash % HOST_ATOM_BUCKETS;
+}
+
+static unsigned int hashInteger(int number)
+{
+   return (unsigned int)number * 2654435761u;
+}
+
+static unsigned int hashString(string string)
+{
+   unsigned int hash = 5381;
+   for(; *string != '\0'; string++) hash = hash * 33 + (unsigned char)*string;
+   /* Keep strings and integers with the same hash apart. */
+   return hash ^ 0x55555555u;
+}
+
+void recordHostInteger(int number)
+{
+   recordHostAtom(hashInteger(number));
+}
+
+void recordHostString(string string)
+{
+   recordHostAtom(hashString(string == NULL ? "" : string));
+}
+
+void recordHostMark(int mark)
+{
+   label_mark = mark;
+}
+
+/* Adds the current label to the statistics and starts a new one. */
+static void recordHostLabel(LabelStatistics *labels)
+{
+   labels->items++;
+   labels->lengths[label_length < HOST_LENGTH_CAP ? label_length : HOST_LENGTH_CAP]++;
    int index;
-   for(index = 0; index < lhs->node_index; index++) tagged_nodes[index] = false;
-   for(index = 0; index < lhs->edge_index; index++) tagged_edges[index] = false;
+   for(index = 0; index < label_length; index++) labels->atoms[label_atoms[index]]++;
+   label_length = 0;
+   label_mark = NONE;
+}
 
-   /* Perform a depth-first traversal of the graph from its root nodes. */
-   for(index = 0; index < lhs->node_index; index++)
+static void *resizeArray(void *array, int capacity, size_t item_size)
+{
+   array = realloc(array, capacity * item_size);
+   if(array == NULL)
    {
-      RuleNode *node = getRuleNode(lhs, index);
-      if(node->root && !tagged_nodes[node->index]) 
-         traverseNode(searchplan, node, 'r', tagged_nodes, tagged_edges);
+      print_to_log("Error (recordHostGraph): malloc failure.\n");
+      exit(1);
    }
+   return array;
+}
 
-   /* Search for undiscovered nodes, namely nodes that are not reachable 
-    * from a root node. */
-   for(index = 0; index < lhs->node_index; index++)
+void recordHostNode(int id, bool root)
+{
+   HostStatistics *stats = &host_statistics;
+   if(stats->nodes == stats->node_capacity)
    {
-      if(!tagged_nodes[index]) 
-      {
-         RuleNode *node = getRuleNode(lhs, index);
-         traverseNode(searchplan, node, 'n', tagged_nodes, tagged_edges);
-      }
+      stats->node_capacity = stats->node_capacity == 0 ? 64 : 2 * stats->node_capacity;
+      stats->node_ids = resizeArray(stats->node_ids, stats->node_capacity, sizeof(int));
+      stats->node_roots = resizeArray(stats->node_roots, stats->node_capacity, sizeof(bool));
+      stats->node_marks = resizeArray(stats->node_marks, stats->node_capacity, 
+                                      sizeof(MarkType));
    }
-   return searchplan;
+   stats->node_ids[stats->nodes] = id;
+   stats->node_roots[stats->nodes] = root;
+   stats->node_marks[stats->nodes] = label_mark;
+   stats->nodes++;
+   recordHostLabel(&(stats->node_labels));
+}
+
+void recordHostEdge(int source, int target)
+{
+   HostStatistics *stats = &host_statistics;
+   if(2 * stats->edges == stats->edge_capacity)
+   {
+      stats->edge_capacity = stats->edge_capacity == 0 ? 128 : 2 * stats->edge_capacity;
+      stats->edge_ends = resizeArray(stats->edge_ends, stats->edge_capacity, sizeof(int));
+   }
+   stats->edge_ends[2 * stats->edges] = source;
+   stats->edge_ends[2 * stats->edges + 1] = target;
+   stats->edges++;
+   if(label_mark >= 0 && label_mark < ANY) stats->edge_marks[label_mark]++;
+   if(source == target) stats->loops++;
+   recordHostLabel(&(stats->edge_labels));
+}
+
+static int compareNodeIDs(const void *first, const void *second)
+{
+   int first_id = host_statistics.node_ids[*(const int *)first];
+   int second_id = host_statistics.node_ids[*(const int *)second];
+   return (first_id > second_id) - (first_id < second_id);
+}
+
+/* Returns the position of the node with the given ID in the recorded nodes,
+ * or -1. order lists the positions sorted by node ID. */
+static int findHostNode(int *order, int id)
+{
+   int low = 0, high = host_statistics.nodes - 1;
+   while(low <= high)
+   {
+      int middle = low + (high - low) / 2;
+      int middle_id = host_statistics.node_ids[order[middle]];
+      if(middle_id == id) return order[middle];
+      if(middle_id < id) low = middle + 1;
+      else high = middle - 1;
+   }
+   return -1;
+}
+
+/* Counts the signatures of the recorded host nodes once the whole host graph
+ * has been parsed, and frees the recorded nodes and edges. */
+static void countHostSignatures(void)
+{
+   HostStatistics *stats = &host_statistics;
+   if(stats->counted) return;
+   stats->counted = true;
+   int nodes = stats->nodes, index;
+   int *order = malloc((nodes + 1) * sizeof(int));
+   int *degrees = calloc(3 * nodes + 1, sizeof(int));
+   if(order == NULL || degrees == NULL)
+   {
+      print_to_log("Error (countHostSignatures): malloc failure.\n");
+      exit(1);
+   }
+   for(index = 0; index < nodes; index++) order[index] = index;
+   qsort(order, nodes, sizeof(int), compareNodeIDs);
+   /* degrees holds the outdegree, indegree and number of loops of each node. */
+   for(index = 0; index < stats->edges; index++)
+   {
+      int source = findHostNode(order, stats->edge_ends[2 * index]);
+      int target = findHostNode(order, stats->edge_ends[2 * index + 1]);
+      if(source < 0 || target < 0) continue;
+      degrees[3 * source]++;
+      degrees[3 * target + 1]++;
+      if(source == target) degrees[3 * source + 2]++;
+   }
+   for(index = 0; index < nodes; index++)
+   {
+      MarkType mark = stats->node_marks[index];
+      if(mark < 0 || mark >= ANY) mark = NONE;
+      stats->signatures[SIGNATURE(mark, degrees[3 * index], degrees[3 * index + 1],
+                                  degrees[3 * index + 2], stats->node_roots[index])]++;
+   }
+   free(order);
+   free(degrees);
+   free(stats->node_ids);
+   free(stats->node_roots);
+   free(stats->node_marks);
+   free(stats->edge_ends);
+   free(label_atoms);
+   stats->node_ids = stats->edge_ends = NULL;
+   stats->node_roots = NULL;
+   stats->node_marks = NULL;
+   label_atoms = NULL;
+   label_capacity = 0;
 }
 
-static void traverseNode(Searchplan *searchplan, RuleNode *node, char type, 
-                  bool *tagged_nodes, bool *tagged_edges)
+/* ========================
+ * Searchplan Cost Model
+ * ======================== */
+/* A signature stores a degree exactly if it is less than SIG_DEGREE_CAP, in
+ * which case the signature alone decides if the host node passes the degree
+ * check. Otherwise the degree is only known to be at least SIG_DEGREE_CAP.
+ * degree_check is set to true if any of the returned signatures has a capped
+ * degree, which means the degree check must still be made at runtime. */
+int getSignatures(RuleNode *left_node, int *signatures, bool *degree_check)
 {
-   tagged_nodes[node->index] = true;
-   appendSearchOp(searchplan, type, node->index);
-   /* Search the node's incident edges for an untagged edge. Outedges
-    * are arbitrarily examined first. If no such edges exist, the function
-    * exits and control passes to the caller. */
-   RuleEdges *iterator = node->outedges;
-   while(iterator != NULL)
+   /* Count the loops incident to the rule node. Each of these must be matched
+    * to a distinct loop incident to the host node. */
+   int rule_loops = 0;
+   RuleEdges *iterator;
+   for(iterator = left_node->outedges; iterator != NULL; iterator = iterator->next)
+      if(iterator->edge->target == left_node) rule_loops++;
+   int rule_total = left_node->outdegree + left_node->indegree + left_node->bidegree;
+   /* Nodes deleted by the rule must satisfy the dangling condition. */
+   bool dangling = left_node->interface == NULL;
+
+   int first_mark = left_node->label.mark == ANY ? 0 : left_node->label.mark;
+   int last_mark = left_node->label.mark == ANY ? ANY - 1 : left_node->label.mark;
+   int mark, out, in, loops, root, count = 0;
+   *degree_check = false;
+   for(mark = first_mark; mark <= last_mark; mark++)
    {
-      RuleEdge *edge = iterator->edge;
-      if(!tagged_edges[edge->index])
+      for(out = 0; out <= SIG_DEGREE_CAP; out++)
       {
-         if(edge->source == edge->target) 
-              traverseEdge(searchplan, edge, 'l', tagged_nodes, tagged_edges);
-         else traverseEdge(searchplan, edge, 's', tagged_nodes, tagged_edges);
+         for(in = 0; in <= SIG_DEGREE_CAP; in++)
+         {
+            bool out_capped = out == SIG_DEGREE_CAP, in_capped = in == SIG_DEGREE_CAP;
+            if(!out_capped && out < left_node->outdegree) continue;
+            if(!in_capped && in < left_node->indegree) continue;
+            if(!out_capped && !in_capped && out + in < rule_total) continue;
+            /* Capped degrees are lower bounds on the host node's degrees. */
+            if(dangling && (out + in > rule_total || out > rule_total - left_node->indegree
+                            || in > rule_total - left_node->outdegree)) continue;
+            for(loops = SIG_CAPPED(rule_loops, SIG_LOOP_CAP); loops <= SIG_LOOP_CAP; loops++)
+            {
+               /* Each loop counts towards both degrees of the host node. */
+               if((!out_capped && loops > out) || (!in_capped && loops > in)) continue;
+               for(root = left_node->root ? 1 : 0; root <= 1; root++)
+               {
+                  signatures[count++] = SIGNATURE(mark, out, in, loops, root);
+                  if(out_capped || in_capped) *degree_check = true;
+               }
+            }
+         }
       }
-      iterator = iterator->next;
    }
-   iterator = node->inedges;
-   while(iterator != NULL)
+   return count;
+}
+
+/* Every count is incremented by one so that the estimates are defined for an
+ * empty host graph, where they reduce to comparing how constrained the rule
+ * items are. */
+
+/* The fraction of host labels compatible with the rule label: the fraction
+ * with a suitable length, times the fraction containing each constant atom
+ * of the rule label. */
+static double labelSelectivity(RuleLabel label, LabelStatistics *labels)
+{
+   int atoms = 0, length;
+   bool list_variable = false;
+   double selectivity = 1.0;
+   RuleListItem *item;
+   for(item = label.list == NULL ? NULL : label.list->first; item != NULL; item = item->next)
    {
-      RuleEdge *edge = iterator->edge;
-      if(!tagged_edges[edge->index])
+      RuleAtom *atom = item->atom;
+      if(atom->type == VARIABLE && atom->variable.type == LIST_VAR) 
       {
-         if(edge->source == edge->target)
-              traverseEdge(searchplan, edge, 'l', tagged_nodes, tagged_edges);
-         else traverseEdge(searchplan, edge, 't', tagged_nodes, tagged_edges);
+         list_variable = true;
+         continue;
       }
-      iterator = iterator->next;
+      atoms++;
+      unsigned int hash;
+      if(atom->type == INTEGER_CONSTANT) hash = hashInteger(atom->number);
+      else if(atom->type == NEG && atom->neg_exp->type == INTEGER_CONSTANT)
+         hash = hashInteger(-(atom->neg_exp->number));
+      else if(atom->type == STRING_CONSTANT) hash = hashString(atom->string);
+      else continue;
+      selectivity *= (labels->atoms[hash % HOST_ATOM_BUCKETS] + 1.0) / (labels->items + 1.0);
+   }
+   int matching = 0;
+   if(list_variable)
+   {
+      for(length = atoms < HOST_LENGTH_CAP ? atoms : HOST_LENGTH_CAP; 
+          length <= HOST_LENGTH_CAP; length++) 
+         matching += labels->lengths[length];
+   }
+   else matching = labels->lengths[atoms < HOST_LENGTH_CAP ? atoms : HOST_LENGTH_CAP];
+   selectivity *= (matching + 1.0) / (labels->items + 1.0);
+   return selectivity > 1.0 ? 1.0 : selectivity;
+}
+
+/* The estimated number of host nodes that match the rule node. */
+static double nodeCandidates(RuleNode *node)
+{
+   int signatures[NUMBER_OF_SIGNATURES];
+   bool degree_check;
+   int count = getSignatures(node, signatures, &degree_check), index;
+   double candidates = 0.0;
+   for(index = 0; index < count; index++) 
+      candidates += host_statistics.signatures[signatures[index]] + 1.0;
+   return candidates * labelSelectivity(node->label, &(host_statistics.node_labels));
+}
+
+/* The estimated probability that a host node matches the rule node. */
+static double nodeProbability(RuleNode *node)
+{
+   return nodeCandidates(node) / (host_statistics.nodes + NUMBER_OF_SIGNATURES);
+}
+
+/* The estimated number of host edges that match the rule edge among the edges
+ * of a host node in the direction the edge is searched from. */
+static double edgeCandidates(RuleEdge *edge)
+{
+   HostStatistics *stats = &host_statistics;
+   double candidates;
+   if(edge->source == edge->target) 
+      candidates = (stats->loops + 1.0) / (stats->nodes + 1.0);
+   else 
+   {
+      candidates = (stats->edges + 1.0) / (stats->nodes + 1.0);
+      /* A bidirectional edge is searched in both directions. */
+      if(edge->bidirectional) candidates *= 2;
    }
+   if(edge->label.mark != ANY) 
+      candidates *= (stats->edge_marks[edge->label.mark] + 1.0) / (stats->edges + ANY);
+   return candidates * labelSelectivity(edge->label, &(stats->edge_labels));
 }
 
-static void traverseEdge(Searchplan *searchplan, RuleEdge *edge, char type,
-                  bool *tagged_nodes, bool *tagged_edges)
+/* The number of host nodes with the given mark, or of all host nodes if the
+ * mark is ANY, counted as in nodeCandidates. */
+static double markCount(MarkType mark)
 {
-   tagged_edges[edge->index] = true;
-   appendSearchOp(searchplan, type, edge->index);
+   if(mark == ANY) return host_statistics.nodes + NUMBER_OF_SIGNATURES;
+   int signature, count = 0;
+   for(signature = 0; signature < NUMBER_OF_SIGNATURES; signature++)
+      if(SIGNATURE_MARK(signature) == (int)mark) count += host_statistics.signatures[signature] + 1;
+   return count;
+}
 
-   /* If the edge is a loop, its incident node has already been examined. 
-    * Backtrack by returning control to the caller. */
-   if(type == 'l') return;
+/* Builds the searchplan described in searchplan.h, starting from the given
+ * node if it is not NULL. The estimated number of partial matches after each
+ * operation is summed to give the cost of the searchplan. */
+static Searchplan *buildSearchplan(RuleGraph *lhs, RuleNode *start)
+{
+   countHostSignatures();
+   Searchplan *searchplan = makeSearchplan();
+   double partial_matches = 1.0, cost = 0.0;
+   bool tagged_nodes[lhs->node_index]; 
+   bool tagged_edges[lhs->edge_index];  
+   int index;
+   for(index = 0; index < lhs->node_index; index++) tagged_nodes[index] = false;
+   for(index = 0; index < lhs->edge_index; index++) tagged_edges[index] = false;
 
-   /* Continue the graph traversal of any untagged nodes incident to the edge. */
-   if(type == 's')
+   while(true)
    {
-      RuleNode *target = edge->target;
-      if(!tagged_nodes[target->index])
+      /* Step (2): the cheapest edge incident to a tagged node. */
+      RuleEdge *best_edge = NULL;
+      double best_cost = 0.0;
+      for(index = 0; index < lhs->edge_index; index++)
+      {
+         if(tagged_edges[index]) continue;
+         RuleEdge *edge = getRuleEdge(lhs, index);
+         bool source_tagged = tagged_nodes[edge->source->index];
+         bool target_tagged = tagged_nodes[edge->target->index];
+         if(!source_tagged && !target_tagged) continue;
+         double cost = edgeCandidates(edge);
+         if(edge->source != edge->target)
+         {
+            /* If both end nodes are matched, one host node in all can be the
+             * other end of the host edge. */
+            if(source_tagged && target_tagged) cost /= host_statistics.nodes + 1.0;
+            else cost *= nodeProbability(source_tagged ? edge->target : edge->source);
+         }
+         if(best_edge == NULL || cost < best_cost)
+         {
+            best_edge = edge;
+            best_cost = cost;
+         }
+      }
+      if(best_edge != NULL)
       {
-         if(edge->bidirectional) 
-              traverseNode(searchplan, target, 'b', tagged_nodes, tagged_edges);
-         else traverseNode(searchplan, target, 'i', tagged_nodes, tagged_edges);
+         partial_matches *= best_cost;
+         cost += partial_matches;
+         RuleNode *source = best_edge->source, *target = best_edge->target;
+         tagged_edges[best_edge->index] = true;
+         if(source == target) appendSearchOp(searchplan, 'l', best_edge->index);
+         else if(tagged_nodes[source->index])
+         {
+            appendSearchOp(searchplan, 's', best_edge->index);
+            if(!tagged_nodes[target->index])
+            {
+               tagged_nodes[target->index] = true;
+               appendSearchOp(searchplan, best_edge->bidirectional ? 'b' : 'i', 
+                              target->index);
+            }
+         }
+         else
+         {
+            appendSearchOp(searchplan, 't', best_edge->index);
+            tagged_nodes[source->index] = true;
+            appendSearchOp(searchplan, best_edge->bidirectional ? 'b' : 'o', 
+                           source->index);
+         }
+         continue;
       }
-   }      
-   else /* type == 't' */ 
+      /* Step (1): the untagged node with the fewest candidates, roots first. */
+      RuleNode *best_node = NULL;
+      if(start != NULL && !tagged_nodes[start->index])
+      {
+         best_node = start;
+         best_cost = nodeCandidates(start);
+      }
+      else for(index = 0; index < lhs->node_index; index++)
+      {
+         if(tagged_nodes[index]) continue;
+         RuleNode *node = getRuleNode(lhs, index);
+         double cost = nodeCandidates(node);
+         if(best_node == NULL || (node->root && !best_node->root) ||
+            (node->root == best_node->root && cost < best_cost))
+         {
+            best_node = node;
+            best_cost = cost;
+         }
+      }
+      if(best_node == NULL) break;
+      partial_matches *= best_cost;
+      cost += partial_matches;
+      tagged_nodes[best_node->index] = true;
+      appendSearchOp(searchplan, best_node->root ? 'r' : 'n', best_node->index);
+   }
+   /* The first node's candidates are the factor of the cost known at runtime. */
+   if(searchplan->first != NULL) 
    {
-      RuleNode *source = edge->source;
-      if(!tagged_nodes[source->index])
+      RuleNode *first = getRuleNode(lhs, searchplan->first->index);
+      searchplan->weight = first->root ? cost : cost / markCount(first->label.mark);
+      /* The weight is written into the generated code, so it must be finite. */
+      if(!(searchplan->weight < 1e300)) searchplan->weight = 1e300;
+   }
+   return searchplan;
+}
+
+Searchplan *generateSearchplan(RuleGraph *lhs)
+{
+   return buildSearchplan(lhs, NULL);
+}
+
+int generateSearchplans(RuleGraph *lhs, Searchplan **plans)
+{
+   plans[0] = buildSearchplan(lhs, NULL);
+   if(plans[0]->first == NULL || plans[0]->first->type == 'r') return 1;
+   int count = 1, index;
+   MarkType mark;
+   for(mark = NONE; mark <= ANY; mark++)
+   {
+      if(mark == getRuleNode(lhs, plans[0]->first->index)->label.mark) continue;
+      RuleNode *start = NULL;
+      double best_cost = 0.0;
+      for(index = 0; index < lhs->node_index; index++)
       {
-         if(edge->bidirectional) 
-              traverseNode(searchplan, source, 'b', tagged_nodes, tagged_edges);
-         else traverseNode(searchplan, source, 'o', tagged_nodes, tagged_edges);  
+         RuleNode *node = getRuleNode(lhs, index);
+         if(node->label.mark != mark) continue;
+         double cost = nodeCandidates(node);
+         if(start == NULL || cost < best_cost)
+         {
+            start = node;
+            best_cost = cost;
+         }
       }
+      if(start != NULL) plans[count++] = buildSearchplan(lhs, start);
    }
+   return count;
 }
 
 void printSearchplan(Searchplan *plan)
@@ -21,7 +21,7 @@
 
   Defines a data structure for searchplans and functions operating on this
   data structure. Also defines a function to construct a static searchplan
-  from a graph.
+  from a graph, and the host graph statistics it uses to order the search.
 
 /////////////////////////////////////////////////////////////////////////// */
 
@@ -52,30 +52,86 @@ typedef struct SearchOp {
 } SearchOp;
 
 /* Operations are appended to the searchplan, so a pointer to the last
- * searchplan operation is maintained for efficiency. */
+ * searchplan operation is maintained for efficiency. The estimated cost of
+ * the searchplan is weight times the number of host nodes with the mark of
+ * the first rule node (all host nodes if the mark is ANY), which is the part
+ * of the estimate that is counted again at runtime. */
 typedef struct Searchplan {
    SearchOp *first;
    SearchOp *last;
+   double weight;
 } Searchplan;
 
-/* generateSearchplan traverses a graph in order to create a searchplan
- * using the following algorithm:
- * (1) Walk the graph in a depth-first manner starting at the root nodes. 
- *     Tag each item, including the initial root node, when it is encountered.
- *     If the next item in the traversal is untagged, tag it and append the
- *     appropriate operation to the searchplan. For instance, if we examine an
- *     outgoing edge of a root node, add the 's' operation to the searchplan.
- *     Once this step is complete, all connected components containing root
- *     nodes have been examined.
- * (2) Scan the node list of the graph, performing step 2 on any untagged nodes.
- *     Unnecessary if the input graph is root-connected.
- *
- * The depth-first search is performed by recursive calls to traverseNode and
- * traverseEdge. These two functions are responsible for checking if items
- * are tagged, tagging items, and adding new operations to the searchplan. */ 
+/* Statistics of the input host graph, collected by the parser (see the host
+ * graph grammar in gpParser.y) and used to estimate the number of host items
+ * each search operation yields. The estimates only order the searchplan, so
+ * the counts may be approximate: atom frequencies are counted in a fixed 
+ * number of hash buckets, and labels of length HOST_LENGTH_CAP or more share
+ * a count. */
+#define HOST_LENGTH_CAP 4
+#define HOST_ATOM_BUCKETS 1024
+
+typedef struct LabelStatistics {
+   int items;
+   int lengths[HOST_LENGTH_CAP + 1];
+   int atoms[HOST_ATOM_BUCKETS];
+} LabelStatistics;
+
+typedef struct HostStatistics {
+   LabelStatistics node_labels, edge_labels;
+   /* The number of host nodes with each signature (see SIGNATURE in globals.h),
+    * the number of host edges with each mark, and the number of loops. */
+   int signatures[NUMBER_OF_SIGNATURES];
+   int edge_marks[ANY];
+   int loops;
+   /* The node IDs, roots and marks and the edge end points are kept until the
+    * degrees of the nodes, and hence their signatures, are counted. */
+   int *node_ids, *edge_ends;
+   bool *node_roots;
+   MarkType *node_marks;
+   int nodes, node_capacity, edges, edge_capacity;
+   bool counted;
+} HostStatistics;
+
+extern HostStatistics host_statistics;
 
+/* The parser records the atoms and mark of a host label before the node or
+ * edge it belongs to. */
+void recordHostInteger(int number);
+void recordHostString(string string);
+void recordHostMark(int mark);
+void recordHostNode(int id, bool root);
+void recordHostEdge(int source, int target);
+
+/* Computes the signatures of the host nodes that can match the rule node, 
+ * writes them to the signatures array, and returns the number of signatures
+ * written. The array must have space for NUMBER_OF_SIGNATURES items. */
+int getSignatures(RuleNode *left_node, int *signatures, bool *degree_check);
+
+/* generateSearchplan orders the search greedily by the estimated number of
+ * partial matches after each operation:
+ * (1) If no LHS item is tagged yet, or no untagged edge is incident to a
+ *     tagged node, tag the untagged node with the fewest estimated candidate
+ *     host nodes, taking root nodes first because the host graph's root list
+ *     is usually short. Append an 'r' or 'n' operation.
+ * (2) Otherwise, tag the untagged edge incident to a tagged node that is
+ *     expected to leave the fewest partial matches, counting the edges of a
+ *     host node with a compatible mark and label and the chance that its 
+ *     other end node matches. Append the 's', 't' or 'l' operation, followed
+ *     by the 'i', 'o' or 'b' operation for its end node if that is untagged.
+ * (3) Repeat until every item is tagged.
+ * An edge between two tagged nodes only filters the partial matches, so it 
+ * is taken as soon as possible. */
 Searchplan *generateSearchplan(RuleGraph *lhs);
 
+/* Writes alternative searchplans for the LHS to plans and returns how many
+ * were written. The first is the searchplan returned by generateSearchplan.
+ * If the LHS has no root node, it is followed by the cheapest searchplan
+ * starting from a node of each other mark in the LHS: a mark that becomes
+ * rare in the host graph at runtime makes the searchplans starting from it
+ * cheaper. plans must have space for ANY + 1 searchplans. */
+int generateSearchplans(RuleGraph *lhs, Searchplan **plans);
+
 void printSearchplan(Searchplan *searchplan);
 void freeSearchplan(Searchplan *searchplan);
 #endif /* INC_SEARCHPLAN_H */